@@ -13,6 +13,15 @@ SET SOURCE=source/zx_engine.cpp
 SET LIBS=-L%VULKAN_SDK%\Lib 
 SET TARGET=zxengine.exe
 
+:: Shaders
+for %%f in (shaders\*.comp) do (
+    %VULKAN_SDK%\Bin\glslc.exe %%f -o %%f.spv
+    IF ERRORLEVEL 1 (
+        echo Shader compilation failed.
+        exit /b 1
+    )
+)
+
 :: Build
 %COMPILER% %CFLAGS% %DEFINES% %INCLUDES% %SOURCE%   %LIBS% -o %TARGET%
 
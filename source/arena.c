@@ -0,0 +1,176 @@
+#include "arena.h"
+#include "debug.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Backing blocks are cache-line aligned so per-thread arenas never share a line
+#define ARENA_BLOCK_ALIGN 64
+
+// ARENA //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ArenaInit(Arena* arena, size_t capacity, const char* name)
+{
+    memset(arena, 0, sizeof(*arena));
+
+    capacity = (capacity + ARENA_BLOCK_ALIGN - 1) & ~(size_t)(ARENA_BLOCK_ALIGN - 1);
+#ifdef _WIN32
+    arena->base = (uint8_t*)_aligned_malloc(capacity, ARENA_BLOCK_ALIGN);
+#else
+    arena->base = (uint8_t*)aligned_alloc(ARENA_BLOCK_ALIGN, capacity);
+#endif
+    if (!arena->base) {
+        PRINT_ERROR("Arena %s: failed to allocate %zu bytes\n", name ? name : "?", capacity);
+        return false;
+    }
+
+    arena->capacity = capacity;
+    arena->name = name;
+    arena->owned = true;
+    return true;
+}
+
+void ArenaInitBuffer(Arena* arena, void* memory, size_t capacity, const char* name)
+{
+    memset(arena, 0, sizeof(*arena));
+    arena->base = (uint8_t*)memory;
+    arena->capacity = capacity;
+    arena->name = name;
+}
+
+void ArenaDestroy(Arena* arena)
+{
+    if (arena->owned && arena->base) {
+#ifdef _WIN32
+        _aligned_free(arena->base);
+#else
+        free(arena->base);
+#endif
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+void* ArenaAlloc(Arena* arena, size_t size, size_t align)
+{
+    // Align the address, not the offset, so buffers handed in by the caller work too
+    uintptr_t current = (uintptr_t)arena->base + arena->used;
+    uintptr_t aligned = (current + (align - 1)) & ~(uintptr_t)(align - 1);
+    size_t offset = (size_t)(aligned - (uintptr_t)arena->base);
+
+    if (offset + size > arena->capacity) {
+        if (arena->failures++ == 0) {
+            PRINT_WARNING("Arena %s: out of memory (%zu of %zu bytes used, %zu requested)\n",
+                          arena->name ? arena->name : "?", arena->used, arena->capacity, size);
+        }
+        return NULL;
+    }
+
+    arena->used = offset + size;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    return (void*)aligned;
+}
+
+void* ArenaAllocZero(Arena* arena, size_t size, size_t align)
+{
+    void* memory = ArenaAlloc(arena, size, align);
+    if (memory) {
+        memset(memory, 0, size);
+    }
+    return memory;
+}
+
+char* ArenaStrdup(Arena* arena, const char* str)
+{
+    size_t length = strlen(str) + 1;
+    char* copy = (char*)ArenaAlloc(arena, length, 1);
+    if (copy) {
+        memcpy(copy, str, length);
+    }
+    return copy;
+}
+
+ArenaMarker ArenaMark(const Arena* arena)
+{
+    return arena->used;
+}
+
+void ArenaRewind(Arena* arena, ArenaMarker marker)
+{
+    assert(marker <= arena->used);
+    arena->used = marker;
+}
+
+void ArenaReset(Arena* arena)
+{
+    arena->used = 0;
+}
+
+// FRAME ARENA ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool FrameArenaInit(FrameArena* frame_arena, uint32_t frame_count, uint32_t thread_count, size_t capacity_per_thread)
+{
+    memset(frame_arena, 0, sizeof(*frame_arena));
+
+    if (frame_count < 1) frame_count = 1;
+    if (frame_count > FRAME_ARENA_MAX_FRAMES) frame_count = FRAME_ARENA_MAX_FRAMES;
+
+    uint32_t arena_count = frame_count * thread_count;
+    frame_arena->arenas = (Arena*)calloc(arena_count, sizeof(Arena));
+    if (!frame_arena->arenas) {
+        PRINT_ERROR("FrameArena: failed to allocate %u arenas\n", arena_count);
+        return false;
+    }
+
+    frame_arena->frameCount = frame_count;
+    frame_arena->threadCount = thread_count;
+
+    for (uint32_t i = 0; i < arena_count; i++) {
+        if (!ArenaInit(&frame_arena->arenas[i], capacity_per_thread, "frame")) {
+            FrameArenaDestroy(frame_arena);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FrameArenaDestroy(FrameArena* frame_arena)
+{
+    if (frame_arena->arenas) {
+        for (uint32_t i = 0; i < frame_arena->frameCount * frame_arena->threadCount; i++) {
+            ArenaDestroy(&frame_arena->arenas[i]);
+        }
+        free(frame_arena->arenas);
+    }
+    memset(frame_arena, 0, sizeof(*frame_arena));
+}
+
+void FrameArenaBegin(FrameArena* frame_arena, uint64_t frame_index)
+{
+    Arena* slot = &frame_arena->arenas[(frame_index % frame_arena->frameCount) * frame_arena->threadCount];
+
+    // Record what the slot's previous frame used before throwing it away
+    size_t frame_used = 0;
+    for (uint32_t t = 0; t < frame_arena->threadCount; t++) {
+        frame_used += slot[t].used;
+        ArenaReset(&slot[t]);
+    }
+
+    if (frame_used > frame_arena->peak) {
+        frame_arena->peak = frame_used;
+    }
+}
+
+Arena* FrameArenaGet(FrameArena* frame_arena, uint64_t frame_index, uint32_t thread)
+{
+    assert(thread < frame_arena->threadCount);
+    return &frame_arena->arenas[(frame_index % frame_arena->frameCount) * frame_arena->threadCount + thread];
+}
+
+void* FrameArenaAlloc(FrameArena* frame_arena, uint64_t frame_index, uint32_t thread, size_t size, size_t align)
+{
+    return ArenaAlloc(FrameArenaGet(frame_arena, frame_index, thread), size, align);
+}
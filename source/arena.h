@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Linear allocator over one fixed block. Allocation is a pointer bump, nothing is freed
+// individually; memory is released by rewinding to a marker or resetting the whole arena.
+typedef struct Arena {
+    uint8_t*    base;
+    size_t      capacity;
+    size_t      used;
+    size_t      peak;           // Highest 'used' seen since init
+    size_t      failures;       // Allocations that did not fit
+    const char* name;
+    bool        owned;          // base was allocated by ArenaInit
+} Arena;
+
+typedef size_t ArenaMarker;
+
+bool  ArenaInit(Arena* arena, size_t capacity, const char* name);
+void  ArenaInitBuffer(Arena* arena, void* memory, size_t capacity, const char* name);
+void  ArenaDestroy(Arena* arena);
+
+// Returns NULL when the arena is exhausted; align must be a power of two
+void* ArenaAlloc(Arena* arena, size_t size, size_t align);
+void* ArenaAllocZero(Arena* arena, size_t size, size_t align);
+char* ArenaStrdup(Arena* arena, const char* str);
+
+ArenaMarker ArenaMark(const Arena* arena);
+void  ArenaRewind(Arena* arena, ArenaMarker marker);
+void  ArenaReset(Arena* arena);
+
+#define ARENA_NEW(arena, type, count) ((type*)ArenaAlloc((arena), sizeof(type) * (count), alignof(type)))
+
+#define FRAME_ARENA_MAX_FRAMES 4
+
+// One arena per frame in flight per thread. Beginning a frame resets the arenas that frame last
+// used framesInFlight frames ago, so transient data lives exactly as long as its frame.
+typedef struct FrameArena {
+    Arena*   arenas;            // [frame slot][thread]
+    uint32_t frameCount;
+    uint32_t threadCount;
+    size_t   peak;              // Largest total used by a single frame across all threads
+} FrameArena;
+
+bool   FrameArenaInit(FrameArena* frame_arena, uint32_t frame_count, uint32_t thread_count, size_t capacity_per_thread);
+void   FrameArenaDestroy(FrameArena* frame_arena);
+
+// Call once per frame before any thread allocates for it. The previous user of the slot
+// (frame_index - frame_count) must be completely finished.
+void   FrameArenaBegin(FrameArena* frame_arena, uint64_t frame_index);
+
+// Arena of one thread for one frame; only that thread may allocate from it
+Arena* FrameArenaGet(FrameArena* frame_arena, uint64_t frame_index, uint32_t thread);
+void*  FrameArenaAlloc(FrameArena* frame_arena, uint64_t frame_index, uint32_t thread, size_t size, size_t align);
+
+#ifdef __cplusplus
+
+#include <new>
+
+namespace ZX {
+
+// Lets STL containers draw from an arena; deallocate is a no-op, memory returns on rewind/reset
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    Arena* arena;
+
+    explicit ArenaAllocator(Arena* a) noexcept : arena(a) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    T* allocate(size_t n)
+    {
+        void* memory = ArenaAlloc(arena, n * sizeof(T), alignof(T));
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T*, size_t) noexcept {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena == other.arena; }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return arena != other.arena; }
+};
+
+} // namespace ZX
+
+#endif
@@ -0,0 +1,887 @@
+#include "bench.h"
+#include "vmath.h"
+#include "arena.h"
+#include "culling.h"
+#include "jobs.h"
+#include "pool.h"
+#include "debug.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace ZX {
+
+namespace {
+
+// HARNESS /////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Results are folded into this so the compiler cannot drop the timed work
+volatile float g_benchSink;
+
+// xorshift32, so runs are reproducible
+struct BenchRandom {
+    uint32_t state = 0x9E3779B9u;
+
+    uint32_t Next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Uniform in [lo, hi)
+    float Range(float lo, float hi) { return lo + (hi - lo) * (float)(Next() >> 8) * (1.0f / 16777216.0f); }
+};
+
+double BenchNow()
+{
+    static LARGE_INTEGER frequency = {};
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+// Best time of several runs of fn, in nanoseconds per item; the best run is the one least disturbed
+// by the rest of the system
+template <typename F>
+double BenchNs(uint32_t items, uint32_t runs, const F& fn)
+{
+    double best = 1e30;
+    for (uint32_t run = 0; run < runs; run++) {
+        double start = BenchNow();
+        fn();
+        double elapsed = BenchNow() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+    return best * 1e9 / (double)items;
+}
+
+// Prints one old-vs-new row; returns 1 when the results differ by more than tolerance
+int BenchReport(const char* name, double old_ns, double new_ns, float error, float tolerance)
+{
+    bool failed = !(error <= tolerance);
+    PRINT("  %-24s %9.2f ns -> %9.2f ns  %5.2fx   max error %.1e%s\n", name, old_ns, new_ns,
+          new_ns > 0.0 ? old_ns / new_ns : 0.0, error, failed ? "  FAILED" : "");
+    return failed ? 1 : 0;
+}
+
+float MaxError(const mat4& a, const mat4& b)
+{
+    float error = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        error = fmaxf(error, fabsf(a.m[i] - b.m[i]));
+    }
+    return error;
+}
+
+mat4 RandomMatrix(BenchRandom& random)
+{
+    mat4 m;
+    for (int i = 0; i < 16; i++) {
+        m.m[i] = random.Range(-1.0f, 1.0f);
+    }
+    return m;
+}
+
+// MATRIX KERNELS //////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The scalar matrix code the SIMD kernels replaced, kept as the reference
+mat4 ScalarMul(const mat4& a, const mat4& b)
+{
+    mat4 out;
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            out.idx[r][c] = a.idx[r][0] * b.idx[0][c] + a.idx[r][1] * b.idx[1][c] +
+                            a.idx[r][2] * b.idx[2][c] + a.idx[r][3] * b.idx[3][c];
+        }
+    }
+    return out;
+}
+
+mat4 ScalarMulf(const mat4& in, float f)
+{
+    mat4 out;
+    for (int i = 0; i < 16; i++) {
+        out.m[i] = in.m[i] * f;
+    }
+    return out;
+}
+
+mat4 ScalarTranspose(const mat4& in)
+{
+    mat4 out;
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            out.idx[r][c] = in.idx[c][r];
+        }
+    }
+    return out;
+}
+
+mat4 ScalarIdentity()
+{
+    mat4 m = {0};
+    m.idx[0][0] = m.idx[1][1] = m.idx[2][2] = m.idx[3][3] = 1.0f;
+    return m;
+}
+
+mat4 ScalarTranslate(const mat4& in, float x, float y, float z)
+{
+    mat4 trans = ScalarIdentity();
+    trans.idx[0][3] = x;
+    trans.idx[1][3] = y;
+    trans.idx[2][3] = z;
+    return ScalarMul(in, trans);
+}
+
+mat4 ScalarScale(const mat4& in, float x, float y, float z)
+{
+    mat4 scaling = {0};
+    scaling.idx[0][0] = x;
+    scaling.idx[1][1] = y;
+    scaling.idx[2][2] = z;
+    scaling.idx[3][3] = 1.0f;
+    return ScalarMul(in, scaling);
+}
+
+mat4 ScalarRotateY(const mat4& in, float angle_rad)
+{
+    float s = sinf(angle_rad);
+    float c = cosf(angle_rad);
+    mat4 rot = {0};
+    rot.idx[0][0] = c;
+    rot.idx[0][2] = s;
+    rot.idx[1][1] = 1.0f;
+    rot.idx[2][0] = -s;
+    rot.idx[2][2] = c;
+    rot.idx[3][3] = 1.0f;
+    return ScalarMul(in, rot);
+}
+
+mat4 ScalarRotate(const mat4& in, const vec3& axis, float angle_rad)
+{
+    float s = sinf(angle_rad);
+    float c = cosf(angle_rad);
+    float nc = 1.0f - c;
+    float inv_len = 1.0f / sqrtf(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+    float x = axis.x * inv_len, y = axis.y * inv_len, z = axis.z * inv_len;
+
+    mat4 rot = {0};
+    rot.idx[0][0] = x * x * nc + c;
+    rot.idx[0][1] = x * y * nc - s * z;
+    rot.idx[0][2] = x * z * nc + s * y;
+    rot.idx[1][0] = y * x * nc + s * z;
+    rot.idx[1][1] = y * y * nc + c;
+    rot.idx[1][2] = y * z * nc - s * x;
+    rot.idx[2][0] = z * x * nc - s * y;
+    rot.idx[2][1] = z * y * nc + s * x;
+    rot.idx[2][2] = z * z * nc + c;
+    rot.idx[3][3] = 1.0f;
+    return ScalarMul(in, rot);
+}
+
+// Times old and new over the same inputs and compares every result
+template <typename Old, typename New>
+int BenchMatrixOp(const char* name, const std::vector<mat4>& a, const std::vector<mat4>& b, const Old& old_fn,
+                  const New& new_fn)
+{
+    const uint32_t count = (uint32_t)a.size();
+    std::vector<mat4> old_out(count), new_out(count);
+
+    double old_ns = BenchNs(count, 20, [&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            old_out[i] = old_fn(a[i], b[i]);
+        }
+    });
+    double new_ns = BenchNs(count, 20, [&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            new_out[i] = new_fn(a[i], b[i]);
+        }
+    });
+
+    float error = 0.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        error = fmaxf(error, MaxError(old_out[i], new_out[i]));
+    }
+    g_benchSink = g_benchSink + old_out[count - 1].m[5] + new_out[count - 1].m[10];
+    return BenchReport(name, old_ns, new_ns, error, 1e-5f);
+}
+
+int BenchMatrix()
+{
+    const uint32_t count = 4096;
+    BenchRandom random;
+    std::vector<mat4> a(count), b(count);
+    for (uint32_t i = 0; i < count; i++) {
+        a[i] = RandomMatrix(random);
+        b[i] = RandomMatrix(random);
+    }
+
+    PRINT("Matrix kernels, %u matrices, ns per call (scalar -> SIMD):\n", count);
+    int failures = 0;
+    failures += BenchMatrixOp("m4_mul", a, b,
+        [](const mat4& x, const mat4& y) { return ScalarMul(x, y); },
+        [](const mat4& x, const mat4& y) { return m4_mul(x, y); });
+    failures += BenchMatrixOp("m4_mulf", a, b,
+        [](const mat4& x, const mat4& y) { return ScalarMulf(x, y.m[0]); },
+        [](const mat4& x, const mat4& y) { return m4_mulf(x, y.m[0]); });
+    failures += BenchMatrixOp("transpose", a, b,
+        [](const mat4& x, const mat4&) { return ScalarTranspose(x); },
+        [](const mat4& x, const mat4&) { return transpose(x); });
+    failures += BenchMatrixOp("translate", a, b,
+        [](const mat4& x, const mat4& y) { return ScalarTranslate(x, y.m[0], y.m[1], y.m[2]); },
+        [](const mat4& x, const mat4& y) { return translate(x, y.m[0], y.m[1], y.m[2]); });
+    failures += BenchMatrixOp("scale", a, b,
+        [](const mat4& x, const mat4& y) { return ScalarScale(x, y.m[0], y.m[1], y.m[2]); },
+        [](const mat4& x, const mat4& y) { return scale(x, y.m[0], y.m[1], y.m[2]); });
+    failures += BenchMatrixOp("rotateY", a, b,
+        [](const mat4& x, const mat4& y) { return ScalarRotateY(x, y.m[0] * 3.0f); },
+        [](const mat4& x, const mat4& y) { return rotateY(x, y.m[0] * 3.0f); });
+    failures += BenchMatrixOp("rotate", a, b,
+        [](const mat4& x, const mat4& y) {
+            vec3 axis = { y.m[0], y.m[1], y.m[2] + 2.0f };
+            return ScalarRotate(x, axis, y.m[3] * 3.0f);
+        },
+        [](const mat4& x, const mat4& y) {
+            vec3 axis = { y.m[0], y.m[1], y.m[2] + 2.0f };
+            return rotate(x, axis, y.m[3] * 3.0f);
+        });
+    return failures;
+}
+
+// BATCH FUNCTIONS /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int BenchBatch()
+{
+    const uint32_t count = 65536;
+    BenchRandom random;
+    std::vector<vec3> points(count);
+    std::vector<float> x(count), y(count), z(count), out_x(count), out_y(count), out_z(count);
+    for (uint32_t i = 0; i < count; i++) {
+        points[i] = { random.Range(-100.0f, 100.0f), random.Range(-100.0f, 100.0f), random.Range(-100.0f, 100.0f) };
+        x[i] = points[i].x;
+        y[i] = points[i].y;
+        z[i] = points[i].z;
+    }
+    // Zero-length vectors must come through normalization untouched
+    points[7] = { 0.0f, 0.0f, 0.0f };
+    x[7] = y[7] = z[7] = 0.0f;
+    v3_soa in = { x.data(), y.data(), z.data() };
+    v3_soa out = { out_x.data(), out_y.data(), out_z.data() };
+    std::vector<vec3> expected(count);
+
+    PRINT("Batch functions, %u elements, ns per element (per-element loop -> batch):\n", count);
+    int failures = 0;
+
+    BenchRandom matrix_random;
+    mat4 m = RandomMatrix(matrix_random);
+    double old_ns = BenchNs(count, 20, [&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            vec3 p = points[i];
+            expected[i].x = m.idx[0][0] * p.x + m.idx[0][1] * p.y + m.idx[0][2] * p.z + m.idx[0][3];
+            expected[i].y = m.idx[1][0] * p.x + m.idx[1][1] * p.y + m.idx[1][2] * p.z + m.idx[1][3];
+            expected[i].z = m.idx[2][0] * p.x + m.idx[2][1] * p.y + m.idx[2][2] * p.z + m.idx[2][3];
+        }
+    });
+    double new_ns = BenchNs(count, 20, [&]() { m4_transform_points(m, in, out, count); });
+    float error = 0.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        error = fmaxf(error, fmaxf(fabsf(expected[i].x - out_x[i]),
+                                   fmaxf(fabsf(expected[i].y - out_y[i]), fabsf(expected[i].z - out_z[i]))));
+    }
+    failures += BenchReport("m4_transform_points", old_ns, new_ns, error, 1e-3f);
+
+    old_ns = BenchNs(count, 20, [&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            expected[i] = v3_normalize(points[i]);
+        }
+    });
+    new_ns = BenchNs(count, 20, [&]() { v3_normalize_batch(in, out, count); });
+    error = 0.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        error = fmaxf(error, fmaxf(fabsf(expected[i].x - out_x[i]),
+                                   fmaxf(fabsf(expected[i].y - out_y[i]), fabsf(expected[i].z - out_z[i]))));
+    }
+    failures += BenchReport("v3_normalize_batch", old_ns, new_ns, error, 1e-5f);
+
+    const uint32_t matrices = 4096;
+    std::vector<mat4> a(matrices), b(matrices), product(matrices), batched(matrices);
+    for (uint32_t i = 0; i < matrices; i++) {
+        a[i] = RandomMatrix(random);
+        b[i] = RandomMatrix(random);
+    }
+    old_ns = BenchNs(matrices, 20, [&]() {
+        for (uint32_t i = 0; i < matrices; i++) {
+            product[i] = m4_mul(a[i], b[i]);
+        }
+    });
+    new_ns = BenchNs(matrices, 20, [&]() { m4_mul_batch(batched.data(), a.data(), b.data(), matrices); });
+    error = 0.0f;
+    for (uint32_t i = 0; i < matrices; i++) {
+        error = fmaxf(error, MaxError(product[i], batched[i]));
+    }
+    failures += BenchReport("m4_mul_batch", old_ns, new_ns, error, 1e-6f);
+
+    g_benchSink = g_benchSink + out_x[count - 1] + expected[count - 1].y + batched[matrices - 1].m[3];
+    return failures;
+}
+
+// INVERSE ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Gauss-Jordan elimination with partial pivoting in double precision, the accuracy reference
+mat4 ReferenceInverse(const mat4& in)
+{
+    double a[4][8];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            a[r][c] = in.idx[r][c];
+            a[r][c + 4] = r == c ? 1.0 : 0.0;
+        }
+    }
+    for (int c = 0; c < 4; c++) {
+        int pivot = c;
+        for (int r = c + 1; r < 4; r++) {
+            if (fabs(a[r][c]) > fabs(a[pivot][c])) {
+                pivot = r;
+            }
+        }
+        for (int k = 0; k < 8; k++) {
+            double t = a[c][k];
+            a[c][k] = a[pivot][k];
+            a[pivot][k] = t;
+        }
+        double inv_pivot = 1.0 / a[c][c];
+        for (int k = 0; k < 8; k++) {
+            a[c][k] *= inv_pivot;
+        }
+        for (int r = 0; r < 4; r++) {
+            if (r != c) {
+                double f = a[r][c];
+                for (int k = 0; k < 8; k++) {
+                    a[r][k] -= f * a[c][k];
+                }
+            }
+        }
+    }
+    mat4 out;
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            out.idx[r][c] = (float)a[r][c + 4];
+        }
+    }
+    return out;
+}
+
+// Largest entry of m * inverse - I
+float IdentityError(const mat4& m, const mat4& inverse)
+{
+    mat4 product = ScalarMul(m, inverse);
+    return MaxError(product, ScalarIdentity());
+}
+
+vec3 RandomVec3(BenchRandom& random, float extent)
+{
+    return { random.Range(-extent, extent), random.Range(-extent, extent), random.Range(-extent, extent) };
+}
+
+int BenchInverse()
+{
+    const uint32_t count = 10000;
+    BenchRandom random;
+
+    // General matrices kept away from singular by a diagonal boost; rigid ones are lookAt views, affine
+    // ones rotate, scale and translate
+    std::vector<mat4> general(count), rigid(count), affine(count), out(count);
+    for (uint32_t i = 0; i < count; i++) {
+        general[i] = RandomMatrix(random);
+        for (int d = 0; d < 4; d++) {
+            general[i].idx[d][d] += 4.0f;
+        }
+
+        vec3 eye = RandomVec3(random, 50.0f);
+        vec3 target = v3_add(eye, RandomVec3(random, 10.0f));
+        vec3 up = { 0.0f, 1.0f, 0.0f };
+        rigid[i] = lookAt(eye, target, up);
+
+        vec3 axis = RandomVec3(random, 1.0f);
+        axis.z += 2.0f;
+        mat4 m = translate(identity(), random.Range(-50.0f, 50.0f), random.Range(-50.0f, 50.0f),
+                           random.Range(-50.0f, 50.0f));
+        m = rotate(m, axis, random.Range(-3.0f, 3.0f));
+        affine[i] = scale(m, random.Range(0.5f, 2.0f), random.Range(0.5f, 2.0f), random.Range(0.5f, 2.0f));
+    }
+
+    PRINT("Inverse, %u matrices, ns per call (double Gauss-Jordan -> vmath):\n", count);
+    int failures = 0;
+
+    // Accuracy: M * inverse(M) = I for every kind, and the fast paths agree with the general inverse on
+    // the matrices they are meant for
+    float general_error = 0.0f, affine_error = 0.0f, rigid_error = 0.0f;
+    float affine_match = 0.0f, rigid_match = 0.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        general_error = fmaxf(general_error, IdentityError(general[i], m4_inverse(general[i])));
+        mat4 affine_general = m4_inverse(affine[i]);
+        mat4 affine_fast = m4_inverse_affine(affine[i]);
+        affine_error = fmaxf(affine_error, IdentityError(affine[i], affine_fast));
+        affine_match = fmaxf(affine_match, MaxError(affine_general, affine_fast));
+        mat4 rigid_general = m4_inverse(rigid[i]);
+        mat4 rigid_fast = m4_inverse_rigid(rigid[i]);
+        rigid_error = fmaxf(rigid_error, IdentityError(rigid[i], rigid_fast));
+        rigid_match = fmaxf(rigid_match, fmaxf(MaxError(rigid_general, rigid_fast),
+                                               MaxError(rigid_general, m4_inverse_affine(rigid[i]))));
+    }
+
+    // A singular matrix (here a projection flattening z) inverts to zero
+    mat4 singular = general[0];
+    for (int r = 0; r < 4; r++) {
+        singular.idx[r][2] = 0.0f;
+    }
+    mat4 zero = {0};
+    float singular_error = MaxError(m4_inverse(singular), zero);
+
+    double reference_ns = BenchNs(count, 10, [&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            out[i] = ReferenceInverse(rigid[i]);
+        }
+    });
+    double general_ns = BenchNs(count, 10, [&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            out[i] = m4_inverse(rigid[i]);
+        }
+    });
+    double affine_ns = BenchNs(count, 10, [&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            out[i] = m4_inverse_affine(rigid[i]);
+        }
+    });
+    double rigid_ns = BenchNs(count, 10, [&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            out[i] = m4_inverse_rigid(rigid[i]);
+        }
+    });
+    g_benchSink = g_benchSink + out[count - 1].m[7];
+
+    // Timings on the lookAt views, which every variant accepts; errors against the identity
+    failures += BenchReport("m4_inverse", reference_ns, general_ns, general_error, 1e-4f);
+    failures += BenchReport("m4_inverse_affine", reference_ns, affine_ns, affine_error, 1e-4f);
+    failures += BenchReport("m4_inverse_rigid", reference_ns, rigid_ns, rigid_error, 1e-4f);
+    PRINT("  fast paths against m4_inverse: affine %.1e, rigid %.1e; singular input %.1e\n",
+          affine_match, rigid_match, singular_error);
+    failures += affine_match <= 1e-4f ? 0 : 1;
+    failures += rigid_match <= 1e-4f ? 0 : 1;
+    failures += singular_error == 0.0f ? 0 : 1;
+    return failures;
+}
+
+// CULLING ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// One object against the planes the way the per-object loop the SIMD kernels replaced did it. Returns the
+// smallest signed distance, negative when the object is outside a plane.
+float ScalarCullDistance(const Frustum& frustum, float cx, float cy, float cz, float ex, float ey, float ez,
+                         float radius)
+{
+    float nearest = FLT_MAX;
+    for (int p = 0; p < 6; p++) {
+        float r = radius + ex * fabsf(frustum.nx[p]) + ey * fabsf(frustum.ny[p]) + ez * fabsf(frustum.nz[p]);
+        float dist = cx * frustum.nx[p] + cy * frustum.ny[p] + cz * frustum.nz[p] + frustum.d[p] + r;
+        nearest = fminf(nearest, dist);
+    }
+    return nearest;
+}
+
+// Compares a visible list with the reference distances; objects within a rounding margin of a plane may
+// go either way, any other disagreement counts
+uint32_t CullMismatches(const std::vector<float>& distance, const uint32_t* visible, size_t visible_count)
+{
+    std::vector<uint8_t> seen(distance.size(), 0);
+    for (size_t i = 0; i < visible_count; i++) {
+        seen[visible[i]] = 1;
+    }
+    uint32_t mismatches = 0;
+    for (size_t i = 0; i < distance.size(); i++) {
+        bool expected = distance[i] >= 0.0f;
+        if (seen[i] != (expected ? 1 : 0) && fabsf(distance[i]) > 1e-3f) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int BenchCulling()
+{
+    const uint32_t count = 200000;
+    BenchRandom random;
+
+    // A flat level around a camera at the origin looking down -z, mostly ahead of it: about 30% of
+    // the objects in view, the rest behind, beside or past the far plane
+    std::vector<float> cx(count), cy(count), cz(count), radius(count), ex(count), ey(count), ez(count);
+    for (uint32_t i = 0; i < count; i++) {
+        cx[i] = random.Range(-200.0f, 200.0f);
+        cy[i] = random.Range(-50.0f, 50.0f);
+        cz[i] = random.Range(-300.0f, 50.0f);
+        radius[i] = random.Range(0.1f, 4.0f);
+        ex[i] = random.Range(0.1f, 4.0f);
+        ey[i] = random.Range(0.1f, 4.0f);
+        ez[i] = random.Range(0.1f, 4.0f);
+    }
+    BoundingSpheres spheres = { cx.data(), cy.data(), cz.data(), radius.data() };
+    BoundingBoxes boxes = { cx.data(), cy.data(), cz.data(), ex.data(), ey.data(), ez.data() };
+
+    vec3 eye = { 0.0f, 0.0f, 0.0f };
+    vec3 target = { 0.0f, 0.0f, -1.0f };
+    vec3 up = { 0.0f, 1.0f, 0.0f };
+    mat4 view_proj = m4_mul(perspective(1.2f, 16.0f / 9.0f, 0.1f, 250.0f), lookAt(eye, target, up));
+    Frustum frustum;
+    FrustumFromMatrix(&frustum, &view_proj);
+
+    std::vector<uint32_t> visible(count);
+    std::vector<float> sphere_distance(count), box_distance(count);
+    size_t sphere_visible = 0, box_visible = 0;
+
+    PRINT("Frustum culling, %u objects, ns per object (per-object loop -> SIMD):\n", count);
+    int failures = 0;
+
+    double old_ns = BenchNs(count, 20, [&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            sphere_distance[i] = ScalarCullDistance(frustum, cx[i], cy[i], cz[i], 0.0f, 0.0f, 0.0f, radius[i]);
+        }
+    });
+    double new_ns = BenchNs(count, 20, [&]() {
+        sphere_visible = FrustumCullSpheres(&frustum, &spheres, 0, count, visible.data());
+    });
+    uint32_t mismatches = CullMismatches(sphere_distance, visible.data(), sphere_visible);
+    failures += BenchReport("FrustumCullSpheres", old_ns, new_ns, (float)mismatches, 0.0f);
+
+    old_ns = BenchNs(count, 20, [&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            box_distance[i] = ScalarCullDistance(frustum, cx[i], cy[i], cz[i], ex[i], ey[i], ez[i], 0.0f);
+        }
+    });
+    new_ns = BenchNs(count, 20, [&]() {
+        box_visible = FrustumCullBoxes(&frustum, &boxes, 0, count, visible.data());
+    });
+    mismatches = CullMismatches(box_distance, visible.data(), box_visible);
+    failures += BenchReport("FrustumCullBoxes", old_ns, new_ns, (float)mismatches, 0.0f);
+
+    // Chunks culled separately (as on the job threads) and merged give the single-call result. Chunk
+    // sizes are odd so the scalar tails run too.
+    const size_t chunk_count = 7;
+    size_t chunk_first[chunk_count], chunk_visible[chunk_count];
+    size_t chunk_size = count / chunk_count + 1;
+    for (size_t c = 0; c < chunk_count; c++) {
+        chunk_first[c] = c * chunk_size;
+        size_t chunk_end = MIN(chunk_first[c] + chunk_size, (size_t)count);
+        chunk_visible[c] = FrustumCullBoxes(&frustum, &boxes, chunk_first[c], chunk_end - chunk_first[c],
+                                            visible.data() + chunk_first[c]);
+    }
+    size_t merged = FrustumMergeVisible(visible.data(), chunk_first, chunk_visible, chunk_count);
+    std::vector<uint32_t> single(count);
+    size_t single_count = FrustumCullBoxes(&frustum, &boxes, 0, count, single.data());
+    bool merge_ok = merged == single_count && memcmp(visible.data(), single.data(), merged * sizeof(uint32_t)) == 0;
+    PRINT("  %zu spheres and %zu boxes visible (%.0f%%); %zu chunks merged %s\n", sphere_visible, box_visible,
+          100.0 * (double)box_visible / count, chunk_count,
+          merge_ok ? "match the single call" : "DIFFER from the single call  FAILED");
+    failures += merge_ok ? 0 : 1;
+    return failures;
+}
+
+// JOBS ///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Enough arithmetic per item that the loop is not purely memory bound
+inline float JobWork(float x)
+{
+    for (int i = 0; i < 8; i++) {
+        x = sqrtf(x * x + 1.0f) * 0.75f;
+    }
+    return x;
+}
+
+int BenchJobs()
+{
+    const uint32_t count = 4 * 1024 * 1024;
+    const uint32_t outer = 64;
+    uint32_t cores = std::thread::hardware_concurrency();
+    uint32_t max_threads = MAX(cores, 2u);
+
+    std::vector<float> input(count), reference(count), output(count);
+    BenchRandom random;
+    for (uint32_t i = 0; i < count; i++) {
+        input[i] = random.Range(0.0f, 100.0f);
+    }
+
+    double serial_ns = BenchNs(count, 3, [&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            reference[i] = JobWork(input[i]);
+        }
+    });
+    double serial_ms = serial_ns * count * 1e-6;
+
+    PRINT("Job system, ParallelFor over %u items, %u cores (serial loop %.2f ms):\n", count, cores, serial_ms);
+    int failures = 0;
+
+    // One thread is the plain loop; from two up the calling thread plus threads - 1 workers
+    for (uint32_t threads = 2; threads <= max_threads; threads++) {
+        auto jobs = JobSystem::Create(threads - 1);
+
+        double flat_ns = BenchNs(count, 5, [&]() {
+            jobs->ParallelFor(count, 0, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; i++) {
+                    output[i] = JobWork(input[i]);
+                }
+            });
+        });
+        bool flat_ok = memcmp(output.data(), reference.data(), count * sizeof(float)) == 0;
+        std::fill(output.begin(), output.end(), 0.0f);
+
+        // Each outer item runs its own ParallelFor, so workers park in Wait and pick the inner chunks up
+        uint32_t inner = count / outer;
+        double nested_ns = BenchNs(count, 5, [&]() {
+            jobs->ParallelFor(outer, 1, [&](uint32_t outer_begin, uint32_t outer_end) {
+                for (uint32_t o = outer_begin; o < outer_end; o++) {
+                    jobs->ParallelFor(inner, 0, [&](uint32_t begin, uint32_t end) {
+                        for (uint32_t i = o * inner + begin; i < o * inner + end; i++) {
+                            output[i] = JobWork(input[i]);
+                        }
+                    });
+                }
+            });
+        });
+        bool nested_ok = memcmp(output.data(), reference.data(), count * sizeof(float)) == 0;
+
+        double flat_ms = flat_ns * count * 1e-6;
+        double nested_ms = nested_ns * count * 1e-6;
+        PRINT("  %2u threads  flat %8.2f ms %5.2fx   nested %8.2f ms %5.2fx%s\n", threads, flat_ms,
+              serial_ms / flat_ms, nested_ms, serial_ms / nested_ms, flat_ok && nested_ok ? "" : "  FAILED");
+        failures += (flat_ok ? 0 : 1) + (nested_ok ? 0 : 1);
+    }
+    return failures;
+}
+
+// FRAME ARENA ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int BenchFrameArena()
+{
+    const uint32_t frames = 100000;
+    const uint32_t per_frame = 64;
+    const uint32_t frames_in_flight = 3;
+
+    // The same 64 sizes every frame, so the expected per-frame footprint is known up front
+    BenchRandom random;
+    uint32_t sizes[per_frame];
+    size_t expected_peak = 0;
+    for (uint32_t i = 0; i < per_frame; i++) {
+        sizes[i] = 16 + random.Next() % 241;
+        expected_peak = ((expected_peak + 15) & ~(size_t)15) + sizes[i];
+    }
+
+    // malloc'd blocks live as long as the arena's do: freed when their frame slot comes around again
+    std::vector<void*> blocks(frames_in_flight * per_frame, nullptr);
+    double malloc_ns = BenchNs(frames * per_frame, 3, [&]() {
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            void** slot = &blocks[(frame % frames_in_flight) * per_frame];
+            for (uint32_t i = 0; i < per_frame; i++) {
+                free(slot[i]);
+                slot[i] = malloc(sizes[i]);
+                *(uint32_t*)slot[i] = frame;
+            }
+        }
+    });
+    for (void* block : blocks) {
+        free(block);
+    }
+
+    FrameArena frame_arena;
+    if (!FrameArenaInit(&frame_arena, frames_in_flight, 1, 64 * 1024)) {
+        return 1;
+    }
+
+    // Every block is aligned and the previous frame's blocks are still intact while the next one allocates
+    std::vector<uint32_t*> previous(per_frame, nullptr), current(per_frame, nullptr);
+    bool intact = true;
+    double arena_ns = BenchNs(frames * per_frame, 3, [&]() {
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            FrameArenaBegin(&frame_arena, frame);
+            for (uint32_t i = 0; i < per_frame; i++) {
+                current[i] = (uint32_t*)FrameArenaAlloc(&frame_arena, frame, 0, sizes[i], 16);
+                *current[i] = frame;
+            }
+            if (frame > 0) {
+                intact &= *previous[frame % per_frame] == frame - 1;
+            }
+            intact &= ((uintptr_t)current[frame % per_frame] & 15) == 0;
+            std::swap(previous, current);
+        }
+    });
+
+    size_t failed_allocations = 0;
+    for (uint32_t i = 0; i < frame_arena.frameCount * frame_arena.threadCount; i++) {
+        failed_allocations += frame_arena.arenas[i].failures;
+    }
+    bool ok = intact && failed_allocations == 0 && frame_arena.peak == expected_peak;
+
+    PRINT("Frame arena, %u frames of %u allocations, ns per allocation (malloc/free -> arena):\n", frames, per_frame);
+    int failures = BenchReport("FrameArenaAlloc", malloc_ns, arena_ns, ok ? 0.0f : 1.0f, 0.0f);
+    PRINT("  peak %zu bytes per frame (expected %zu), %zu failed allocations, blocks %s\n", frame_arena.peak,
+          expected_peak, failed_allocations, intact ? "intact and aligned" : "OVERWRITTEN or misaligned");
+    FrameArenaDestroy(&frame_arena);
+    return failures;
+}
+
+// POOL ///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// A cache line of game object state
+struct BenchObject {
+    float    position[3];
+    float    velocity[3];
+    uint32_t id;
+    uint8_t  padding[36];
+};
+
+int BenchPool()
+{
+    const uint32_t count = 100000;
+    const uint32_t rounds = 20;
+
+    // Best time of each phase over the rounds; destruction goes evens first, then odds, so the free
+    // list and the heap both end up fragmented before the next round
+    double heap_create = 1e30, heap_iterate = 1e30, heap_destroy = 1e30;
+    double pool_create = 1e30, pool_iterate = 1e30, pool_destroy = 1e30;
+    auto phase = [](double& best, double start) { best = fmin(best, BenchNow() - start); };
+
+    std::vector<BenchObject*> objects(count);
+    double heap_sum = 0.0;
+    for (uint32_t round = 0; round < rounds; round++) {
+        double start = BenchNow();
+        for (uint32_t i = 0; i < count; i++) {
+            objects[i] = new BenchObject{ { (float)i, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, i, {} };
+        }
+        phase(heap_create, start);
+
+        start = BenchNow();
+        heap_sum = 0.0;
+        for (BenchObject* object : objects) {
+            object->position[0] += object->velocity[0];
+            heap_sum += object->position[0];
+        }
+        phase(heap_iterate, start);
+
+        start = BenchNow();
+        for (uint32_t parity = 0; parity < 2; parity++) {
+            for (uint32_t i = parity; i < count; i += 2) {
+                delete objects[i];
+            }
+        }
+        phase(heap_destroy, start);
+    }
+
+    Pool<BenchObject> pool;
+    std::vector<Handle<BenchObject>> handles(count), stale(count);
+    double pool_sum = 0.0;
+    uint32_t iterated = 0;
+    bool handles_ok = true;
+    for (uint32_t round = 0; round < rounds; round++) {
+        double start = BenchNow();
+        for (uint32_t i = 0; i < count; i++) {
+            handles[i] = pool.Create(BenchObject{ { (float)i, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, i, {} });
+        }
+        phase(pool_create, start);
+
+        start = BenchNow();
+        pool_sum = 0.0;
+        iterated = 0;
+        pool.ForEach([&](Handle<BenchObject>, BenchObject& object) {
+            object.position[0] += object.velocity[0];
+            pool_sum += object.position[0];
+            iterated++;
+        });
+        phase(pool_iterate, start);
+
+        // Handles of the previous round point at reused slots and must all be dead
+        for (uint32_t i = 0; round > 0 && i < count; i++) {
+            handles_ok &= pool.Get(stale[i]) == nullptr && handles[i] != stale[i];
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            handles_ok &= pool.Get(handles[i]) && pool.Get(handles[i])->id == i;
+        }
+
+        start = BenchNow();
+        for (uint32_t parity = 0; parity < 2; parity++) {
+            for (uint32_t i = parity; i < count; i += 2) {
+                pool.Destroy(handles[i]);
+            }
+        }
+        phase(pool_destroy, start);
+        handles_ok &= pool.GetCount() == 0;
+        std::swap(handles, stale);
+    }
+
+    bool iterate_ok = iterated == count && pool_sum == heap_sum;
+    PRINT("Pool, %u objects of %zu bytes, ns per object (new/delete -> Pool):\n", count, sizeof(BenchObject));
+    int failures = 0;
+    failures += BenchReport("Create", heap_create * 1e9 / count, pool_create * 1e9 / count, 0.0f, 0.0f);
+    failures += BenchReport("Iterate", heap_iterate * 1e9 / count, pool_iterate * 1e9 / count,
+                            iterate_ok ? 0.0f : 1.0f, 0.0f);
+    failures += BenchReport("Destroy", heap_destroy * 1e9 / count, pool_destroy * 1e9 / count,
+                            handles_ok ? 0.0f : 1.0f, 0.0f);
+    PRINT("  %u slots in %u-object slabs; stale handles %s\n", pool.GetCapacity(), 256u,
+          handles_ok ? "all rejected" : "RESOLVED  FAILED");
+    return failures;
+}
+
+// REGISTRY ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct BenchEntry {
+    const char* name;
+    int (*run)();
+};
+
+const BenchEntry g_benches[] = {
+    { "math", BenchMatrix },
+    { "batch", BenchBatch },
+    { "inverse", BenchInverse },
+    { "culling", BenchCulling },
+    { "jobs", BenchJobs },
+    { "arena", BenchFrameArena },
+    { "pool", BenchPool },
+};
+
+} // namespace
+
+int RunBenchmarks(const char* name)
+{
+    bool all = !name || strcmp(name, "all") == 0;
+    bool found = false;
+    int failures = 0;
+    for (const BenchEntry& bench : g_benches) {
+        if (all || strcmp(name, bench.name) == 0) {
+            found = true;
+            failures += bench.run();
+            PRINT("\n");
+        }
+    }
+
+    if (!found) {
+        PRINT_ERROR("Unknown benchmark '%s', available:", name);
+        for (const BenchEntry& bench : g_benches) {
+            PRINT(" %s", bench.name);
+        }
+        PRINT("\n");
+        return -1;
+    }
+    if (failures > 0) {
+        PRINT_ERROR("%d benchmark checks failed\n", failures);
+    }
+    return failures;
+}
+
+} // namespace ZX
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace ZX {
+
+// Micro-benchmarks of the engine's CPU-side building blocks, each timed against the code it replaced
+// and checked against a reference implementation. Run with --bench [name]; no name (or "all") runs
+// every benchmark. Returns the number of failed checks, -1 for an unknown name.
+int RunBenchmarks(const char* name);
+
+} // namespace ZX
@@ -7,8 +7,13 @@ public:
     const char* name;
     bool fullscreen;
     bool vsync;
+    int framesInFlight;     // Frames simulation may run ahead of rendering; 1 runs both in lockstep on one thread
+    int gpuFramesInFlight;  // Frames the GPU may trail behind render submission (1-3)
+    bool bindless;          // One descriptor-indexed set for all resources, indices in push constants
     
     // Constructor with default values
-    Config(int w = 1280, int h = 720, const char* n = "ZXEngine", bool fs = false, bool vs = true)
-        : width(w), height(h), name(n), fullscreen(fs), vsync(vs) {}
+    Config(int w = 1280, int h = 720, const char* n = "ZXEngine", bool fs = false, bool vs = true, int frames = 2,
+           int gpuFrames = 2, bool bindlessMode = false)
+        : width(w), height(h), name(n), fullscreen(fs), vsync(vs), framesInFlight(frames), gpuFramesInFlight(gpuFrames),
+          bindless(bindlessMode) {}
 };
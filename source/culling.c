@@ -0,0 +1,149 @@
+#include "culling.h"
+#include "vsimd.h"
+
+#include <float.h>
+#include <string.h>
+
+// PLANES /////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void SetPlane(Frustum* frustum, int i, float a, float b, float c, float d)
+{
+    float inv_len = 1.0f / sqrtf(a * a + b * b + c * c);
+
+    frustum->nx[i] = a * inv_len;
+    frustum->ny[i] = b * inv_len;
+    frustum->nz[i] = c * inv_len;
+    frustum->d[i] = d * inv_len;
+}
+
+// Gribb-Hartmann: with column vectors, each plane is row 3 plus or minus one of the other rows
+void FrustumFromMatrix(Frustum* frustum, const mat4* view_proj)
+{
+    const float (*m)[4] = view_proj->idx;
+
+    for (int axis = 0; axis < 3; axis++) {
+        SetPlane(frustum, axis * 2 + 0,
+                 m[3][0] + m[axis][0], m[3][1] + m[axis][1], m[3][2] + m[axis][2], m[3][3] + m[axis][3]);
+        SetPlane(frustum, axis * 2 + 1,
+                 m[3][0] - m[axis][0], m[3][1] - m[axis][1], m[3][2] - m[axis][2], m[3][3] - m[axis][3]);
+    }
+}
+
+// CULLING ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Appends the set bits of a lane mask as indices without branching per lane
+VMATH_INLINE size_t WriteVisible(uint32_t* visible, size_t n, int mask, size_t base)
+{
+    for (int lane = 0; lane < VMATH_LANES; lane++) {
+        visible[n] = (uint32_t)(base + lane);
+        n += (mask >> lane) & 1;
+    }
+    return n;
+}
+
+size_t FrustumCullSpheres(const Frustum* frustum, const BoundingSpheres* spheres,
+                          size_t first, size_t count, uint32_t* visible)
+{
+    size_t n = 0;
+    size_t i = first;
+    size_t end = first + count;
+
+    fw zero = fw_set1(0.f);
+
+    for (; i + VMATH_LANES <= end; i += VMATH_LANES) {
+        fw cx = fw_load(spheres->centerX + i);
+        fw cy = fw_load(spheres->centerY + i);
+        fw cz = fw_load(spheres->centerZ + i);
+        fw r = fw_load(spheres->radius + i);
+
+        // Smallest signed distance (plus radius) over all planes; negative means fully outside one
+        fw nearest = fw_set1(FLT_MAX);
+        for (int p = 0; p < 6; p++) {
+            fw dist = fw_madd(cx, fw_set1(frustum->nx[p]),
+                      fw_madd(cy, fw_set1(frustum->ny[p]),
+                      fw_madd(cz, fw_set1(frustum->nz[p]), fw_add(fw_set1(frustum->d[p]), r))));
+            nearest = fw_min(nearest, dist);
+        }
+
+        int culled = fw_movemask(fw_cmpgt(zero, nearest));
+        n = WriteVisible(visible, n, ~culled, i);
+    }
+
+    for (; i < end; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            float dist = spheres->centerX[i] * frustum->nx[p] + spheres->centerY[i] * frustum->ny[p] +
+                         spheres->centerZ[i] * frustum->nz[p] + frustum->d[p];
+            inside = dist >= -spheres->radius[i];
+        }
+        if (inside) visible[n++] = (uint32_t)i;
+    }
+
+    return n;
+}
+
+size_t FrustumCullBoxes(const Frustum* frustum, const BoundingBoxes* boxes,
+                        size_t first, size_t count, uint32_t* visible)
+{
+    size_t n = 0;
+    size_t i = first;
+    size_t end = first + count;
+
+    // The box corner furthest along each plane normal is center + |n| . extent
+    float abs_nx[6], abs_ny[6], abs_nz[6];
+    for (int p = 0; p < 6; p++) {
+        abs_nx[p] = fabsf(frustum->nx[p]);
+        abs_ny[p] = fabsf(frustum->ny[p]);
+        abs_nz[p] = fabsf(frustum->nz[p]);
+    }
+
+    fw zero = fw_set1(0.f);
+
+    for (; i + VMATH_LANES <= end; i += VMATH_LANES) {
+        fw cx = fw_load(boxes->centerX + i);
+        fw cy = fw_load(boxes->centerY + i);
+        fw cz = fw_load(boxes->centerZ + i);
+        fw ex = fw_load(boxes->extentX + i);
+        fw ey = fw_load(boxes->extentY + i);
+        fw ez = fw_load(boxes->extentZ + i);
+
+        fw nearest = fw_set1(FLT_MAX);
+        for (int p = 0; p < 6; p++) {
+            fw radius = fw_madd(ex, fw_set1(abs_nx[p]), fw_madd(ey, fw_set1(abs_ny[p]), fw_mul(ez, fw_set1(abs_nz[p]))));
+            fw dist = fw_madd(cx, fw_set1(frustum->nx[p]),
+                      fw_madd(cy, fw_set1(frustum->ny[p]),
+                      fw_madd(cz, fw_set1(frustum->nz[p]), fw_add(fw_set1(frustum->d[p]), radius))));
+            nearest = fw_min(nearest, dist);
+        }
+
+        int culled = fw_movemask(fw_cmpgt(zero, nearest));
+        n = WriteVisible(visible, n, ~culled, i);
+    }
+
+    for (; i < end; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            float radius = boxes->extentX[i] * abs_nx[p] + boxes->extentY[i] * abs_ny[p] + boxes->extentZ[i] * abs_nz[p];
+            float dist = boxes->centerX[i] * frustum->nx[p] + boxes->centerY[i] * frustum->ny[p] +
+                         boxes->centerZ[i] * frustum->nz[p] + frustum->d[p];
+            inside = dist >= -radius;
+        }
+        if (inside) visible[n++] = (uint32_t)i;
+    }
+
+    return n;
+}
+
+size_t FrustumMergeVisible(uint32_t* visible, const size_t* chunk_first, const size_t* chunk_visible, size_t chunk_count)
+{
+    size_t total = 0;
+
+    for (size_t c = 0; c < chunk_count; c++) {
+        if (chunk_first[c] != total) {
+            memmove(visible + total, visible + chunk_first[c], chunk_visible[c] * sizeof(uint32_t));
+        }
+        total += chunk_visible[c];
+    }
+
+    return total;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "vmath.h"
+
+// Frustum planes in structure-of-arrays form: a point p is inside plane i when
+// nx[i] * p.x + ny[i] * p.y + nz[i] * p.z + d[i] >= 0. Planes are normalized.
+typedef struct Frustum {
+    float nx[6];
+    float ny[6];
+    float nz[6];
+    float d[6];
+} Frustum;
+
+// Bounding spheres as parallel float streams
+typedef struct BoundingSpheres {
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* radius;
+} BoundingSpheres;
+
+// Axis-aligned boxes as center/half-extent streams
+typedef struct BoundingBoxes {
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* extentX;
+    const float* extentY;
+    const float* extentZ;
+} BoundingBoxes;
+
+// Extracts the six planes (left, right, bottom, top, near, far) from a view-projection matrix
+// built with perspective()/ortho*() (clip-space depth in [-w, w])
+void FrustumFromMatrix(Frustum* frustum, const mat4* view_proj);
+
+// Cull functions test objects [first, first + count) and write the indices of the visible ones to
+// visible[0..n), returning n. visible must hold count entries. Disjoint ranges can be culled on
+// different threads, each into its own output slice, and joined with FrustumMergeVisible.
+size_t FrustumCullSpheres(const Frustum* frustum, const BoundingSpheres* spheres,
+                          size_t first, size_t count, uint32_t* visible);
+size_t FrustumCullBoxes(const Frustum* frustum, const BoundingBoxes* boxes,
+                        size_t first, size_t count, uint32_t* visible);
+
+// Compacts per-chunk results: chunk i wrote chunk_visible[i] indices at visible + chunk_first[i].
+// Returns the total number of visible indices, packed at the front of visible.
+size_t FrustumMergeVisible(uint32_t* visible, const size_t* chunk_first, const size_t* chunk_visible, size_t chunk_count);
@@ -0,0 +1,265 @@
+#include "fiber.h"
+
+#if defined(_WIN32)
+    #define FIBER_WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <Windows.h>
+#elif defined(__x86_64__) && defined(__linux__)
+    #define FIBER_X64_SYSV
+    #include <sys/mman.h>
+    #include <unistd.h>
+#else
+    #define FIBER_UCONTEXT
+    #include <sys/mman.h>
+    #include <ucontext.h>
+    #include <unistd.h>
+#endif
+
+#include <cstdint>
+#include <cstdlib>
+
+namespace ZX {
+
+#if defined(FIBER_WIN32) // WIN32 /////////////////////////////////////////////////////////////////////////////////////
+
+static VOID CALLBACK FiberProc(LPVOID param)
+{
+    Fiber* fiber = static_cast<Fiber*>(param);
+    fiber->entry(fiber->arg);
+    abort();
+}
+
+bool FiberCreate(Fiber* fiber, size_t stackSize, FiberEntry entry, void* arg)
+{
+    fiber->stack = nullptr;
+    fiber->stackSize = stackSize;
+    fiber->entry = entry;
+    fiber->arg = arg;
+    fiber->handle = CreateFiberEx(stackSize, stackSize, FIBER_FLAG_FLOAT_SWITCH, FiberProc, fiber);
+    return fiber->handle != nullptr;
+}
+
+void FiberDestroy(Fiber* fiber)
+{
+    if (fiber->handle) {
+        DeleteFiber(fiber->handle);
+        fiber->handle = nullptr;
+    }
+}
+
+bool FiberFromThread(Fiber* fiber)
+{
+    *fiber = {};
+    fiber->handle = ConvertThreadToFiberEx(nullptr, FIBER_FLAG_FLOAT_SWITCH);
+    return fiber->handle != nullptr;
+}
+
+void FiberToThread(Fiber* fiber)
+{
+    ConvertFiberToThread();
+    fiber->handle = nullptr;
+}
+
+void FiberSwitch(Fiber* from, Fiber* to)
+{
+    (void)from;
+    SwitchToFiber(to->handle);
+}
+
+#else // POSIX ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Stacks come straight from mmap with a PROT_NONE page at the bottom, so an overflow faults
+// instead of silently corrupting the neighbouring fiber
+static void* AllocateStack(size_t* size)
+{
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    *size = (*size + page - 1) & ~(page - 1);
+
+    void* memory = mmap(nullptr, *size + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+    mprotect(memory, page, PROT_NONE);
+    return static_cast<char*>(memory) + page;
+}
+
+static void FreeStack(void* stack, size_t size)
+{
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    munmap(static_cast<char*>(stack) - page, size + page);
+}
+
+#if defined(FIBER_X64_SYSV)
+
+// Only callee-saved state needs to survive a switch: rbx, rbp, r12-r15, the stack pointer and the
+// SSE/x87 control words. Unlike swapcontext this never enters the kernel to swap signal masks.
+extern "C" void zx_fiber_switch(void** from_sp, void* to_sp);
+extern "C" void zx_fiber_start();
+
+asm(R"(
+    .text
+    .globl  zx_fiber_switch
+    .type   zx_fiber_switch, @function
+zx_fiber_switch:
+    pushq   %rbp
+    pushq   %rbx
+    pushq   %r12
+    pushq   %r13
+    pushq   %r14
+    pushq   %r15
+    subq    $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw  4(%rsp)
+    movq    %rsp, (%rdi)
+    movq    %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw   4(%rsp)
+    addq    $8, %rsp
+    popq    %r15
+    popq    %r14
+    popq    %r13
+    popq    %r12
+    popq    %rbx
+    popq    %rbp
+    ret
+    .size   zx_fiber_switch, .-zx_fiber_switch
+
+    .globl  zx_fiber_start
+    .type   zx_fiber_start, @function
+zx_fiber_start:
+    movq    %r12, %rdi
+    callq   *%r13
+    ud2
+    .size   zx_fiber_start, .-zx_fiber_start
+)");
+
+static void FiberProc(Fiber* fiber)
+{
+    fiber->entry(fiber->arg);
+    abort();
+}
+
+bool FiberCreate(Fiber* fiber, size_t stackSize, FiberEntry entry, void* arg)
+{
+    fiber->stackSize = stackSize;
+    fiber->stack = AllocateStack(&fiber->stackSize);
+    fiber->entry = entry;
+    fiber->arg = arg;
+    if (!fiber->stack) {
+        fiber->handle = nullptr;
+        return false;
+    }
+
+    // Initial frame as zx_fiber_switch would have left it; the return address lands in
+    // zx_fiber_start with r12 = fiber and r13 = FiberProc, and a 16-byte aligned stack for the call
+    uintptr_t top = (reinterpret_cast<uintptr_t>(fiber->stack) + fiber->stackSize) & ~uintptr_t(15);
+    uint64_t* frame = reinterpret_cast<uint64_t*>(top - 24);
+
+    frame[0] = reinterpret_cast<uint64_t>(&zx_fiber_start);   // return address
+    frame[-1] = 0;                                              // rbp
+    frame[-2] = 0;                                              // rbx
+    frame[-3] = reinterpret_cast<uint64_t>(fiber);              // r12
+    frame[-4] = reinterpret_cast<uint64_t>(&FiberProc);         // r13
+    frame[-5] = 0;                                              // r14
+    frame[-6] = 0;                                              // r15
+    frame[-7] = 0x037F00001F80ull;                              // default fpu control word : mxcsr
+
+    fiber->handle = &frame[-7];
+    return true;
+}
+
+void FiberDestroy(Fiber* fiber)
+{
+    if (fiber->stack) {
+        FreeStack(fiber->stack, fiber->stackSize);
+        fiber->stack = nullptr;
+    }
+    fiber->handle = nullptr;
+}
+
+bool FiberFromThread(Fiber* fiber)
+{
+    // The thread keeps its own stack; the saved stack pointer is filled in on the first switch away
+    *fiber = {};
+    return true;
+}
+
+void FiberToThread(Fiber* fiber)
+{
+    fiber->handle = nullptr;
+}
+
+void FiberSwitch(Fiber* from, Fiber* to)
+{
+    zx_fiber_switch(&from->handle, to->handle);
+}
+
+#else // FIBER_UCONTEXT
+
+static void FiberProc(unsigned int low, unsigned int high)
+{
+    Fiber* fiber = reinterpret_cast<Fiber*>((static_cast<uintptr_t>(high) << 16 << 16) | low);
+    fiber->entry(fiber->arg);
+    abort();
+}
+
+bool FiberCreate(Fiber* fiber, size_t stackSize, FiberEntry entry, void* arg)
+{
+    fiber->stackSize = stackSize;
+    fiber->stack = AllocateStack(&fiber->stackSize);
+    fiber->entry = entry;
+    fiber->arg = arg;
+    fiber->handle = nullptr;
+    if (!fiber->stack) {
+        return false;
+    }
+
+    ucontext_t* context = new ucontext_t();
+    getcontext(context);
+    context->uc_stack.ss_sp = fiber->stack;
+    context->uc_stack.ss_size = fiber->stackSize;
+    context->uc_link = nullptr;
+
+    // makecontext only forwards int arguments, so the pointer travels in two halves
+    uintptr_t address = reinterpret_cast<uintptr_t>(fiber);
+    makecontext(context, reinterpret_cast<void (*)()>(&FiberProc), 2,
+                static_cast<unsigned int>(address), static_cast<unsigned int>(address >> 16 >> 16));
+
+    fiber->handle = context;
+    return true;
+}
+
+void FiberDestroy(Fiber* fiber)
+{
+    delete static_cast<ucontext_t*>(fiber->handle);
+    fiber->handle = nullptr;
+    if (fiber->stack) {
+        FreeStack(fiber->stack, fiber->stackSize);
+        fiber->stack = nullptr;
+    }
+}
+
+bool FiberFromThread(Fiber* fiber)
+{
+    *fiber = {};
+    fiber->handle = new ucontext_t();
+    return true;
+}
+
+void FiberToThread(Fiber* fiber)
+{
+    delete static_cast<ucontext_t*>(fiber->handle);
+    fiber->handle = nullptr;
+}
+
+void FiberSwitch(Fiber* from, Fiber* to)
+{
+    swapcontext(static_cast<ucontext_t*>(from->handle), static_cast<ucontext_t*>(to->handle));
+}
+
+#endif
+#endif
+
+} // namespace ZX
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ZX {
+
+using FiberEntry = void (*)(void* arg);
+
+// User-mode execution context with its own stack. The platform half lives in fiber.cpp:
+// Win32 fibers on Windows, a hand-written register switch on x86-64 Linux and ucontext elsewhere.
+struct Fiber {
+    void*      handle;      // Win32 fiber, saved stack pointer or ucontext_t depending on platform
+    void*      stack;       // Stack we allocated ourselves, null when the OS owns it
+    size_t     stackSize;
+    FiberEntry entry;       // Must never return
+    void*      arg;
+};
+
+// Creates a fiber that runs entry(arg) the first time it is switched to
+bool FiberCreate(Fiber* fiber, size_t stackSize, FiberEntry entry, void* arg);
+void FiberDestroy(Fiber* fiber);
+
+// Turns the calling thread into a fiber so it can switch to others and be switched back to
+bool FiberFromThread(Fiber* fiber);
+void FiberToThread(Fiber* fiber);
+
+// Saves the current context into from and resumes to
+void FiberSwitch(Fiber* from, Fiber* to);
+
+} // namespace ZX
@@ -0,0 +1,104 @@
+#include "frame.h"
+
+namespace ZX {
+
+std::unique_ptr<FramePipeline> FramePipeline::Create(uint32_t framesInFlight, RenderFunction render)
+{
+    if (framesInFlight < 1) {
+        framesInFlight = 1;
+    }
+    if (framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+        framesInFlight = MAX_FRAMES_IN_FLIGHT;
+    }
+
+    return std::make_unique<FramePipeline>(framesInFlight, std::move(render));
+}
+
+FramePipeline::FramePipeline(uint32_t framesInFlight, RenderFunction render)
+    : m_framesInFlight(framesInFlight)
+    , m_render(std::move(render))
+    , m_slots()
+    , m_produced(0)
+    , m_consumed(0)
+    , m_stop(false)
+{
+    if (m_framesInFlight > 1) {
+        m_thread = std::thread([this]() { RenderLoop(); });
+    }
+}
+
+FramePipeline::~FramePipeline()
+{
+    if (m_thread.joinable()) {
+        Flush();
+
+        // Bump the counter so the render thread wakes up and sees the stop flag
+        m_stop.store(true);
+        m_produced.fetch_add(1, std::memory_order_release);
+        m_produced.notify_one();
+        m_thread.join();
+    }
+}
+
+RenderState* FramePipeline::BeginSimulation()
+{
+    uint64_t frame = m_produced.load(std::memory_order_relaxed);
+
+    // The slot for this frame was last used framesInFlight frames ago; wait until it has been rendered
+    uint64_t consumed = m_consumed.load(std::memory_order_acquire);
+    while (frame - consumed >= m_framesInFlight) {
+        m_consumed.wait(consumed, std::memory_order_acquire);
+        consumed = m_consumed.load(std::memory_order_acquire);
+    }
+
+    RenderState* state = &m_slots[frame % m_framesInFlight].state;
+    state->frameIndex = frame;
+    return state;
+}
+
+void FramePipeline::EndSimulation()
+{
+    uint64_t frame = m_produced.load(std::memory_order_relaxed);
+
+    if (!m_thread.joinable()) {
+        m_render(m_slots[frame % m_framesInFlight].state);
+        m_produced.store(frame + 1, std::memory_order_relaxed);
+        m_consumed.store(frame + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    m_produced.store(frame + 1, std::memory_order_release);
+    m_produced.notify_one();
+}
+
+void FramePipeline::Flush()
+{
+    uint64_t produced = m_produced.load(std::memory_order_relaxed);
+    uint64_t consumed = m_consumed.load(std::memory_order_acquire);
+    while (consumed < produced) {
+        m_consumed.wait(consumed, std::memory_order_acquire);
+        consumed = m_consumed.load(std::memory_order_acquire);
+    }
+}
+
+void FramePipeline::RenderLoop()
+{
+    for (uint64_t frame = 0;; frame++) {
+        uint64_t produced = m_produced.load(std::memory_order_acquire);
+        while (produced <= frame) {
+            m_produced.wait(produced, std::memory_order_acquire);
+            produced = m_produced.load(std::memory_order_acquire);
+        }
+
+        if (m_stop.load()) {
+            return;
+        }
+
+        m_render(m_slots[frame % m_framesInFlight].state);
+
+        m_consumed.store(frame + 1, std::memory_order_release);
+        m_consumed.notify_one();
+    }
+}
+
+} // namespace ZX
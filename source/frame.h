@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "vmath.h"
+
+namespace ZX {
+
+// Everything the renderer needs from one simulated frame. Written by the simulation thread,
+// read by the render thread; never shared between the two at the same time.
+struct RenderState {
+    uint64_t frameIndex;
+    float    time;
+    float    deltaTime;
+    int      width;
+    int      height;
+    bool     resized;       // Swapchain must be recreated before rendering this frame
+    mat4     viewProj;
+};
+
+// Runs simulation on the calling thread and render submission on a dedicated thread, up to
+// framesInFlight frames apart. Each frame gets its own RenderState slot; the two sides hand slots
+// over through a pair of monotonically increasing frame counters, so no locks are taken.
+class FramePipeline {
+public:
+    using RenderFunction = std::function<void(const RenderState& state)>;
+
+    // framesInFlight <= 1 renders inline from EndSimulation without a second thread
+    static std::unique_ptr<FramePipeline> Create(uint32_t framesInFlight, RenderFunction render);
+
+    FramePipeline(uint32_t framesInFlight, RenderFunction render);
+    ~FramePipeline();
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // Returns the state slot for the next frame, waiting while the renderer is framesInFlight behind
+    RenderState* BeginSimulation();
+    // Publishes the slot returned by BeginSimulation to the renderer
+    void EndSimulation();
+    // Waits until every published frame has been rendered
+    void Flush();
+
+    uint32_t GetFramesInFlight() const { return m_framesInFlight; }
+    uint64_t GetSimulatedFrames() const { return m_produced.load(std::memory_order_relaxed); }
+    uint64_t GetRenderedFrames() const { return m_consumed.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+    // Keep slots on separate cache lines so the two threads never share one
+    struct alignas(64) Slot {
+        RenderState state;
+    };
+
+    void RenderLoop();
+
+    uint32_t       m_framesInFlight;
+    RenderFunction m_render;
+    Slot           m_slots[MAX_FRAMES_IN_FLIGHT];
+    std::thread    m_thread;
+
+    alignas(64) std::atomic<uint64_t> m_produced;   // Frames published by simulation
+    alignas(64) std::atomic<uint64_t> m_consumed;   // Frames the renderer is done with
+    std::atomic<bool> m_stop;
+};
+
+} // namespace ZX
@@ -0,0 +1,788 @@
+#include "gpu_scene.h"
+#include "culling.h"
+#include "debug.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// vkCmdUpdateBuffer takes at most this many bytes per call
+#define GPU_SCENE_UPDATE_LIMIT  65536
+
+// Hi-Z build push constants
+typedef struct GpuSceneHiZParams {
+    uint32_t depthSize[2];
+    uint32_t levelCount;
+    uint32_t groupCount;
+} GpuSceneHiZParams;
+
+// SETUP ///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool CreateSceneBuffer(GpuScene* scene, VkDeviceSize size, VkBufferUsageFlags usage, VulkanMemoryUsage memory,
+                              VkBuffer* buffer, VulkanAllocation* allocation)
+{
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+    return VulkanMemoryCreateBuffer(&scene->vk->memory, &buffer_info, memory, buffer, allocation);
+}
+
+static bool CreateComputePipeline(GpuScene* scene, const char* path, VkPipelineLayout layout, VkPipeline* pipeline)
+{
+    VkShaderModule shader = VulkanLoadShader(scene->vk, path);
+    if (!shader) {
+        return false;
+    }
+    VkComputePipelineCreateInfo pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader,
+            .pName = "main"
+        },
+        .layout = layout
+    };
+    bool created = VulkanPipelineCacheCreateCompute(&scene->vk->pipelineCache, VK_NULL_HANDLE, &pipeline_info,
+                                                    pipeline);
+    vkDestroyShaderModule(scene->vk->device, shader, NULL);
+    return created;
+}
+
+// Level 0 is half the depth buffer, rounded up, and every level halves the one above. The image is a power
+// of two so these sizes always fit inside its levels.
+static uint32_t HiZLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t size = MAX((width + 1) / 2, (height + 1) / 2);
+    uint32_t levels = 1;
+    while (size > 1) {
+        size = (size + 1) / 2;
+        levels++;
+    }
+    return levels;
+}
+
+static bool CreateHiZ(GpuScene* scene, uint32_t max_width, uint32_t max_height)
+{
+    VkDevice device = scene->vk->device;
+    uint32_t frames = scene->vk->framesInFlight;
+
+    // Without occlusion culling a 1x1 pyramid stands in, culling still binds it
+    uint32_t size = 1;
+    while (size < (max_width + 1) / 2 || size < (max_height + 1) / 2) {
+        size *= 2;
+    }
+    scene->hizAllocatedLevels = HiZLevelCount(size * 2, size * 2);
+
+    VkImageCreateInfo image_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .extent = { size, size, 1 },
+        .mipLevels = scene->hizAllocatedLevels,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    if (!VulkanMemoryCreateImage(&scene->vk->memory, &image_info, VULKAN_MEMORY_GPU_ONLY, &scene->hizImage,
+                                 &scene->hizAllocation)) {
+        return false;
+    }
+
+    VkImageViewCreateInfo view_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = scene->hizImage,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, scene->hizAllocatedLevels, 0, 1 }
+    };
+    if (vkCreateImageView(device, &view_info, NULL, &scene->hizView) != VK_SUCCESS) {
+        return false;
+    }
+    for (uint32_t level = 0; level < scene->hizAllocatedLevels; level++) {
+        view_info.subresourceRange.baseMipLevel = level;
+        view_info.subresourceRange.levelCount = 1;
+        if (vkCreateImageView(device, &view_info, NULL, &scene->hizLevelViews[level]) != VK_SUCCESS) {
+            return false;
+        }
+    }
+
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = VK_LOD_CLAMP_NONE
+    };
+    if (vkCreateSampler(device, &sampler_info, NULL, &scene->hizSampler) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkBufferUsageFlags counter_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (!CreateSceneBuffer(scene, sizeof(uint32_t), counter_usage, VULKAN_MEMORY_GPU_ONLY, &scene->hizCounter,
+                           &scene->hizCounterAllocation)) {
+        return false;
+    }
+
+    // Depth buffer, pyramid levels, workgroup counter
+    VkDescriptorSetLayoutBinding bindings[3] = {
+        { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, GPU_SCENE_HIZ_MAX_LEVELS, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL }
+    };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 3,
+        .pBindings = bindings
+    };
+    if (vkCreateDescriptorSetLayout(device, &layout_info, NULL, &scene->hizSetLayout) != VK_SUCCESS) {
+        return false;
+    }
+
+    uint32_t set_count = frames * GPU_SCENE_HIZ_BUILDS;
+    VkDescriptorPoolSize pool_sizes[3] = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, set_count },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, set_count * GPU_SCENE_HIZ_MAX_LEVELS },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, set_count }
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = set_count,
+        .poolSizeCount = 3,
+        .pPoolSizes = pool_sizes
+    };
+    if (vkCreateDescriptorPool(device, &pool_info, NULL, &scene->hizDescriptorPool) != VK_SUCCESS) {
+        return false;
+    }
+
+    // Levels past the allocated ones repeat the last, the shader never touches them
+    VkDescriptorImageInfo level_infos[GPU_SCENE_HIZ_MAX_LEVELS];
+    for (uint32_t level = 0; level < GPU_SCENE_HIZ_MAX_LEVELS; level++) {
+        uint32_t view = MIN(level, scene->hizAllocatedLevels - 1);
+        level_infos[level].sampler = VK_NULL_HANDLE;
+        level_infos[level].imageView = scene->hizLevelViews[view];
+        level_infos[level].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+    VkDescriptorBufferInfo counter_info = { scene->hizCounter, 0, VK_WHOLE_SIZE };
+
+    // The depth view is written when a build first uses the set
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        for (uint32_t build = 0; build < GPU_SCENE_HIZ_BUILDS; build++) {
+            VkDescriptorSetAllocateInfo set_info = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .descriptorPool = scene->hizDescriptorPool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &scene->hizSetLayout
+            };
+            if (vkAllocateDescriptorSets(device, &set_info, &scene->hizSets[frame][build]) != VK_SUCCESS) {
+                return false;
+            }
+
+            VkWriteDescriptorSet writes[2] = {0};
+            writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[0].dstSet = scene->hizSets[frame][build];
+            writes[0].dstBinding = 1;
+            writes[0].descriptorCount = GPU_SCENE_HIZ_MAX_LEVELS;
+            writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[0].pImageInfo = level_infos;
+            writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[1].dstSet = scene->hizSets[frame][build];
+            writes[1].dstBinding = 2;
+            writes[1].descriptorCount = 1;
+            writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[1].pBufferInfo = &counter_info;
+            vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+        }
+    }
+
+    VkPushConstantRange push_constants = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(GpuSceneHiZParams)
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &scene->hizSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constants
+    };
+    if (vkCreatePipelineLayout(device, &pipeline_layout_info, NULL, &scene->hizPipelineLayout) != VK_SUCCESS) {
+        return false;
+    }
+
+    return !scene->occlusion ||
+           CreateComputePipeline(scene, GPU_SCENE_HIZ_SHADER, scene->hizPipelineLayout, &scene->hizPipeline);
+}
+
+static bool CreateCullPipeline(GpuScene* scene)
+{
+    VkDevice device = scene->vk->device;
+
+    // Meshes, instances, draws, counts, retest list, parameters, Hi-Z pyramid
+    VkDescriptorSetLayoutBinding bindings[7] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL }
+    };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 7,
+        .pBindings = bindings
+    };
+    if (vkCreateDescriptorSetLayout(device, &layout_info, NULL, &scene->setLayout) != VK_SUCCESS) {
+        PRINT_ERROR("GpuScene: Failed to create descriptor set layout\n");
+        return false;
+    }
+
+    VkDescriptorPoolSize pool_sizes[2] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 1,
+        .poolSizeCount = 2,
+        .pPoolSizes = pool_sizes
+    };
+    if (vkCreateDescriptorPool(device, &pool_info, NULL, &scene->descriptorPool) != VK_SUCCESS) {
+        PRINT_ERROR("GpuScene: Failed to create descriptor pool\n");
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo set_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = scene->descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &scene->setLayout
+    };
+    if (vkAllocateDescriptorSets(device, &set_info, &scene->set) != VK_SUCCESS) {
+        PRINT_ERROR("GpuScene: Failed to allocate descriptor set\n");
+        return false;
+    }
+
+    VkDescriptorBufferInfo buffer_infos[6] = {
+        { scene->meshBuffer, 0, VK_WHOLE_SIZE },
+        { scene->instanceBuffer, 0, VK_WHOLE_SIZE },
+        { scene->drawBuffer, 0, VK_WHOLE_SIZE },
+        { scene->countBuffer, 0, VK_WHOLE_SIZE },
+        { scene->retestBuffer, 0, VK_WHOLE_SIZE },
+        { scene->paramsBuffer, 0, VK_WHOLE_SIZE }
+    };
+    VkDescriptorImageInfo hiz_info = { scene->hizSampler, scene->hizView, VK_IMAGE_LAYOUT_GENERAL };
+    VkWriteDescriptorSet writes[7] = {0};
+    for (uint32_t i = 0; i < 7; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = scene->set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        if (i < 6) {
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &buffer_infos[i];
+        } else {
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[i].pImageInfo = &hiz_info;
+        }
+    }
+    vkUpdateDescriptorSets(device, 7, writes, 0, NULL);
+
+    // Index of the GpuSceneCullParams entry to use
+    VkPushConstantRange push_constants = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(uint32_t)
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &scene->setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constants
+    };
+    if (vkCreatePipelineLayout(device, &pipeline_layout_info, NULL, &scene->pipelineLayout) != VK_SUCCESS) {
+        PRINT_ERROR("GpuScene: Failed to create pipeline layout\n");
+        return false;
+    }
+
+    return CreateComputePipeline(scene, GPU_SCENE_CULL_SHADER, scene->pipelineLayout, &scene->cullPipeline);
+}
+
+bool GpuSceneInit(GpuScene* scene, Vulkan* vk, uint32_t max_meshes, uint32_t max_instances,
+                  uint32_t hiz_width, uint32_t hiz_height)
+{
+    memset(scene, 0, sizeof(*scene));
+    if (!vk->device) {
+        return false;
+    }
+
+    if (!vk->multiDrawIndirect) {
+        PRINT_WARNING("GpuScene: multiDrawIndirect not supported, GPU-driven rendering disabled\n");
+        return false;
+    }
+
+    if (hiz_width > GPU_SCENE_HIZ_MAX_SIZE || hiz_height > GPU_SCENE_HIZ_MAX_SIZE) {
+        PRINT_WARNING("GpuScene: %ux%u depth is over the Hi-Z limit of %u, occlusion culling disabled\n",
+                      hiz_width, hiz_height, GPU_SCENE_HIZ_MAX_SIZE);
+        hiz_width = hiz_height = 0;
+    }
+
+    scene->vk = vk;
+    scene->maxMeshes = max_meshes;
+    scene->maxInstances = max_instances;
+    scene->drawCount = vk->features12.drawIndirectCount;
+    scene->occlusion = hiz_width > 0 && hiz_height > 0;
+    scene->hizFrame = UINT64_MAX;
+    scene->earlyFrame = UINT64_MAX;
+
+    VkBufferUsageFlags upload = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    VkBufferUsageFlags indirect = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    VkDeviceSize draw_size = (VkDeviceSize)max_instances * sizeof(VkDrawIndexedIndirectCommand);
+    VkDeviceSize params_size = (VkDeviceSize)vk->framesInFlight * 2 * sizeof(GpuSceneCullParams);
+    VkDeviceSize readback_size = (VkDeviceSize)vk->framesInFlight * sizeof(GpuSceneCounts);
+    if (!CreateSceneBuffer(scene, (VkDeviceSize)max_meshes * sizeof(GpuMesh), upload, VULKAN_MEMORY_GPU_ONLY,
+                           &scene->meshBuffer, &scene->meshAllocation) ||
+        !CreateSceneBuffer(scene, (VkDeviceSize)max_instances * sizeof(GpuInstance), upload, VULKAN_MEMORY_GPU_ONLY,
+                           &scene->instanceBuffer, &scene->instanceAllocation) ||
+        !CreateSceneBuffer(scene, scene->occlusion ? draw_size * 2 : draw_size, indirect, VULKAN_MEMORY_GPU_ONLY,
+                           &scene->drawBuffer, &scene->drawAllocation) ||
+        !CreateSceneBuffer(scene, sizeof(GpuSceneCounts), indirect | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           VULKAN_MEMORY_GPU_ONLY, &scene->countBuffer, &scene->countAllocation) ||
+        !CreateSceneBuffer(scene, scene->occlusion ? (VkDeviceSize)max_instances * sizeof(uint32_t) : sizeof(uint32_t),
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VULKAN_MEMORY_GPU_ONLY,
+                           &scene->retestBuffer, &scene->retestAllocation) ||
+        !CreateSceneBuffer(scene, params_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VULKAN_MEMORY_CPU_TO_GPU,
+                           &scene->paramsBuffer, &scene->paramsAllocation) ||
+        !CreateSceneBuffer(scene, readback_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VULKAN_MEMORY_GPU_TO_CPU,
+                           &scene->readbackBuffer, &scene->readbackAllocation)) {
+        PRINT_ERROR("GpuScene: Failed to create scene buffers\n");
+        GpuSceneDestroy(scene);
+        return false;
+    }
+    memset(scene->readbackAllocation.mapped, 0, (size_t)readback_size);
+
+    if (!CreateHiZ(scene, hiz_width, hiz_height)) {
+        PRINT_ERROR("GpuScene: Failed to create Hi-Z pyramid\n");
+        GpuSceneDestroy(scene);
+        return false;
+    }
+
+    if (!CreateCullPipeline(scene)) {
+        GpuSceneDestroy(scene);
+        return false;
+    }
+
+    PRINT("GpuScene: %u meshes, %u instances, %s, %s\n", max_meshes, max_instances,
+          scene->drawCount ? "indirect count" : "zero-filled indirect draws",
+          scene->occlusion ? "Hi-Z occlusion culling" : "frustum culling only");
+    return true;
+}
+
+void GpuSceneDestroy(GpuScene* scene)
+{
+    if (!scene->vk) {
+        return;
+    }
+
+    VkDevice device = scene->vk->device;
+    if (scene->cullPipeline) {
+        vkDestroyPipeline(device, scene->cullPipeline, NULL);
+    }
+    if (scene->pipelineLayout) {
+        vkDestroyPipelineLayout(device, scene->pipelineLayout, NULL);
+    }
+    if (scene->descriptorPool) {
+        vkDestroyDescriptorPool(device, scene->descriptorPool, NULL);
+    }
+    if (scene->setLayout) {
+        vkDestroyDescriptorSetLayout(device, scene->setLayout, NULL);
+    }
+
+    if (scene->hizPipeline) {
+        vkDestroyPipeline(device, scene->hizPipeline, NULL);
+    }
+    if (scene->hizPipelineLayout) {
+        vkDestroyPipelineLayout(device, scene->hizPipelineLayout, NULL);
+    }
+    if (scene->hizDescriptorPool) {
+        vkDestroyDescriptorPool(device, scene->hizDescriptorPool, NULL);
+    }
+    if (scene->hizSetLayout) {
+        vkDestroyDescriptorSetLayout(device, scene->hizSetLayout, NULL);
+    }
+    if (scene->hizSampler) {
+        vkDestroySampler(device, scene->hizSampler, NULL);
+    }
+    for (uint32_t level = 0; level < GPU_SCENE_HIZ_MAX_LEVELS; level++) {
+        if (scene->hizLevelViews[level]) {
+            vkDestroyImageView(device, scene->hizLevelViews[level], NULL);
+        }
+    }
+    if (scene->hizView) {
+        vkDestroyImageView(device, scene->hizView, NULL);
+    }
+
+    VulkanMemory* memory = &scene->vk->memory;
+    VulkanMemoryDestroyImage(memory, scene->hizImage, &scene->hizAllocation);
+    VulkanMemoryDestroyBuffer(memory, scene->hizCounter, &scene->hizCounterAllocation);
+    VulkanMemoryDestroyBuffer(memory, scene->readbackBuffer, &scene->readbackAllocation);
+    VulkanMemoryDestroyBuffer(memory, scene->paramsBuffer, &scene->paramsAllocation);
+    VulkanMemoryDestroyBuffer(memory, scene->retestBuffer, &scene->retestAllocation);
+    VulkanMemoryDestroyBuffer(memory, scene->countBuffer, &scene->countAllocation);
+    VulkanMemoryDestroyBuffer(memory, scene->drawBuffer, &scene->drawAllocation);
+    VulkanMemoryDestroyBuffer(memory, scene->instanceBuffer, &scene->instanceAllocation);
+    VulkanMemoryDestroyBuffer(memory, scene->meshBuffer, &scene->meshAllocation);
+
+    memset(scene, 0, sizeof(*scene));
+}
+
+// SCENE DATA //////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool GpuSceneSetMeshes(GpuScene* scene, uint32_t first, uint32_t count, const GpuMesh* meshes)
+{
+    if (first > scene->maxMeshes || count > scene->maxMeshes - first) {
+        PRINT_ERROR("GpuScene: Meshes %u-%u out of range\n", first, first + count);
+        return false;
+    }
+    return VulkanUploadBuffer(&scene->vk->uploader, scene->meshBuffer, (VkDeviceSize)first * sizeof(GpuMesh),
+                              meshes, (VkDeviceSize)count * sizeof(GpuMesh));
+}
+
+bool GpuSceneSetInstances(GpuScene* scene, uint32_t first, uint32_t count, const GpuInstance* instances)
+{
+    if (first > scene->maxInstances || count > scene->maxInstances - first) {
+        PRINT_ERROR("GpuScene: Instances %u-%u out of range\n", first, first + count);
+        return false;
+    }
+    return VulkanUploadBuffer(&scene->vk->uploader, scene->instanceBuffer, (VkDeviceSize)first * sizeof(GpuInstance),
+                              instances, (VkDeviceSize)count * sizeof(GpuInstance));
+}
+
+void GpuSceneUpdateInstances(GpuScene* scene, VkCommandBuffer cmd, uint32_t first, uint32_t count,
+                             const GpuInstance* instances)
+{
+    if (first > scene->maxInstances || count > scene->maxInstances - first) {
+        PRINT_ERROR("GpuScene: Instances %u-%u out of range\n", first, first + count);
+        return;
+    }
+
+    // Reads of the old data by earlier frames come first in queue order
+    VkMemoryBarrier war = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &war, 0, NULL, 0, NULL);
+
+    const uint8_t* data = (const uint8_t*)instances;
+    VkDeviceSize offset = (VkDeviceSize)first * sizeof(GpuInstance);
+    VkDeviceSize remaining = (VkDeviceSize)count * sizeof(GpuInstance);
+    while (remaining > 0) {
+        VkDeviceSize size = MIN(remaining, GPU_SCENE_UPDATE_LIMIT);
+        vkCmdUpdateBuffer(cmd, scene->instanceBuffer, offset, size, data);
+        data += size;
+        offset += size;
+        remaining -= size;
+    }
+
+    // Culling reads the instances, and so do the vertex shaders of the draws at gl_InstanceIndex
+    VkMemoryBarrier written = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         0, 1, &written, 0, NULL, 0, NULL);
+}
+
+void GpuSceneSetInstanceCount(GpuScene* scene, uint32_t count)
+{
+    scene->instanceCount = MIN(count, scene->maxInstances);
+}
+
+// HI-Z PYRAMID ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GpuSceneBuildHiZ(GpuScene* scene, VkCommandBuffer cmd, VkImageView depth_view, VkImageLayout depth_layout,
+                      uint32_t width, uint32_t height, const mat4* view_proj)
+{
+    if (!scene->occlusion) {
+        return;
+    }
+    if (width > GPU_SCENE_HIZ_MAX_SIZE || height > GPU_SCENE_HIZ_MAX_SIZE ||
+        HiZLevelCount(width, height) > scene->hizAllocatedLevels) {
+        PRINT_ERROR("GpuScene: %ux%u depth does not fit the Hi-Z pyramid\n", width, height);
+        return;
+    }
+
+    Vulkan* vk = scene->vk;
+    uint32_t slot = (uint32_t)(vk->frameNumber % vk->framesInFlight);
+    if (scene->hizFrame != vk->frameNumber) {
+        scene->hizFrame = vk->frameNumber;
+        scene->hizBuildsThisFrame = 0;
+    }
+    if (scene->hizBuildsThisFrame == GPU_SCENE_HIZ_BUILDS) {
+        PRINT_ERROR("GpuScene: More than %u Hi-Z builds in a frame\n", GPU_SCENE_HIZ_BUILDS);
+        return;
+    }
+
+    // The slot's previous frame has completed, so its set can be pointed at another depth buffer
+    uint32_t build = scene->hizBuildsThisFrame++;
+    VkDescriptorSet set = scene->hizSets[slot][build];
+    if (scene->hizDepthViews[slot][build] != depth_view || scene->hizDepthLayouts[slot][build] != depth_layout) {
+        VkDescriptorImageInfo depth_info = { scene->hizSampler, depth_view, depth_layout };
+        VkWriteDescriptorSet write = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &depth_info
+        };
+        vkUpdateDescriptorSets(vk->device, 1, &write, 0, NULL);
+        scene->hizDepthViews[slot][build] = depth_view;
+        scene->hizDepthLayouts[slot][build] = depth_layout;
+    }
+
+    VulkanProfilerBeginScope(&vk->profiler, cmd, "Hi-Z");
+
+    // Culls (and the previous build) are done with the pyramid before it is overwritten
+    VkMemoryBarrier before = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+    };
+    VkImageMemoryBarrier layout = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = scene->hizImage,
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 }
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         1, &before, 0, NULL, scene->hizInitialized ? 0 : 1, &layout);
+    scene->hizInitialized = true;
+
+    vkCmdFillBuffer(cmd, scene->hizCounter, 0, sizeof(uint32_t), 0);
+    VkMemoryBarrier cleared = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &cleared, 0, NULL, 0, NULL);
+
+    // One workgroup per 64x64 depth tile
+    uint32_t groups_x = (width + GPU_SCENE_HIZ_TILE - 1) / GPU_SCENE_HIZ_TILE;
+    uint32_t groups_y = (height + GPU_SCENE_HIZ_TILE - 1) / GPU_SCENE_HIZ_TILE;
+    GpuSceneHiZParams params = {
+        .depthSize = { width, height },
+        .levelCount = HiZLevelCount(width, height),
+        .groupCount = groups_x * groups_y
+    };
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->hizPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->hizPipelineLayout, 0, 1, &set, 0, NULL);
+    vkCmdPushConstants(cmd, scene->hizPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    vkCmdDispatch(cmd, groups_x, groups_y, 1);
+
+    VkMemoryBarrier built = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &built, 0, NULL, 0, NULL);
+
+    VulkanProfilerEndScope(&vk->profiler, cmd);
+
+    scene->hizValid = true;
+    scene->hizWidth = width;
+    scene->hizHeight = height;
+    scene->hizLevels = params.levelCount;
+    scene->hizViewProj = *view_proj;
+}
+
+void GpuSceneInvalidateDepth(GpuScene* scene)
+{
+    // The next build of every set rewrites its depth descriptor, whatever handle it is given
+    memset(scene->hizDepthViews, 0, sizeof(scene->hizDepthViews));
+}
+
+// CULLING AND DRAWING /////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t WriteCullParams(GpuScene* scene, const mat4* view_proj, uint32_t flags)
+{
+    Vulkan* vk = scene->vk;
+    uint32_t index = (uint32_t)(vk->frameNumber % vk->framesInFlight) * 2 + ((flags & GPU_SCENE_CULL_LATE) ? 1 : 0);
+    GpuSceneCullParams* params = (GpuSceneCullParams*)scene->paramsAllocation.mapped + index;
+    memset(params, 0, sizeof(*params));
+
+    if (view_proj) {
+        Frustum frustum;
+        FrustumFromMatrix(&frustum, view_proj);
+        for (uint32_t i = 0; i < 6; i++) {
+            params->planes[i][0] = frustum.nx[i];
+            params->planes[i][1] = frustum.ny[i];
+            params->planes[i][2] = frustum.nz[i];
+            params->planes[i][3] = frustum.d[i];
+        }
+    }
+
+    // GLSL matrices are column-major
+    for (uint32_t row = 0; row < 4; row++) {
+        for (uint32_t col = 0; col < 4; col++) {
+            params->hizViewProj[col][row] = scene->hizViewProj.idx[row][col];
+        }
+    }
+    params->hizSize[0] = (float)scene->hizWidth;
+    params->hizSize[1] = (float)scene->hizHeight;
+    params->hizLevels = scene->hizLevels;
+    params->instanceCount = scene->instanceCount;
+    params->flags = flags;
+    params->drawBase = (flags & GPU_SCENE_CULL_LATE) ? scene->maxInstances : 0;
+    VulkanMemoryFlush(&vk->memory, &scene->paramsAllocation);
+    return index;
+}
+
+static void DispatchCull(GpuScene* scene, VkCommandBuffer cmd, uint32_t params_index)
+{
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->cullPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->pipelineLayout, 0, 1, &scene->set, 0, NULL);
+    vkCmdPushConstants(cmd, scene->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params_index), &params_index);
+    vkCmdDispatch(cmd, (scene->instanceCount + GPU_SCENE_CULL_GROUP_SIZE - 1) / GPU_SCENE_CULL_GROUP_SIZE, 1, 1);
+
+    // Draws, the late pass and the count readback see the results
+    VkMemoryBarrier culled = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT |
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &culled, 0, NULL, 0, NULL);
+
+    // Counts of this slot, read back when it comes around again
+    uint32_t slot = (uint32_t)(scene->vk->frameNumber % scene->vk->framesInFlight);
+    VkBufferCopy copy = { 0, (VkDeviceSize)slot * sizeof(GpuSceneCounts), sizeof(GpuSceneCounts) };
+    vkCmdCopyBuffer(cmd, scene->countBuffer, scene->readbackBuffer, 1, &copy);
+
+    VkMemoryBarrier readback = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &readback, 0, NULL, 0, NULL);
+}
+
+void GpuSceneCull(GpuScene* scene, VkCommandBuffer cmd, const mat4* view_proj)
+{
+    Vulkan* vk = scene->vk;
+    uint32_t slot = (uint32_t)(vk->frameNumber % vk->framesInFlight);
+
+    // The slot's fence has been waited on, so its counts are in
+    VulkanMemoryInvalidate(&vk->memory, &scene->readbackAllocation);
+    scene->counts = ((const GpuSceneCounts*)scene->readbackAllocation.mapped)[slot];
+
+    VulkanProfilerBeginScope(&vk->profiler, cmd, "GPU Cull");
+
+    // Earlier frames' indirect draws and count readback are done with the buffers we overwrite; instance
+    // updates and uploads recorded before are visible to culling
+    VkMemoryBarrier before = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT |
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &before, 0, NULL, 0, NULL);
+
+    vkCmdFillBuffer(cmd, scene->countBuffer, 0, sizeof(GpuSceneCounts), 0);
+    if (!scene->drawCount && scene->instanceCount > 0) {
+        // Without a count, every slot up to instanceCount gets drawn: culled ones must be empty draws
+        VkDeviceSize size = (VkDeviceSize)scene->instanceCount * sizeof(VkDrawIndexedIndirectCommand);
+        vkCmdFillBuffer(cmd, scene->drawBuffer, 0, size, 0);
+        if (scene->occlusion) {
+            vkCmdFillBuffer(cmd, scene->drawBuffer,
+                            (VkDeviceSize)scene->maxInstances * sizeof(VkDrawIndexedIndirectCommand), size, 0);
+        }
+    }
+
+    VkMemoryBarrier cleared = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &cleared, 0, NULL, 0, NULL);
+
+    // Before the first pyramid exists everything in the frustum is drawn early
+    uint32_t flags = scene->occlusion && scene->hizValid ? GPU_SCENE_CULL_OCCLUSION : 0;
+    DispatchCull(scene, cmd, WriteCullParams(scene, view_proj, flags));
+    scene->earlyFrame = vk->frameNumber;
+
+    VulkanProfilerEndScope(&vk->profiler, cmd);
+}
+
+void GpuSceneCullLate(GpuScene* scene, VkCommandBuffer cmd)
+{
+    Vulkan* vk = scene->vk;
+    if (!scene->occlusion || scene->earlyFrame != vk->frameNumber) {
+        return;
+    }
+
+    // Frustum planes are not needed: every instance on the retest list passed them early
+    VulkanProfilerBeginScope(&vk->profiler, cmd, "GPU Cull Late");
+    DispatchCull(scene, cmd, WriteCullParams(scene, NULL, GPU_SCENE_CULL_OCCLUSION | GPU_SCENE_CULL_LATE));
+    VulkanProfilerEndScope(&vk->profiler, cmd);
+}
+
+static void DrawRange(GpuScene* scene, VkCommandBuffer cmd, uint32_t first_draw, VkDeviceSize count_offset)
+{
+    if (scene->instanceCount == 0) {
+        return;
+    }
+
+    uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    VkDeviceSize offset = (VkDeviceSize)first_draw * stride;
+    if (scene->drawCount) {
+        vkCmdDrawIndexedIndirectCount(cmd, scene->drawBuffer, offset, scene->countBuffer, count_offset,
+                                      scene->instanceCount, stride);
+        return;
+    }
+
+    // Visible draws are packed at the front, the rest are empty; split by the device's per-call limit
+    for (uint32_t first = 0; first < scene->instanceCount; first += scene->vk->maxDrawIndirectCount) {
+        uint32_t count = MIN(scene->instanceCount - first, scene->vk->maxDrawIndirectCount);
+        vkCmdDrawIndexedIndirect(cmd, scene->drawBuffer, offset + (VkDeviceSize)first * stride, count, stride);
+    }
+}
+
+void GpuSceneDraw(GpuScene* scene, VkCommandBuffer cmd)
+{
+    DrawRange(scene, cmd, 0, offsetof(GpuSceneCounts, earlyDraws));
+}
+
+void GpuSceneDrawLate(GpuScene* scene, VkCommandBuffer cmd)
+{
+    if (scene->occlusion && scene->earlyFrame == scene->vk->frameNumber) {
+        DrawRange(scene, cmd, scene->maxInstances, offsetof(GpuSceneCounts, lateDraws));
+    }
+}
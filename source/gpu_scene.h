@@ -0,0 +1,174 @@
+#pragma once
+
+#include "vulkan.h"
+#include "vmath.h"
+
+// SPIR-V of shaders/*.comp, compiled by build.bat
+#define GPU_SCENE_CULL_SHADER       "shaders/gpu_cull.comp.spv"
+#define GPU_SCENE_HIZ_SHADER        "shaders/gpu_hiz.comp.spv"
+#define GPU_SCENE_CULL_GROUP_SIZE   64
+
+// Hi-Z pyramid limits. One workgroup reduces a 64x64 depth tile to 6 levels and the last group to finish
+// builds the rest, which covers depth buffers up to 4096 pixels on a side.
+#define GPU_SCENE_HIZ_MAX_LEVELS    12
+#define GPU_SCENE_HIZ_MAX_SIZE      4096
+#define GPU_SCENE_HIZ_TILE          64
+#define GPU_SCENE_HIZ_BUILDS        2       // Pyramid builds per frame: previous frame's depth, early pass depth
+
+// GpuSceneCullParams::flags
+#define GPU_SCENE_CULL_OCCLUSION    0x1
+#define GPU_SCENE_CULL_LATE         0x2
+
+// Geometry of one mesh inside the shared vertex and index buffers, std430 layout
+typedef struct GpuMesh {
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t  vertexOffset;
+    uint32_t pad0;
+    float    center[3];         // Bounding box in mesh space
+    float    pad1;
+    float    extent[3];         // Half size along each axis
+    float    pad2;
+} GpuMesh;
+
+// One placed mesh, std430 layout
+typedef struct GpuInstance {
+    float    transform[3][4];   // Rows of the object-to-world matrix, the last row is (0, 0, 0, 1)
+    uint32_t mesh;
+    uint32_t material;          // Not used by culling; for the shaders that draw the instance
+    uint32_t pad[2];
+} GpuInstance;
+
+// Inputs of one cull dispatch, std430 layout
+typedef struct GpuSceneCullParams {
+    float    planes[6][4];      // Frustum planes, xyz . p + w >= 0 inside
+    float    hizViewProj[4][4]; // Column-major view-projection the pyramid's depth was rendered with
+    float    hizSize[2];        // Depth buffer size the pyramid was built from
+    uint32_t hizLevels;
+    uint32_t instanceCount;
+    uint32_t flags;
+    uint32_t drawBase;          // First draw slot written
+    uint32_t pad[2];
+} GpuSceneCullParams;
+
+// Per-frame readback of the counts buffer
+typedef struct GpuSceneCounts {
+    uint32_t earlyDraws;
+    uint32_t lateDraws;
+    uint32_t retested;          // Failed the occlusion test against the previous frame's pyramid
+    uint32_t pad;
+} GpuSceneCounts;
+
+// GPU-driven drawing of every instance in the scene. Meshes and instances live in storage buffers; a
+// compute pass culls the instances and writes one VkDrawIndexedIndirectCommand per visible instance,
+// compacted to the front of the draw buffer, plus the draw count. The whole scene is then drawn with a
+// single vkCmdDrawIndexedIndirectCount, so the CPU cost does not grow with the scene.
+//
+// With occlusion culling the frame runs in two phases:
+//   GpuSceneBuildHiZ(previous frame's depth)   max-depth pyramid, before the depth buffer is cleared
+//   GpuSceneCull + GpuSceneDraw                frustum and pyramid tests, draws what passes
+//   GpuSceneBuildHiZ(this frame's depth)       rebuilt from what the early draws rendered
+//   GpuSceneCullLate + GpuSceneDrawLate        re-tests the occluded ones, draws those now visible
+// so objects uncovered this frame are drawn this frame instead of popping in one frame late. Depth is
+// expected in [0, 1] with nearer values smaller.
+//
+// Draws carry the instance index in firstInstance: vertex shaders read their instance from
+// instanceBuffer at gl_InstanceIndex. Compaction does not keep instance order.
+// Not thread-safe; owned by the thread that records and submits Vulkan work.
+typedef struct GpuScene {
+    Vulkan*          vk;
+
+    VkBuffer         meshBuffer;
+    VulkanAllocation meshAllocation;
+    VkBuffer         instanceBuffer;
+    VulkanAllocation instanceAllocation;
+    VkBuffer         drawBuffer;        // Early draws from 0, late draws from maxInstances
+    VulkanAllocation drawAllocation;
+    VkBuffer         countBuffer;       // GpuSceneCounts of the last cull
+    VulkanAllocation countAllocation;
+    VkBuffer         retestBuffer;      // Instances the late pass re-tests
+    VulkanAllocation retestAllocation;
+    VkBuffer         paramsBuffer;      // GpuSceneCullParams, early and late for each frame in flight
+    VulkanAllocation paramsAllocation;
+    VkBuffer         readbackBuffer;    // GpuSceneCounts of each frame in flight, for statistics
+    VulkanAllocation readbackAllocation;
+
+    uint32_t         maxMeshes;
+    uint32_t         maxInstances;
+    uint32_t         instanceCount;     // Instances culled and drawn, [0, instanceCount) of the buffer
+    bool             drawCount;         // vkCmdDrawIndexedIndirectCount available; otherwise culled draws are zeroed
+
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool      descriptorPool;
+    VkDescriptorSet       set;
+    VkPipelineLayout      pipelineLayout;
+    VkPipeline            cullPipeline;
+
+    // Hi-Z pyramid, allocated for the largest depth buffer up front and used partially for smaller ones
+    bool             occlusion;
+    VkImage          hizImage;
+    VulkanAllocation hizAllocation;
+    VkImageView      hizView;           // All levels, sampled by culling
+    VkImageView      hizLevelViews[GPU_SCENE_HIZ_MAX_LEVELS];   // Storage views written by the build
+    uint32_t         hizAllocatedLevels;
+    VkSampler        hizSampler;
+    VkBuffer         hizCounter;        // Workgroups done with their tile, finds the last one
+    VulkanAllocation hizCounterAllocation;
+    VkDescriptorSetLayout hizSetLayout;
+    VkDescriptorPool      hizDescriptorPool;
+    VkDescriptorSet       hizSets[VULKAN_MAX_FRAMES_IN_FLIGHT][GPU_SCENE_HIZ_BUILDS];
+    VkImageView           hizDepthViews[VULKAN_MAX_FRAMES_IN_FLIGHT][GPU_SCENE_HIZ_BUILDS]; // Bound to hizSets
+    VkImageLayout         hizDepthLayouts[VULKAN_MAX_FRAMES_IN_FLIGHT][GPU_SCENE_HIZ_BUILDS];
+    VkPipelineLayout      hizPipelineLayout;
+    VkPipeline            hizPipeline;
+    bool             hizInitialized;    // Moved to GENERAL
+    bool             hizValid;          // Holds a built pyramid
+    uint32_t         hizWidth;          // Depth buffer of the last build
+    uint32_t         hizHeight;
+    uint32_t         hizLevels;
+    mat4             hizViewProj;
+    uint64_t         hizFrame;          // Frame of hizBuildsThisFrame
+    uint32_t         hizBuildsThisFrame;
+    uint64_t         earlyFrame;        // Last frame GpuSceneCull ran, the late pass needs its retest list
+
+    GpuSceneCounts   counts;            // Counts framesInFlight frames ago
+} GpuScene;
+
+// Needs vk->multiDrawIndirect; returns false (and stays unusable) without it or the shaders. hiz_width and
+// hiz_height are the largest depth buffer occlusion culling will see, 0 to cull against the frustum only.
+bool GpuSceneInit(GpuScene* scene, Vulkan* vk, uint32_t max_meshes, uint32_t max_instances,
+                  uint32_t hiz_width, uint32_t hiz_height);
+// The frames drawing the scene must have completed
+void GpuSceneDestroy(GpuScene* scene);
+
+// Bulk updates through vk->uploader, for data no frame in flight reads (loading, new instances)
+bool GpuSceneSetMeshes(GpuScene* scene, uint32_t first, uint32_t count, const GpuMesh* meshes);
+bool GpuSceneSetInstances(GpuScene* scene, uint32_t first, uint32_t count, const GpuInstance* instances);
+// Per-frame updates (moving instances) recorded into the frame command buffer ahead of GpuSceneCull,
+// ordered after the frames in flight that still read the old data. Meant for small ranges: the data is
+// copied into the command buffer.
+void GpuSceneUpdateInstances(GpuScene* scene, VkCommandBuffer cmd, uint32_t first, uint32_t count,
+                             const GpuInstance* instances);
+void GpuSceneSetInstanceCount(GpuScene* scene, uint32_t count);
+
+// Builds the Hi-Z pyramid from a depth buffer rendered with view_proj. The depth image must be readable
+// by compute shaders through depth_view in depth_layout (DEPTH_STENCIL_READ_ONLY_OPTIMAL or
+// SHADER_READ_ONLY_OPTIMAL, with its writes made visible) and sampled usage. Record outside a render pass.
+void GpuSceneBuildHiZ(GpuScene* scene, VkCommandBuffer cmd, VkImageView depth_view, VkImageLayout depth_layout,
+                      uint32_t width, uint32_t height, const mat4* view_proj);
+// Call when depth buffers passed to GpuSceneBuildHiZ are destroyed (swapchain recreation): descriptor
+// sets are only rewritten for a new view handle, and a recreated view may reuse the old one
+void GpuSceneInvalidateDepth(GpuScene* scene);
+
+// Culls [0, instanceCount) against view_proj and, once a pyramid has been built, against the pyramid;
+// leaves the draw and count buffers ready for GpuSceneDraw. Record after VulkanBeginFrame and outside a
+// render pass.
+void GpuSceneCull(GpuScene* scene, VkCommandBuffer cmd, const mat4* view_proj);
+// Re-tests the instances GpuSceneCull found occluded against the pyramid as last built; a no-op without
+// occlusion culling. Same recording rules as GpuSceneCull.
+void GpuSceneCullLate(GpuScene* scene, VkCommandBuffer cmd);
+
+// Issue the culled draws. The caller binds the pipeline, its descriptors and the shared vertex and
+// index buffers the meshes point into.
+void GpuSceneDraw(GpuScene* scene, VkCommandBuffer cmd);
+void GpuSceneDrawLate(GpuScene* scene, VkCommandBuffer cmd);
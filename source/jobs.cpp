@@ -0,0 +1,469 @@
+#include "jobs.h"
+
+#if defined(_MSC_VER)
+    #define JOBS_NOINLINE __declspec(noinline)
+#else
+    #define JOBS_NOINLINE __attribute__((noinline))
+#endif
+
+namespace ZX {
+
+// Index of the worker running on this thread; the creating thread owns slot 0
+static thread_local uint32_t t_threadIndex = 0;
+
+// Spins before a worker parks itself on the wake condition
+static constexpr int IDLE_SPIN_COUNT = 256;
+
+// JOB QUEUE //////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool JobQueue::Push(JobSlot* slot)
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+
+    if (bottom - top >= static_cast<int64_t>(CAPACITY)) {
+        return false;
+    }
+
+    m_slots[bottom & (CAPACITY - 1)].store(slot, std::memory_order_relaxed);
+    m_bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+JobSlot* JobQueue::Pop()
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        // Queue was empty
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    JobSlot* slot = m_slots[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // Last job: race any thief for it
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            slot = nullptr;
+        }
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return slot;
+}
+
+JobSlot* JobQueue::Steal()
+{
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+    if (top >= bottom) {
+        return nullptr;
+    }
+
+    JobSlot* slot = m_slots[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return slot;
+}
+
+// JOB SYSTEM /////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::unique_ptr<JobSystem> JobSystem::Create(uint32_t workerCount, uint32_t externalThreads)
+{
+    if (workerCount == 0) {
+        uint32_t cores = std::thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    auto system = std::make_unique<JobSystem>();
+
+    // Slot 0 belongs to the calling thread, workers get their own OS thread and the external slots
+    // wait for AttachThread
+    t_threadIndex = 0;
+    system->m_creatorThread = std::this_thread::get_id();
+    system->m_nextExternal.store(workerCount + 1);
+    for (uint32_t i = 0; i <= workerCount + externalThreads; i++) {
+        auto worker = std::make_unique<Worker>();
+        worker->nextSlot = 0;
+        worker->stealSeed = 0x9E3779B9u ^ (i * 0x85EBCA6Bu);
+        worker->threadFiber = {};
+        worker->currentFiber = nullptr;
+        worker->pendingRelease = nullptr;
+        worker->pendingWait = {};
+        system->m_workers.push_back(std::move(worker));
+    }
+
+    // Stacks are allocated once up front and recycled with their fibers
+    system->m_fibers = std::make_unique<Fiber[]>(FIBER_COUNT);
+    system->m_freeFibers.reserve(FIBER_COUNT);
+    system->m_waitList.reserve(FIBER_COUNT);
+    for (uint32_t i = 0; i < FIBER_COUNT; i++) {
+        if (!FiberCreate(&system->m_fibers[i], FIBER_STACK_SIZE, &JobSystem::FiberMain, system.get())) {
+            break;
+        }
+        system->m_freeFibers.push_back(&system->m_fibers[i]);
+        system->m_fiberCount++;
+    }
+
+    JobSystem* self = system.get();
+    for (uint32_t i = 1; i <= workerCount; i++) {
+        system->m_workers[i]->thread = std::thread([self, i]() { self->WorkerLoop(i); });
+    }
+
+    return system;
+}
+
+JobSystem::JobSystem()
+    : m_nextExternal(0)
+    , m_fiberCount(0)
+    , m_waiting(0)
+    , m_running(true)
+    , m_queued(0)
+    , m_sleeping(0)
+{
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_running.store(false);
+    }
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+
+    for (uint32_t i = 0; i < m_fiberCount; i++) {
+        FiberDestroy(&m_fibers[i]);
+    }
+}
+
+// Kept out of line: a fiber can resume on a different thread, and an inlined TLS access may
+// otherwise reuse the previous thread's address across the switch
+JOBS_NOINLINE uint32_t JobSystem::GetThreadIndex()
+{
+    return t_threadIndex;
+}
+
+bool JobSystem::AttachThread()
+{
+    if (t_threadIndex != 0 || std::this_thread::get_id() == m_creatorThread) {
+        return true;
+    }
+
+    uint32_t index = m_nextExternal.fetch_add(1);
+    if (index >= GetThreadCount()) {
+        return false;
+    }
+
+    // Runs jobs only while waiting, like the creating thread: no fiber scheduler
+    t_threadIndex = index;
+    return true;
+}
+
+JobSystem::Worker* JobSystem::CurrentWorker()
+{
+    return m_workers[GetThreadIndex()].get();
+}
+
+uint32_t JobSystem::DefaultGrain(uint32_t count) const
+{
+    // Several chunks per thread so stealing can even out uneven work
+    uint32_t chunks = GetThreadCount() * 8;
+    uint32_t grain = count / chunks;
+    return grain > 0 ? grain : 1;
+}
+
+JobSlot* JobSystem::AllocateSlot()
+{
+    Worker* worker = CurrentWorker();
+
+    // Round-robin over this thread's slots, skipping any whose job has not been picked up yet
+    for (uint32_t i = 0; i < SLOT_COUNT; i++) {
+        JobSlot* slot = &worker->slots[worker->nextSlot++ & (SLOT_COUNT - 1)];
+        if (!slot->busy.load(std::memory_order_acquire)) {
+            slot->busy.store(true, std::memory_order_relaxed);
+            return slot;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::Submit(const Job& job)
+{
+    JobSlot* slot = AllocateSlot();
+
+    if (slot) {
+        slot->job = job;
+    }
+
+    if (!slot || !CurrentWorker()->queue.Push(slot)) {
+        // Out of room: run it here rather than drop it
+        if (slot) {
+            slot->busy.store(false, std::memory_order_relaxed);
+        }
+        Execute(job);
+        return;
+    }
+
+    m_queued.fetch_add(1);
+    if (m_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_wake.notify_one();
+    }
+}
+
+void JobSystem::Run(const Job* jobs, uint32_t count, JobCounter* counter)
+{
+    if (counter) {
+        counter->value.fetch_add(static_cast<int32_t>(count), std::memory_order_relaxed);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        Submit(jobs[i]);
+    }
+}
+
+void JobSystem::Run(JobFunction function, void* data, JobCounter* counter)
+{
+    Job job = {};
+    job.function = function;
+    job.data = data;
+    job.counter = counter;
+
+    Run(&job, 1, counter);
+}
+
+bool JobSystem::Fetch(Job* job)
+{
+    Worker* worker = CurrentWorker();
+    JobSlot* slot = worker->queue.Pop();
+
+    if (!slot) {
+        uint32_t count = GetThreadCount();
+
+        // xorshift picks the first victim so thieves do not all hammer the same queue
+        worker->stealSeed ^= worker->stealSeed << 13;
+        worker->stealSeed ^= worker->stealSeed >> 17;
+        worker->stealSeed ^= worker->stealSeed << 5;
+
+        uint32_t start = worker->stealSeed % count;
+        for (uint32_t i = 0; i < count && !slot; i++) {
+            uint32_t victim = (start + i) % count;
+            if (m_workers[victim].get() != worker) {
+                slot = m_workers[victim]->queue.Steal();
+            }
+        }
+    }
+
+    if (!slot) {
+        return false;
+    }
+
+    *job = slot->job;
+    slot->busy.store(false, std::memory_order_release);
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+void JobSystem::Execute(Job job)
+{
+    // Split oversized ranges, handing the upper half to other threads
+    while (job.end - job.begin > job.grain) {
+        uint32_t mid = job.begin + (job.end - job.begin) / 2;
+
+        Job upper = job;
+        upper.begin = mid;
+        if (job.counter) {
+            job.counter->value.fetch_add(1, std::memory_order_relaxed);
+        }
+        Submit(upper);
+
+        job.end = mid;
+    }
+
+    job.function(job.data, job.begin, job.end);
+
+    if (job.counter) {
+        job.counter->value.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void JobSystem::HelpUntilDone(JobCounter* counter)
+{
+    Job job;
+    while (!counter->IsDone()) {
+        if (Fetch(&job)) {
+            Execute(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+    if (counter->IsDone()) {
+        return;
+    }
+
+    Worker* worker = CurrentWorker();
+    Fiber* next = worker->currentFiber ? AcquireFiber() : nullptr;
+    if (!next) {
+        HelpUntilDone(counter);
+        return;
+    }
+
+    // Park this fiber and keep the thread busy on a fresh one. The fiber is only added to the
+    // wait list once we have switched off its stack (see CompleteSwitch).
+    worker->pendingWait = { worker->currentFiber, counter };
+    SwitchTo(worker, next);
+
+    // Resumed by SchedulerLoop once the counter drained, possibly on another worker
+    CompleteSwitch(CurrentWorker());
+}
+
+// FIBER SCHEDULER ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::FiberMain(void* arg)
+{
+    static_cast<JobSystem*>(arg)->SchedulerLoop();
+}
+
+Fiber* JobSystem::AcquireFiber()
+{
+    std::lock_guard<std::mutex> lock(m_fiberMutex);
+    if (m_freeFibers.empty()) {
+        return nullptr;
+    }
+    Fiber* fiber = m_freeFibers.back();
+    m_freeFibers.pop_back();
+    return fiber;
+}
+
+Fiber* JobSystem::TakeReadyFiber()
+{
+    if (m_waiting.load(std::memory_order_acquire) == 0) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_waitMutex);
+    for (size_t i = 0; i < m_waitList.size(); i++) {
+        if (m_waitList[i].counter->IsDone()) {
+            Fiber* fiber = m_waitList[i].fiber;
+            m_waitList[i] = m_waitList.back();
+            m_waitList.pop_back();
+            m_waiting.fetch_sub(1, std::memory_order_relaxed);
+            return fiber;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::SwitchTo(Worker* worker, Fiber* fiber)
+{
+    Fiber* current = worker->currentFiber;
+    worker->currentFiber = fiber;
+    FiberSwitch(current, fiber);
+}
+
+// Finishes bookkeeping for the fiber we just left, now that nothing runs on its stack
+void JobSystem::CompleteSwitch(Worker* worker)
+{
+    if (worker->pendingRelease) {
+        std::lock_guard<std::mutex> lock(m_fiberMutex);
+        m_freeFibers.push_back(worker->pendingRelease);
+        worker->pendingRelease = nullptr;
+    }
+
+    if (worker->pendingWait.fiber) {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+        m_waitList.push_back(worker->pendingWait);
+        m_waiting.fetch_add(1, std::memory_order_release);
+        worker->pendingWait = {};
+    }
+}
+
+void JobSystem::SchedulerLoop()
+{
+    Job job;
+    int idle = 0;
+
+    for (;;) {
+        // Looked up on every iteration: after a switch this fiber may be running on another thread
+        Worker* worker = CurrentWorker();
+        CompleteSwitch(worker);
+
+        if (!m_running.load(std::memory_order_relaxed)) {
+            if (worker->currentFiber) {
+                SwitchTo(worker, &worker->threadFiber);
+            }
+            return;
+        }
+
+        // Parked jobs whose counters drained come first; this loop fiber returns to the pool
+        if (worker->currentFiber) {
+            if (Fiber* ready = TakeReadyFiber()) {
+                worker->pendingRelease = worker->currentFiber;
+                SwitchTo(worker, ready);
+                idle = 0;
+                continue;
+            }
+        }
+
+        if (Fetch(&job)) {
+            Execute(job);
+            idle = 0;
+            continue;
+        }
+
+        // Parked fibers are found by polling, so never sleep while any exist
+        if (++idle < IDLE_SPIN_COUNT || m_waiting.load(std::memory_order_relaxed) > 0) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Park until new work is queued. m_sleeping is raised before m_queued is checked and
+        // Submit raises m_queued before checking m_sleeping, so a wakeup cannot be missed.
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_sleeping.fetch_add(1);
+        m_wake.wait(lock, [this]() { return m_queued.load() > 0 || !m_running.load(); });
+        m_sleeping.fetch_sub(1);
+        idle = 0;
+    }
+}
+
+void JobSystem::WorkerLoop(uint32_t index)
+{
+    t_threadIndex = index;
+    Worker* worker = m_workers[index].get();
+
+    // Run the scheduler on pooled fibers; SchedulerLoop switches back here on shutdown
+    Fiber* fiber = nullptr;
+    if (FiberFromThread(&worker->threadFiber)) {
+        fiber = AcquireFiber();
+        if (!fiber) {
+            FiberToThread(&worker->threadFiber);
+        }
+    }
+
+    if (fiber) {
+        worker->currentFiber = &worker->threadFiber;
+        SwitchTo(worker, fiber);
+        FiberToThread(&worker->threadFiber);
+        return;
+    }
+
+    SchedulerLoop();
+}
+
+} // namespace ZX
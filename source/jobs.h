@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "fiber.h"
+
+namespace ZX {
+
+// Job entry point. Range jobs receive the sub-range [begin, end) they have to process,
+// single jobs get begin == end == 0.
+using JobFunction = void (*)(void* data, uint32_t begin, uint32_t end);
+
+// Completion counter: incremented for every job submitted against it, decremented when a job
+// finishes. Work that depends on a batch of jobs waits for the counter to reach zero.
+struct JobCounter {
+    std::atomic<int32_t> value{0};
+
+    bool IsDone() const { return value.load(std::memory_order_acquire) <= 0; }
+};
+
+struct Job {
+    JobFunction function;
+    void*       data;
+    uint32_t    begin;
+    uint32_t    end;
+    uint32_t    grain;      // Ranges larger than this are split in half before running
+    JobCounter* counter;
+};
+
+// Queued job storage; busy stays set until whoever dequeues the job has copied it out
+struct JobSlot {
+    Job               job;
+    std::atomic<bool> busy{false};
+};
+
+// Fixed-size Chase-Lev deque. The owning worker pushes and pops at the bottom,
+// other workers steal from the top.
+class JobQueue {
+public:
+    static constexpr uint32_t CAPACITY = 4096;
+
+    bool Push(JobSlot* slot);
+    JobSlot* Pop();
+    JobSlot* Steal();
+
+private:
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    std::atomic<JobSlot*> m_slots[CAPACITY];
+};
+
+class JobSystem {
+public:
+    // workerCount == 0 sizes the pool from the core count, leaving one core for the calling thread,
+    // which takes part in execution whenever it waits on a counter. externalThreads reserves slots for
+    // threads of our own (the render thread) that submit and wait on jobs, see AttachThread.
+    static std::unique_ptr<JobSystem> Create(uint32_t workerCount = 0, uint32_t externalThreads = 0);
+
+    JobSystem();
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Submit jobs; counter (optional) is incremented by count before any of them can run
+    void Run(const Job* jobs, uint32_t count, JobCounter* counter);
+    void Run(JobFunction function, void* data, JobCounter* counter);
+
+    // Waits for the counter to reach zero. Inside a job running on a worker the current fiber is
+    // parked and the thread moves on to other work; it resumes, possibly on another worker, once the
+    // counter drains. Other threads (the main thread) execute queued jobs until the counter is done.
+    void Wait(JobCounter* counter);
+
+    // Calls fn(begin, end) over [0, count) in chunks of at most grain items (0 picks a grain from the
+    // thread count). The calling thread participates and the call returns once every chunk is done.
+    template <typename F>
+    void ParallelFor(uint32_t count, uint32_t grain, const F& fn);
+
+    // Same as ParallelFor but returns immediately; fn must stay alive until the counter is done
+    template <typename F>
+    void ParallelForAsync(uint32_t count, uint32_t grain, const F& fn, JobCounter* counter);
+
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+    // 0 for the thread that created the system, then workers, then attached threads
+    static uint32_t GetThreadIndex();
+
+    // Gives the calling thread a queue of its own so it can submit and wait on jobs. Returns true on
+    // threads that already may (the creating thread, workers, attached threads), false once every
+    // slot reserved with externalThreads is taken; such a thread must not touch the job system.
+    bool AttachThread();
+
+private:
+    // Twice the queue capacity, so a free slot exists even with a full queue and thieves mid-copy
+    static constexpr uint32_t SLOT_COUNT = JobQueue::CAPACITY * 2;
+
+    // Fibers bound the number of jobs that can be parked in Wait at once; when the pool runs dry
+    // Wait falls back to running jobs on the waiting fiber's stack
+    static constexpr uint32_t FIBER_COUNT = 128;
+    static constexpr size_t   FIBER_STACK_SIZE = 128 * 1024;
+
+    struct WaitingFiber {
+        Fiber*      fiber;
+        JobCounter* counter;
+    };
+
+    struct Worker {
+        JobQueue     queue;
+        JobSlot      slots[SLOT_COUNT];  // Ring of job storage owned by this thread
+        uint32_t     nextSlot;
+        uint32_t     stealSeed;
+        std::thread  thread;
+
+        Fiber        threadFiber;       // The OS thread's own context, resumed on shutdown
+        Fiber*       currentFiber;      // Null on threads that do not run the fiber scheduler
+        Fiber*       pendingRelease;    // Handed back to the pool once we have switched off it
+        WaitingFiber pendingWait;       // Parked once we have switched off it
+    };
+
+    JobSlot* AllocateSlot();
+    void Submit(const Job& job);
+    bool Fetch(Job* job);
+    void Execute(Job job);
+    void WorkerLoop(uint32_t index);
+    uint32_t DefaultGrain(uint32_t count) const;
+    void HelpUntilDone(JobCounter* counter);
+
+    Worker* CurrentWorker();
+    static void FiberMain(void* arg);
+    void SchedulerLoop();
+    void SwitchTo(Worker* worker, Fiber* fiber);
+    void CompleteSwitch(Worker* worker);
+    Fiber* AcquireFiber();
+    Fiber* TakeReadyFiber();
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::thread::id                      m_creatorThread;
+    std::atomic<uint32_t>                m_nextExternal;    // Next free attached-thread slot
+
+    std::unique_ptr<Fiber[]>  m_fibers;
+    uint32_t                  m_fiberCount;
+    std::vector<Fiber*>       m_freeFibers;
+    std::mutex                m_fiberMutex;
+    std::vector<WaitingFiber> m_waitList;
+    std::mutex                m_waitMutex;
+    std::atomic<int32_t>      m_waiting;      // Entries in m_waitList
+
+    std::atomic<bool>       m_running;
+    std::atomic<int32_t>    m_queued;       // Jobs sitting in any queue
+    std::atomic<int32_t>    m_sleeping;     // Workers parked on m_wake
+    std::mutex              m_wakeMutex;
+    std::condition_variable m_wake;
+};
+
+template <typename F>
+void JobSystem::ParallelFor(uint32_t count, uint32_t grain, const F& fn)
+{
+    JobCounter counter;
+    ParallelForAsync(count, grain, fn, &counter);
+    Wait(&counter);
+}
+
+template <typename F>
+void JobSystem::ParallelForAsync(uint32_t count, uint32_t grain, const F& fn, JobCounter* counter)
+{
+    if (count == 0) {
+        return;
+    }
+
+    Job job = {};
+    job.function = [](void* data, uint32_t begin, uint32_t end) { (*static_cast<const F*>(data))(begin, end); };
+    job.data = const_cast<F*>(&fn);
+    job.begin = 0;
+    job.end = count;
+    job.grain = grain ? grain : DefaultGrain(count);
+    job.counter = counter;
+
+    Run(&job, 1, counter);
+}
+
+} // namespace ZX
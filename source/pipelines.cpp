@@ -0,0 +1,587 @@
+#include "pipelines.h"
+#include "vulkan.h"
+
+#include <algorithm>
+
+namespace ZX {
+
+// Manifest file: header followed by count PipelineDesc records
+static constexpr uint32_t MANIFEST_MAGIC = 0x4D505A58u;    // "XZPM"
+static constexpr uint32_t MANIFEST_VERSION = 1;
+
+struct ManifestHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t descSize;      // Catches layout changes of PipelineDesc
+    uint32_t count;
+};
+
+static uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325ull)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static int64_t Ticks()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+static double TicksToMs(int64_t ticks)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return static_cast<double>(ticks) * 1000.0 / static_cast<double>(frequency.QuadPart);
+}
+
+// PIPELINE DESC //////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PipelineDesc::PipelineDesc()
+{
+    memset(this, 0, sizeof(*this));
+    topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    polygonMode = VK_POLYGON_MODE_FILL;
+    cullMode = VK_CULL_MODE_BACK_BIT;
+    frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    depthTest = 1;
+    depthWrite = 1;
+    depthCompare = VK_COMPARE_OP_LESS_OR_EQUAL;
+    blend = BlendMode::Opaque;
+    colorFormat = VK_FORMAT_B8G8R8A8_SRGB;
+    depthFormat = VK_FORMAT_UNDEFINED;
+    samples = VK_SAMPLE_COUNT_1_BIT;
+}
+
+uint64_t PipelineDesc::Hash() const
+{
+    return HashBytes(this, sizeof(*this));
+}
+
+bool PipelineDesc::operator==(const PipelineDesc& other) const
+{
+    return memcmp(this, &other, sizeof(*this)) == 0;
+}
+
+// MANAGER ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::unique_ptr<PipelineManager> PipelineManager::Create(Vulkan* vk, JobSystem* jobs, const char* manifestPath,
+                                                         VkPipelineLayout layout)
+{
+    auto manager = std::make_unique<PipelineManager>(vk, jobs, manifestPath, layout);
+    if (!manager->m_layout) {
+        return nullptr;
+    }
+    return manager;
+}
+
+PipelineManager::PipelineManager(Vulkan* vk, JobSystem* jobs, const char* manifestPath, VkPipelineLayout layout)
+    : m_vk(vk)
+    , m_jobs(jobs)
+    , m_manifestPath(manifestPath)
+    , m_layout(layout)
+    , m_ownsLayout(false)
+    , m_manifestDirty(false)
+    , m_precompiling(false)
+    , m_precompileStart(0)
+{
+    if (!m_layout) {
+        VkPushConstantRange push_constants = {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+            .offset = 0,
+            .size = PUSH_CONSTANT_SIZE
+        };
+        VkPipelineLayoutCreateInfo layout_info = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_constants
+        };
+        if (vkCreatePipelineLayout(m_vk->device, &layout_info, NULL, &m_layout) != VK_SUCCESS) {
+            PRINT_ERROR("Pipelines: Failed to create pipeline layout\n");
+            m_layout = VK_NULL_HANDLE;
+        }
+        m_ownsLayout = true;
+    }
+}
+
+PipelineManager::~PipelineManager()
+{
+    WaitPrecompile();
+    SaveManifest();
+
+    VkDevice device = m_vk->device;
+    for (auto& [hash, entry] : m_entries) {
+        if (entry->pipeline) {
+            vkDestroyPipeline(device, entry->pipeline, NULL);
+        }
+    }
+    for (auto& [path, module] : m_shaders) {
+        vkDestroyShaderModule(device, module, NULL);
+    }
+    for (auto& [key, render_pass] : m_renderPasses) {
+        vkDestroyRenderPass(device, render_pass, NULL);
+    }
+    if (m_ownsLayout && m_layout) {
+        vkDestroyPipelineLayout(device, m_layout, NULL);
+    }
+}
+
+PipelineManager::Entry* PipelineManager::FindOrAdd(const PipelineDesc& desc, bool* added)
+{
+    std::lock_guard<std::mutex> lock(m_entryMutex);
+
+    // Probe past the (unlikely) hash collisions
+    uint64_t hash = desc.Hash();
+    for (;;) {
+        auto it = m_entries.find(hash);
+        if (it == m_entries.end()) {
+            break;
+        }
+        if (it->second->desc == desc) {
+            *added = false;
+            return it->second.get();
+        }
+        hash++;
+    }
+
+    auto entry = std::make_unique<Entry>();
+    entry->desc = desc;
+    Entry* result = entry.get();
+    m_entries.emplace(hash, std::move(entry));
+    *added = true;
+    return result;
+}
+
+// SHADERS AND RENDER PASSES //////////////////////////////////////////////////////////////////////////////////////////
+
+VkShaderModule PipelineManager::GetShader(const char* path)
+{
+    if (!path[0]) {
+        return VK_NULL_HANDLE;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_shaderMutex);
+        auto it = m_shaders.find(path);
+        if (it != m_shaders.end()) {
+            return it->second;
+        }
+    }
+
+    // Load outside the lock; a thread racing us on the same file wastes a module, nothing more
+    std::string bytes = System::LoadTextFile(path);
+    if (bytes.empty() || bytes.size() % 4 != 0) {
+        PRINT_ERROR("Pipelines: %s is not a SPIR-V module\n", path);
+        return VK_NULL_HANDLE;
+    }
+    std::vector<uint32_t> code(bytes.size() / 4);
+    memcpy(code.data(), bytes.data(), bytes.size());
+
+    VkShaderModuleCreateInfo module_info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = bytes.size(),
+        .pCode = code.data()
+    };
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(m_vk->device, &module_info, NULL, &module) != VK_SUCCESS) {
+        PRINT_ERROR("Pipelines: Failed to create shader module %s\n", path);
+        return VK_NULL_HANDLE;
+    }
+
+    std::lock_guard<std::mutex> lock(m_shaderMutex);
+    auto [it, inserted] = m_shaders.emplace(path, module);
+    if (!inserted) {
+        vkDestroyShaderModule(m_vk->device, module, NULL);
+    }
+    return it->second;
+}
+
+VkRenderPass PipelineManager::GetRenderPass(VkFormat colorFormat, VkFormat depthFormat, VkSampleCountFlagBits samples)
+{
+    uint32_t formats[3] = { (uint32_t)colorFormat, (uint32_t)depthFormat, (uint32_t)samples };
+    uint64_t key = HashBytes(formats, sizeof(formats));
+
+    std::lock_guard<std::mutex> lock(m_renderPassMutex);
+    auto it = m_renderPasses.find(key);
+    if (it != m_renderPasses.end()) {
+        return it->second;
+    }
+
+    // Load/store ops and layouts do not affect compatibility
+    VkAttachmentDescription attachments[2] = {};
+    attachments[0].format = colorFormat;
+    attachments[0].samples = samples;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[1] = attachments[0];
+    attachments[1].format = depthFormat;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference color_ref = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkAttachmentReference depth_ref = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+    bool has_depth = depthFormat != VK_FORMAT_UNDEFINED;
+
+    VkSubpassDescription subpass = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_ref,
+        .pDepthStencilAttachment = has_depth ? &depth_ref : NULL
+    };
+    VkRenderPassCreateInfo render_pass_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = has_depth ? 2u : 1u,
+        .pAttachments = attachments,
+        .subpassCount = 1,
+        .pSubpasses = &subpass
+    };
+
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    if (vkCreateRenderPass(m_vk->device, &render_pass_info, NULL, &render_pass) != VK_SUCCESS) {
+        PRINT_ERROR("Pipelines: Failed to create render pass\n");
+        return VK_NULL_HANDLE;
+    }
+    m_renderPasses.emplace(key, render_pass);
+    return render_pass;
+}
+
+// COMPILATION ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PipelineManager::Compile(Entry* entry, VkPipelineCache cache)
+{
+    const PipelineDesc& desc = entry->desc;
+
+    VkShaderModule vertex = GetShader(desc.vertexShader);
+    VkShaderModule fragment = GetShader(desc.fragmentShader);
+    VkRenderPass render_pass = GetRenderPass(desc.colorFormat, desc.depthFormat, desc.samples);
+    if (!vertex || !render_pass || (desc.fragmentShader[0] && !fragment)) {
+        entry->state.store(ENTRY_FAILED, std::memory_order_release);
+        return;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    uint32_t stage_count = 0;
+    stages[stage_count].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[stage_count].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[stage_count].module = vertex;
+    stages[stage_count++].pName = "main";
+    if (fragment) {
+        stages[stage_count].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[stage_count].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[stage_count].module = fragment;
+        stages[stage_count++].pName = "main";
+    }
+
+    VkVertexInputBindingDescription binding = { 0, desc.vertexStride, VK_VERTEX_INPUT_RATE_VERTEX };
+    VkVertexInputAttributeDescription attributes[PipelineDesc::MAX_ATTRIBUTES];
+    uint32_t attribute_count = desc.vertexStride ? std::min(desc.attributeCount, PipelineDesc::MAX_ATTRIBUTES) : 0;
+    for (uint32_t i = 0; i < attribute_count; i++) {
+        attributes[i] = { desc.attributes[i].location, 0, desc.attributes[i].format, desc.attributes[i].offset };
+    }
+    VkPipelineVertexInputStateCreateInfo vertex_input = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = desc.vertexStride ? 1u : 0u,
+        .pVertexBindingDescriptions = &binding,
+        .vertexAttributeDescriptionCount = attribute_count,
+        .pVertexAttributeDescriptions = attributes
+    };
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = desc.topology
+    };
+
+    // Viewport and scissor follow the swapchain, so they are set at draw time
+    VkPipelineViewportStateCreateInfo viewport = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1
+    };
+    VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamic_states
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = desc.polygonMode,
+        .cullMode = desc.cullMode,
+        .frontFace = desc.frontFace,
+        .lineWidth = 1.0f
+    };
+    VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = desc.samples
+    };
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE,
+        .depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE,
+        .depthCompareOp = desc.depthCompare
+    };
+
+    VkPipelineColorBlendAttachmentState blend = {};
+    blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                           VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    if (desc.blend != BlendMode::Opaque) {
+        blend.blendEnable = VK_TRUE;
+        blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blend.dstColorBlendFactor = desc.blend == BlendMode::Alpha ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA
+                                                                   : VK_BLEND_FACTOR_ONE;
+        blend.colorBlendOp = VK_BLEND_OP_ADD;
+        blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+    VkPipelineColorBlendStateCreateInfo color_blend = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &blend
+    };
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = stage_count,
+        .pStages = stages,
+        .pVertexInputState = &vertex_input,
+        .pInputAssemblyState = &input_assembly,
+        .pViewportState = &viewport,
+        .pRasterizationState = &rasterization,
+        .pMultisampleState = &multisample,
+        .pDepthStencilState = &depth_stencil,
+        .pColorBlendState = &color_blend,
+        .pDynamicState = &dynamic,
+        .layout = m_layout,
+        .renderPass = render_pass,
+        .subpass = 0
+    };
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    bool compiled;
+    if (cache) {
+        compiled = VulkanPipelineCacheCreateGraphics(&m_vk->pipelineCache, cache, &pipeline_info, &pipeline);
+    } else {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        compiled = VulkanPipelineCacheCreateGraphics(&m_vk->pipelineCache, VK_NULL_HANDLE, &pipeline_info, &pipeline);
+    }
+    if (!compiled) {
+        PRINT_ERROR("Pipelines: Failed to compile %s / %s\n", desc.vertexShader, desc.fragmentShader);
+        entry->state.store(ENTRY_FAILED, std::memory_order_release);
+        return;
+    }
+
+    entry->pipeline = pipeline;
+    entry->state.store(ENTRY_READY, std::memory_order_release);
+}
+
+VkPipeline PipelineManager::Get(const PipelineDesc& desc)
+{
+    bool added = false;
+    Entry* entry = FindOrAdd(desc, &added);
+    if (added) {
+        m_manifestDirty = true;
+        PRINT_DEBUG("Pipelines: Compiling new permutation %s / %s on first use\n", desc.vertexShader, desc.fragmentShader);
+    }
+
+    uint32_t state = entry->state.load(std::memory_order_acquire);
+    if (state == ENTRY_QUEUED) {
+        // Not picked up by a job thread yet (or never queued): do it here instead of waiting in line
+        uint32_t expected = ENTRY_QUEUED;
+        if (entry->state.compare_exchange_strong(expected, ENTRY_COMPILING, std::memory_order_acq_rel)) {
+            Compile(entry, VK_NULL_HANDLE);
+        }
+        state = entry->state.load(std::memory_order_acquire);
+    }
+    while (state == ENTRY_COMPILING) {
+        std::this_thread::yield();
+        state = entry->state.load(std::memory_order_acquire);
+    }
+
+    return state == ENTRY_READY ? entry->pipeline : VK_NULL_HANDLE;
+}
+
+// PRECOMPILATION /////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t PipelineManager::PrecompileAsync()
+{
+    if (m_precompiling.load(std::memory_order_acquire)) {
+        return 0;
+    }
+
+    HANDLE file = CreateFileA(m_manifestPath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        PRINT("Pipelines: No manifest at %s, nothing to precompile\n", m_manifestPath.c_str());
+        return 0;
+    }
+
+    ManifestHeader header = {};
+    DWORD read = 0;
+    std::vector<PipelineDesc> descs;
+    if (ReadFile(file, &header, sizeof(header), &read, NULL) && read == sizeof(header) &&
+        header.magic == MANIFEST_MAGIC && header.version == MANIFEST_VERSION &&
+        header.descSize == sizeof(PipelineDesc) && header.count < 65536) {
+        descs.resize(header.count);
+        DWORD bytes = header.count * sizeof(PipelineDesc);
+        if (!ReadFile(file, descs.data(), bytes, &read, NULL) || read != bytes) {
+            descs.clear();
+        }
+    }
+    CloseHandle(file);
+
+    if (descs.empty()) {
+        PRINT_WARNING("Pipelines: Ignoring invalid manifest %s\n", m_manifestPath.c_str());
+        return 0;
+    }
+
+    for (const PipelineDesc& desc : descs) {
+        bool added = false;
+        Entry* entry = FindOrAdd(desc, &added);
+        if (added) {
+            m_precompileList.push_back(entry);
+        }
+    }
+    if (m_precompileList.empty()) {
+        return 0;
+    }
+
+    // Each job thread compiles through its own cache so they do not serialize on the driver's cache
+    // lock; seeding them with the persistent cache keeps the disk hits
+    size_t size = 0;
+    std::vector<uint8_t> seed;
+    VkPipelineCache main_cache = m_vk->pipelineCache.cache;
+    if (vkGetPipelineCacheData(m_vk->device, main_cache, &size, NULL) == VK_SUCCESS && size) {
+        seed.resize(size);
+        if (vkGetPipelineCacheData(m_vk->device, main_cache, &size, seed.data()) != VK_SUCCESS) {
+            size = 0;
+        }
+    }
+    m_threadCaches.resize(m_jobs->GetThreadCount(), VK_NULL_HANDLE);
+    for (VkPipelineCache& cache : m_threadCaches) {
+        VkPipelineCacheCreateInfo cache_info = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .initialDataSize = size,
+            .pInitialData = size ? seed.data() : NULL
+        };
+        vkCreatePipelineCache(m_vk->device, &cache_info, NULL, &cache);
+    }
+
+    m_precompileJob = [this](uint32_t begin, uint32_t end) {
+        VkPipelineCache cache = m_threadCaches[JobSystem::GetThreadIndex()];
+        for (uint32_t i = begin; i < end; i++) {
+            // Get may have taken it already
+            Entry* entry = m_precompileList[i];
+            uint32_t expected = ENTRY_QUEUED;
+            if (entry->state.compare_exchange_strong(expected, ENTRY_COMPILING, std::memory_order_acq_rel)) {
+                Compile(entry, cache);
+            }
+        }
+    };
+
+    // Published once the counter holds the jobs, so Update cannot find it drained before they start
+    m_precompileStart = Ticks();
+    m_jobs->ParallelForAsync(static_cast<uint32_t>(m_precompileList.size()), 1, m_precompileJob, &m_precompileCounter);
+    m_precompiling.store(true, std::memory_order_release);
+
+    PRINT_INFO("Pipelines: Precompiling %zu permutations on %u threads\n", m_precompileList.size(),
+               m_jobs->GetThreadCount());
+    return static_cast<uint32_t>(m_precompileList.size());
+}
+
+void PipelineManager::WaitPrecompile()
+{
+    if (m_precompiling.load(std::memory_order_acquire)) {
+        m_jobs->Wait(&m_precompileCounter);
+        FinishPrecompile();
+    }
+}
+
+void PipelineManager::Update()
+{
+    if (m_precompiling.load(std::memory_order_acquire) && m_precompileCounter.IsDone()) {
+        FinishPrecompile();
+    }
+}
+
+void PipelineManager::FinishPrecompile()
+{
+    // Update and WaitPrecompile may both get here; the second one waits for the first to finish
+    std::lock_guard<std::mutex> finish_lock(m_finishMutex);
+    if (!m_precompiling.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    double ms = TicksToMs(Ticks() - m_precompileStart);
+    uint32_t failed = 0;
+    for (const Entry* entry : m_precompileList) {
+        failed += entry->state.load(std::memory_order_acquire) == ENTRY_FAILED ? 1 : 0;
+    }
+    PRINT_INFO("Pipelines: Precompiled %zu permutations in %.1f ms (%u failed)\n", m_precompileList.size(), ms, failed);
+
+    {
+        std::lock_guard<std::mutex> cache_lock(m_cacheMutex);
+        VulkanPipelineCacheMerge(&m_vk->pipelineCache, m_threadCaches.data(),
+                                 static_cast<uint32_t>(m_threadCaches.size()));
+    }
+    m_threadCaches.clear();
+    m_precompileList.clear();
+    m_precompiling.store(false, std::memory_order_release);
+}
+
+bool PipelineManager::SaveManifest()
+{
+    // Cleared up front: a permutation Get adds while the file is written marks it dirty again
+    if (!m_manifestDirty.exchange(false)) {
+        return true;
+    }
+
+    std::vector<PipelineDesc> descs;
+    {
+        std::lock_guard<std::mutex> lock(m_entryMutex);
+        descs.reserve(m_entries.size());
+        for (const auto& [hash, entry] : m_entries) {
+            if (entry->state.load(std::memory_order_acquire) == ENTRY_READY) {
+                descs.push_back(entry->desc);
+            }
+        }
+    }
+
+    ManifestHeader header = { MANIFEST_MAGIC, MANIFEST_VERSION, sizeof(PipelineDesc), static_cast<uint32_t>(descs.size()) };
+
+    // Same write-then-rename as the pipeline cache
+    std::string temp_path = m_manifestPath + ".tmp";
+    HANDLE file = CreateFileA(temp_path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        PRINT_ERROR("Pipelines: Failed to create %s\n", temp_path.c_str());
+        m_manifestDirty.store(true);
+        return false;
+    }
+
+    DWORD bytes = static_cast<DWORD>(descs.size() * sizeof(PipelineDesc));
+    DWORD written_header = 0, written_descs = 0;
+    bool ok = WriteFile(file, &header, sizeof(header), &written_header, NULL) && written_header == sizeof(header) &&
+              WriteFile(file, descs.data(), bytes, &written_descs, NULL) && written_descs == bytes;
+    CloseHandle(file);
+
+    if (!ok || !MoveFileExA(temp_path.c_str(), m_manifestPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        PRINT_ERROR("Pipelines: Failed to write manifest %s\n", m_manifestPath.c_str());
+        DeleteFileA(temp_path.c_str());
+        m_manifestDirty.store(true);
+        return false;
+    }
+
+    PRINT("Pipelines: Saved %zu permutations to %s\n", descs.size(), m_manifestPath.c_str());
+    return true;
+}
+
+} // namespace ZX
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "jobs.h"
+
+struct Vulkan;
+
+namespace ZX {
+
+enum class BlendMode : uint32_t {
+    Opaque,
+    Alpha,          // src * a + dst * (1 - a)
+    Additive        // src * a + dst
+};
+
+struct VertexAttribute {
+    uint32_t location;
+    VkFormat format;
+    uint32_t offset;
+};
+
+// Everything a graphics pipeline permutation depends on: shader set, vertex layout and render state.
+// Plain data without padding; compared and hashed bytewise and written to the manifest as is.
+struct PipelineDesc {
+    static constexpr uint32_t MAX_ATTRIBUTES = 8;
+    static constexpr uint32_t MAX_SHADER_PATH = 64;
+
+    // Shader set, SPIR-V files
+    char vertexShader[MAX_SHADER_PATH];
+    char fragmentShader[MAX_SHADER_PATH];
+
+    // Vertex layout, one interleaved binding (stride 0 for no vertex input)
+    uint32_t        vertexStride;
+    uint32_t        attributeCount;
+    VertexAttribute attributes[MAX_ATTRIBUTES];
+
+    // Render state
+    VkPrimitiveTopology   topology;
+    VkPolygonMode         polygonMode;
+    VkCullModeFlags       cullMode;
+    VkFrontFace           frontFace;
+    uint32_t              depthTest;
+    uint32_t              depthWrite;
+    VkCompareOp           depthCompare;
+    BlendMode             blend;
+    VkFormat              colorFormat;
+    VkFormat              depthFormat;      // VK_FORMAT_UNDEFINED for no depth attachment
+    VkSampleCountFlagBits samples;
+
+    // Zeroed (so unused bytes hash the same) with opaque, depth-tested, back-face culled triangles
+    PipelineDesc();
+
+    uint64_t Hash() const;
+    bool operator==(const PipelineDesc& other) const;
+};
+
+// Creates graphics pipelines on demand and remembers every permutation used in a session in a
+// manifest file. On the next start PrecompileAsync compiles the whole manifest on the job system,
+// each job thread through a pipeline cache of its own seeded from the persistent one, so the
+// permutations are ready (and in the disk cache) before the first frame asks for them.
+//
+// Get and Update belong to the rendering thread; PrecompileAsync, WaitPrecompile and destruction
+// to the thread that created the job system. Whichever of Update and WaitPrecompile sees the jobs done
+// first folds their caches in, the other one finds nothing left to do.
+class PipelineManager {
+public:
+    // layout == VK_NULL_HANDLE creates a layout with just a push constant range
+    static std::unique_ptr<PipelineManager> Create(Vulkan* vk, JobSystem* jobs, const char* manifestPath,
+                                                   VkPipelineLayout layout = VK_NULL_HANDLE);
+
+    PipelineManager(Vulkan* vk, JobSystem* jobs, const char* manifestPath, VkPipelineLayout layout);
+    ~PipelineManager();
+
+    PipelineManager(const PipelineManager&) = delete;
+    PipelineManager& operator=(const PipelineManager&) = delete;
+
+    // Loads the manifest and queues every permutation in it; returns the number queued
+    uint32_t PrecompileAsync();
+    // Blocks until precompilation is done, running compile jobs on the calling thread meanwhile
+    void WaitPrecompile();
+    bool IsPrecompiling() const { return m_precompiling.load(std::memory_order_acquire); }
+
+    // Folds the job threads' caches into the persistent cache once precompilation has finished.
+    // Call once per frame.
+    void Update();
+
+    // Returns the pipeline for desc. Compiles it on the calling thread if it is not in the manifest or
+    // still waiting in the job queue; waits for it if a job thread is compiling it right now.
+    VkPipeline Get(const PipelineDesc& desc);
+
+    VkPipelineLayout GetLayout() const { return m_layout; }
+
+    // Writes the manifest if new permutations were used
+    bool SaveManifest();
+
+private:
+    // Default push constant budget, the minimum every implementation guarantees
+    static constexpr uint32_t PUSH_CONSTANT_SIZE = 128;
+
+    enum EntryState : uint32_t {
+        ENTRY_QUEUED,
+        ENTRY_COMPILING,
+        ENTRY_READY,
+        ENTRY_FAILED
+    };
+
+    struct Entry {
+        PipelineDesc          desc;
+        std::atomic<uint32_t> state{ENTRY_QUEUED};
+        VkPipeline            pipeline = VK_NULL_HANDLE;
+    };
+
+    Entry* FindOrAdd(const PipelineDesc& desc, bool* added);
+    void Compile(Entry* entry, VkPipelineCache cache);
+    VkShaderModule GetShader(const char* path);
+    VkRenderPass GetRenderPass(VkFormat colorFormat, VkFormat depthFormat, VkSampleCountFlagBits samples);
+    void FinishPrecompile();
+
+    Vulkan*          m_vk;
+    JobSystem*       m_jobs;
+    std::string      m_manifestPath;
+    VkPipelineLayout m_layout;
+    bool             m_ownsLayout;
+
+    std::mutex                                        m_entryMutex;
+    std::unordered_map<uint64_t, std::unique_ptr<Entry>> m_entries;
+    std::atomic<bool>                                 m_manifestDirty;
+
+    // vkMergePipelineCaches needs the persistent cache to itself, while inline compiles on the rendering
+    // thread go through it
+    std::mutex                                        m_cacheMutex;
+
+    std::mutex                                      m_shaderMutex;
+    std::unordered_map<std::string, VkShaderModule> m_shaders;
+
+    // Pipelines only need a render pass compatible with the one they are used in: same formats and samples
+    std::mutex                               m_renderPassMutex;
+    std::unordered_map<uint64_t, VkRenderPass> m_renderPasses;
+
+    // Precompilation
+    std::vector<Entry*>                         m_precompileList;
+    std::vector<VkPipelineCache>                m_threadCaches;     // Indexed by JobSystem::GetThreadIndex()
+    std::function<void(uint32_t, uint32_t)>     m_precompileJob;
+    JobCounter                                  m_precompileCounter;
+    std::atomic<bool>                           m_precompiling;
+    std::mutex                                  m_finishMutex;      // Held while the caches are folded in
+    int64_t                                     m_precompileStart;
+};
+
+} // namespace ZX
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ZX {
+
+// 32-bit reference into a Pool: 20 bits of slot index and 12 bits of generation. The generation
+// of a live object is always odd, so a zero handle is never valid.
+template <typename T>
+struct Handle {
+    static constexpr uint32_t INDEX_BITS = 20;
+    static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static constexpr uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+    uint32_t value = 0;
+
+    static Handle Make(uint32_t index, uint32_t generation)
+    {
+        return Handle{ index | ((generation & GENERATION_MASK) << INDEX_BITS) };
+    }
+
+    uint32_t Index() const { return value & INDEX_MASK; }
+    uint32_t Generation() const { return value >> INDEX_BITS; }
+    bool IsNull() const { return value == 0; }
+
+    bool operator==(const Handle& other) const { return value == other.value; }
+    bool operator!=(const Handle& other) const { return value != other.value; }
+};
+
+// Typed object pool. Objects live in cache-line aligned slabs of SLAB_SIZE and never move, so a
+// pointer from Get() stays valid until that object is destroyed. Freed slots go on a LIFO free
+// list and are reused before new slabs are allocated. Not thread-safe.
+template <typename T, uint32_t SLAB_SIZE = 256>
+class Pool {
+public:
+    using HandleType = Handle<T>;
+
+    static constexpr uint32_t MAX_OBJECTS = HandleType::INDEX_MASK + 1;
+
+    Pool() = default;
+    ~Pool() { Clear(); ReleaseSlabs(); }
+
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+    template <typename... Args>
+    HandleType Create(Args&&... args)
+    {
+        uint32_t index;
+        if (m_freeHead != INVALID_INDEX) {
+            index = m_freeHead;
+            m_freeHead = m_nextFree[index];
+        } else {
+            if (m_generations.size() >= MAX_OBJECTS) {
+                return HandleType{};
+            }
+            index = static_cast<uint32_t>(m_generations.size());
+            if (index % SLAB_SIZE == 0) {
+                m_slabs.push_back(static_cast<T*>(::operator new(SLAB_SIZE * sizeof(T), std::align_val_t(SLAB_ALIGN))));
+            }
+            m_generations.push_back(0);
+            m_nextFree.push_back(INVALID_INDEX);
+        }
+
+        new (Slot(index)) T(std::forward<Args>(args)...);
+        uint32_t generation = ++m_generations[index];
+        m_count++;
+        return HandleType::Make(index, generation);
+    }
+
+    void Destroy(HandleType handle)
+    {
+        if (!IsValid(handle)) {
+            return;
+        }
+
+        uint32_t index = handle.Index();
+        Slot(index)->~T();
+        uint32_t generation = ++m_generations[index];
+        m_count--;
+
+        // Retire the slot instead of letting its 12-bit generation wrap, which would let a
+        // stale handle alias a new object
+        if ((generation & HandleType::GENERATION_MASK) != 0) {
+            m_nextFree[index] = m_freeHead;
+            m_freeHead = index;
+        }
+    }
+
+    bool IsValid(HandleType handle) const
+    {
+        uint32_t index = handle.Index();
+        if (index >= m_generations.size()) {
+            return false;
+        }
+        uint32_t generation = m_generations[index];
+        return (generation & 1) && (generation & HandleType::GENERATION_MASK) == handle.Generation();
+    }
+
+    // Returns null for null, destroyed or stale handles
+    T* Get(HandleType handle) { return IsValid(handle) ? Slot(handle.Index()) : nullptr; }
+    const T* Get(HandleType handle) const { return IsValid(handle) ? Slot(handle.Index()) : nullptr; }
+
+    // Recovers the handle of a live object from its address (linear in the number of slabs)
+    HandleType HandleOf(const T* object) const
+    {
+        for (size_t s = 0; s < m_slabs.size(); s++) {
+            if (object >= m_slabs[s] && object < m_slabs[s] + SLAB_SIZE) {
+                uint32_t index = static_cast<uint32_t>(s * SLAB_SIZE + (object - m_slabs[s]));
+                if (index < m_generations.size() && (m_generations[index] & 1)) {
+                    return HandleType::Make(index, m_generations[index]);
+                }
+                break;
+            }
+        }
+        return HandleType{};
+    }
+
+    // Calls fn(handle, object) for every live object in slot order
+    template <typename F>
+    void ForEach(F&& fn)
+    {
+        uint32_t slot_count = static_cast<uint32_t>(m_generations.size());
+        for (uint32_t i = 0; i < slot_count; i++) {
+            if (m_generations[i] & 1) {
+                fn(HandleType::Make(i, m_generations[i]), *Slot(i));
+            }
+        }
+    }
+
+    // Destroys every live object; slabs are kept for reuse
+    void Clear()
+    {
+        uint32_t slot_count = static_cast<uint32_t>(m_generations.size());
+        m_freeHead = INVALID_INDEX;
+        for (uint32_t i = slot_count; i-- > 0;) {
+            if (m_generations[i] & 1) {
+                Slot(i)->~T();
+                m_generations[i]++;
+            }
+            if ((m_generations[i] & HandleType::GENERATION_MASK) != 0) {
+                m_nextFree[i] = m_freeHead;
+                m_freeHead = i;
+            }
+        }
+        m_count = 0;
+    }
+
+    uint32_t GetCount() const { return m_count; }
+    uint32_t GetCapacity() const { return static_cast<uint32_t>(m_slabs.size()) * SLAB_SIZE; }
+
+private:
+    static constexpr uint32_t INVALID_INDEX = ~0u;
+    static constexpr size_t SLAB_ALIGN = alignof(T) > 64 ? alignof(T) : 64;
+
+    T* Slot(uint32_t index) { return m_slabs[index / SLAB_SIZE] + index % SLAB_SIZE; }
+    const T* Slot(uint32_t index) const { return m_slabs[index / SLAB_SIZE] + index % SLAB_SIZE; }
+
+    void ReleaseSlabs()
+    {
+        for (T* slab : m_slabs) {
+            ::operator delete(slab, std::align_val_t(SLAB_ALIGN));
+        }
+        m_slabs.clear();
+        m_generations.clear();
+        m_nextFree.clear();
+        m_freeHead = INVALID_INDEX;
+    }
+
+    std::vector<T*>       m_slabs;
+    std::vector<uint32_t> m_generations;    // Odd while the slot holds a live object
+    std::vector<uint32_t> m_nextFree;
+    uint32_t              m_freeHead = INVALID_INDEX;
+    uint32_t              m_count = 0;
+};
+
+} // namespace ZX
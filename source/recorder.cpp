@@ -0,0 +1,177 @@
+#include "recorder.h"
+#include "vulkan.h"
+
+namespace ZX {
+
+std::unique_ptr<CommandRecorder> CommandRecorder::Create(Vulkan* vk, JobSystem* jobs, uint32_t minBatch)
+{
+    auto recorder = std::make_unique<CommandRecorder>(vk, jobs, minBatch);
+
+    VkCommandPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = vk->graphicsQueueFamily
+    };
+
+    for (FrameSlot& frame : recorder->m_frames) {
+        for (uint32_t i = 0; i < recorder->m_threadCount; i++) {
+            if (vkCreateCommandPool(vk->device, &pool_info, NULL, &frame.threads[i].pool) != VK_SUCCESS) {
+                PRINT_ERROR("Recorder: Failed to create command pool\n");
+                return nullptr;
+            }
+        }
+    }
+
+    return recorder;
+}
+
+CommandRecorder::CommandRecorder(Vulkan* vk, JobSystem* jobs, uint32_t minBatch)
+    : m_vk(vk)
+    , m_jobs(jobs)
+    , m_minBatch(minBatch > 0 ? minBatch : 1)
+    , m_threadCount(jobs ? jobs->GetThreadCount() : 1)
+    , m_frames(vk->framesInFlight)
+    , m_current(nullptr)
+    , m_inheritance(nullptr)
+    , m_record(nullptr)
+    , m_recordedDraws(0)
+    , m_recordedBuffers(0)
+{
+    for (FrameSlot& frame : m_frames) {
+        frame.threads = std::make_unique<ThreadPool[]>(m_threadCount);
+    }
+}
+
+CommandRecorder::~CommandRecorder()
+{
+    // Destroying a pool frees its command buffers
+    for (FrameSlot& frame : m_frames) {
+        for (uint32_t i = 0; i < m_threadCount; i++) {
+            if (frame.threads[i].pool) {
+                vkDestroyCommandPool(m_vk->device, frame.threads[i].pool, NULL);
+            }
+        }
+    }
+}
+
+void CommandRecorder::BeginFrame()
+{
+    uint64_t frame_number = m_vk->frameNumber;
+    m_current = &m_frames[frame_number % m_frames.size()];
+    if (m_current->frameNumber == frame_number) {
+        return;
+    }
+
+    // The slot's last frame has executed: VulkanBeginFrame waited on its fence. Resetting without
+    // VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT keeps the buffers and their memory for this frame.
+    for (uint32_t i = 0; i < m_threadCount; i++) {
+        ThreadPool& pool = m_current->threads[i];
+        if (pool.used > 0) {
+            vkResetCommandPool(m_vk->device, pool.pool, 0);
+            pool.used = 0;
+        }
+    }
+    m_current->frameNumber = frame_number;
+}
+
+VkCommandBuffer CommandRecorder::RecordChunk(uint32_t begin, uint32_t end)
+{
+    ThreadPool& pool = m_current->threads[JobSystem::GetThreadIndex()];
+
+    if (pool.used == pool.buffers.size()) {
+        size_t first = pool.buffers.size();
+        pool.buffers.resize(first + ALLOCATE_BATCH);
+
+        VkCommandBufferAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pool.pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = ALLOCATE_BATCH
+        };
+        if (vkAllocateCommandBuffers(m_vk->device, &alloc_info, &pool.buffers[first]) != VK_SUCCESS) {
+            PRINT_ERROR("Recorder: Failed to allocate secondary command buffers\n");
+            pool.buffers.resize(first);
+            return VK_NULL_HANDLE;
+        }
+    }
+
+    VkCommandBuffer cmd = pool.buffers[pool.used++];
+
+    VkCommandBufferInheritanceInfo no_render_pass = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO
+    };
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = m_inheritance ? m_inheritance : &no_render_pass
+    };
+    if (m_inheritance) {
+        begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    }
+
+    if (vkBeginCommandBuffer(cmd, &begin_info) != VK_SUCCESS) {
+        PRINT_ERROR("Recorder: Failed to begin secondary command buffer\n");
+        return VK_NULL_HANDLE;
+    }
+    (*m_record)(cmd, begin, end);
+    if (vkEndCommandBuffer(cmd) != VK_SUCCESS) {
+        PRINT_ERROR("Recorder: Failed to record draws %u-%u\n", begin, end);
+        return VK_NULL_HANDLE;
+    }
+    return cmd;
+}
+
+uint32_t CommandRecorder::Record(VkCommandBuffer cmd, const VkCommandBufferInheritanceInfo* inheritance,
+                                 uint32_t count, const RecordFunction& fn)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    BeginFrame();
+    m_inheritance = inheritance;
+    m_record = &fn;
+
+    // A couple of chunks per thread, none smaller than minBatch. A thread that could not attach to the
+    // job system records everything itself.
+    bool parallel = m_jobs && m_threadCount > 1 && count > m_minBatch && m_jobs->AttachThread();
+    uint32_t chunks = parallel ? m_threadCount * CHUNKS_PER_THREAD : 1;
+    uint32_t batch = (count + chunks - 1) / chunks;
+    batch = batch > m_minBatch ? batch : m_minBatch;
+    chunks = (count + batch - 1) / batch;
+
+    m_chunks.assign(chunks, VK_NULL_HANDLE);
+    auto record_chunks = [this, batch, count](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t first = i * batch;
+            uint32_t last = first + batch < count ? first + batch : count;
+            m_chunks[i] = RecordChunk(first, last);
+        }
+    };
+
+    // Chunks land at fixed indices, so the draw order does not depend on which thread took which
+    if (chunks > 1) {
+        m_jobs->ParallelFor(chunks, 1, record_chunks);
+    } else {
+        record_chunks(0, 1);
+    }
+
+    // Drop the chunks that failed to record rather than execute them
+    uint32_t recorded = 0;
+    for (uint32_t i = 0; i < chunks; i++) {
+        if (m_chunks[i]) {
+            m_chunks[recorded++] = m_chunks[i];
+        }
+    }
+    if (recorded > 0) {
+        vkCmdExecuteCommands(cmd, recorded, m_chunks.data());
+    }
+
+    m_inheritance = nullptr;
+    m_record = nullptr;
+    m_recordedDraws += count;
+    m_recordedBuffers += recorded;
+    return recorded;
+}
+
+} // namespace ZX
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "jobs.h"
+
+struct Vulkan;
+
+namespace ZX {
+
+// Records a draw list into secondary command buffers on the job threads and stitches them into the
+// frame's primary command buffer with vkCmdExecuteCommands, in draw list order. Every job thread owns one
+// command pool per frame in flight, so recording takes no locks; a slot's pools are reset wholesale by the
+// first Record of the frame that reuses it, after VulkanBeginFrame has waited on the slot's fence.
+//
+// Owned by the rendering thread, which attaches itself to the job system on the first Record; create the
+// job system with an external slot for it when rendering runs on its own thread.
+class CommandRecorder {
+public:
+    // Records draws [begin, end) into cmd. Runs on any job thread: it must not wait on jobs, as the job
+    // could resume on another thread while cmd still belongs to this one's pool.
+    using RecordFunction = std::function<void(VkCommandBuffer cmd, uint32_t begin, uint32_t end)>;
+
+    // minBatch is the fewest draws worth a secondary command buffer; smaller lists are recorded in one
+    static std::unique_ptr<CommandRecorder> Create(Vulkan* vk, JobSystem* jobs, uint32_t minBatch = 256);
+
+    CommandRecorder(Vulkan* vk, JobSystem* jobs, uint32_t minBatch);
+    ~CommandRecorder();     // The frames using the recorded buffers must have completed
+
+    CommandRecorder(const CommandRecorder&) = delete;
+    CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+    // Records [0, count) across the job threads and executes the result in cmd; returns the number of
+    // secondary command buffers. With inheritance the secondaries continue its render pass (chain
+    // VkCommandBufferInheritanceRenderingInfo for dynamic rendering), which cmd must have begun with
+    // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS; NULL records outside a render pass.
+    uint32_t Record(VkCommandBuffer cmd, const VkCommandBufferInheritanceInfo* inheritance, uint32_t count,
+                    const RecordFunction& fn);
+
+    uint64_t GetRecordedDraws() const { return m_recordedDraws; }
+    uint64_t GetRecordedBuffers() const { return m_recordedBuffers; }
+
+private:
+    // Secondaries per thread the draws are split into; more than one lets stealing even out slow chunks
+    static constexpr uint32_t CHUNKS_PER_THREAD = 2;
+    static constexpr uint32_t ALLOCATE_BATCH = 16;
+
+    // One thread's pool for one frame in flight, on its own cache line
+    struct alignas(64) ThreadPool {
+        VkCommandPool                pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> buffers;     // Allocated so far, kept across resets
+        uint32_t                     used = 0;    // Begun this frame
+    };
+
+    struct FrameSlot {
+        std::unique_ptr<ThreadPool[]> threads;    // Indexed by JobSystem::GetThreadIndex()
+        uint64_t                      frameNumber = UINT64_MAX;
+    };
+
+    void BeginFrame();
+    VkCommandBuffer RecordChunk(uint32_t begin, uint32_t end);
+
+    Vulkan*    m_vk;
+    JobSystem* m_jobs;
+    uint32_t   m_minBatch;
+    uint32_t   m_threadCount;
+
+    std::vector<FrameSlot>       m_frames;
+    FrameSlot*                   m_current;
+    std::vector<VkCommandBuffer> m_chunks;        // Secondaries of the Record in progress, in order
+
+    // Set for the duration of Record
+    const VkCommandBufferInheritanceInfo* m_inheritance;
+    const RecordFunction*                 m_record;
+
+    uint64_t m_recordedDraws;
+    uint64_t m_recordedBuffers;
+};
+
+} // namespace ZX
@@ -0,0 +1,788 @@
+#include "render_graph.h"
+#include "debug.h"
+
+#include <string.h>
+
+// ACCESS TABLE ///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct RenderGraphAccessInfo {
+    VkPipelineStageFlags2KHR stage;
+    VkAccessFlags2KHR        access;
+    VkImageLayout            layout;
+    VkImageUsageFlags        usage;
+    bool                     write;
+} RenderGraphAccessInfo;
+
+// Every stage and access bit used here has the same value in the legacy flags, so the table also serves the
+// vkCmdPipelineBarrier fallback
+static const RenderGraphAccessInfo access_table[RENDER_GRAPH_ACCESS_COUNT] = {
+    // RENDER_GRAPH_COLOR_ATTACHMENT
+    { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+      VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true },
+    // RENDER_GRAPH_DEPTH_ATTACHMENT
+    { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+      VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true },
+    // RENDER_GRAPH_DEPTH_READ
+    { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+      VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, false },
+    // RENDER_GRAPH_SAMPLED_FRAGMENT
+    { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false },
+    // RENDER_GRAPH_SAMPLED_COMPUTE
+    { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false },
+    // RENDER_GRAPH_STORAGE_READ
+    { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR,
+      VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false },
+    // RENDER_GRAPH_STORAGE_WRITE
+    { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+      VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true },
+    // RENDER_GRAPH_TRANSFER_SRC
+    { VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR,
+      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false },
+    // RENDER_GRAPH_TRANSFER_DST
+    { VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true },
+    // RENDER_GRAPH_INDIRECT_READ
+    { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR,
+      VK_IMAGE_LAYOUT_UNDEFINED, 0, false },
+    // RENDER_GRAPH_VERTEX_READ
+    { VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT_KHR, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR | VK_ACCESS_2_INDEX_READ_BIT_KHR,
+      VK_IMAGE_LAYOUT_UNDEFINED, 0, false },
+};
+
+static const VkAccessFlags2KHR write_access_mask =
+    VK_ACCESS_2_SHADER_WRITE_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR |
+    VK_ACCESS_2_HOST_WRITE_BIT_KHR | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+
+static VkImageAspectFlags FormatAspect(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+// BUILDING ///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraphInit(RenderGraph* graph, Vulkan* vk)
+{
+    memset(graph, 0, sizeof(*graph));
+    graph->vk = vk;
+}
+
+static uint32_t AddResource(RenderGraph* graph, const char* name)
+{
+    if (graph->resourceCount >= RENDER_GRAPH_MAX_RESOURCES) {
+        PRINT_ERROR("RenderGraph: Too many resources, %s not added\n", name);
+        return RENDER_GRAPH_INVALID;
+    }
+    graph->compiled = false;
+
+    uint32_t index = graph->resourceCount++;
+    RenderGraphResource* res = &graph->resources[index];
+    memset(res, 0, sizeof(*res));
+    res->name = name;
+    res->aliasSlot = RENDER_GRAPH_INVALID;
+    return index;
+}
+
+uint32_t RenderGraphCreateImage(RenderGraph* graph, const char* name, VkFormat format, uint32_t width, uint32_t height)
+{
+    uint32_t index = AddResource(graph, name);
+    if (index != RENDER_GRAPH_INVALID) {
+        RenderGraphResource* res = &graph->resources[index];
+        res->format = format;
+        res->width = width;
+        res->height = height;
+        res->aspect = FormatAspect(format);
+    }
+    return index;
+}
+
+uint32_t RenderGraphImportImage(RenderGraph* graph, const char* name, VkImage image, VkImageView view, VkFormat format,
+                                uint32_t width, uint32_t height, VkImageLayout initial_layout,
+                                VkPipelineStageFlags2KHR initial_stage, VkAccessFlags2KHR initial_access,
+                                VkImageLayout final_layout)
+{
+    uint32_t index = AddResource(graph, name);
+    if (index != RENDER_GRAPH_INVALID) {
+        RenderGraphResource* res = &graph->resources[index];
+        res->imported = true;
+        res->format = format;
+        res->width = width;
+        res->height = height;
+        res->aspect = FormatAspect(format);
+        res->image = image;
+        res->view = view;
+        res->initial.layout = initial_layout;
+        res->initial.writeStage = initial_stage;
+        res->initial.writeAccess = initial_access & write_access_mask;
+        res->finalLayout = final_layout;
+    }
+    return index;
+}
+
+uint32_t RenderGraphImportBuffer(RenderGraph* graph, const char* name, VkBuffer buffer,
+                                 VkPipelineStageFlags2KHR initial_stage, VkAccessFlags2KHR initial_access)
+{
+    uint32_t index = AddResource(graph, name);
+    if (index != RENDER_GRAPH_INVALID) {
+        RenderGraphResource* res = &graph->resources[index];
+        res->imported = true;
+        res->buffer = true;
+        res->bufferHandle = buffer;
+        res->initial.writeStage = initial_stage;
+        res->initial.writeAccess = initial_access & write_access_mask;
+    }
+    return index;
+}
+
+void RenderGraphSetImportedImage(RenderGraph* graph, uint32_t resource, VkImage image, VkImageView view)
+{
+    RenderGraphResource* res = &graph->resources[resource];
+    if (!res->imported || res->buffer) {
+        PRINT_ERROR("RenderGraph: %s is not an imported image\n", res->name);
+        return;
+    }
+    res->image = image;
+    res->view = view;
+}
+
+uint32_t RenderGraphAddPass(RenderGraph* graph, const char* name, RenderGraphExecuteFn execute, void* user_data)
+{
+    if (graph->passCount >= RENDER_GRAPH_MAX_PASSES) {
+        PRINT_ERROR("RenderGraph: Too many passes, %s not added\n", name);
+        return RENDER_GRAPH_INVALID;
+    }
+    graph->compiled = false;
+
+    uint32_t index = graph->passCount++;
+    RenderGraphPass* pass = &graph->passes[index];
+    memset(pass, 0, sizeof(*pass));
+    pass->name = name;
+    pass->execute = execute;
+    pass->userData = user_data;
+    return index;
+}
+
+void RenderGraphUseResource(RenderGraph* graph, uint32_t pass, uint32_t resource, RenderGraphAccess access)
+{
+    if (pass >= graph->passCount || resource >= graph->resourceCount) {
+        return;
+    }
+    RenderGraphPass* p = &graph->passes[pass];
+    RenderGraphResource* res = &graph->resources[resource];
+    if (p->useCount >= RENDER_GRAPH_MAX_PASS_ACCESSES) {
+        PRINT_ERROR("RenderGraph: Too many resources used by %s\n", p->name);
+        return;
+    }
+    if (res->buffer != (access_table[access].usage == 0)) {
+        PRINT_ERROR("RenderGraph: %s used by %s with an access of the wrong resource type\n", res->name, p->name);
+        return;
+    }
+    graph->compiled = false;
+
+    p->uses[p->useCount].resource = resource;
+    p->uses[p->useCount].access = access;
+    p->useCount++;
+
+    if (!res->imported) {
+        res->usage |= access_table[access].usage;
+    }
+}
+
+void RenderGraphSetSideEffects(RenderGraph* graph, uint32_t pass)
+{
+    if (pass < graph->passCount) {
+        graph->passes[pass].sideEffects = true;
+    }
+}
+
+// TRANSIENT MEMORY ///////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void ReleaseRetiredTransients(RenderGraph* graph, bool all)
+{
+    Vulkan* vk = graph->vk;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < graph->retiredCount; i++) {
+        RenderGraphRetired* retired = &graph->retired[i];
+        if (!all && vk->frameNumber < retired->retireFrame) {
+            graph->retired[kept++] = *retired;
+            continue;
+        }
+        if (retired->view) {
+            vkDestroyImageView(vk->device, retired->view, NULL);
+        }
+        if (retired->image) {
+            vkDestroyImage(vk->device, retired->image, NULL);
+        }
+        if (retired->allocation.memory) {
+            VulkanMemoryFree(&vk->memory, &retired->allocation);
+        }
+    }
+    graph->retiredCount = kept;
+}
+
+static void RetireTransient(RenderGraph* graph, VkImage image, VkImageView view, const VulkanAllocation* allocation)
+{
+    Vulkan* vk = graph->vk;
+    if (graph->retiredCount == RENDER_GRAPH_MAX_RETIRED) {
+        // Resets faster than frames retire; nothing to do but wait for the GPU
+        vkDeviceWaitIdle(vk->device);
+        ReleaseRetiredTransients(graph, true);
+    }
+
+    RenderGraphRetired* retired = &graph->retired[graph->retiredCount++];
+    memset(retired, 0, sizeof(*retired));
+    retired->image = image;
+    retired->view = view;
+    if (allocation) {
+        retired->allocation = *allocation;
+    }
+    retired->retireFrame = vk->frameNumber + vk->framesInFlight;
+}
+
+// Hands every compiled transient to the retire list; the frame currently being recorded may still use them
+static void RetireTransients(RenderGraph* graph)
+{
+    for (uint32_t i = 0; i < graph->resourceCount; i++) {
+        RenderGraphResource* res = &graph->resources[i];
+        if (res->imported || !res->image) {
+            continue;
+        }
+        RetireTransient(graph, res->image, res->view, res->ownAllocation.memory ? &res->ownAllocation : NULL);
+        res->image = VK_NULL_HANDLE;
+        res->view = VK_NULL_HANDLE;
+        memset(&res->ownAllocation, 0, sizeof(res->ownAllocation));
+    }
+    if (graph->transientMemory.memory) {
+        RetireTransient(graph, VK_NULL_HANDLE, VK_NULL_HANDLE, &graph->transientMemory);
+        memset(&graph->transientMemory, 0, sizeof(graph->transientMemory));
+    }
+    graph->compiled = false;
+}
+
+typedef struct RenderGraphSlot {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+    uint32_t     memoryTypeBits;
+} RenderGraphSlot;
+
+static bool Overlaps(const RenderGraphResource* a, const RenderGraphResource* b)
+{
+    return a->firstPass <= b->lastPass && b->firstPass <= a->lastPass;
+}
+
+// Greedy first fit, largest images first: an image joins the first slot whose occupants' lifetimes it does
+// not overlap, otherwise opens a new slot. Slots are laid out back to back in one allocation.
+static bool AllocateTransients(RenderGraph* graph)
+{
+    Vulkan* vk = graph->vk;
+
+    uint32_t order[RENDER_GRAPH_MAX_RESOURCES];
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < graph->resourceCount; i++) {
+        RenderGraphResource* res = &graph->resources[i];
+        if (res->imported || res->buffer || !res->needed) {
+            continue;
+        }
+
+        VkImageCreateInfo image_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = res->format,
+            .extent = { res->width, res->height, 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = res->usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        if (vkCreateImage(vk->device, &image_info, NULL, &res->image) != VK_SUCCESS) {
+            PRINT_ERROR("RenderGraph: Failed to create transient image %s\n", res->name);
+            return false;
+        }
+        vkGetImageMemoryRequirements(vk->device, res->image, &res->requirements);
+
+        // Insertion sort by size, descending
+        uint32_t j = count++;
+        while (j > 0 && graph->resources[order[j - 1]].requirements.size < res->requirements.size) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    RenderGraphSlot slots[RENDER_GRAPH_MAX_RESOURCES];
+    uint32_t slot_count = 0;
+    uint32_t memory_type_bits = 0xFFFFFFFFu;
+    VkDeviceSize alignment = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        RenderGraphResource* res = &graph->resources[order[i]];
+        graph->unaliasedSize += res->requirements.size;
+        memory_type_bits &= res->requirements.memoryTypeBits;
+        alignment = MAX(alignment, res->requirements.alignment);
+
+        uint32_t slot = slot_count;
+        for (uint32_t s = 0; s < slot_count && slot == slot_count; s++) {
+            bool fits = true;
+            for (uint32_t k = 0; k < i && fits; k++) {
+                const RenderGraphResource* other = &graph->resources[order[k]];
+                fits = other->aliasSlot != s || !Overlaps(res, other);
+            }
+            if (fits) {
+                slot = s;
+            }
+        }
+        if (slot == slot_count) {
+            memset(&slots[slot_count++], 0, sizeof(RenderGraphSlot));
+        }
+
+        res->aliasSlot = slot;
+        slots[slot].size = MAX(slots[slot].size, res->requirements.size);
+        slots[slot].alignment = MAX(slots[slot].alignment, res->requirements.alignment);
+    }
+
+    VkDeviceSize total = 0;
+    for (uint32_t s = 0; s < slot_count; s++) {
+        total = (total + slots[s].alignment - 1) & ~(slots[s].alignment - 1);
+        slots[s].offset = total;
+        total += slots[s].size;
+    }
+
+    VkMemoryRequirements requirements = {
+        .size = total,
+        .alignment = alignment,
+        .memoryTypeBits = memory_type_bits
+    };
+    bool aliased = false;
+    if (memory_type_bits == 0) {
+        PRINT_WARNING("RenderGraph: Transient images share no memory type, allocating them separately\n");
+    } else {
+        aliased = VulkanMemoryAlloc(&vk->memory, &requirements, VULKAN_MEMORY_GPU_ONLY, VULKAN_MEMORY_KIND_OPTIMAL,
+                                    false, NULL, &graph->transientMemory);
+        if (!aliased) {
+            PRINT_ERROR("RenderGraph: Failed to allocate %llu bytes for aliased transient images, allocating "
+                        "them separately\n", (unsigned long long)total);
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        RenderGraphResource* res = &graph->resources[order[i]];
+        VkDeviceMemory memory;
+        VkDeviceSize offset;
+        if (aliased) {
+            res->memoryOffset = slots[res->aliasSlot].offset;
+            memory = graph->transientMemory.memory;
+            offset = graph->transientMemory.offset + res->memoryOffset;
+        } else {
+            res->aliasSlot = RENDER_GRAPH_INVALID;
+            if (!VulkanMemoryAlloc(&vk->memory, &res->requirements, VULKAN_MEMORY_GPU_ONLY, VULKAN_MEMORY_KIND_OPTIMAL,
+                                   false, NULL, &res->ownAllocation)) {
+                PRINT_ERROR("RenderGraph: Failed to allocate memory for %s\n", res->name);
+                return false;
+            }
+            memory = res->ownAllocation.memory;
+            offset = res->ownAllocation.offset;
+        }
+        vkBindImageMemory(vk->device, res->image, memory, offset);
+
+        VkImageViewCreateInfo view_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = res->image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = res->format,
+            .subresourceRange = { res->aspect, 0, 1, 0, 1 }
+        };
+        if (vkCreateImageView(vk->device, &view_info, NULL, &res->view) != VK_SUCCESS) {
+            PRINT_ERROR("RenderGraph: Failed to create view for %s\n", res->name);
+            return false;
+        }
+    }
+    graph->transientSize = aliased ? total : graph->unaliasedSize;
+    return true;
+}
+
+// COMPILATION ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Walks the passes backwards: a pass survives if it has side effects or writes something a surviving pass
+// reads, or an imported resource that outlives the graph
+static void CullPasses(RenderGraph* graph)
+{
+    for (uint32_t i = 0; i < graph->resourceCount; i++) {
+        graph->resources[i].needed = graph->resources[i].imported;
+    }
+
+    graph->culledPasses = 0;
+    for (uint32_t p = graph->passCount; p-- > 0;) {
+        RenderGraphPass* pass = &graph->passes[p];
+        bool live = pass->sideEffects;
+        for (uint32_t u = 0; u < pass->useCount && !live; u++) {
+            const RenderGraphUse* use = &pass->uses[u];
+            live = access_table[use->access].write && graph->resources[use->resource].needed;
+        }
+
+        pass->culled = !live;
+        if (!live) {
+            graph->culledPasses++;
+            continue;
+        }
+        for (uint32_t u = 0; u < pass->useCount; u++) {
+            graph->resources[pass->uses[u].resource].needed = true;
+        }
+    }
+
+    // Lifetimes over the surviving passes
+    for (uint32_t i = 0; i < graph->resourceCount; i++) {
+        graph->resources[i].needed = false;
+        graph->resources[i].firstPass = RENDER_GRAPH_INVALID;
+        graph->resources[i].lastPass = 0;
+    }
+    for (uint32_t p = 0; p < graph->passCount; p++) {
+        const RenderGraphPass* pass = &graph->passes[p];
+        if (pass->culled) {
+            continue;
+        }
+        for (uint32_t u = 0; u < pass->useCount; u++) {
+            RenderGraphResource* res = &graph->resources[pass->uses[u].resource];
+            res->needed = true;
+            res->firstPass = MIN(res->firstPass, p);
+            res->lastPass = MAX(res->lastPass, p);
+        }
+    }
+}
+
+static void AddBarrier(RenderGraph* graph, uint32_t resource, VkPipelineStageFlags2KHR src_stage, VkAccessFlags2KHR src_access,
+                       VkPipelineStageFlags2KHR dst_stage, VkAccessFlags2KHR dst_access,
+                       VkImageLayout old_layout, VkImageLayout new_layout)
+{
+    RenderGraphBarrier* barrier = &graph->barriers[graph->barrierCount++];
+    barrier->resource = resource;
+    barrier->srcStage = src_stage;
+    barrier->srcAccess = src_access;
+    barrier->dstStage = dst_stage;
+    barrier->dstAccess = dst_access;
+    barrier->oldLayout = old_layout;
+    barrier->newLayout = new_layout;
+}
+
+// Brings one resource from its tracked state to what a pass needs, adding a barrier only for a layout
+// change, a write after anything, or a read the last write has not been made visible to yet
+static void TransitionResource(RenderGraph* graph, uint32_t resource, RenderGraphState* state,
+                               const RenderGraphAccessInfo* info, bool first_use)
+{
+    const RenderGraphResource* res = &graph->resources[resource];
+    bool layout_change = !res->buffer && state->layout != info->layout;
+
+    if (first_use && !res->imported) {
+        // The memory may have held another transient, in this frame or in the previous one still executing
+        AddBarrier(graph, resource, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, VK_ACCESS_2_MEMORY_WRITE_BIT_KHR,
+                   info->stage, info->access, VK_IMAGE_LAYOUT_UNDEFINED, info->layout);
+        if (!info->write) {
+            PRINT_WARNING("RenderGraph: %s is read before anything writes it\n", res->name);
+        }
+    } else if (layout_change || info->write) {
+        VkPipelineStageFlags2KHR src_stage = state->writeStage | state->readStages;
+        if (layout_change || src_stage) {
+            AddBarrier(graph, resource, src_stage, state->writeAccess, info->stage, info->access,
+                       layout_change ? state->layout : info->layout, info->layout);
+        } else {
+            graph->elidedBarriers++;
+        }
+    } else if (state->writeStage &&
+               ((info->stage & ~state->visibleStages) || (info->access & ~state->visibleAccess))) {
+        AddBarrier(graph, resource, state->writeStage, state->writeAccess, info->stage, info->access,
+                   info->layout, info->layout);
+        state->visibleStages |= info->stage;
+        state->visibleAccess |= info->access;
+        state->readStages |= info->stage;
+        return;
+    } else {
+        graph->elidedBarriers++;
+        state->readStages |= info->stage;
+        return;
+    }
+
+    // A write or a layout transition happened; later accesses order themselves against this pass
+    state->layout = info->layout;
+    state->writeStage = info->stage;
+    state->writeAccess = info->access & write_access_mask;
+    state->readStages = info->write ? 0 : info->stage;
+    state->visibleStages = info->write ? 0 : info->stage;
+    state->visibleAccess = info->write ? 0 : info->access;
+}
+
+bool RenderGraphCompile(RenderGraph* graph)
+{
+    ReleaseRetiredTransients(graph, false);
+    RetireTransients(graph);
+    graph->barrierCount = 0;
+    graph->elidedBarriers = 0;
+    graph->transientSize = 0;
+    graph->unaliasedSize = 0;
+
+    CullPasses(graph);
+    if (!AllocateTransients(graph)) {
+        RetireTransients(graph);
+        return false;
+    }
+
+    RenderGraphState states[RENDER_GRAPH_MAX_RESOURCES];
+    for (uint32_t i = 0; i < graph->resourceCount; i++) {
+        states[i] = graph->resources[i].initial;
+    }
+
+    for (uint32_t p = 0; p < graph->passCount; p++) {
+        RenderGraphPass* pass = &graph->passes[p];
+        pass->barrierFirst = graph->barrierCount;
+        pass->barrierCount = 0;
+        if (pass->culled) {
+            continue;
+        }
+
+        // Several uses of one resource in a pass are merged; differing layouts fall back to GENERAL
+        for (uint32_t u = 0; u < pass->useCount; u++) {
+            uint32_t resource = pass->uses[u].resource;
+            bool seen = false;
+            for (uint32_t k = 0; k < u && !seen; k++) {
+                seen = pass->uses[k].resource == resource;
+            }
+            if (seen) {
+                continue;
+            }
+
+            RenderGraphAccessInfo info = access_table[pass->uses[u].access];
+            for (uint32_t k = u + 1; k < pass->useCount; k++) {
+                if (pass->uses[k].resource != resource) {
+                    continue;
+                }
+                const RenderGraphAccessInfo* other = &access_table[pass->uses[k].access];
+                info.stage |= other->stage;
+                info.access |= other->access;
+                info.write |= other->write;
+                if (info.layout != other->layout) {
+                    info.layout = VK_IMAGE_LAYOUT_GENERAL;
+                }
+            }
+            TransitionResource(graph, resource, &states[resource], &info,
+                               !graph->resources[resource].imported && graph->resources[resource].firstPass == p);
+        }
+        pass->barrierCount = graph->barrierCount - pass->barrierFirst;
+    }
+
+    // Imported images go back to the layout their owner expects
+    graph->finalBarrierFirst = graph->barrierCount;
+    for (uint32_t i = 0; i < graph->resourceCount; i++) {
+        const RenderGraphResource* res = &graph->resources[i];
+        const RenderGraphState* state = &states[i];
+        if (!res->imported || res->buffer || res->finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+            res->finalLayout == state->layout) {
+            continue;
+        }
+        AddBarrier(graph, i, state->writeStage | state->readStages, state->writeAccess,
+                   VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, VK_ACCESS_2_MEMORY_READ_BIT_KHR | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR,
+                   state->layout, res->finalLayout);
+    }
+    graph->finalBarrierCount = graph->barrierCount - graph->finalBarrierFirst;
+
+    graph->compiled = true;
+    PRINT_DEBUG("RenderGraph: %u passes (%u culled), %u barriers (%u elided), transients %llu KB (%llu KB unaliased)\n",
+                graph->passCount, graph->culledPasses, graph->barrierCount, graph->elidedBarriers,
+                (unsigned long long)(graph->transientSize / 1024), (unsigned long long)(graph->unaliasedSize / 1024));
+    return true;
+}
+
+// EXECUTION //////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void IssueBarriers(RenderGraph* graph, VkCommandBuffer cmd, uint32_t first, uint32_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    Vulkan* vk = graph->vk;
+
+    uint32_t image_count = 0;
+    uint32_t buffer_count = 0;
+    for (uint32_t i = first; i < first + count; i++) {
+        if (graph->resources[graph->barriers[i].resource].buffer) {
+            buffer_count++;
+        } else {
+            image_count++;
+        }
+    }
+
+    if (vk->synchronization2) {
+        VkImageMemoryBarrier2KHR image_barriers[image_count + 1];
+        VkBufferMemoryBarrier2KHR buffer_barriers[buffer_count + 1];
+        image_count = 0;
+        buffer_count = 0;
+        for (uint32_t i = first; i < first + count; i++) {
+            const RenderGraphBarrier* b = &graph->barriers[i];
+            const RenderGraphResource* res = &graph->resources[b->resource];
+            if (res->buffer) {
+                VkBufferMemoryBarrier2KHR barrier = {
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
+                    .srcStageMask = b->srcStage,
+                    .srcAccessMask = b->srcAccess,
+                    .dstStageMask = b->dstStage,
+                    .dstAccessMask = b->dstAccess,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .buffer = res->bufferHandle,
+                    .offset = 0,
+                    .size = VK_WHOLE_SIZE
+                };
+                buffer_barriers[buffer_count++] = barrier;
+            } else {
+                VkImageMemoryBarrier2KHR barrier = {
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR,
+                    .srcStageMask = b->srcStage,
+                    .srcAccessMask = b->srcAccess,
+                    .dstStageMask = b->dstStage,
+                    .dstAccessMask = b->dstAccess,
+                    .oldLayout = b->oldLayout,
+                    .newLayout = b->newLayout,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .image = res->image,
+                    .subresourceRange = { res->aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS }
+                };
+                image_barriers[image_count++] = barrier;
+            }
+        }
+
+        VkDependencyInfoKHR dependency = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+            .bufferMemoryBarrierCount = buffer_count,
+            .pBufferMemoryBarriers = buffer_barriers,
+            .imageMemoryBarrierCount = image_count,
+            .pImageMemoryBarriers = image_barriers
+        };
+        vk->cmdPipelineBarrier2(cmd, &dependency);
+        return;
+    }
+
+    // Legacy path: one call with the union of the stages. All bits in use fit the 32-bit flags.
+    VkImageMemoryBarrier image_barriers[image_count + 1];
+    VkBufferMemoryBarrier buffer_barriers[buffer_count + 1];
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    image_count = 0;
+    buffer_count = 0;
+    for (uint32_t i = first; i < first + count; i++) {
+        const RenderGraphBarrier* b = &graph->barriers[i];
+        const RenderGraphResource* res = &graph->resources[b->resource];
+        src_stages |= (VkPipelineStageFlags)b->srcStage;
+        dst_stages |= (VkPipelineStageFlags)b->dstStage;
+        if (res->buffer) {
+            VkBufferMemoryBarrier barrier = {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .srcAccessMask = (VkAccessFlags)b->srcAccess,
+                .dstAccessMask = (VkAccessFlags)b->dstAccess,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = res->bufferHandle,
+                .offset = 0,
+                .size = VK_WHOLE_SIZE
+            };
+            buffer_barriers[buffer_count++] = barrier;
+        } else {
+            VkImageMemoryBarrier barrier = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask = (VkAccessFlags)b->srcAccess,
+                .dstAccessMask = (VkAccessFlags)b->dstAccess,
+                .oldLayout = b->oldLayout,
+                .newLayout = b->newLayout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = res->image,
+                .subresourceRange = { res->aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS }
+            };
+            image_barriers[image_count++] = barrier;
+        }
+    }
+    vkCmdPipelineBarrier(cmd, src_stages ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         dst_stages ? dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, NULL, buffer_count, buffer_barriers, image_count, image_barriers);
+}
+
+void RenderGraphExecute(RenderGraph* graph, VkCommandBuffer cmd)
+{
+    ReleaseRetiredTransients(graph, false);
+    if (!graph->compiled && !RenderGraphCompile(graph)) {
+        return;
+    }
+
+    for (uint32_t p = 0; p < graph->passCount; p++) {
+        RenderGraphPass* pass = &graph->passes[p];
+        if (pass->culled) {
+            continue;
+        }
+        // Timed with its barriers, so waits a pass causes show up against it
+        VulkanProfilerBeginScope(&graph->vk->profiler, cmd, pass->name);
+        IssueBarriers(graph, cmd, pass->barrierFirst, pass->barrierCount);
+        if (pass->execute) {
+            pass->execute(cmd, graph, pass->userData);
+        }
+        VulkanProfilerEndScope(&graph->vk->profiler, cmd);
+    }
+    IssueBarriers(graph, cmd, graph->finalBarrierFirst, graph->finalBarrierCount);
+}
+
+// LIFETIME ///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraphReset(RenderGraph* graph)
+{
+    RetireTransients(graph);
+    graph->passCount = 0;
+    graph->resourceCount = 0;
+    graph->barrierCount = 0;
+    graph->finalBarrierFirst = 0;
+    graph->finalBarrierCount = 0;
+}
+
+void RenderGraphDestroy(RenderGraph* graph)
+{
+    if (!graph->vk) {
+        return;
+    }
+    RetireTransients(graph);
+    ReleaseRetiredTransients(graph, true);
+    memset(graph, 0, sizeof(*graph));
+}
+
+VkImage RenderGraphGetImage(const RenderGraph* graph, uint32_t resource)
+{
+    return resource < graph->resourceCount ? graph->resources[resource].image : VK_NULL_HANDLE;
+}
+
+VkImageView RenderGraphGetView(const RenderGraph* graph, uint32_t resource)
+{
+    return resource < graph->resourceCount ? graph->resources[resource].view : VK_NULL_HANDLE;
+}
+
+VkBuffer RenderGraphGetBuffer(const RenderGraph* graph, uint32_t resource)
+{
+    return resource < graph->resourceCount ? graph->resources[resource].bufferHandle : VK_NULL_HANDLE;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "vulkan.h"
+
+#define RENDER_GRAPH_MAX_PASSES         64
+#define RENDER_GRAPH_MAX_RESOURCES      64
+#define RENDER_GRAPH_MAX_PASS_ACCESSES  8
+#define RENDER_GRAPH_MAX_BARRIERS       (RENDER_GRAPH_MAX_PASSES * RENDER_GRAPH_MAX_PASS_ACCESSES + RENDER_GRAPH_MAX_RESOURCES)
+
+// Transient memory released by Reset waits here until the frames that used it have retired
+#define RENDER_GRAPH_MAX_RETIRED        (RENDER_GRAPH_MAX_RESOURCES * 4)
+
+#define RENDER_GRAPH_INVALID            0xFFFFFFFFu
+
+// How a pass uses a resource; decides the pipeline stage, access mask, image layout and usage flags
+typedef enum RenderGraphAccess {
+    RENDER_GRAPH_COLOR_ATTACHMENT,      // Write (blending reads too)
+    RENDER_GRAPH_DEPTH_ATTACHMENT,      // Depth test and write
+    RENDER_GRAPH_DEPTH_READ,            // Depth test only
+    RENDER_GRAPH_SAMPLED_FRAGMENT,
+    RENDER_GRAPH_SAMPLED_COMPUTE,
+    RENDER_GRAPH_STORAGE_READ,          // Compute shader
+    RENDER_GRAPH_STORAGE_WRITE,         // Compute shader, read-write
+    RENDER_GRAPH_TRANSFER_SRC,
+    RENDER_GRAPH_TRANSFER_DST,
+    RENDER_GRAPH_INDIRECT_READ,         // Buffers: draw/dispatch arguments
+    RENDER_GRAPH_VERTEX_READ,           // Buffers: vertex and index data
+    RENDER_GRAPH_ACCESS_COUNT
+} RenderGraphAccess;
+
+typedef struct RenderGraph RenderGraph;
+
+// Records the pass's commands. Barriers for everything the pass declared have been issued already.
+typedef void (*RenderGraphExecuteFn)(VkCommandBuffer cmd, RenderGraph* graph, void* user_data);
+
+// Synchronization state of a resource between passes
+typedef struct RenderGraphState {
+    VkPipelineStageFlags2KHR writeStage;    // Last write (or layout transition)
+    VkAccessFlags2KHR        writeAccess;
+    VkPipelineStageFlags2KHR readStages;    // Readers since the last write
+    VkPipelineStageFlags2KHR visibleStages; // Stages the last write has been made visible to
+    VkAccessFlags2KHR        visibleAccess;
+    VkImageLayout            layout;
+} RenderGraphState;
+
+typedef struct RenderGraphResource {
+    const char*        name;
+    bool               imported;
+    bool               buffer;
+    VkFormat           format;
+    uint32_t           width;
+    uint32_t           height;
+    VkImageUsageFlags  usage;           // Transient images: union of the declared accesses
+    VkImageAspectFlags aspect;
+    VkImage            image;
+    VkImageView        view;
+    VkBuffer           bufferHandle;
+    RenderGraphState   initial;         // Imported: state on entry to the graph
+    VkImageLayout      finalLayout;     // Imported: layout to leave it in, UNDEFINED for wherever it ends up
+
+    // Compiled
+    bool                 needed;
+    uint32_t             firstPass;
+    uint32_t             lastPass;
+    VkMemoryRequirements requirements;
+    uint32_t             aliasSlot;     // Transients sharing a slot have disjoint lifetimes
+    VkDeviceSize         memoryOffset;
+    VulkanAllocation     ownAllocation; // Only when aliasing was impossible
+} RenderGraphResource;
+
+typedef struct RenderGraphUse {
+    uint32_t          resource;
+    RenderGraphAccess access;
+} RenderGraphUse;
+
+typedef struct RenderGraphBarrier {
+    uint32_t                 resource;
+    VkPipelineStageFlags2KHR srcStage;
+    VkAccessFlags2KHR        srcAccess;
+    VkPipelineStageFlags2KHR dstStage;
+    VkAccessFlags2KHR        dstAccess;
+    VkImageLayout            oldLayout;
+    VkImageLayout            newLayout;
+} RenderGraphBarrier;
+
+typedef struct RenderGraphRetired {
+    VkImage          image;
+    VkImageView      view;
+    VulkanAllocation allocation;    // memory == VK_NULL_HANDLE for none
+    uint64_t         retireFrame;   // Destroyed once vk->frameNumber reaches this
+} RenderGraphRetired;
+
+typedef struct RenderGraphPass {
+    const char*          name;
+    RenderGraphExecuteFn execute;
+    void*                userData;
+    RenderGraphUse       uses[RENDER_GRAPH_MAX_PASS_ACCESSES];
+    uint32_t             useCount;
+    bool                 sideEffects;   // Never culled (readbacks, queries...)
+
+    // Compiled
+    bool                 culled;
+    uint32_t             barrierFirst;  // Issued as one batch before the pass
+    uint32_t             barrierCount;
+} RenderGraphPass;
+
+// A frame's passes and the resources flowing between them. Passes run in declaration order; Compile
+// culls passes whose results nothing consumes, places transient images with disjoint lifetimes in the
+// same memory and works out the minimal barrier batch in front of each pass. Built and compiled once
+// (again after a resize), executed every frame with the imported images swapped in.
+struct RenderGraph {
+    Vulkan*             vk;
+    RenderGraphPass     passes[RENDER_GRAPH_MAX_PASSES];
+    uint32_t            passCount;
+    RenderGraphResource resources[RENDER_GRAPH_MAX_RESOURCES];
+    uint32_t            resourceCount;
+    RenderGraphBarrier  barriers[RENDER_GRAPH_MAX_BARRIERS];
+    uint32_t            barrierCount;
+    uint32_t            finalBarrierFirst;  // Issued after the last pass
+    uint32_t            finalBarrierCount;
+
+    VulkanAllocation    transientMemory;    // Backs every aliased transient image
+    VkDeviceSize        transientSize;      // Bytes used with aliasing
+    VkDeviceSize        unaliasedSize;      // Bytes the transients would take on their own
+    uint32_t            culledPasses;
+    uint32_t            elidedBarriers;     // Uses that needed no barrier
+    bool                compiled;
+
+    RenderGraphRetired  retired[RENDER_GRAPH_MAX_RETIRED];
+    uint32_t            retiredCount;
+};
+
+void RenderGraphInit(RenderGraph* graph, Vulkan* vk);
+// Forgets every pass and resource, ready to be built again. Transient images still used by frames in
+// flight are destroyed once those frames have retired.
+void RenderGraphReset(RenderGraph* graph);
+// The device must be idle
+void RenderGraphDestroy(RenderGraph* graph);
+
+// Images owned by the graph, alive only between their first and last use
+uint32_t RenderGraphCreateImage(RenderGraph* graph, const char* name, VkFormat format, uint32_t width, uint32_t height);
+// Images and buffers owned elsewhere. initial_stage / initial_access describe the last write before the graph.
+uint32_t RenderGraphImportImage(RenderGraph* graph, const char* name, VkImage image, VkImageView view, VkFormat format,
+                                uint32_t width, uint32_t height, VkImageLayout initial_layout,
+                                VkPipelineStageFlags2KHR initial_stage, VkAccessFlags2KHR initial_access,
+                                VkImageLayout final_layout);
+uint32_t RenderGraphImportBuffer(RenderGraph* graph, const char* name, VkBuffer buffer,
+                                 VkPipelineStageFlags2KHR initial_stage, VkAccessFlags2KHR initial_access);
+// Swap the handles of an imported image (e.g. this frame's swapchain image) without recompiling
+void RenderGraphSetImportedImage(RenderGraph* graph, uint32_t resource, VkImage image, VkImageView view);
+
+uint32_t RenderGraphAddPass(RenderGraph* graph, const char* name, RenderGraphExecuteFn execute, void* user_data);
+void RenderGraphUseResource(RenderGraph* graph, uint32_t pass, uint32_t resource, RenderGraphAccess access);
+void RenderGraphSetSideEffects(RenderGraph* graph, uint32_t pass);
+
+bool RenderGraphCompile(RenderGraph* graph);
+void RenderGraphExecute(RenderGraph* graph, VkCommandBuffer cmd);
+
+VkImage RenderGraphGetImage(const RenderGraph* graph, uint32_t resource);
+VkImageView RenderGraphGetView(const RenderGraph* graph, uint32_t resource);
+VkBuffer RenderGraphGetBuffer(const RenderGraph* graph, uint32_t resource);
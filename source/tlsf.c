@@ -0,0 +1,308 @@
+#include "tlsf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+    static inline uint32_t TlsfMsb64(uint64_t x) { unsigned long i; _BitScanReverse64(&i, x); return (uint32_t)i; }
+    static inline uint32_t TlsfLsb64(uint64_t x) { unsigned long i; _BitScanForward64(&i, x); return (uint32_t)i; }
+    static inline uint32_t TlsfLsb32(uint32_t x) { unsigned long i; _BitScanForward(&i, x); return (uint32_t)i; }
+    static inline uint32_t TlsfMsb32(uint32_t x) { unsigned long i; _BitScanReverse(&i, x); return (uint32_t)i; }
+#else
+    static inline uint32_t TlsfMsb64(uint64_t x) { return 63 - (uint32_t)__builtin_clzll(x); }
+    static inline uint32_t TlsfLsb64(uint64_t x) { return (uint32_t)__builtin_ctzll(x); }
+    static inline uint32_t TlsfLsb32(uint32_t x) { return (uint32_t)__builtin_ctz(x); }
+    static inline uint32_t TlsfMsb32(uint32_t x) { return 31 - (uint32_t)__builtin_clz(x); }
+#endif
+
+// SIZE CLASSES ///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// First level is the power of two, second level splits it linearly into TLSF_SL_COUNT classes
+static void TlsfMapping(uint64_t size, uint32_t* fl, uint32_t* sl)
+{
+    if (size < TLSF_SL_COUNT) {
+        *fl = 0;
+        *sl = (uint32_t)size;
+    } else {
+        uint32_t msb = TlsfMsb64(size);
+        *fl = msb - TLSF_SL_BITS + 1;
+        *sl = (uint32_t)(size >> (msb - TLSF_SL_BITS)) ^ TLSF_SL_COUNT;
+    }
+}
+
+// Rounds up to the next class boundary so every range in the found list is large enough
+static void TlsfMappingSearch(uint64_t size, uint32_t* fl, uint32_t* sl)
+{
+    if (size >= TLSF_SL_COUNT) {
+        size += (1ull << (TlsfMsb64(size) - TLSF_SL_BITS)) - 1;
+    }
+    TlsfMapping(size, fl, sl);
+}
+
+// NODES //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t TlsfNewNode(Tlsf* tlsf)
+{
+    if (tlsf->unusedNodes != TLSF_NULL) {
+        uint32_t node = tlsf->unusedNodes;
+        tlsf->unusedNodes = tlsf->nodes[node].nextFree;
+        return node;
+    }
+
+    if (tlsf->nodeCount == tlsf->nodeCapacity) {
+        uint32_t capacity = tlsf->nodeCapacity ? tlsf->nodeCapacity * 2 : 64;
+        TlsfNode* nodes = (TlsfNode*)realloc(tlsf->nodes, capacity * sizeof(TlsfNode));
+        if (!nodes) {
+            return TLSF_NULL;
+        }
+        tlsf->nodes = nodes;
+        tlsf->nodeCapacity = capacity;
+    }
+    return tlsf->nodeCount++;
+}
+
+static void TlsfReleaseNode(Tlsf* tlsf, uint32_t node)
+{
+    tlsf->nodes[node].nextFree = tlsf->unusedNodes;
+    tlsf->unusedNodes = node;
+}
+
+static void TlsfInsertFree(Tlsf* tlsf, uint32_t node)
+{
+    uint32_t fl, sl;
+    TlsfMapping(tlsf->nodes[node].size, &fl, &sl);
+
+    uint32_t head = tlsf->heads[fl][sl];
+    tlsf->nodes[node].used = false;
+    tlsf->nodes[node].prevFree = TLSF_NULL;
+    tlsf->nodes[node].nextFree = head;
+    if (head != TLSF_NULL) {
+        tlsf->nodes[head].prevFree = node;
+    }
+    tlsf->heads[fl][sl] = node;
+    tlsf->flBitmap |= 1ull << fl;
+    tlsf->slBitmap[fl] |= 1u << sl;
+}
+
+static void TlsfRemoveFree(Tlsf* tlsf, uint32_t node)
+{
+    TlsfNode* n = &tlsf->nodes[node];
+
+    if (n->prevFree != TLSF_NULL) {
+        tlsf->nodes[n->prevFree].nextFree = n->nextFree;
+    } else {
+        uint32_t fl, sl;
+        TlsfMapping(n->size, &fl, &sl);
+        tlsf->heads[fl][sl] = n->nextFree;
+        if (n->nextFree == TLSF_NULL) {
+            tlsf->slBitmap[fl] &= ~(1u << sl);
+            if (tlsf->slBitmap[fl] == 0) {
+                tlsf->flBitmap &= ~(1ull << fl);
+            }
+        }
+    }
+    if (n->nextFree != TLSF_NULL) {
+        tlsf->nodes[n->nextFree].prevFree = n->prevFree;
+    }
+}
+
+// Splits [offset, offset + size) off the front of node as a new node placed physically before it
+static uint32_t TlsfSplitFront(Tlsf* tlsf, uint32_t node, uint64_t size)
+{
+    uint32_t front = TlsfNewNode(tlsf);
+    if (front == TLSF_NULL) {
+        return TLSF_NULL;
+    }
+
+    TlsfNode* n = &tlsf->nodes[node];
+    TlsfNode* f = &tlsf->nodes[front];
+    f->offset = n->offset;
+    f->size = size;
+    f->prevPhysical = n->prevPhysical;
+    f->nextPhysical = node;
+    f->userData = NULL;
+    if (n->prevPhysical != TLSF_NULL) {
+        tlsf->nodes[n->prevPhysical].nextPhysical = front;
+    } else {
+        tlsf->firstPhysical = front;
+    }
+    n->prevPhysical = front;
+    n->offset += size;
+    n->size -= size;
+    return front;
+}
+
+// ALLOCATOR //////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TlsfInit(Tlsf* tlsf, uint64_t size)
+{
+    memset(tlsf, 0, sizeof(*tlsf));
+    memset(tlsf->heads, 0xFF, sizeof(tlsf->heads));
+    tlsf->unusedNodes = TLSF_NULL;
+    tlsf->size = size;
+
+    uint32_t node = TlsfNewNode(tlsf);
+    if (node == TLSF_NULL) {
+        return false;
+    }
+
+    TlsfNode* n = &tlsf->nodes[node];
+    n->offset = 0;
+    n->size = size;
+    n->prevPhysical = TLSF_NULL;
+    n->nextPhysical = TLSF_NULL;
+    n->userData = NULL;
+    tlsf->firstPhysical = node;
+    TlsfInsertFree(tlsf, node);
+    return true;
+}
+
+void TlsfDestroy(Tlsf* tlsf)
+{
+    free(tlsf->nodes);
+    memset(tlsf, 0, sizeof(*tlsf));
+}
+
+uint32_t TlsfAlloc(Tlsf* tlsf, uint64_t size, uint64_t align, void* user_data)
+{
+    if (size == 0) {
+        size = 1;
+    }
+
+    // Searching for size + align - 1 guarantees an aligned start inside whatever we find
+    uint64_t search = size + (align > 1 ? align - 1 : 0);
+    uint32_t fl, sl;
+    TlsfMappingSearch(search, &fl, &sl);
+    if (fl >= TLSF_FL_COUNT) {
+        return TLSF_NULL;
+    }
+
+    uint32_t sl_map = tlsf->slBitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        uint64_t fl_map = fl + 1 < TLSF_FL_COUNT ? tlsf->flBitmap & (~0ull << (fl + 1)) : 0;
+        if (fl_map == 0) {
+            return TLSF_NULL;
+        }
+        fl = TlsfLsb64(fl_map);
+        sl_map = tlsf->slBitmap[fl];
+    }
+    sl = TlsfLsb32(sl_map);
+
+    uint32_t node = tlsf->heads[fl][sl];
+    TlsfRemoveFree(tlsf, node);
+
+    // Give alignment padding in front back to the free lists
+    uint64_t offset = tlsf->nodes[node].offset;
+    uint64_t aligned = (offset + align - 1) & ~(align - 1);
+    if (aligned > offset) {
+        uint32_t front = TlsfSplitFront(tlsf, node, aligned - offset);
+        if (front == TLSF_NULL) {
+            TlsfInsertFree(tlsf, node);
+            return TLSF_NULL;
+        }
+        TlsfInsertFree(tlsf, front);
+    }
+
+    // Return the tail as well: split our size off the front and free what remains
+    if (tlsf->nodes[node].size > size) {
+        uint32_t front = TlsfSplitFront(tlsf, node, size);
+        if (front != TLSF_NULL) {
+            TlsfInsertFree(tlsf, node);
+            node = front;
+        }
+    }
+
+    TlsfNode* n = &tlsf->nodes[node];
+    n->used = true;
+    n->userData = user_data;
+    n->alignShift = align > 1 ? (uint8_t)TlsfMsb64(align) : 0;
+    tlsf->used += n->size;
+    tlsf->allocationCount++;
+    return node;
+}
+
+void TlsfFree(Tlsf* tlsf, uint32_t node)
+{
+    TlsfNode* n = &tlsf->nodes[node];
+    tlsf->used -= n->size;
+    tlsf->allocationCount--;
+    n->userData = NULL;
+
+    // Merge with free neighbours; the free ones are absorbed into this node
+    uint32_t prev = n->prevPhysical;
+    if (prev != TLSF_NULL && !tlsf->nodes[prev].used) {
+        TlsfRemoveFree(tlsf, prev);
+        n->offset = tlsf->nodes[prev].offset;
+        n->size += tlsf->nodes[prev].size;
+        n->prevPhysical = tlsf->nodes[prev].prevPhysical;
+        if (n->prevPhysical != TLSF_NULL) {
+            tlsf->nodes[n->prevPhysical].nextPhysical = node;
+        } else {
+            tlsf->firstPhysical = node;
+        }
+        TlsfReleaseNode(tlsf, prev);
+    }
+
+    uint32_t next = n->nextPhysical;
+    if (next != TLSF_NULL && !tlsf->nodes[next].used) {
+        TlsfRemoveFree(tlsf, next);
+        n->size += tlsf->nodes[next].size;
+        n->nextPhysical = tlsf->nodes[next].nextPhysical;
+        if (n->nextPhysical != TLSF_NULL) {
+            tlsf->nodes[n->nextPhysical].prevPhysical = node;
+        }
+        TlsfReleaseNode(tlsf, next);
+    }
+
+    TlsfInsertFree(tlsf, node);
+}
+
+uint64_t TlsfLargestFree(const Tlsf* tlsf)
+{
+    if (tlsf->flBitmap == 0) {
+        return 0;
+    }
+
+    uint32_t fl = TlsfMsb64(tlsf->flBitmap);
+    uint32_t sl_map = tlsf->slBitmap[fl];
+    uint32_t sl = TlsfMsb32(sl_map);
+
+    uint64_t largest = 0;
+    for (uint32_t node = tlsf->heads[fl][sl]; node != TLSF_NULL; node = tlsf->nodes[node].nextFree) {
+        if (tlsf->nodes[node].size > largest) {
+            largest = tlsf->nodes[node].size;
+        }
+    }
+    return largest;
+}
+
+uint32_t TlsfFreeRangeCount(const Tlsf* tlsf)
+{
+    uint32_t count = 0;
+    for (uint32_t fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        for (uint32_t sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            for (uint32_t node = tlsf->heads[fl][sl]; node != TLSF_NULL; node = tlsf->nodes[node].nextFree) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+uint32_t TlsfNextAllocation(const Tlsf* tlsf, uint32_t node)
+{
+    if (node == TLSF_NULL) {
+        node = tlsf->firstPhysical;
+        if (tlsf->nodes[node].used) {
+            return node;
+        }
+    }
+
+    for (node = tlsf->nodes[node].nextPhysical; node != TLSF_NULL; node = tlsf->nodes[node].nextPhysical) {
+        if (tlsf->nodes[node].used) {
+            return node;
+        }
+    }
+    return TLSF_NULL;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Two-level segregated fit allocator over an abstract range [0, size). It hands out offsets, not
+// pointers, so it can manage GPU memory, buffer ranges or anything else addressed by offset.
+// Allocation and free are O(1); adjacent free ranges are merged on free.
+
+#define TLSF_SL_BITS  4
+#define TLSF_SL_COUNT (1 << TLSF_SL_BITS)
+#define TLSF_FL_COUNT 64
+#define TLSF_NULL     0xFFFFFFFFu
+
+typedef struct TlsfNode {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t prevPhysical;      // Neighbouring ranges in address order
+    uint32_t nextPhysical;
+    uint32_t prevFree;          // Free-list links; nextFree also chains unused node records
+    uint32_t nextFree;
+    void*    userData;
+    bool     used;
+    uint8_t  alignShift;        // log2 of the alignment the allocation was made with
+} TlsfNode;
+
+typedef struct Tlsf {
+    TlsfNode* nodes;
+    uint32_t  nodeCount;
+    uint32_t  nodeCapacity;
+    uint32_t  unusedNodes;      // Recycled node records
+    uint32_t  firstPhysical;    // Node starting at offset 0
+
+    uint64_t  size;
+    uint64_t  used;
+    uint32_t  allocationCount;
+
+    uint64_t  flBitmap;
+    uint32_t  slBitmap[TLSF_FL_COUNT];
+    uint32_t  heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+} Tlsf;
+
+bool     TlsfInit(Tlsf* tlsf, uint64_t size);
+void     TlsfDestroy(Tlsf* tlsf);
+
+// Returns the node of the allocation, or TLSF_NULL when nothing fits. align must be a power of two.
+uint32_t TlsfAlloc(Tlsf* tlsf, uint64_t size, uint64_t align, void* user_data);
+void     TlsfFree(Tlsf* tlsf, uint32_t node);
+
+static inline uint64_t TlsfOffset(const Tlsf* tlsf, uint32_t node) { return tlsf->nodes[node].offset; }
+static inline uint64_t TlsfSize(const Tlsf* tlsf, uint32_t node) { return tlsf->nodes[node].size; }
+static inline uint64_t TlsfAlignment(const Tlsf* tlsf, uint32_t node) { return 1ull << tlsf->nodes[node].alignShift; }
+static inline void*    TlsfUserData(const Tlsf* tlsf, uint32_t node) { return tlsf->nodes[node].userData; }
+
+uint64_t TlsfLargestFree(const Tlsf* tlsf);
+uint32_t TlsfFreeRangeCount(const Tlsf* tlsf);
+
+// Walks allocations in address order: start with TLSF_NULL, stop when TLSF_NULL comes back
+uint32_t TlsfNextAllocation(const Tlsf* tlsf, uint32_t node);
@@ -1,4 +1,5 @@
 #include "vmath.h"
+#include "vsimd.h"
 
 // DEFINES ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -122,110 +123,180 @@ mat4 identity()
     };
 }
 
-mat4 m4_mul(const mat4 a, const mat4 b)
+// Row i of the product is the sum of b's rows weighted by row i of a
+VMATH_INLINE f4 m4_mul_row(f4 a_row, f4 b0, f4 b1, f4 b2, f4 b3)
 {
-    return (mat4) {
+    f4 r = f4_mul(f4_splat(a_row, 0), b0);
+    r = f4_madd(f4_splat(a_row, 1), b1, r);
+    r = f4_madd(f4_splat(a_row, 2), b2, r);
+    r = f4_madd(f4_splat(a_row, 3), b3, r);
+    return r;
+}
 
-        a.idx[0][0] * b.idx[0][0] + a.idx[0][1] * b.idx[1][0] + a.idx[0][2] * b.idx[2][0] + a.idx[0][3] * b.idx[3][0],
-        a.idx[0][0] * b.idx[0][1] + a.idx[0][1] * b.idx[1][1] + a.idx[0][2] * b.idx[2][1] + a.idx[0][3] * b.idx[3][1],
-        a.idx[0][0] * b.idx[0][2] + a.idx[0][1] * b.idx[1][2] + a.idx[0][2] * b.idx[2][2] + a.idx[0][3] * b.idx[3][2],
-        a.idx[0][0] * b.idx[0][3] + a.idx[0][1] * b.idx[1][3] + a.idx[0][2] * b.idx[2][3] + a.idx[0][3] * b.idx[3][3],
-
-        a.idx[1][0] * b.idx[0][0] + a.idx[1][1] * b.idx[1][0] + a.idx[1][2] * b.idx[2][0] + a.idx[1][3] * b.idx[3][0],
-        a.idx[1][0] * b.idx[0][1] + a.idx[1][1] * b.idx[1][1] + a.idx[1][2] * b.idx[2][1] + a.idx[1][3] * b.idx[3][1],
-        a.idx[1][0] * b.idx[0][2] + a.idx[1][1] * b.idx[1][2] + a.idx[1][2] * b.idx[2][2] + a.idx[1][3] * b.idx[3][2],
-        a.idx[1][0] * b.idx[0][3] + a.idx[1][1] * b.idx[1][3] + a.idx[1][2] * b.idx[2][3] + a.idx[1][3] * b.idx[3][3],
-
-        a.idx[2][0] * b.idx[0][0] + a.idx[2][1] * b.idx[1][0] + a.idx[2][2] * b.idx[2][0] + a.idx[2][3] * b.idx[3][0],
-        a.idx[2][0] * b.idx[0][1] + a.idx[2][1] * b.idx[1][1] + a.idx[2][2] * b.idx[2][1] + a.idx[2][3] * b.idx[3][1],
-        a.idx[2][0] * b.idx[0][2] + a.idx[2][1] * b.idx[1][2] + a.idx[2][2] * b.idx[2][2] + a.idx[2][3] * b.idx[3][2],
-        a.idx[2][0] * b.idx[0][3] + a.idx[2][1] * b.idx[1][3] + a.idx[2][2] * b.idx[2][3] + a.idx[2][3] * b.idx[3][3],
-
-        a.idx[3][0] * b.idx[0][0] + a.idx[3][1] * b.idx[1][0] + a.idx[3][2] * b.idx[2][0] + a.idx[3][3] * b.idx[3][0],
-        a.idx[3][0] * b.idx[0][1] + a.idx[3][1] * b.idx[1][1] + a.idx[3][2] * b.idx[2][1] + a.idx[3][3] * b.idx[3][1],
-        a.idx[3][0] * b.idx[0][2] + a.idx[3][1] * b.idx[1][2] + a.idx[3][2] * b.idx[2][2] + a.idx[3][3] * b.idx[3][2],
-        a.idx[3][0] * b.idx[0][3] + a.idx[3][1] * b.idx[1][3] + a.idx[3][2] * b.idx[2][3] + a.idx[3][3] * b.idx[3][3]
-    };
+// Column access for the builders that only touch a few columns of the product
+VMATH_INLINE void m4_load_columns(const mat4* in, f4* c0, f4* c1, f4* c2, f4* c3)
+{
+    f4 r0 = f4_load(in->idx[0]);
+    f4 r1 = f4_load(in->idx[1]);
+    f4 r2 = f4_load(in->idx[2]);
+    f4 r3 = f4_load(in->idx[3]);
+
+    f4_transpose(r0, r1, r2, r3);
+
+    *c0 = r0;
+    *c1 = r1;
+    *c2 = r2;
+    *c3 = r3;
 }
 
-mat4 m4_mulf(const mat4 in, float f)
+VMATH_INLINE mat4 m4_from_columns(f4 c0, f4 c1, f4 c2, f4 c3)
 {
-    return (mat4) {
+    mat4 out;
 
-        in.idx[0][0] * f, in.idx[0][1] * f, in.idx[0][2] * f, in.idx[0][3] * f,
-        in.idx[1][0] * f, in.idx[1][1] * f, in.idx[1][2] * f, in.idx[1][3] * f,
-        in.idx[2][0] * f, in.idx[2][1] * f, in.idx[2][2] * f, in.idx[2][3] * f,
-        in.idx[3][0] * f, in.idx[3][1] * f, in.idx[3][2] * f, in.idx[3][3] * f
-    };
+    f4_transpose(c0, c1, c2, c3);
+
+    f4_store(out.idx[0], c0);
+    f4_store(out.idx[1], c1);
+    f4_store(out.idx[2], c2);
+    f4_store(out.idx[3], c3);
+
+    return out;
 }
 
-mat4 transpose(const mat4 in)
+// Product with a matrix whose last row is (0, 0, 0, 1) and last column is zero (pure 3x3 linear part)
+static mat4 m4_mul_linear3(const mat4* in, f4 b0, f4 b1, f4 b2)
 {
-    return (mat4) {
+    mat4 out;
 
-        in.idx[0][0], in.idx[1][0], in.idx[2][0], in.idx[3][0],
-        in.idx[0][1], in.idx[1][1], in.idx[2][1], in.idx[3][1],
-        in.idx[0][2], in.idx[1][2], in.idx[2][2], in.idx[3][2],
-        in.idx[0][3], in.idx[1][3], in.idx[2][3], in.idx[3][3]
-    };
+    for (int i = 0; i < 4; i++) {
+        f4 a_row = f4_load(in->idx[i]);
+        f4 r = f4_mul(f4_splat(a_row, 0), b0);
+        r = f4_madd(f4_splat(a_row, 1), b1, r);
+        r = f4_madd(f4_splat(a_row, 2), b2, r);
+        f4_store(out.idx[i], r);
+        out.idx[i][3] = in->idx[i][3];
+    }
+
+    return out;
 }
 
-mat4 scale_uni(const mat4 in, float f)
+VMATH_INLINE void m4_mul_to(mat4* out, const mat4* a, const mat4* b)
+{
+#if defined(VMATH_SIMD_AVX2)
+    // Two result rows per iteration: lane-local permutes broadcast a[i][k] / a[i+1][k] into each 128-bit half
+    __m256 b0 = _mm256_broadcast_ps((const __m128*)b->idx[0]);
+    __m256 b1 = _mm256_broadcast_ps((const __m128*)b->idx[1]);
+    __m256 b2 = _mm256_broadcast_ps((const __m128*)b->idx[2]);
+    __m256 b3 = _mm256_broadcast_ps((const __m128*)b->idx[3]);
+
+    for (int i = 0; i < 4; i += 2) {
+        __m256 a_rows = _mm256_loadu_ps(a->idx[i]);
+        __m256 r = _mm256_mul_ps(_mm256_permute_ps(a_rows, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+    #if defined(__FMA__)
+        r = _mm256_fmadd_ps(_mm256_permute_ps(a_rows, _MM_SHUFFLE(1, 1, 1, 1)), b1, r);
+        r = _mm256_fmadd_ps(_mm256_permute_ps(a_rows, _MM_SHUFFLE(2, 2, 2, 2)), b2, r);
+        r = _mm256_fmadd_ps(_mm256_permute_ps(a_rows, _MM_SHUFFLE(3, 3, 3, 3)), b3, r);
+    #else
+        r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(a_rows, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+        r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(a_rows, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+        r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(a_rows, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+    #endif
+        _mm256_storeu_ps(out->idx[i], r);
+    }
+#else
+    f4 b0 = f4_load(b->idx[0]);
+    f4 b1 = f4_load(b->idx[1]);
+    f4 b2 = f4_load(b->idx[2]);
+    f4 b3 = f4_load(b->idx[3]);
+
+    f4_store(out->idx[0], m4_mul_row(f4_load(a->idx[0]), b0, b1, b2, b3));
+    f4_store(out->idx[1], m4_mul_row(f4_load(a->idx[1]), b0, b1, b2, b3));
+    f4_store(out->idx[2], m4_mul_row(f4_load(a->idx[2]), b0, b1, b2, b3));
+    f4_store(out->idx[3], m4_mul_row(f4_load(a->idx[3]), b0, b1, b2, b3));
+#endif
+}
+
+mat4 m4_mul(const mat4 a, const mat4 b)
+{
+    mat4 out;
+    m4_mul_to(&out, &a, &b);
+    return out;
+}
+
+mat4 m4_mulf(const mat4 in, float f)
 {
-    mat4 scaling = {0};
+    mat4 out;
+    f4 s = f4_set1(f);
 
-    scaling.idx[0][0] = f;
-    scaling.idx[1][1] = f;
-    scaling.idx[2][2] = f;
-    scaling.idx[3][3] = 1.0f;
+    f4_store(out.idx[0], f4_mul(f4_load(in.idx[0]), s));
+    f4_store(out.idx[1], f4_mul(f4_load(in.idx[1]), s));
+    f4_store(out.idx[2], f4_mul(f4_load(in.idx[2]), s));
+    f4_store(out.idx[3], f4_mul(f4_load(in.idx[3]), s));
 
-    return m4_mul(in, scaling);
+    return out;
 }
 
-mat4 scale(const mat4 in, float x, float y, float z)
+mat4 transpose(const mat4 in)
 {
-    mat4 scaling = {0};
+    mat4 out;
+
+    f4 r0 = f4_load(in.idx[0]);
+    f4 r1 = f4_load(in.idx[1]);
+    f4 r2 = f4_load(in.idx[2]);
+    f4 r3 = f4_load(in.idx[3]);
 
-    scaling.idx[0][0] = x;
-    scaling.idx[1][1] = y;
-    scaling.idx[2][2] = z;
-    scaling.idx[3][3] = 1.f;
+    f4_transpose(r0, r1, r2, r3);
 
-    return m4_mul(in, scaling);
+    f4_store(out.idx[0], r0);
+    f4_store(out.idx[1], r1);
+    f4_store(out.idx[2], r2);
+    f4_store(out.idx[3], r3);
+
+    return out;
 }
 
-mat4 scale_vec(const mat4 in, const vec3 v)
+// The builders below multiply by a known sparse matrix, so they scale or mix only the affected
+// columns instead of running the general m4_mul.
+
+mat4 scale(const mat4 in, float x, float y, float z)
 {
-    mat4 scaling = {0};
+    mat4 out;
+    f4 s = f4_set(x, y, z, 1.f);
 
-    scaling.idx[0][0] = v.x;
-    scaling.idx[1][1] = v.y;
-    scaling.idx[2][2] = v.z;
-    scaling.idx[3][3] = 1.f;
+    f4_store(out.idx[0], f4_mul(f4_load(in.idx[0]), s));
+    f4_store(out.idx[1], f4_mul(f4_load(in.idx[1]), s));
+    f4_store(out.idx[2], f4_mul(f4_load(in.idx[2]), s));
+    f4_store(out.idx[3], f4_mul(f4_load(in.idx[3]), s));
+
+    return out;
+}
+
+mat4 scale_uni(const mat4 in, float f)
+{
+    return scale(in, f, f, f);
+}
 
-    return m4_mul(in, scaling);
+mat4 scale_vec(const mat4 in, const vec3 v)
+{
+    return scale(in, v.x, v.y, v.z);
 }
 
 mat4 translate(const mat4 in, float x, float y, float z)
 {
-    mat4 trans = identity();
+    f4 c0, c1, c2, c3;
+    m4_load_columns(&in, &c0, &c1, &c2, &c3);
 
-    trans.idx[0][3] = x;
-    trans.idx[1][3] = y;
-    trans.idx[2][3] = z;
+    // Only the last column changes
+    c3 = f4_madd(c0, f4_set1(x), c3);
+    c3 = f4_madd(c1, f4_set1(y), c3);
+    c3 = f4_madd(c2, f4_set1(z), c3);
 
-    return m4_mul(in, trans);
+    return m4_from_columns(c0, c1, c2, c3);
 }
 
 mat4 translate_vec(const mat4 in, const vec3 v)
 {
-    mat4 trans = identity();
-
-    trans.idx[0][3] = v.x;
-    trans.idx[1][3] = v.y;
-    trans.idx[2][3] = v.z;
-
-    return m4_mul(in, trans);
+    return translate(in, v.x, v.y, v.z);
 }
 
 mat4 rotate(const mat4 in, const vec3 axis, float angle_rad)
@@ -236,71 +307,62 @@ mat4 rotate(const mat4 in, const vec3 axis, float angle_rad)
 
     vec3 n_axis = v3_normalize(axis);
 
-    mat4 rot = {0};
+    f4 r0 = f4_set(n_axis.x * n_axis.x * nc + c,
+                   n_axis.x * n_axis.y * nc - s * n_axis.z,
+                   n_axis.x * n_axis.z * nc + s * n_axis.y, 0.f);
+    f4 r1 = f4_set(n_axis.y * n_axis.x * nc + s * n_axis.z,
+                   n_axis.y * n_axis.y * nc + c,
+                   n_axis.y * n_axis.z * nc - s * n_axis.x, 0.f);
+    f4 r2 = f4_set(n_axis.z * n_axis.x * nc - s * n_axis.y,
+                   n_axis.z * n_axis.y * nc + s * n_axis.x,
+                   n_axis.z * n_axis.z * nc + c, 0.f);
 
-    rot.idx[0][0] = n_axis.x * n_axis.x * nc + c;
-    rot.idx[0][1] = n_axis.x * n_axis.y * nc - s * n_axis.z;
-    rot.idx[0][2] = n_axis.x * n_axis.z * nc + s * n_axis.y;
-    rot.idx[1][0] = n_axis.y * n_axis.x * nc + s * n_axis.z;
-    rot.idx[1][1] = n_axis.y * n_axis.y * nc + c;
-    rot.idx[1][2] = n_axis.y * n_axis.z * nc - s * n_axis.x;
-    rot.idx[2][0] = n_axis.z * n_axis.x * nc - s * n_axis.y;
-    rot.idx[2][1] = n_axis.z * n_axis.y * nc + s * n_axis.x;
-    rot.idx[2][2] = n_axis.z * n_axis.z * nc + c;
-    rot.idx[3][3] = 1.0f;
-
-    return m4_mul(in, rot);
+    return m4_mul_linear3(&in, r0, r1, r2);
 }
 
 mat4 rotateX(const mat4 in, float angle_rad)
 {
-    float s = sinf(angle_rad);
-    float c = cosf(angle_rad);
+    f4 vs = f4_set1(sinf(angle_rad));
+    f4 vc = f4_set1(cosf(angle_rad));
 
-    mat4 rot = {0};
+    f4 c0, c1, c2, c3;
+    m4_load_columns(&in, &c0, &c1, &c2, &c3);
 
-    rot.idx[0][0] = 1.0f;
-    rot.idx[1][1] = c;
-    rot.idx[1][2] = -s;
-    rot.idx[2][1] = s;
-    rot.idx[2][2] = c;
-    rot.idx[3][3] = 1.0f;
+    // Only columns 1 and 2 change
+    f4 n1 = f4_madd(c2, vs, f4_mul(c1, vc));
+    f4 n2 = f4_sub(f4_mul(c2, vc), f4_mul(c1, vs));
 
-    return m4_mul(in, rot);
+    return m4_from_columns(c0, n1, n2, c3);
 }
 
 mat4 rotateY(const mat4 in, float angle_rad)
 {
-    float s = sinf(angle_rad);
-    float c = cosf(angle_rad);
+    f4 vs = f4_set1(sinf(angle_rad));
+    f4 vc = f4_set1(cosf(angle_rad));
 
-    mat4 rot = {0};
+    f4 c0, c1, c2, c3;
+    m4_load_columns(&in, &c0, &c1, &c2, &c3);
 
-    rot.idx[0][0] = c;
-    rot.idx[0][2] = s;
-    rot.idx[1][1] = 1.0f;
-    rot.idx[2][0] = -s;
-    rot.idx[2][2] = c;
-    rot.idx[3][3] = 1.0f;
+    // Only columns 0 and 2 change
+    f4 n0 = f4_sub(f4_mul(c0, vc), f4_mul(c2, vs));
+    f4 n2 = f4_madd(c0, vs, f4_mul(c2, vc));
 
-    return m4_mul(in, rot);
+    return m4_from_columns(n0, c1, n2, c3);
 }
 
 mat4 rotateZ(const mat4 in, float angle_rad)
 {
-    float s = sinf(angle_rad);
-    float c = cosf(angle_rad);
+    f4 vs = f4_set1(sinf(angle_rad));
+    f4 vc = f4_set1(cosf(angle_rad));
 
-    mat4 rot = {0};
+    f4 c0, c1, c2, c3;
+    m4_load_columns(&in, &c0, &c1, &c2, &c3);
 
-    rot.idx[0][0] = c;
-    rot.idx[0][1] = -s;
-    rot.idx[1][0] = s;
-    rot.idx[1][1] = c;
-    rot.idx[2][2] = 1.0f;
-    rot.idx[3][3] = 1.0f;
+    // Only columns 0 and 1 change
+    f4 n0 = f4_madd(c1, vs, f4_mul(c0, vc));
+    f4 n1 = f4_sub(f4_mul(c1, vc), f4_mul(c0, vs));
 
-    return m4_mul(in, rot);
+    return m4_from_columns(n0, n1, c2, c3);
 }
 
 mat4 lookAt(const vec3 eye, const vec3 target, const vec3 up)
@@ -364,10 +426,391 @@ mat4 perspective(float fov, float aspect, float zNear, float zFar)
     return out;
 }
 
-mat4 m4_inverse()
+// 2x2 minors of two rows for the column pair (i, j), packed as (rows 2-3, rows 2-3, rows 0-1, rows 0-1)
+#define M4_PAIR_MINOR(u, v, i, j) f4_sub(f4_mul(u[i], v[j]), f4_mul(u[j], v[i]))
+
+// General inverse by cofactor expansion; returns a zero matrix if the input is singular
+mat4 m4_inverse(const mat4 in)
+{
+    f4 col[4];
+    m4_load_columns(&in, &col[0], &col[1], &col[2], &col[3]);
+
+    f4 u[4], v[4], q[4];
+    for (int i = 0; i < 4; i++) {
+        u[i] = f4_swizzle(col[i], 2, 2, 0, 0);
+        v[i] = f4_swizzle(col[i], 3, 3, 1, 1);
+        q[i] = f4_swizzle(col[i], 1, 0, 3, 2);
+    }
+
+    f4 k0 = M4_PAIR_MINOR(u, v, 0, 1);
+    f4 k1 = M4_PAIR_MINOR(u, v, 0, 2);
+    f4 k2 = M4_PAIR_MINOR(u, v, 0, 3);
+    f4 k3 = M4_PAIR_MINOR(u, v, 1, 2);
+    f4 k4 = M4_PAIR_MINOR(u, v, 1, 3);
+    f4 k5 = M4_PAIR_MINOR(u, v, 2, 3);
+
+    // Rows of the adjugate, before the alternating sign
+    f4 r0 = f4_madd(q[3], k3, f4_sub(f4_mul(q[1], k5), f4_mul(q[2], k4)));
+    f4 r1 = f4_madd(q[3], k1, f4_sub(f4_mul(q[0], k5), f4_mul(q[2], k2)));
+    f4 r2 = f4_madd(q[3], k0, f4_sub(f4_mul(q[0], k4), f4_mul(q[1], k2)));
+    f4 r3 = f4_madd(q[2], k0, f4_sub(f4_mul(q[0], k3), f4_mul(q[1], k1)));
+
+    f4 sign = f4_set(1.f, -1.f, 1.f, -1.f);
+    r0 = f4_mul(r0, sign);
+    r1 = f4_mul(r1, f4_sub(f4_zero(), sign));
+    r2 = f4_mul(r2, sign);
+    r3 = f4_mul(r3, f4_sub(f4_zero(), sign));
+
+    // Row 0 of in * adj(in) is (det, 0, 0, 0)
+    float det = f4_first(m4_mul_row(f4_load(in.idx[0]), r0, r1, r2, r3));
+    if (det == 0.f) {
+        mat4 zero = {0};
+        return zero;
+    }
+
+    mat4 out;
+    f4 inv_det = f4_set1(1.f / det);
+
+    f4_store(out.idx[0], f4_mul(r0, inv_det));
+    f4_store(out.idx[1], f4_mul(r1, inv_det));
+    f4_store(out.idx[2], f4_mul(r2, inv_det));
+    f4_store(out.idx[3], f4_mul(r3, inv_det));
+
+    return out;
+}
+
+#undef M4_PAIR_MINOR
+
+// a x b in the xyz lanes; w is zero
+VMATH_INLINE f4 f4_cross3(f4 a, f4 b)
 {
-    mat4 inverse = {0};
-    return inverse;
+    return f4_sub(f4_mul(f4_swizzle(a, 1, 2, 0, 3), f4_swizzle(b, 2, 0, 1, 3)),
+                  f4_mul(f4_swizzle(a, 2, 0, 1, 3), f4_swizzle(b, 1, 2, 0, 3)));
+}
+
+// Inverse of a matrix whose last row is (0, 0, 0, 1): invert the 3x3 part and rotate the translation back.
+// Returns a zero matrix if the 3x3 part is singular.
+mat4 m4_inverse_affine(const mat4 in)
+{
+    f4 c0, c1, c2, t;
+    m4_load_columns(&in, &c0, &c1, &c2, &t);
+
+    // Rows of the 3x3 inverse are cross products of its columns
+    f4 r0 = f4_cross3(c1, c2);
+    f4 r1 = f4_cross3(c2, c0);
+    f4 r2 = f4_cross3(c0, c1);
+    f4 r3 = f4_zero();
+
+    f4 d = f4_mul(c0, r0);
+    float det = f4_first(f4_add(d, f4_add(f4_splat(d, 1), f4_splat(d, 2))));
+    if (det == 0.f) {
+        mat4 zero = {0};
+        return zero;
+    }
+
+    f4 inv_det = f4_set1(1.f / det);
+    r0 = f4_mul(r0, inv_det);
+    r1 = f4_mul(r1, inv_det);
+    r2 = f4_mul(r2, inv_det);
+
+    f4_transpose(r0, r1, r2, r3);
+
+    // New translation is -inverse(L) * t; the w lane ends up 1
+    f4 nt = f4_set(0.f, 0.f, 0.f, 1.f);
+    nt = f4_sub(nt, f4_mul(r0, f4_splat(t, 0)));
+    nt = f4_sub(nt, f4_mul(r1, f4_splat(t, 1)));
+    nt = f4_sub(nt, f4_mul(r2, f4_splat(t, 2)));
+
+    return m4_from_columns(r0, r1, r2, nt);
+}
+
+// Inverse of a rotation + translation matrix (orthonormal 3x3 part, e.g. from lookAt/translate/rotate):
+// the rotation is transposed instead of inverted
+mat4 m4_inverse_rigid(const mat4 in)
+{
+    f4 xyz = f4_set(1.f, 1.f, 1.f, 0.f);
+
+    f4 r0 = f4_load(in.idx[0]);
+    f4 r1 = f4_load(in.idx[1]);
+    f4 r2 = f4_load(in.idx[2]);
+
+    // New translation is -transpose(R) * t; the w lane ends up 1
+    f4 nt = f4_set(0.f, 0.f, 0.f, 1.f);
+    nt = f4_sub(nt, f4_mul(f4_mul(r0, xyz), f4_splat(r0, 3)));
+    nt = f4_sub(nt, f4_mul(f4_mul(r1, xyz), f4_splat(r1, 3)));
+    nt = f4_sub(nt, f4_mul(f4_mul(r2, xyz), f4_splat(r2, 3)));
+
+    return m4_from_columns(f4_mul(r0, xyz), f4_mul(r1, xyz), f4_mul(r2, xyz), nt);
+}
+
+// BATCH OPERATIONS ///////////////////////////////////////////////////////////////////////////////////////////////
+
+// out[i] = a[i] * b[i]; out may alias a or b
+void m4_mul_batch(mat4* out, const mat4* a, const mat4* b, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        mat4 r;
+        m4_mul_to(&r, &a[i], &b[i]);
+        out[i] = r;
+    }
+}
+
+// Transforms count points (w = 1) by m, VMATH_LANES points per iteration; out may alias in
+void m4_transform_points(const mat4 m, const v3_soa in, v3_soa out, size_t count)
+{
+    size_t i = 0;
+
+    fw m00 = fw_set1(m.idx[0][0]), m01 = fw_set1(m.idx[0][1]), m02 = fw_set1(m.idx[0][2]), m03 = fw_set1(m.idx[0][3]);
+    fw m10 = fw_set1(m.idx[1][0]), m11 = fw_set1(m.idx[1][1]), m12 = fw_set1(m.idx[1][2]), m13 = fw_set1(m.idx[1][3]);
+    fw m20 = fw_set1(m.idx[2][0]), m21 = fw_set1(m.idx[2][1]), m22 = fw_set1(m.idx[2][2]), m23 = fw_set1(m.idx[2][3]);
+
+    for (; i + VMATH_LANES <= count; i += VMATH_LANES) {
+        fw x = fw_load(in.x + i);
+        fw y = fw_load(in.y + i);
+        fw z = fw_load(in.z + i);
+
+        fw_store(out.x + i, fw_madd(m00, x, fw_madd(m01, y, fw_madd(m02, z, m03))));
+        fw_store(out.y + i, fw_madd(m10, x, fw_madd(m11, y, fw_madd(m12, z, m13))));
+        fw_store(out.z + i, fw_madd(m20, x, fw_madd(m21, y, fw_madd(m22, z, m23))));
+    }
+
+    for (; i < count; i++) {
+        float x = in.x[i], y = in.y[i], z = in.z[i];
+        out.x[i] = m.idx[0][0] * x + m.idx[0][1] * y + m.idx[0][2] * z + m.idx[0][3];
+        out.y[i] = m.idx[1][0] * x + m.idx[1][1] * y + m.idx[1][2] * z + m.idx[1][3];
+        out.z[i] = m.idx[2][0] * x + m.idx[2][1] * y + m.idx[2][2] * z + m.idx[2][3];
+    }
+}
+
+// Normalizes count vectors; zero-length vectors are passed through like v3_normalize does
+void v3_normalize_batch(const v3_soa in, v3_soa out, size_t count)
+{
+    size_t i = 0;
+
+    fw zero = fw_set1(0.f);
+    fw one = fw_set1(1.f);
+
+    for (; i + VMATH_LANES <= count; i += VMATH_LANES) {
+        fw x = fw_load(in.x + i);
+        fw y = fw_load(in.y + i);
+        fw z = fw_load(in.z + i);
+
+        fw len2 = fw_madd(x, x, fw_madd(y, y, fw_mul(z, z)));
+        fw nonzero = fw_cmpgt(len2, zero);
+        fw inv_len = fw_select(nonzero, fw_rsqrt(fw_select(nonzero, len2, one)), one);
+
+        fw_store(out.x + i, fw_mul(x, inv_len));
+        fw_store(out.y + i, fw_mul(y, inv_len));
+        fw_store(out.z + i, fw_mul(z, inv_len));
+    }
+
+    for (; i < count; i++) {
+        vec3 n = v3_normalize((vec3) { in.x[i], in.y[i], in.z[i] });
+        out.x[i] = n.x;
+        out.y[i] = n.y;
+        out.z[i] = n.z;
+    }
 }
 
 // QUATERNION TYPE ////////////////////////////////////////////////////////////////////////////////////////////////
+
+quat quat_identity()
+{
+    return (quat) { 0.f, 0.f, 0.f, 1.f };
+}
+
+quat quat_from_axis_angle(const vec3 axis, float angle_rad)
+{
+    vec3 n_axis = v3_normalize(axis);
+    float s = sinf(angle_rad * 0.5f);
+
+    return (quat) { n_axis.x * s, n_axis.y * s, n_axis.z * s, cosf(angle_rad * 0.5f) };
+}
+
+quat quat_conjugate(const quat q)
+{
+    return (quat) { -q.x, -q.y, -q.z, q.w };
+}
+
+float quat_dot(const quat a, const quat b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+quat quat_normalize(const quat q)
+{
+    float len2 = quat_dot(q, q);
+    if (len2 == 0) return quat_identity();
+    float inv_len = 1.0f / sqrtf(len2);
+    return (quat) { q.x * inv_len, q.y * inv_len, q.z * inv_len, q.w * inv_len };
+}
+
+// Hamilton product: a * b applies b first, then a
+quat quat_mul(const quat a, const quat b)
+{
+    f4 va = f4_load(&a.x);
+    f4 vb = f4_load(&b.x);
+
+    f4 r = f4_mul(f4_splat(va, 3), vb);
+    r = f4_madd(f4_splat(va, 0), f4_mul(f4_swizzle(vb, 3, 2, 1, 0), f4_set(1.f, -1.f, 1.f, -1.f)), r);
+    r = f4_madd(f4_splat(va, 1), f4_mul(f4_swizzle(vb, 2, 3, 0, 1), f4_set(1.f, 1.f, -1.f, -1.f)), r);
+    r = f4_madd(f4_splat(va, 2), f4_mul(f4_swizzle(vb, 1, 0, 3, 2), f4_set(-1.f, 1.f, 1.f, -1.f)), r);
+
+    quat out;
+    f4_store(&out.x, r);
+    return out;
+}
+
+// Rotates v by the unit quaternion q
+vec3 quat_rotate_v3(const quat q, const vec3 v)
+{
+    vec3 u = { q.x, q.y, q.z };
+    vec3 t = v3_mulf(cross(u, v), 2.f);
+    return v3_add(v3_add(v, v3_mulf(t, q.w)), cross(u, t));
+}
+
+// Normalized linear interpolation along the shortest arc
+quat quat_nlerp(const quat a, const quat b, float t)
+{
+    float sign = quat_dot(a, b) < 0.f ? -1.f : 1.f;
+
+    f4 va = f4_load(&a.x);
+    f4 vb = f4_mul(f4_load(&b.x), f4_set1(sign));
+    f4 r = f4_madd(f4_sub(vb, va), f4_set1(t), va);
+
+    // Horizontal sum of squares, broadcast to every lane
+    f4 len2 = f4_mul(r, r);
+    len2 = f4_add(len2, f4_swizzle(len2, 1, 0, 3, 2));
+    len2 = f4_add(len2, f4_swizzle(len2, 2, 3, 0, 1));
+    if (f4_first(len2) == 0) return quat_identity();
+
+    quat out;
+    f4_store(&out.x, f4_mul(r, f4_rsqrt(len2)));
+    return out;
+}
+
+// Spherical linear interpolation along the shortest arc; falls back to nlerp for nearly parallel inputs
+quat quat_slerp(const quat a, const quat b, float t)
+{
+    float d = quat_dot(a, b);
+    float sign = d < 0.f ? -1.f : 1.f;
+    d *= sign;
+
+    if (d > 0.9995f) return quat_nlerp(a, b, t);
+
+    float theta = acosf(d);
+    float inv_sin = 1.f / sinf(theta);
+    float wa = sinf((1.f - t) * theta) * inv_sin;
+    float wb = sinf(t * theta) * inv_sin * sign;
+
+    f4 r = f4_madd(f4_load(&a.x), f4_set1(wa), f4_mul(f4_load(&b.x), f4_set1(wb)));
+
+    quat out;
+    f4_store(&out.x, r);
+    return out;
+}
+
+// translate(t) * rotation(r) * scale(s) built directly, without any matrix multiply
+mat4 m4_compose_trs(const vec3 t, const quat r, const vec3 s)
+{
+    float x2 = r.x + r.x, y2 = r.y + r.y, z2 = r.z + r.z;
+    float xx = r.x * x2, yy = r.y * y2, zz = r.z * z2;
+    float xy = r.x * y2, xz = r.x * z2, yz = r.y * z2;
+    float wx = r.w * x2, wy = r.w * y2, wz = r.w * z2;
+
+    return (mat4) {
+
+        (1.f - (yy + zz)) * s.x, (xy - wz) * s.y, (xz + wy) * s.z, t.x,
+        (xy + wz) * s.x, (1.f - (xx + zz)) * s.y, (yz - wx) * s.z, t.y,
+        (xz - wy) * s.x, (yz + wx) * s.y, (1.f - (xx + yy)) * s.z, t.z,
+        0.f, 0.f, 0.f, 1.f
+    };
+}
+
+// Rotation matrix of the unit quaternion q
+mat4 quat_to_m4(const quat q)
+{
+    return m4_compose_trs((vec3) { 0.f, 0.f, 0.f }, q, (vec3) { 1.f, 1.f, 1.f });
+}
+
+// acos(x) for x in [0, 1] (Abramowitz & Stegun 4.4.46, |error| < 2e-8)
+VMATH_INLINE f4 f4_acos01(f4 x)
+{
+    f4 p = f4_set1(-0.0012624911f);
+    p = f4_madd(p, x, f4_set1(0.0066700901f));
+    p = f4_madd(p, x, f4_set1(-0.0170881256f));
+    p = f4_madd(p, x, f4_set1(0.0308918810f));
+    p = f4_madd(p, x, f4_set1(-0.0501743046f));
+    p = f4_madd(p, x, f4_set1(0.0889789874f));
+    p = f4_madd(p, x, f4_set1(-0.2145988016f));
+    p = f4_madd(p, x, f4_set1(1.5707963050f));
+    return f4_mul(p, f4_sqrt(f4_sub(f4_set1(1.f), x)));
+}
+
+// sin(x) for x in [0, pi/2] (Taylor series to x^11)
+VMATH_INLINE f4 f4_sin_half_pi(f4 x)
+{
+    f4 x2 = f4_mul(x, x);
+    f4 p = f4_set1(-1.f / 39916800.f);
+    p = f4_madd(p, x2, f4_set1(1.f / 362880.f));
+    p = f4_madd(p, x2, f4_set1(-1.f / 5040.f));
+    p = f4_madd(p, x2, f4_set1(1.f / 120.f));
+    p = f4_madd(p, x2, f4_set1(-1.f / 6.f));
+    p = f4_madd(p, x2, f4_set1(1.f));
+    return f4_mul(p, x);
+}
+
+// out[i] = quat_slerp(a[i], b[i], t[i]), four tracks per iteration; out may alias a or b
+void quat_slerp_batch(quat* out, const quat* a, const quat* b, const float* t, size_t count)
+{
+    size_t i = 0;
+
+    f4 zero = f4_zero();
+    f4 one = f4_set1(1.f);
+    f4 nearly_parallel = f4_set1(0.9995f);
+
+    for (; i + 4 <= count; i += 4) {
+        // Load four quaternions and transpose them into x/y/z/w streams
+        f4 ax = f4_load(&a[i + 0].x), ay = f4_load(&a[i + 1].x), az = f4_load(&a[i + 2].x), aw = f4_load(&a[i + 3].x);
+        f4 bx = f4_load(&b[i + 0].x), by = f4_load(&b[i + 1].x), bz = f4_load(&b[i + 2].x), bw = f4_load(&b[i + 3].x);
+        f4_transpose(ax, ay, az, aw);
+        f4_transpose(bx, by, bz, bw);
+        f4 vt = f4_load(t + i);
+
+        // Shortest arc: flip b where the dot product is negative
+        f4 d = f4_madd(ax, bx, f4_madd(ay, by, f4_madd(az, bz, f4_mul(aw, bw))));
+        f4 sign = f4_select(f4_cmpgt(zero, d), f4_set1(-1.f), one);
+        d = f4_mul(d, sign);
+
+        f4 theta = f4_acos01(f4_select(f4_cmpgt(d, one), one, d));
+        f4 sin_theta = f4_sin_half_pi(theta);
+
+        // Nearly parallel lanes use plain linear weights (normalized below)
+        f4 slerp = f4_cmpgt(nearly_parallel, d);
+        f4 inv_sin = f4_div(one, f4_select(slerp, sin_theta, one));
+        f4 wa = f4_select(slerp, f4_mul(f4_sin_half_pi(f4_mul(f4_sub(one, vt), theta)), inv_sin), f4_sub(one, vt));
+        f4 wb = f4_select(slerp, f4_mul(f4_sin_half_pi(f4_mul(vt, theta)), inv_sin), vt);
+        wb = f4_mul(wb, sign);
+
+        f4 rx = f4_madd(ax, wa, f4_mul(bx, wb));
+        f4 ry = f4_madd(ay, wa, f4_mul(by, wb));
+        f4 rz = f4_madd(az, wa, f4_mul(bz, wb));
+        f4 rw = f4_madd(aw, wa, f4_mul(bw, wb));
+
+        f4 inv_len = f4_rsqrt(f4_madd(rx, rx, f4_madd(ry, ry, f4_madd(rz, rz, f4_mul(rw, rw)))));
+        rx = f4_mul(rx, inv_len);
+        ry = f4_mul(ry, inv_len);
+        rz = f4_mul(rz, inv_len);
+        rw = f4_mul(rw, inv_len);
+
+        f4_transpose(rx, ry, rz, rw);
+        f4_store(&out[i + 0].x, rx);
+        f4_store(&out[i + 1].x, ry);
+        f4_store(&out[i + 2].x, rz);
+        f4_store(&out[i + 3].x, rw);
+    }
+
+    for (; i < count; i++) {
+        out[i] = quat_slerp(a[i], b[i], t[i]);
+    }
+}
@@ -2,6 +2,105 @@
 
 #include <cmath>
 #include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define VMATH_FORCEINLINE __forceinline
+#else
+#define VMATH_FORCEINLINE inline __attribute__((always_inline))
+#endif
+
+// C-style vector types for C interop and the SIMD kernels in vmath.c.
+// The Math:: classes below share their exact layout, so either can be viewed as the other without a copy.
+typedef struct vec2 {
+    float x, y;
+} vec2;
+
+typedef struct vec3 {
+    float x, y, z;
+} vec3;
+
+typedef struct alignas(16) vec4 {
+    float x, y, z, w;
+} vec4;
+
+typedef struct alignas(16) quat {
+    float x, y, z, w;
+} quat;
+
+// Row-major, column-vector convention: idx[row][col], translation in idx[0..2][3]
+typedef union alignas(16) mat4 {
+    float m[16];
+    float idx[4][4]; // Added 2D array access for compatibility
+} mat4;
+
+// Structure-of-arrays view of a vec3 stream for the batch functions
+typedef struct v3_soa {
+    float* x;
+    float* y;
+    float* z;
+} v3_soa;
+
+// C API (vmath.c)
+float to_radians(float angle_deg);
+
+vec2 v2_neg(const vec2 a);
+vec2 v2_add(const vec2 a, const vec2 b);
+vec2 v2_sub(const vec2 a, const vec2 b);
+vec2 v2_mulf(const vec2 a, float f);
+vec2 v2_pairwise(const vec2 a, const vec2 b);
+float v2_dot(const vec2 a, const vec2 b);
+float v2_len(const vec2 in);
+vec2 v2_normalize(const vec2 in);
+
+vec3 v3_neg(const vec3 a);
+vec3 v3_add(const vec3 a, const vec3 b);
+vec3 v3_sub(const vec3 a, const vec3 b);
+vec3 v3_mulf(const vec3 a, float f);
+vec3 v3_pairwise(const vec3 a, const vec3 b);
+float v3_dot(const vec3 a, const vec3 b);
+vec3 cross(const vec3 a, const vec3 b);
+float v3_len(const vec3 in);
+vec3 v3_normalize(const vec3 in);
+
+mat4 identity();
+mat4 m4_mul(const mat4 a, const mat4 b);
+mat4 m4_mulf(const mat4 in, float f);
+mat4 transpose(const mat4 in);
+mat4 scale(const mat4 in, float x, float y, float z);
+mat4 scale_uni(const mat4 in, float f);
+mat4 scale_vec(const mat4 in, const vec3 v);
+mat4 translate(const mat4 in, float x, float y, float z);
+mat4 translate_vec(const mat4 in, const vec3 v);
+mat4 rotate(const mat4 in, const vec3 axis, float angle_rad);
+mat4 rotateX(const mat4 in, float angle_rad);
+mat4 rotateY(const mat4 in, float angle_rad);
+mat4 rotateZ(const mat4 in, float angle_rad);
+mat4 lookAt(const vec3 eye, const vec3 target, const vec3 up);
+mat4 ortho1(float width, float height, float zNear, float zFar);
+mat4 ortho2(float left, float right, float bottom, float top, float zNear, float zFar);
+mat4 perspective(float fov, float aspect, float zNear, float zFar);
+mat4 m4_inverse(const mat4 in);
+mat4 m4_inverse_affine(const mat4 in);
+mat4 m4_inverse_rigid(const mat4 in);
+
+void m4_mul_batch(mat4* out, const mat4* a, const mat4* b, size_t count);
+void m4_transform_points(const mat4 m, const v3_soa in, v3_soa out, size_t count);
+void v3_normalize_batch(const v3_soa in, v3_soa out, size_t count);
+
+quat quat_identity();
+quat quat_from_axis_angle(const vec3 axis, float angle_rad);
+quat quat_conjugate(const quat q);
+float quat_dot(const quat a, const quat b);
+quat quat_normalize(const quat q);
+quat quat_mul(const quat a, const quat b);
+vec3 quat_rotate_v3(const quat q, const vec3 v);
+quat quat_nlerp(const quat a, const quat b, float t);
+quat quat_slerp(const quat a, const quat b, float t);
+mat4 m4_compose_trs(const vec3 t, const quat r, const vec3 s);
+mat4 quat_to_m4(const quat q);
+void quat_slerp_batch(quat* out, const quat* a, const quat* b, const float* t, size_t count);
 
 namespace Math {
 
@@ -9,7 +108,7 @@ namespace Math {
 constexpr float PI = 3.1415926535897932384626433f;
 
 // Utility functions
-inline float ToRadians(float angle_deg) {
+VMATH_FORCEINLINE constexpr float ToRadians(float angle_deg) {
     return angle_deg * (PI / 180.0f);
 }
 
@@ -19,53 +118,59 @@ public:
     float x, y;
 
     // Constructors
-    Vector2() : x(0.0f), y(0.0f) {}
-    Vector2(float x, float y) : x(x), y(y) {}
-    
+    constexpr Vector2() : x(0.0f), y(0.0f) {}
+    constexpr Vector2(float x, float y) : x(x), y(y) {}
+
     // Unary operators
-    Vector2 operator-() const { return Vector2(-x, -y); }
-    
+    VMATH_FORCEINLINE constexpr Vector2 operator-() const { return Vector2(-x, -y); }
+
     // Binary operators
-    Vector2 operator+(const Vector2& other) const { return Vector2(x + other.x, y + other.y); }
-    Vector2 operator-(const Vector2& other) const { return Vector2(x - other.x, y - other.y); }
-    Vector2 operator*(float scalar) const { return Vector2(x * scalar, y * scalar); }
-    Vector2 operator*(const Vector2& other) const { return Vector2(x * other.x, y * other.y); }
-    
+    VMATH_FORCEINLINE constexpr Vector2 operator+(const Vector2& other) const { return Vector2(x + other.x, y + other.y); }
+    VMATH_FORCEINLINE constexpr Vector2 operator-(const Vector2& other) const { return Vector2(x - other.x, y - other.y); }
+    VMATH_FORCEINLINE constexpr Vector2 operator*(float scalar) const { return Vector2(x * scalar, y * scalar); }
+    VMATH_FORCEINLINE constexpr Vector2 operator*(const Vector2& other) const { return Vector2(x * other.x, y * other.y); }
+
     // Compound assignment operators
-    Vector2& operator+=(const Vector2& other) {
+    VMATH_FORCEINLINE constexpr Vector2& operator+=(const Vector2& other) {
         x += other.x;
         y += other.y;
         return *this;
     }
-    
-    Vector2& operator-=(const Vector2& other) {
+
+    VMATH_FORCEINLINE constexpr Vector2& operator-=(const Vector2& other) {
         x -= other.x;
         y -= other.y;
         return *this;
     }
-    
-    Vector2& operator*=(float scalar) {
+
+    VMATH_FORCEINLINE constexpr Vector2& operator*=(float scalar) {
         x *= scalar;
         y *= scalar;
         return *this;
     }
-    
+
     // Vector operations
-    float Dot(const Vector2& other) const { return x * other.x + y * other.y; }
-    float Length() const { return std::sqrt(x * x + y * y); }
-    Vector2 Normalized() const {
+    VMATH_FORCEINLINE constexpr float Dot(const Vector2& other) const { return x * other.x + y * other.y; }
+    VMATH_FORCEINLINE float Length() const { return std::sqrt(x * x + y * y); }
+    VMATH_FORCEINLINE Vector2 Normalized() const {
         float len = Length();
         if (len < 1e-6f) return Vector2();
         float invLen = 1.0f / len;
         return Vector2(x * invLen, y * invLen);
     }
-    void Normalize() {
+    VMATH_FORCEINLINE void Normalize() {
         float len = Length();
         if (len < 1e-6f) return;
         float invLen = 1.0f / len;
         x *= invLen;
         y *= invLen;
     }
+
+    // C struct views (no copy)
+    VMATH_FORCEINLINE vec2& AsC() { return *reinterpret_cast<vec2*>(this); }
+    VMATH_FORCEINLINE const vec2& AsC() const { return *reinterpret_cast<const vec2*>(this); }
+    VMATH_FORCEINLINE static Vector2& FromC(vec2& v) { return *reinterpret_cast<Vector2*>(&v); }
+    VMATH_FORCEINLINE static const Vector2& FromC(const vec2& v) { return *reinterpret_cast<const Vector2*>(&v); }
 };
 
 // Vector3 class
@@ -74,57 +179,57 @@ public:
     float x, y, z;
 
     // Constructors
-    Vector3() : x(0.0f), y(0.0f), z(0.0f) {}
-    Vector3(float x, float y, float z) : x(x), y(y), z(z) {}
-    
+    constexpr Vector3() : x(0.0f), y(0.0f), z(0.0f) {}
+    constexpr Vector3(float x, float y, float z) : x(x), y(y), z(z) {}
+
     // Unary operators
-    Vector3 operator-() const { return Vector3(-x, -y, -z); }
-    
+    VMATH_FORCEINLINE constexpr Vector3 operator-() const { return Vector3(-x, -y, -z); }
+
     // Binary operators
-    Vector3 operator+(const Vector3& other) const { return Vector3(x + other.x, y + other.y, z + other.z); }
-    Vector3 operator-(const Vector3& other) const { return Vector3(x - other.x, y - other.y, z - other.z); }
-    Vector3 operator*(float scalar) const { return Vector3(x * scalar, y * scalar, z * scalar); }
-    Vector3 operator*(const Vector3& other) const { return Vector3(x * other.x, y * other.y, z * other.z); }
-    
+    VMATH_FORCEINLINE constexpr Vector3 operator+(const Vector3& other) const { return Vector3(x + other.x, y + other.y, z + other.z); }
+    VMATH_FORCEINLINE constexpr Vector3 operator-(const Vector3& other) const { return Vector3(x - other.x, y - other.y, z - other.z); }
+    VMATH_FORCEINLINE constexpr Vector3 operator*(float scalar) const { return Vector3(x * scalar, y * scalar, z * scalar); }
+    VMATH_FORCEINLINE constexpr Vector3 operator*(const Vector3& other) const { return Vector3(x * other.x, y * other.y, z * other.z); }
+
     // Compound assignment operators
-    Vector3& operator+=(const Vector3& other) {
+    VMATH_FORCEINLINE constexpr Vector3& operator+=(const Vector3& other) {
         x += other.x;
         y += other.y;
         z += other.z;
         return *this;
     }
-    
-    Vector3& operator-=(const Vector3& other) {
+
+    VMATH_FORCEINLINE constexpr Vector3& operator-=(const Vector3& other) {
         x -= other.x;
         y -= other.y;
         z -= other.z;
         return *this;
     }
-    
-    Vector3& operator*=(float scalar) {
+
+    VMATH_FORCEINLINE constexpr Vector3& operator*=(float scalar) {
         x *= scalar;
         y *= scalar;
         z *= scalar;
         return *this;
     }
-    
+
     // Vector operations
-    float Dot(const Vector3& other) const { return x * other.x + y * other.y + z * other.z; }
-    Vector3 Cross(const Vector3& other) const {
+    VMATH_FORCEINLINE constexpr float Dot(const Vector3& other) const { return x * other.x + y * other.y + z * other.z; }
+    VMATH_FORCEINLINE constexpr Vector3 Cross(const Vector3& other) const {
         return Vector3(
             y * other.z - z * other.y,
             z * other.x - x * other.z,
             x * other.y - y * other.x
         );
     }
-    float Length() const { return std::sqrt(x * x + y * y + z * z); }
-    Vector3 Normalized() const {
+    VMATH_FORCEINLINE float Length() const { return std::sqrt(x * x + y * y + z * z); }
+    VMATH_FORCEINLINE Vector3 Normalized() const {
         float len = Length();
         if (len < 1e-6f) return Vector3();
         float invLen = 1.0f / len;
         return Vector3(x * invLen, y * invLen, z * invLen);
     }
-    void Normalize() {
+    VMATH_FORCEINLINE void Normalize() {
         float len = Length();
         if (len < 1e-6f) return;
         float invLen = 1.0f / len;
@@ -132,24 +237,259 @@ public:
         y *= invLen;
         z *= invLen;
     }
+
+    // C struct views (no copy)
+    VMATH_FORCEINLINE vec3& AsC() { return *reinterpret_cast<vec3*>(this); }
+    VMATH_FORCEINLINE const vec3& AsC() const { return *reinterpret_cast<const vec3*>(this); }
+    VMATH_FORCEINLINE static Vector3& FromC(vec3& v) { return *reinterpret_cast<Vector3*>(&v); }
+    VMATH_FORCEINLINE static const Vector3& FromC(const vec3& v) { return *reinterpret_cast<const Vector3*>(&v); }
 };
 
-} // namespace Math
+// Vector4 class (16-byte aligned, one SIMD register)
+class alignas(16) Vector4 {
+public:
+    float x, y, z, w;
 
-// C-style vector types for backward compatibility and C interop
-typedef struct vec2 {
-    float x, y;
-} vec2;
+    // Constructors
+    constexpr Vector4() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
+    constexpr Vector4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+    constexpr Vector4(const Vector3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
 
-typedef struct vec3 {
-    float x, y, z;
-} vec3;
+    // Unary operators
+    VMATH_FORCEINLINE constexpr Vector4 operator-() const { return Vector4(-x, -y, -z, -w); }
+
+    // Binary operators
+    VMATH_FORCEINLINE constexpr Vector4 operator+(const Vector4& other) const { return Vector4(x + other.x, y + other.y, z + other.z, w + other.w); }
+    VMATH_FORCEINLINE constexpr Vector4 operator-(const Vector4& other) const { return Vector4(x - other.x, y - other.y, z - other.z, w - other.w); }
+    VMATH_FORCEINLINE constexpr Vector4 operator*(float scalar) const { return Vector4(x * scalar, y * scalar, z * scalar, w * scalar); }
+    VMATH_FORCEINLINE constexpr Vector4 operator*(const Vector4& other) const { return Vector4(x * other.x, y * other.y, z * other.z, w * other.w); }
+
+    // Compound assignment operators
+    VMATH_FORCEINLINE constexpr Vector4& operator+=(const Vector4& other) {
+        *this = *this + other;
+        return *this;
+    }
+
+    VMATH_FORCEINLINE constexpr Vector4& operator-=(const Vector4& other) {
+        *this = *this - other;
+        return *this;
+    }
+
+    VMATH_FORCEINLINE constexpr Vector4& operator*=(float scalar) {
+        *this = *this * scalar;
+        return *this;
+    }
+
+    // Vector operations
+    VMATH_FORCEINLINE constexpr float Dot(const Vector4& other) const { return x * other.x + y * other.y + z * other.z + w * other.w; }
+    VMATH_FORCEINLINE constexpr Vector3 XYZ() const { return Vector3(x, y, z); }
+    VMATH_FORCEINLINE float Length() const { return std::sqrt(Dot(*this)); }
+    VMATH_FORCEINLINE Vector4 Normalized() const {
+        float len = Length();
+        if (len < 1e-6f) return Vector4();
+        float invLen = 1.0f / len;
+        return *this * invLen;
+    }
+    VMATH_FORCEINLINE void Normalize() { *this = Normalized(); }
+
+    // C struct views (no copy)
+    VMATH_FORCEINLINE vec4& AsC() { return *reinterpret_cast<vec4*>(this); }
+    VMATH_FORCEINLINE const vec4& AsC() const { return *reinterpret_cast<const vec4*>(this); }
+    VMATH_FORCEINLINE static Vector4& FromC(vec4& v) { return *reinterpret_cast<Vector4*>(&v); }
+    VMATH_FORCEINLINE static const Vector4& FromC(const vec4& v) { return *reinterpret_cast<const Vector4*>(&v); }
+};
 
-typedef struct vec4 {
+// Quaternion class (x, y, z vector part, w scalar part)
+class alignas(16) Quaternion {
+public:
     float x, y, z, w;
-} vec4;
 
-typedef union mat4 {
-    float m[16];
-    float idx[4][4]; // Added 2D array access for compatibility
-} mat4;
\ No newline at end of file
+    // Constructors
+    constexpr Quaternion() : x(0.0f), y(0.0f), z(0.0f), w(1.0f) {}
+    constexpr Quaternion(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+
+    // Rotation of angle_rad around axis (axis does not need to be normalized)
+    static Quaternion FromAxisAngle(const Vector3& axis, float angle_rad) {
+        Vector3 n = axis.Normalized();
+        float s = std::sin(angle_rad * 0.5f);
+        return Quaternion(n.x * s, n.y * s, n.z * s, std::cos(angle_rad * 0.5f));
+    }
+
+    // Unary operators
+    VMATH_FORCEINLINE constexpr Quaternion operator-() const { return Quaternion(-x, -y, -z, -w); }
+
+    // Binary operators (a * b applies b first, then a)
+    VMATH_FORCEINLINE constexpr Quaternion operator*(const Quaternion& b) const {
+        return Quaternion(
+            w * b.x + x * b.w + y * b.z - z * b.y,
+            w * b.y - x * b.z + y * b.w + z * b.x,
+            w * b.z + x * b.y - y * b.x + z * b.w,
+            w * b.w - x * b.x - y * b.y - z * b.z
+        );
+    }
+
+    VMATH_FORCEINLINE constexpr Quaternion& operator*=(const Quaternion& b) {
+        *this = *this * b;
+        return *this;
+    }
+
+    // Quaternion operations
+    VMATH_FORCEINLINE constexpr float Dot(const Quaternion& other) const { return x * other.x + y * other.y + z * other.z + w * other.w; }
+    VMATH_FORCEINLINE float Length() const { return std::sqrt(Dot(*this)); }
+    VMATH_FORCEINLINE constexpr Quaternion Conjugate() const { return Quaternion(-x, -y, -z, w); }
+    VMATH_FORCEINLINE Quaternion Normalized() const {
+        float len = Length();
+        if (len < 1e-6f) return Quaternion();
+        float invLen = 1.0f / len;
+        return Quaternion(x * invLen, y * invLen, z * invLen, w * invLen);
+    }
+    VMATH_FORCEINLINE void Normalize() { *this = Normalized(); }
+
+    // Rotates v by this (unit) quaternion
+    VMATH_FORCEINLINE constexpr Vector3 Rotate(const Vector3& v) const {
+        Vector3 u(x, y, z);
+        Vector3 t = u.Cross(v) * 2.0f;
+        return v + t * w + u.Cross(t);
+    }
+
+    // Normalized linear interpolation along the shortest arc
+    static Quaternion Nlerp(const Quaternion& a, const Quaternion& b, float t) {
+        float sign = a.Dot(b) < 0.0f ? -1.0f : 1.0f;
+        return Quaternion(
+            a.x + (b.x * sign - a.x) * t,
+            a.y + (b.y * sign - a.y) * t,
+            a.z + (b.z * sign - a.z) * t,
+            a.w + (b.w * sign - a.w) * t
+        ).Normalized();
+    }
+
+    // Spherical linear interpolation along the shortest arc
+    static Quaternion Slerp(const Quaternion& a, const Quaternion& b, float t) {
+        float d = a.Dot(b);
+        float sign = d < 0.0f ? -1.0f : 1.0f;
+        d *= sign;
+        if (d > 0.9995f) return Nlerp(a, b, t);
+
+        float theta = std::acos(d);
+        float invSin = 1.0f / std::sin(theta);
+        float wa = std::sin((1.0f - t) * theta) * invSin;
+        float wb = std::sin(t * theta) * invSin * sign;
+        return Quaternion(a.x * wa + b.x * wb, a.y * wa + b.y * wb, a.z * wa + b.z * wb, a.w * wa + b.w * wb);
+    }
+
+    // C struct views (no copy)
+    VMATH_FORCEINLINE quat& AsC() { return *reinterpret_cast<quat*>(this); }
+    VMATH_FORCEINLINE const quat& AsC() const { return *reinterpret_cast<const quat*>(this); }
+    VMATH_FORCEINLINE static Quaternion& FromC(quat& q) { return *reinterpret_cast<Quaternion*>(&q); }
+    VMATH_FORCEINLINE static const Quaternion& FromC(const quat& q) { return *reinterpret_cast<const Quaternion*>(&q); }
+};
+
+// Matrix4 class (same layout and convention as mat4: m[row][col], column vectors)
+// Operations fold at compile time in constant expressions and use the SIMD kernels of vmath.c at run time.
+class alignas(16) Matrix4 {
+public:
+    float m[4][4];
+
+    // Constructors
+    constexpr Matrix4() : m{ { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f },
+                             { 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } {}
+    constexpr Matrix4(const Vector4& r0, const Vector4& r1, const Vector4& r2, const Vector4& r3)
+        : m{ { r0.x, r0.y, r0.z, r0.w }, { r1.x, r1.y, r1.z, r1.w },
+             { r2.x, r2.y, r2.z, r2.w }, { r3.x, r3.y, r3.z, r3.w } } {}
+
+    static constexpr Matrix4 Identity() { return Matrix4(); }
+
+    static constexpr Matrix4 Translation(const Vector3& t) {
+        return Matrix4(Vector4(1.0f, 0.0f, 0.0f, t.x), Vector4(0.0f, 1.0f, 0.0f, t.y),
+                       Vector4(0.0f, 0.0f, 1.0f, t.z), Vector4(0.0f, 0.0f, 0.0f, 1.0f));
+    }
+
+    static constexpr Matrix4 Scaling(const Vector3& s) {
+        return Matrix4(Vector4(s.x, 0.0f, 0.0f, 0.0f), Vector4(0.0f, s.y, 0.0f, 0.0f),
+                       Vector4(0.0f, 0.0f, s.z, 0.0f), Vector4(0.0f, 0.0f, 0.0f, 1.0f));
+    }
+
+    // translate(t) * rotate(r) * scale(s)
+    static VMATH_FORCEINLINE Matrix4 TRS(const Vector3& t, const Quaternion& r, const Vector3& s) {
+        Matrix4 out;
+        out.AsC() = m4_compose_trs(t.AsC(), r.AsC(), s.AsC());
+        return out;
+    }
+
+    // Binary operators
+    VMATH_FORCEINLINE constexpr Matrix4 operator*(const Matrix4& other) const {
+        Matrix4 out;
+        if (std::is_constant_evaluated()) {
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) {
+                    out.m[i][j] = m[i][0] * other.m[0][j] + m[i][1] * other.m[1][j] +
+                                  m[i][2] * other.m[2][j] + m[i][3] * other.m[3][j];
+                }
+            }
+        } else {
+            out.AsC() = m4_mul(AsC(), other.AsC());
+        }
+        return out;
+    }
+
+    VMATH_FORCEINLINE constexpr Vector4 operator*(const Vector4& v) const {
+        return Vector4(
+            m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z + m[0][3] * v.w,
+            m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z + m[1][3] * v.w,
+            m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z + m[2][3] * v.w,
+            m[3][0] * v.x + m[3][1] * v.y + m[3][2] * v.z + m[3][3] * v.w
+        );
+    }
+
+    VMATH_FORCEINLINE constexpr Matrix4& operator*=(const Matrix4& other) {
+        *this = *this * other;
+        return *this;
+    }
+
+    // Matrix operations
+    VMATH_FORCEINLINE constexpr Vector3 TransformPoint(const Vector3& p) const { return (*this * Vector4(p, 1.0f)).XYZ(); }
+    VMATH_FORCEINLINE constexpr Vector3 TransformDirection(const Vector3& d) const { return (*this * Vector4(d, 0.0f)).XYZ(); }
+
+    VMATH_FORCEINLINE constexpr Matrix4 Transposed() const {
+        Matrix4 out;
+        if (std::is_constant_evaluated()) {
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) {
+                    out.m[i][j] = m[j][i];
+                }
+            }
+        } else {
+            out.AsC() = transpose(AsC());
+        }
+        return out;
+    }
+
+    // General inverse; returns a zero matrix if singular
+    VMATH_FORCEINLINE Matrix4 Inverse() const {
+        Matrix4 out;
+        out.AsC() = m4_inverse(AsC());
+        return out;
+    }
+
+    // Inverse of a matrix whose last row is (0, 0, 0, 1)
+    VMATH_FORCEINLINE Matrix4 InverseAffine() const {
+        Matrix4 out;
+        out.AsC() = m4_inverse_affine(AsC());
+        return out;
+    }
+
+    // C struct views (no copy)
+    VMATH_FORCEINLINE mat4& AsC() { return *reinterpret_cast<mat4*>(this); }
+    VMATH_FORCEINLINE const mat4& AsC() const { return *reinterpret_cast<const mat4*>(this); }
+    VMATH_FORCEINLINE static Matrix4& FromC(mat4& c) { return *reinterpret_cast<Matrix4*>(&c); }
+    VMATH_FORCEINLINE static const Matrix4& FromC(const mat4& c) { return *reinterpret_cast<const Matrix4*>(&c); }
+};
+
+// The views above rely on identical size and alignment
+static_assert(sizeof(Vector2) == sizeof(vec2) && alignof(Vector2) == alignof(vec2), "Vector2/vec2 layout mismatch");
+static_assert(sizeof(Vector3) == sizeof(vec3) && alignof(Vector3) == alignof(vec3), "Vector3/vec3 layout mismatch");
+static_assert(sizeof(Vector4) == sizeof(vec4) && alignof(Vector4) == alignof(vec4), "Vector4/vec4 layout mismatch");
+static_assert(sizeof(Quaternion) == sizeof(quat) && alignof(Quaternion) == alignof(quat), "Quaternion/quat layout mismatch");
+static_assert(sizeof(Matrix4) == sizeof(mat4) && alignof(Matrix4) == alignof(mat4), "Matrix4/mat4 layout mismatch");
+
+} // namespace Math
@@ -0,0 +1,296 @@
+#pragma once
+
+// Thin 4-wide float abstraction used by the vmath kernels.
+// The backend is selected at compile time; define VMATH_FORCE_SCALAR to disable SIMD.
+
+// BACKEND SELECTION //////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if defined(VMATH_FORCE_SCALAR)
+    #define VMATH_SIMD_SCALAR 1
+#elif defined(__AVX2__)
+    #define VMATH_SIMD_AVX2 1
+    #define VMATH_SIMD_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define VMATH_SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    #define VMATH_SIMD_NEON 1
+#else
+    #define VMATH_SIMD_SCALAR 1
+#endif
+
+#if defined(VMATH_SIMD_AVX2)
+    #include <immintrin.h>
+#elif defined(VMATH_SIMD_SSE2)
+    #include <emmintrin.h>
+#elif defined(VMATH_SIMD_NEON)
+    #include <arm_neon.h>
+#else
+    #include <math.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #define VMATH_INLINE static __forceinline
+#else
+    #define VMATH_INLINE static inline __attribute__((always_inline))
+#endif
+
+// FLOAT4 TYPE ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if defined(VMATH_SIMD_SSE2)
+
+typedef __m128 f4;
+
+VMATH_INLINE f4 f4_load(const float* p) { return _mm_loadu_ps(p); }
+VMATH_INLINE void f4_store(float* p, f4 v) { _mm_storeu_ps(p, v); }
+VMATH_INLINE f4 f4_set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+VMATH_INLINE f4 f4_set1(float f) { return _mm_set1_ps(f); }
+VMATH_INLINE f4 f4_zero() { return _mm_setzero_ps(); }
+VMATH_INLINE f4 f4_add(f4 a, f4 b) { return _mm_add_ps(a, b); }
+VMATH_INLINE f4 f4_sub(f4 a, f4 b) { return _mm_sub_ps(a, b); }
+VMATH_INLINE f4 f4_mul(f4 a, f4 b) { return _mm_mul_ps(a, b); }
+VMATH_INLINE f4 f4_div(f4 a, f4 b) { return _mm_div_ps(a, b); }
+VMATH_INLINE f4 f4_sqrt(f4 a) { return _mm_sqrt_ps(a); }
+VMATH_INLINE f4 f4_rsqrt(f4 a) { return _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(a)); }
+
+// Lane masks: all bits set where the comparison holds
+VMATH_INLINE f4 f4_cmpgt(f4 a, f4 b) { return _mm_cmpgt_ps(a, b); }
+VMATH_INLINE f4 f4_select(f4 mask, f4 a, f4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+VMATH_INLINE int f4_movemask(f4 mask) { return _mm_movemask_ps(mask); }
+VMATH_INLINE f4 f4_min(f4 a, f4 b) { return _mm_min_ps(a, b); }
+
+// a * b + c
+#if defined(__FMA__)
+VMATH_INLINE f4 f4_madd(f4 a, f4 b, f4 c) { return _mm_fmadd_ps(a, b, c); }
+#else
+VMATH_INLINE f4 f4_madd(f4 a, f4 b, f4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#endif
+
+VMATH_INLINE float f4_first(f4 v) { return _mm_cvtss_f32(v); }
+
+// Broadcast a lane (compile-time constant) to all lanes
+#define f4_splat(src, lane) _mm_shuffle_ps((src), (src), _MM_SHUFFLE(lane, lane, lane, lane))
+
+// Reorder lanes: result = (src[x], src[y], src[z], src[w]) for compile-time constants
+#define f4_swizzle(src, x, y, z, w) _mm_shuffle_ps((src), (src), _MM_SHUFFLE(w, z, y, x))
+
+#define f4_transpose(r0, r1, r2, r3) _MM_TRANSPOSE4_PS(r0, r1, r2, r3)
+
+#elif defined(VMATH_SIMD_NEON)
+
+typedef float32x4_t f4;
+
+VMATH_INLINE f4 f4_load(const float* p) { return vld1q_f32(p); }
+VMATH_INLINE void f4_store(float* p, f4 v) { vst1q_f32(p, v); }
+VMATH_INLINE f4 f4_set(float x, float y, float z, float w) { float v[4] = { x, y, z, w }; return vld1q_f32(v); }
+VMATH_INLINE f4 f4_set1(float f) { return vdupq_n_f32(f); }
+VMATH_INLINE f4 f4_zero() { return vdupq_n_f32(0.f); }
+VMATH_INLINE f4 f4_add(f4 a, f4 b) { return vaddq_f32(a, b); }
+VMATH_INLINE f4 f4_sub(f4 a, f4 b) { return vsubq_f32(a, b); }
+VMATH_INLINE f4 f4_mul(f4 a, f4 b) { return vmulq_f32(a, b); }
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+VMATH_INLINE f4 f4_div(f4 a, f4 b) { return vdivq_f32(a, b); }
+VMATH_INLINE f4 f4_sqrt(f4 a) { return vsqrtq_f32(a); }
+VMATH_INLINE f4 f4_rsqrt(f4 a) { return vdivq_f32(vdupq_n_f32(1.f), vsqrtq_f32(a)); }
+#else
+// ARMv7 has no divide or square root: refine the hardware estimates with two Newton-Raphson steps
+VMATH_INLINE f4 f4_div(f4 a, f4 b)
+{
+    float32x4_t r = vrecpeq_f32(b);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    return vmulq_f32(a, r);
+}
+
+VMATH_INLINE f4 f4_rsqrt(f4 a)
+{
+    float32x4_t r = vrsqrteq_f32(a);
+    r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r);
+    r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r);
+    return r;
+}
+
+// x * rsqrt(x), with the x == 0 lanes forced to zero instead of 0 * inf
+VMATH_INLINE f4 f4_sqrt(f4 a)
+{
+    uint32x4_t positive = vcgtq_f32(a, vdupq_n_f32(0.f));
+    return vbslq_f32(positive, vmulq_f32(a, f4_rsqrt(a)), vdupq_n_f32(0.f));
+}
+#endif
+
+// Lane masks: all bits set where the comparison holds
+VMATH_INLINE f4 f4_cmpgt(f4 a, f4 b) { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+VMATH_INLINE f4 f4_select(f4 mask, f4 a, f4 b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+VMATH_INLINE f4 f4_min(f4 a, f4 b) { return vminq_f32(a, b); }
+
+VMATH_INLINE int f4_movemask(f4 mask)
+{
+    uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(mask), 31);
+    return (int)(vgetq_lane_u32(bits, 0) | (vgetq_lane_u32(bits, 1) << 1) |
+                 (vgetq_lane_u32(bits, 2) << 2) | (vgetq_lane_u32(bits, 3) << 3));
+}
+
+// a * b + c
+#if defined(__aarch64__) || defined(_M_ARM64)
+VMATH_INLINE f4 f4_madd(f4 a, f4 b, f4 c) { return vfmaq_f32(c, a, b); }
+#else
+VMATH_INLINE f4 f4_madd(f4 a, f4 b, f4 c) { return vmlaq_f32(c, a, b); }
+#endif
+
+VMATH_INLINE float f4_first(f4 v) { return vgetq_lane_f32(v, 0); }
+
+// Broadcast a lane (compile-time constant) to all lanes
+#define f4_splat(src, lane) vdupq_n_f32(vgetq_lane_f32((src), lane))
+
+// Reorder lanes: result = (src[x], src[y], src[z], src[w]) for compile-time constants
+#define f4_swizzle(src, x, y, z, w) \
+    f4_set(vgetq_lane_f32((src), x), vgetq_lane_f32((src), y), vgetq_lane_f32((src), z), vgetq_lane_f32((src), w))
+
+#define f4_transpose(r0, r1, r2, r3) { \
+    float32x4x2_t t01 = vtrnq_f32(r0, r1); \
+    float32x4x2_t t23 = vtrnq_f32(r2, r3); \
+    r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])); \
+    r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])); \
+    r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])); \
+    r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])); \
+}
+
+#else // VMATH_SIMD_SCALAR
+
+typedef struct f4 { float v[4]; } f4;
+
+VMATH_INLINE f4 f4_load(const float* p) { f4 r = { { p[0], p[1], p[2], p[3] } }; return r; }
+VMATH_INLINE void f4_store(float* p, f4 v) { p[0] = v.v[0]; p[1] = v.v[1]; p[2] = v.v[2]; p[3] = v.v[3]; }
+VMATH_INLINE f4 f4_set(float x, float y, float z, float w) { f4 r = { { x, y, z, w } }; return r; }
+VMATH_INLINE f4 f4_set1(float f) { f4 r = { { f, f, f, f } }; return r; }
+VMATH_INLINE f4 f4_zero() { return f4_set1(0.f); }
+
+VMATH_INLINE f4 f4_add(f4 a, f4 b)
+{
+    return f4_set(a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]);
+}
+
+VMATH_INLINE f4 f4_sub(f4 a, f4 b)
+{
+    return f4_set(a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]);
+}
+
+VMATH_INLINE f4 f4_mul(f4 a, f4 b)
+{
+    return f4_set(a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]);
+}
+
+VMATH_INLINE f4 f4_div(f4 a, f4 b)
+{
+    return f4_set(a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]);
+}
+
+VMATH_INLINE f4 f4_sqrt(f4 a)
+{
+    return f4_set(sqrtf(a.v[0]), sqrtf(a.v[1]), sqrtf(a.v[2]), sqrtf(a.v[3]));
+}
+
+VMATH_INLINE f4 f4_rsqrt(f4 a)
+{
+    return f4_set(1.f / sqrtf(a.v[0]), 1.f / sqrtf(a.v[1]), 1.f / sqrtf(a.v[2]), 1.f / sqrtf(a.v[3]));
+}
+
+// a * b + c
+VMATH_INLINE f4 f4_madd(f4 a, f4 b, f4 c)
+{
+    return f4_set(a.v[0] * b.v[0] + c.v[0], a.v[1] * b.v[1] + c.v[1],
+                  a.v[2] * b.v[2] + c.v[2], a.v[3] * b.v[3] + c.v[3]);
+}
+
+// Lane masks: non-zero where the comparison holds
+VMATH_INLINE f4 f4_cmpgt(f4 a, f4 b)
+{
+    return f4_set(a.v[0] > b.v[0], a.v[1] > b.v[1], a.v[2] > b.v[2], a.v[3] > b.v[3]);
+}
+
+VMATH_INLINE f4 f4_select(f4 mask, f4 a, f4 b)
+{
+    return f4_set(mask.v[0] != 0.f ? a.v[0] : b.v[0], mask.v[1] != 0.f ? a.v[1] : b.v[1],
+                  mask.v[2] != 0.f ? a.v[2] : b.v[2], mask.v[3] != 0.f ? a.v[3] : b.v[3]);
+}
+
+// One bit per lane, lane 0 in bit 0
+VMATH_INLINE int f4_movemask(f4 mask)
+{
+    return (mask.v[0] != 0.f) | ((mask.v[1] != 0.f) << 1) | ((mask.v[2] != 0.f) << 2) | ((mask.v[3] != 0.f) << 3);
+}
+
+VMATH_INLINE f4 f4_min(f4 a, f4 b)
+{
+    return f4_set(a.v[0] < b.v[0] ? a.v[0] : b.v[0], a.v[1] < b.v[1] ? a.v[1] : b.v[1],
+                  a.v[2] < b.v[2] ? a.v[2] : b.v[2], a.v[3] < b.v[3] ? a.v[3] : b.v[3]);
+}
+
+VMATH_INLINE float f4_first(f4 v) { return v.v[0]; }
+
+// Broadcast a lane to all lanes
+#define f4_splat(src, lane) f4_set1((src).v[lane])
+
+// Reorder lanes: result = (src[x], src[y], src[z], src[w])
+#define f4_swizzle(src, x, y, z, w) f4_set((src).v[x], (src).v[y], (src).v[z], (src).v[w])
+
+#define f4_transpose(r0, r1, r2, r3) { \
+    f4 t0 = r0, t1 = r1, t2 = r2, t3 = r3; \
+    r0 = f4_set(t0.v[0], t1.v[0], t2.v[0], t3.v[0]); \
+    r1 = f4_set(t0.v[1], t1.v[1], t2.v[1], t3.v[1]); \
+    r2 = f4_set(t0.v[2], t1.v[2], t2.v[2], t3.v[2]); \
+    r3 = f4_set(t0.v[3], t1.v[3], t2.v[3], t3.v[3]); \
+}
+
+#endif
+
+// WIDE FLOAT TYPE ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Widest native vector, used by the structure-of-arrays batch kernels (VMATH_LANES floats per register)
+
+#if defined(VMATH_SIMD_AVX2)
+
+#define VMATH_LANES 8
+
+typedef __m256 fw;
+
+VMATH_INLINE fw fw_load(const float* p) { return _mm256_loadu_ps(p); }
+VMATH_INLINE void fw_store(float* p, fw v) { _mm256_storeu_ps(p, v); }
+VMATH_INLINE fw fw_set1(float f) { return _mm256_set1_ps(f); }
+VMATH_INLINE fw fw_add(fw a, fw b) { return _mm256_add_ps(a, b); }
+VMATH_INLINE fw fw_sub(fw a, fw b) { return _mm256_sub_ps(a, b); }
+VMATH_INLINE fw fw_mul(fw a, fw b) { return _mm256_mul_ps(a, b); }
+VMATH_INLINE fw fw_div(fw a, fw b) { return _mm256_div_ps(a, b); }
+VMATH_INLINE fw fw_rsqrt(fw a) { return _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_sqrt_ps(a)); }
+VMATH_INLINE fw fw_cmpgt(fw a, fw b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+VMATH_INLINE fw fw_select(fw mask, fw a, fw b) { return _mm256_blendv_ps(b, a, mask); }
+VMATH_INLINE int fw_movemask(fw mask) { return _mm256_movemask_ps(mask); }
+VMATH_INLINE fw fw_min(fw a, fw b) { return _mm256_min_ps(a, b); }
+
+#if defined(__FMA__)
+VMATH_INLINE fw fw_madd(fw a, fw b, fw c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+VMATH_INLINE fw fw_madd(fw a, fw b, fw c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+
+#else
+
+#define VMATH_LANES 4
+
+typedef f4 fw;
+
+VMATH_INLINE fw fw_load(const float* p) { return f4_load(p); }
+VMATH_INLINE void fw_store(float* p, fw v) { f4_store(p, v); }
+VMATH_INLINE fw fw_set1(float f) { return f4_set1(f); }
+VMATH_INLINE fw fw_add(fw a, fw b) { return f4_add(a, b); }
+VMATH_INLINE fw fw_sub(fw a, fw b) { return f4_sub(a, b); }
+VMATH_INLINE fw fw_mul(fw a, fw b) { return f4_mul(a, b); }
+VMATH_INLINE fw fw_div(fw a, fw b) { return f4_div(a, b); }
+VMATH_INLINE fw fw_rsqrt(fw a) { return f4_rsqrt(a); }
+VMATH_INLINE fw fw_cmpgt(fw a, fw b) { return f4_cmpgt(a, b); }
+VMATH_INLINE fw fw_select(fw mask, fw a, fw b) { return f4_select(mask, a, b); }
+VMATH_INLINE int fw_movemask(fw mask) { return f4_movemask(mask); }
+VMATH_INLINE fw fw_min(fw a, fw b) { return f4_min(a, b); }
+VMATH_INLINE fw fw_madd(fw a, fw b, fw c) { return f4_madd(a, b, c); }
+
+#endif
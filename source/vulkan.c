@@ -1,5 +1,24 @@
 #include "vulkan.h"
 
+// True if any queue family of the device can dispatch compute work
+static bool HasComputeQueue(VkPhysicalDevice device)
+{
+    uint queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, NULL);
+    if (queue_family_count == 0) {
+        return false;
+    }
+    
+    VkQueueFamilyProperties queue_families[queue_family_count];
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_families);
+    for (uint i = 0; i < queue_family_count; i++) {
+        if (queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Helper function to score a physical device based on its properties and features
 static int ScorePhysicalDevice(VkPhysicalDevice device, VkPhysicalDeviceProperties properties,
                              VkPhysicalDeviceFeatures features,
@@ -19,9 +38,8 @@ static int ScorePhysicalDevice(VkPhysicalDevice device, VkPhysicalDeviceProperti
         return -1;  // Disqualify this GPU
     }
     
-    if (prefs->requireComputeShader && !(VK_QUEUE_COMPUTE_BIT & 1)) {
-        // This is a simplification - you'd need to check queue properties more thoroughly
-        return -1;
+    if (prefs->requireComputeShader && !HasComputeQueue(device)) {
+        return -1;  // Disqualify this GPU
     }
     
     // Check for specifically named GPU if that mode is active
@@ -107,10 +125,13 @@ static int ScorePhysicalDevice(VkPhysicalDevice device, VkPhysicalDeviceProperti
 
 // Helper function to find queue families on a physical device
 static bool FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface, 
-                            uint* graphicsQueueFamily, uint* presentQueueFamily)
+                            uint* graphicsQueueFamily, uint* presentQueueFamily,
+                            uint* transferQueueFamily, uint* computeQueueFamily)
 {
     *graphicsQueueFamily = UINT_MAX;
     *presentQueueFamily = UINT_MAX;
+    *transferQueueFamily = UINT_MAX;
+    *computeQueueFamily = UINT_MAX;
     
     uint queue_family_count = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, NULL);
@@ -125,9 +146,13 @@ static bool FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface,
             *graphicsQueueFamily = i;
         }
         
-        // Check for presentation support
+        // Check for presentation support; without a surface (headless) graphics stands in for present
         VkBool32 present_support = VK_FALSE;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+        if (surface) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+        } else {
+            present_support = (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        }
         
         if (present_support) {
             *presentQueueFamily = i;
@@ -139,6 +164,45 @@ static bool FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface,
         }
     }
     
+    // Uploads prefer a pure copy engine (transfer only), then any non-graphics family that can copy,
+    // so streaming runs beside rendering. Graphics queues always support transfers as a fallback.
+    int best_transfer_score = 0;
+    for (uint i = 0; i < queue_family_count; i++) {
+        VkQueueFlags flags = queue_families[i].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+            continue;
+        }
+        int score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+        if (score > best_transfer_score) {
+            best_transfer_score = score;
+            *transferQueueFamily = i;
+        }
+    }
+    if (*transferQueueFamily == UINT_MAX) {
+        *transferQueueFamily = *graphicsQueueFamily;
+    }
+    
+    // Async compute wants a compute family without graphics so dispatches overlap rendering, preferably
+    // not the one uploads already use. Otherwise compute shares a family that has graphics.
+    for (uint i = 0; i < queue_family_count; i++) {
+        VkQueueFlags flags = queue_families[i].queueFlags;
+        if (!(flags & VK_QUEUE_COMPUTE_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+            continue;
+        }
+        if (*computeQueueFamily == UINT_MAX || *computeQueueFamily == *transferQueueFamily) {
+            *computeQueueFamily = i;
+        }
+    }
+    if (*computeQueueFamily == UINT_MAX && *graphicsQueueFamily != UINT_MAX &&
+        (queue_families[*graphicsQueueFamily].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+        *computeQueueFamily = *graphicsQueueFamily;
+    }
+    for (uint i = 0; i < queue_family_count && *computeQueueFamily == UINT_MAX; i++) {
+        if (queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) {
+            *computeQueueFamily = i;
+        }
+    }
+    
     // To be suitable, the device must support both graphics and presentation
     return (*graphicsQueueFamily != UINT_MAX && *presentQueueFamily != UINT_MAX);
 }
@@ -211,10 +275,12 @@ bool VulkanSelectPhysicalDevice(Vulkan* vk)
         PrintDeviceCapabilities(GPU[i], properties, features, i);
 
         // First check if the device supports the required queue families
-        uint graphics_queue_family, present_queue_family;
+        uint graphics_queue_family, present_queue_family, transfer_queue_family, compute_queue_family;
         bool has_required_queue_support = FindQueueFamilies(GPU[i], vk->surface, 
                                                       &graphics_queue_family, 
-                                                      &present_queue_family);
+                                                      &present_queue_family,
+                                                      &transfer_queue_family,
+                                                      &compute_queue_family);
 
         if (has_required_queue_support) {
             // Calculate score for this device
@@ -242,15 +308,29 @@ bool VulkanSelectPhysicalDevice(Vulkan* vk)
         // Find queue family indices for the selected GPU
         bool found_queues = FindQueueFamilies(vk->gpu, vk->surface, 
                                           &vk->graphicsQueueFamily, 
-                                          &vk->presentQueueFamily);
+                                          &vk->presentQueueFamily,
+                                          &vk->transferQueueFamily,
+                                          &vk->computeQueueFamily);
         
         if (!found_queues) {
             PRINT_ERROR("Vulkan: Failed to find queue families on selected GPU\n");
             return false;
         }
         
+        // GPU profiling converts timestamps with these
+        uint queue_family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(vk->gpu, &queue_family_count, NULL);
+        VkQueueFamilyProperties queue_families[queue_family_count];
+        vkGetPhysicalDeviceQueueFamilyProperties(vk->gpu, &queue_family_count, queue_families);
+        vk->timestampPeriod = properties.limits.timestampPeriod;
+        vk->timestampValidBits = queue_families[vk->graphicsQueueFamily].timestampValidBits;
+        
         PRINT("Vulkan: Graphics queue family: %u\n", vk->graphicsQueueFamily);
         PRINT("Vulkan: Present queue family: %u\n", vk->presentQueueFamily);
+        PRINT("Vulkan: Transfer queue family: %u%s\n", vk->transferQueueFamily,
+              vk->transferQueueFamily == vk->graphicsQueueFamily ? " (shared with graphics)" : "");
+        PRINT("Vulkan: Compute queue family: %u%s\n", vk->computeQueueFamily,
+              vk->computeQueueFamily == vk->graphicsQueueFamily ? " (shared with graphics)" : " (async)");
         return true;
     } else {
         PRINT_ERROR("Vulkan: Failed to find a suitable GPU\n");
@@ -258,13 +338,73 @@ bool VulkanSelectPhysicalDevice(Vulkan* vk)
     }
 }
 
-void VulkanInit(Vulkan* vk, Window* wnd)
+// Everything between the instance and the presentation targets, shared by the windowed and headless paths
+static bool VulkanInitDevice(Vulkan* vk)
+{
+    // Select physical device (GPU)
+    if (!VulkanSelectPhysicalDevice(vk)) {
+        PRINT("Vulkan: Failed to find a suitable GPU\n");
+        return false;
+    }
+    
+    // Create logical device with default features
+    if (!VulkanCreateLogicalDevice(vk, NULL)) {
+        PRINT("Vulkan: Failed to create logical device\n");
+        return false;
+    }
+
+    // Device memory allocator
+    if (!VulkanMemoryInit(&vk->memory, vk->gpu, vk->device)) {
+        PRINT("Vulkan: Failed to create memory allocator\n");
+        return false;
+    }
+
+    // Upload path; completion tracking needs timeline semaphores
+    if (!vk->features12.timelineSemaphore) {
+        PRINT_WARNING("Vulkan: Timeline semaphores not supported, uploads disabled\n");
+    } else if (!VulkanUploaderInit(&vk->uploader, &vk->memory, vk->device, vk->transferQueue,
+                                   vk->transferQueueFamily, vk->graphicsQueueFamily, VULKAN_UPLOAD_RING_SIZE)) {
+        PRINT("Vulkan: Failed to create uploader\n");
+        return false;
+    }
+
+    // Compute hands results to graphics through timeline values as well
+    if (vk->features12.timelineSemaphore &&
+        !VulkanComputeInit(&vk->compute, vk->device, vk->computeQueue, vk->computeQueueFamily, vk->graphicsQueueFamily,
+                           VULKAN_MAX_FRAMES_IN_FLIGHT)) {
+        PRINT("Vulkan: Failed to create compute queue submission\n");
+        return false;
+    }
+
+    // One descriptor set for every texture and buffer, when asked for and supported
+    if (vk->features12.descriptorIndexing &&
+        !VulkanBindlessInit(&vk->bindless, vk->gpu, vk->device, VULKAN_MAX_FRAMES_IN_FLIGHT, vk->maxSamplerAnisotropy)) {
+        PRINT("Vulkan: Failed to create bindless descriptor set\n");
+        return false;
+    }
+
+    // Pipelines compiled in earlier runs
+    if (!VulkanPipelineCacheInit(&vk->pipelineCache, vk->gpu, vk->device, VULKAN_PIPELINE_CACHE_FILE,
+                                 vk->pipelineCreationFeedback)) {
+        PRINT("Vulkan: Failed to create pipeline cache\n");
+        return false;
+    }
+
+    return true;
+}
+
+void VulkanInit(Vulkan* vk, Window* wnd, uint32_t frames_in_flight)
 {
     PRINT_DEBUG("Vulkan: initializing...\n");
     
     // Initialize default GPU preferences
     VulkanInitDefaultGpuPreferences(&vk->gpuPreferences);
 
+    if (!ArenaInit(&vk->arena, 64 * 1024, "vulkan")) {
+        PRINT("Vulkan: Failed to create allocation arena\n");
+        return;
+    }
+
     // Create vulkan instance
     if (!VulkanCreateInstance(vk, "ZXEngine", VK_MAKE_VERSION(0, 1, 0))) {
         PRINT("Vulkan: Failed to create instance\n");
@@ -277,15 +417,8 @@ void VulkanInit(Vulkan* vk, Window* wnd)
         return;
     }
 
-    // Select physical device (GPU)
-    if (!VulkanSelectPhysicalDevice(vk)) {
-        PRINT("Vulkan: Failed to find a suitable GPU\n");
-        return;
-    }
-    
-    // Create logical device with default features
-    if (!VulkanCreateLogicalDevice(vk, NULL)) {
-        PRINT("Vulkan: Failed to create logical device\n");
+    // GPU, logical device, memory and uploads
+    if (!VulkanInitDevice(vk)) {
         return;
     }
     
@@ -294,10 +427,52 @@ void VulkanInit(Vulkan* vk, Window* wnd)
         PRINT("Vulkan: Failed to create swapchain\n");
         return;
     }
+
+    // Command buffers and synchronization for the frames the GPU may trail behind
+    if (!VulkanCreateFrames(vk, frames_in_flight)) {
+        PRINT("Vulkan: Failed to create frame resources\n");
+        return;
+    }
     
     PRINT_INFO("Vulkan: ON\n");
 }
 
+bool VulkanInitHeadless(Vulkan* vk, uint32_t width, uint32_t height, uint32_t frames_in_flight)
+{
+    PRINT_DEBUG("Vulkan: initializing headless...\n");
+
+    vk->headless = true;
+    VulkanInitDefaultGpuPreferences(&vk->gpuPreferences);
+
+    if (!ArenaInit(&vk->arena, 64 * 1024, "vulkan")) {
+        PRINT("Vulkan: Failed to create allocation arena\n");
+        return false;
+    }
+
+    if (!VulkanCreateInstance(vk, "ZXEngine", VK_MAKE_VERSION(0, 1, 0))) {
+        PRINT("Vulkan: Failed to create instance\n");
+        return false;
+    }
+
+    if (!VulkanInitDevice(vk)) {
+        return false;
+    }
+
+    if (!VulkanCreateFrames(vk, frames_in_flight)) {
+        PRINT("Vulkan: Failed to create frame resources\n");
+        return false;
+    }
+
+    // One offscreen target per frame in flight stands in for the swapchain images
+    if (!VulkanCreateOffscreenTargets(vk, width, height)) {
+        PRINT("Vulkan: Failed to create offscreen targets\n");
+        return false;
+    }
+
+    PRINT_INFO("Vulkan: ON (headless, %ux%u)\n", width, height);
+    return true;
+}
+
 
 
 void VulkanInitDefaultGpuPreferences(VulkanGpuPreferences* prefs)
@@ -352,7 +527,7 @@ static bool CheckValidationLayerSupport(const char** requested_layers, uint32_t
 }
 
 // Get required instance extensions
-static void GetRequiredExtensions(const char*** extensions, uint32_t* extension_count) {
+static void GetRequiredExtensions(bool headless, const char*** extensions, uint32_t* extension_count) {
     // Base extensions needed
     static const char* base_extensions[] = {
         VK_KHR_SURFACE_EXTENSION_NAME,
@@ -377,6 +552,20 @@ static void GetRequiredExtensions(const char*** extensions, uint32_t* extension_
     *extensions = base_extensions;
     *extension_count = sizeof(base_extensions) / sizeof(base_extensions[0]);
     #endif
+    
+    // Offscreen rendering needs no window system integration
+    if (headless) {
+    #ifdef _DEBUG
+        static const char* headless_extensions[] = {
+            VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+        };
+        *extensions = headless_extensions;
+        *extension_count = sizeof(headless_extensions) / sizeof(headless_extensions[0]);
+    #else
+        *extensions = NULL;
+        *extension_count = 0;
+    #endif
+    }
 }
 
 bool VulkanCreateInstance(Vulkan* vk, const char* app_name, uint32_t app_version) {
@@ -399,9 +588,29 @@ bool VulkanCreateInstance(Vulkan* vk, const char* app_name, uint32_t app_version
     #endif
     
     // Get required extensions
-    const char** extensions;
-    uint32_t extension_count;
-    GetRequiredExtensions(&extensions, &extension_count);
+    const char** required_extensions;
+    uint32_t required_count;
+    GetRequiredExtensions(vk->headless, &required_extensions, &required_count);
+    
+    // Debug utils labels show up in GPU captures and profiles; enabled in every build the loader offers it
+    const char* extensions[required_count + 1];
+    uint32_t extension_count = 0;
+    for (uint32_t i = 0; i < required_count; i++) {
+        extensions[extension_count++] = required_extensions[i];
+        vk->debugUtils |= strcmp(required_extensions[i], VK_EXT_DEBUG_UTILS_EXTENSION_NAME) == 0;
+    }
+    if (!vk->debugUtils) {
+        uint32_t available_count = 0;
+        vkEnumerateInstanceExtensionProperties(NULL, &available_count, NULL);
+        VkExtensionProperties available[available_count + 1];
+        vkEnumerateInstanceExtensionProperties(NULL, &available_count, available);
+        for (uint32_t i = 0; i < available_count && !vk->debugUtils; i++) {
+            vk->debugUtils = strcmp(available[i].extensionName, VK_EXT_DEBUG_UTILS_EXTENSION_NAME) == 0;
+        }
+        if (vk->debugUtils) {
+            extensions[extension_count++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+        }
+    }
     
     // Application info
     VkApplicationInfo app_info = {
@@ -429,6 +638,13 @@ bool VulkanCreateInstance(Vulkan* vk, const char* app_name, uint32_t app_version
     // Create the instance
     VKCALL(vkCreateInstance(&instance_info, NULL, &vk->instance), "vkCreateInstance");
     
+    if (vk->debugUtils) {
+        vk->cmdBeginDebugUtilsLabel =
+            (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(vk->instance, "vkCmdBeginDebugUtilsLabelEXT");
+        vk->cmdEndDebugUtilsLabel =
+            (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(vk->instance, "vkCmdEndDebugUtilsLabelEXT");
+    }
+    
     // Additional debug features could be set up here in the future
     // (Debug messenger, etc.)
     
@@ -459,6 +675,24 @@ bool VulkanCreateSurface(Vulkan* vk, Window* wnd)
     return true;
 }
 
+static bool HasDeviceExtension(VkPhysicalDevice gpu, const char* name)
+{
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(gpu, NULL, &count, NULL);
+    if (count == 0) {
+        return false;
+    }
+    
+    VkExtensionProperties extensions[count];
+    vkEnumerateDeviceExtensionProperties(gpu, NULL, &count, extensions);
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(extensions[i].extensionName, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool VulkanCreateLogicalDevice(Vulkan* vk, const VkPhysicalDeviceFeatures* enabled_features)
 {
     // Check if we have valid queue family indices
@@ -469,7 +703,8 @@ bool VulkanCreateLogicalDevice(Vulkan* vk, const VkPhysicalDeviceFeatures* enabl
 
     // Setup queue create infos
     const float queue_priority = 1.0f;
-    VkDeviceQueueCreateInfo queue_create_infos[2];
+    const float queue_priorities[2] = { 1.0f, 1.0f };
+    VkDeviceQueueCreateInfo queue_create_infos[4];
     uint queue_create_info_count = 0;
     
     // Always add graphics queue
@@ -492,6 +727,42 @@ bool VulkanCreateLogicalDevice(Vulkan* vk, const VkPhysicalDeviceFeatures* enabl
         queue_create_infos[queue_create_info_count++] = present_queue_info;
     }
     
+    // Add transfer queue only if it has a family of its own
+    if (vk->transferQueueFamily != vk->graphicsQueueFamily && vk->transferQueueFamily != vk->presentQueueFamily) {
+        VkDeviceQueueCreateInfo transfer_queue_info = {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = vk->transferQueueFamily,
+            .queueCount = 1,
+            .pQueuePriorities = &queue_priority
+        };
+        queue_create_infos[queue_create_info_count++] = transfer_queue_info;
+    }
+    
+    // Add compute queue if it has a family of its own. Sharing the copy family, it gets a second queue
+    // there when the family has one, so uploads and dispatches do not serialize on one queue.
+    vk->computeQueueIndex = 0;
+    if (vk->computeQueueFamily != vk->graphicsQueueFamily && vk->computeQueueFamily != vk->presentQueueFamily) {
+        if (vk->computeQueueFamily != vk->transferQueueFamily) {
+            VkDeviceQueueCreateInfo compute_queue_info = {
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .queueFamilyIndex = vk->computeQueueFamily,
+                .queueCount = 1,
+                .pQueuePriorities = &queue_priority
+            };
+            queue_create_infos[queue_create_info_count++] = compute_queue_info;
+        } else {
+            uint queue_family_count = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(vk->gpu, &queue_family_count, NULL);
+            VkQueueFamilyProperties queue_families[queue_family_count];
+            vkGetPhysicalDeviceQueueFamilyProperties(vk->gpu, &queue_family_count, queue_families);
+            if (queue_families[vk->computeQueueFamily].queueCount > 1) {
+                queue_create_infos[queue_create_info_count - 1].queueCount = 2;
+                queue_create_infos[queue_create_info_count - 1].pQueuePriorities = queue_priorities;
+                vk->computeQueueIndex = 1;
+            }
+        }
+    }
+    
     // Setup device features
     VkPhysicalDeviceFeatures device_features = {0};
     if (enabled_features) {
@@ -511,28 +782,115 @@ bool VulkanCreateLogicalDevice(Vulkan* vk, const VkPhysicalDeviceFeatures* enabl
         if (available_features.textureCompressionBC) {
             device_features.textureCompressionBC = VK_TRUE;
         }
+        
+        // GPU-driven rendering: many indirect draws per call, each addressing its instance via firstInstance
+        device_features.multiDrawIndirect = available_features.multiDrawIndirect;
+        device_features.drawIndirectFirstInstance = available_features.drawIndirectFirstInstance;
+    }
+    
+    // Vulkan 1.2 features: timeline semaphores track upload completion
+    VkPhysicalDeviceVulkan12Features available_features12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+    };
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(vk->gpu, &properties);
+    if (properties.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceFeatures2 features2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &available_features12
+        };
+        vkGetPhysicalDeviceFeatures2(vk->gpu, &features2);
     }
     
-    // Required device extensions
-    const char* device_extensions[] = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME  // Swapchain is required for presenting to surfaces
+    VkPhysicalDeviceVulkan12Features enabled_features12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .drawIndirectCount = available_features12.drawIndirectCount,
+        .timelineSemaphore = available_features12.timelineSemaphore
     };
     
+    // Opt-in bindless: descriptor indexing with update-after-bind sampled image and storage buffer arrays
+    if (vk->bindlessRequested) {
+        if (available_features12.descriptorIndexing &&
+            available_features12.runtimeDescriptorArray &&
+            available_features12.descriptorBindingPartiallyBound &&
+            available_features12.descriptorBindingUpdateUnusedWhilePending &&
+            available_features12.descriptorBindingSampledImageUpdateAfterBind &&
+            available_features12.descriptorBindingStorageBufferUpdateAfterBind &&
+            available_features12.shaderSampledImageArrayNonUniformIndexing) {
+            enabled_features12.descriptorIndexing = VK_TRUE;
+            enabled_features12.runtimeDescriptorArray = VK_TRUE;
+            enabled_features12.descriptorBindingPartiallyBound = VK_TRUE;
+            enabled_features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            enabled_features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            enabled_features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            enabled_features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            enabled_features12.shaderStorageBufferArrayNonUniformIndexing =
+                available_features12.shaderStorageBufferArrayNonUniformIndexing;
+        } else {
+            PRINT_WARNING("Vulkan: Descriptor indexing not supported, bindless mode disabled\n");
+        }
+    }
+    vk->features12 = enabled_features12;
+    
+    // Optional: synchronization2 barriers for the render graph (core only in 1.3)
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR
+    };
+    if (properties.apiVersion >= VK_API_VERSION_1_2 &&
+        HasDeviceExtension(vk->gpu, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 features2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &sync2_features
+        };
+        vkGetPhysicalDeviceFeatures2(vk->gpu, &features2);
+    }
+    vk->synchronization2 = sync2_features.synchronization2 == VK_TRUE;
+    
+    // Device extensions
+    const char* device_extensions[4];
+    uint32_t device_extension_count = 0;
+    if (!vk->headless) {
+        device_extensions[device_extension_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;  // Required for presenting to surfaces
+    }
+    
+    // Optional: lets the pipeline cache tell hits from misses
+    vk->pipelineCreationFeedback = HasDeviceExtension(vk->gpu, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    if (vk->pipelineCreationFeedback) {
+        device_extensions[device_extension_count++] = VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME;
+    }
+    if (vk->synchronization2) {
+        device_extensions[device_extension_count++] = VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME;
+        vk->features12.pNext = &sync2_features;     // Only for vkCreateDevice, the struct is a local
+    }
+    
     // Create the logical device
     VkDeviceCreateInfo device_create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = properties.apiVersion >= VK_API_VERSION_1_2 ? &vk->features12 : NULL,
         .queueCreateInfoCount = queue_create_info_count,
         .pQueueCreateInfos = queue_create_infos,
-        .enabledExtensionCount = ARRAYSIZE(device_extensions),
+        .enabledExtensionCount = device_extension_count,
         .ppEnabledExtensionNames = device_extensions,
         .pEnabledFeatures = &device_features
     };
     
     VKCALL(vkCreateDevice(vk->gpu, &device_create_info, NULL, &vk->device), "vkCreateDevice");
+    vk->features12.pNext = NULL;
+    
+    if (vk->synchronization2) {
+        vk->cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr(vk->device, "vkCmdPipelineBarrier2KHR");
+        vk->synchronization2 = vk->cmdPipelineBarrier2 != NULL;
+    }
+    
+    vk->maxSamplerAnisotropy = device_features.samplerAnisotropy ? properties.limits.maxSamplerAnisotropy : 0.0f;
+    vk->multiDrawIndirect = device_features.multiDrawIndirect && device_features.drawIndirectFirstInstance;
+    vk->maxDrawIndirectCount = device_features.multiDrawIndirect ? properties.limits.maxDrawIndirectCount : 1;
     
     // Get queue handles
     vkGetDeviceQueue(vk->device, vk->graphicsQueueFamily, 0, &vk->graphicsQueue);
     vkGetDeviceQueue(vk->device, vk->presentQueueFamily, 0, &vk->presentQueue);
+    vkGetDeviceQueue(vk->device, vk->transferQueueFamily, 0, &vk->transferQueue);
+    vkGetDeviceQueue(vk->device, vk->computeQueueFamily, vk->computeQueueIndex, &vk->computeQueue);
     
     PRINT("Vulkan: Logical device created successfully\n");
     return true;
@@ -609,6 +967,96 @@ static VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR* capabilities,
     }
 }
 
+// Creates a color view for each of vk->swapchainImages
+static bool CreateSwapchainImageViews(Vulkan* vk)
+{
+    for (uint32_t i = 0; i < vk->swapchainImageCount; i++) {
+        VkImageViewCreateInfo image_view_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = vk->swapchainImages[i],
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = vk->swapchainImageFormat,
+            .components = {
+                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .a = VK_COMPONENT_SWIZZLE_IDENTITY
+            },
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+        
+        VKCALL(vkCreateImageView(vk->device, &image_view_info, NULL, &vk->swapchainImageViews[i]),
+               "vkCreateImageView");
+    }
+    
+    return true;
+}
+
+// Destroys the views and semaphores of a swapchain along with the swapchain itself
+static void DestroySwapchainObjects(Vulkan* vk, VkSwapchainKHR swapchain, const VkImageView* views,
+                                    const VkSemaphore* semaphores, uint32_t image_count)
+{
+    for (uint32_t i = 0; i < image_count; i++) {
+        if (semaphores && semaphores[i]) {
+            vkDestroySemaphore(vk->device, semaphores[i], NULL);
+        }
+        if (views && views[i]) {
+            vkDestroyImageView(vk->device, views[i], NULL);
+        }
+    }
+    if (swapchain) {
+        vkDestroySwapchainKHR(vk->device, swapchain, NULL);
+    }
+}
+
+// Destroys retired swapchains whose frames have all completed, or every one of them when all is set
+// (the caller has made sure the device is idle)
+static void ReleaseRetiredSwapchains(Vulkan* vk, bool all)
+{
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < vk->retiredSwapchainCount; i++) {
+        VulkanRetiredSwapchain* retired = &vk->retiredSwapchains[i];
+        if (all || vk->frameNumber >= retired->retireFrame) {
+            DestroySwapchainObjects(vk, retired->swapchain, retired->imageViews, retired->renderFinished,
+                                    retired->imageCount);
+        } else {
+            vk->retiredSwapchains[kept++] = *retired;
+        }
+    }
+    vk->retiredSwapchainCount = kept;
+}
+
+// Moves the current views and semaphores over to old_swapchain's retirement entry. Frames up to
+// frameNumber - 1 may still reference them; they are done by the time frame frameNumber + framesInFlight
+// - 1 has waited on its slot, and one more frame covers the presents queued behind them.
+static void RetireSwapchain(Vulkan* vk, VkSwapchainKHR old_swapchain)
+{
+    uint32_t image_count = vk->swapchainImages ? vk->swapchainImageCount : 0;
+    
+    if (vk->retiredSwapchainCount == VULKAN_MAX_RETIRED_SWAPCHAINS || image_count > VULKAN_MAX_SWAPCHAIN_IMAGES) {
+        // Nowhere to park it: fall back to waiting for the GPU
+        vkDeviceWaitIdle(vk->device);
+        ReleaseRetiredSwapchains(vk, true);
+        DestroySwapchainObjects(vk, old_swapchain, vk->swapchainImageViews, vk->swapchainRenderFinished, image_count);
+        return;
+    }
+    
+    VulkanRetiredSwapchain* retired = &vk->retiredSwapchains[vk->retiredSwapchainCount++];
+    retired->swapchain = old_swapchain;
+    retired->imageCount = image_count;
+    retired->retireFrame = vk->frameNumber + vk->framesInFlight;
+    for (uint32_t i = 0; i < image_count; i++) {
+        retired->imageViews[i] = vk->swapchainImageViews[i];
+        retired->renderFinished[i] = vk->swapchainRenderFinished[i];
+    }
+}
+
 bool VulkanCreateSwapchain(Vulkan* vk, VulkanPresentMode preferred_mode) {
     // 1. Query details of the surface
     VkSurfaceCapabilitiesKHR surface_capabilities;
@@ -682,12 +1130,13 @@ bool VulkanCreateSwapchain(Vulkan* vk, VulkanPresentMode preferred_mode) {
         .imageColorSpace = surface_format.colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1, // More for stereoscopic 3D
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                      (surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT),
         .preTransform = surface_capabilities.currentTransform,
         .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
         .presentMode = present_mode,
         .clipped = VK_TRUE,
-        .oldSwapchain = VK_NULL_HANDLE
+        .oldSwapchain = vk->swapchain   // Lets the driver hand over resources and keeps presentation going
     };
     
     // Handle queue family sharing
@@ -706,46 +1155,56 @@ bool VulkanCreateSwapchain(Vulkan* vk, VulkanPresentMode preferred_mode) {
     }
     
     // Create the swapchain
+    VkSwapchainKHR old_swapchain = vk->swapchain;
     VKCALL(vkCreateSwapchainKHR(vk->device, &swapchain_create_info, NULL, &vk->swapchain),
            "vkCreateSwapchainKHR");
     
+    // The old swapchain is retired now; its images may still be in use by frames in flight
+    if (old_swapchain) {
+        RetireSwapchain(vk, old_swapchain);
+    }
+    
     // Store swapchain format and extent
     vk->swapchainImageFormat = surface_format.format;
     vk->swapchainExtent = extent;
+    vk->swapchainImageUsage = swapchain_create_info.imageUsage;
+    vk->presentMode = preferred_mode;
+    vk->swapchainDirty = false;
+    vk->swapchainSuboptimal = false;
     
-    // 4. Retrieve swapchain images
+    // 4. Retrieve swapchain images; the arrays are kept when the image count has not changed
+    uint32_t image_count_old = vk->swapchainImages ? vk->swapchainImageCount : 0;
     vkGetSwapchainImagesKHR(vk->device, vk->swapchain, &vk->swapchainImageCount, NULL);
-    vk->swapchainImages = malloc(vk->swapchainImageCount * sizeof(VkImage));
+    if (vk->swapchainImageCount != image_count_old) {
+        if (vk->swapchainImages) {
+            ArenaRewind(&vk->arena, vk->swapchainMarker);
+        }
+        vk->swapchainMarker = ArenaMark(&vk->arena);
+        vk->swapchainImages = ARENA_NEW(&vk->arena, VkImage, vk->swapchainImageCount);
+        vk->swapchainImageViews = ARENA_NEW(&vk->arena, VkImageView, vk->swapchainImageCount);
+        vk->swapchainRenderFinished = ARENA_NEW(&vk->arena, VkSemaphore, vk->swapchainImageCount);
+        if (!vk->swapchainImages || !vk->swapchainImageViews || !vk->swapchainRenderFinished) {
+            PRINT_ERROR("Vulkan: Out of memory for %u swapchain images\n", vk->swapchainImageCount);
+            return false;
+        }
+    }
     
     VKCALL(vkGetSwapchainImagesKHR(vk->device, vk->swapchain, &vk->swapchainImageCount, vk->swapchainImages),
            "vkGetSwapchainImagesKHR");
     
     // 5. Create image views for all swapchain images
-    vk->swapchainImageViews = malloc(vk->swapchainImageCount * sizeof(VkImageView));
+    if (!CreateSwapchainImageViews(vk)) {
+        return false;
+    }
     
+    // 6. One render-finished semaphore per image: presentation keeps waiting on it until that image
+    //    is acquired again, which frame slots do not line up with
     for (uint32_t i = 0; i < vk->swapchainImageCount; i++) {
-        VkImageViewCreateInfo image_view_info = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-            .image = vk->swapchainImages[i],
-            .viewType = VK_IMAGE_VIEW_TYPE_2D,
-            .format = vk->swapchainImageFormat,
-            .components = {
-                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
-                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-                .a = VK_COMPONENT_SWIZZLE_IDENTITY
-            },
-            .subresourceRange = {
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .baseMipLevel = 0,
-                .levelCount = 1,
-                .baseArrayLayer = 0,
-                .layerCount = 1
-            }
+        VkSemaphoreCreateInfo semaphore_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
         };
-        
-        VKCALL(vkCreateImageView(vk->device, &image_view_info, NULL, &vk->swapchainImageViews[i]),
-               "vkCreateImageView");
+        VKCALL(vkCreateSemaphore(vk->device, &semaphore_info, NULL, &vk->swapchainRenderFinished[i]),
+               "vkCreateSemaphore(render finished)");
     }
     
     PRINT("Vulkan: Created swapchain with %u images, format %d, extent %dx%d\n", 
@@ -757,6 +1216,19 @@ bool VulkanCreateSwapchain(Vulkan* vk, VulkanPresentMode preferred_mode) {
 
 void VulkanDestroySwapchain(Vulkan* vk)
 {
+    // Callers have waited for the device, so retired swapchains can go too
+    ReleaseRetiredSwapchains(vk, true);
+    
+    // Destroy the per-image semaphores
+    if (vk->swapchainRenderFinished) {
+        for (uint32_t i = 0; i < vk->swapchainImageCount; i++) {
+            if (vk->swapchainRenderFinished[i]) {
+                vkDestroySemaphore(vk->device, vk->swapchainRenderFinished[i], NULL);
+            }
+        }
+        vk->swapchainRenderFinished = NULL;
+    }
+    
     // Destroy all image views
     if (vk->swapchainImageViews) {
         for (uint32_t i = 0; i < vk->swapchainImageCount; i++) {
@@ -764,13 +1236,20 @@ void VulkanDestroySwapchain(Vulkan* vk)
                 vkDestroyImageView(vk->device, vk->swapchainImageViews[i], NULL);
             }
         }
-        free(vk->swapchainImageViews);
         vk->swapchainImageViews = NULL;
     }
     
-    // Free swapchain images array (the images themselves are owned by the swapchain)
+    // Offscreen targets are ours to free; swapchain images belong to the swapchain
+    if (vk->swapchainImages && vk->offscreenAllocations) {
+        for (uint32_t i = 0; i < vk->swapchainImageCount; i++) {
+            VulkanMemoryDestroyImage(&vk->memory, vk->swapchainImages[i], &vk->offscreenAllocations[i]);
+        }
+        vk->offscreenAllocations = NULL;
+    }
+    
+    // Release the swapchain arrays
     if (vk->swapchainImages) {
-        free(vk->swapchainImages);
+        ArenaRewind(&vk->arena, vk->swapchainMarker);
         vk->swapchainImages = NULL;
     }
     
@@ -784,23 +1263,485 @@ void VulkanDestroySwapchain(Vulkan* vk)
 }
 
 bool VulkanRecreateSwapchain(Vulkan* vk, VulkanPresentMode preferredMode) {
-    // Wait for the device to be idle before recreating the swapchain
-    vkDeviceWaitIdle(vk->device);
-    
     PRINT("Vulkan: Recreating swapchain due to window resize\n");
     
-    // First, clean up old swapchain resources
-    VulkanDestroySwapchain(vk);
-    
-    // Then create a new swapchain
+    // No device wait: the current swapchain is handed to the new one as oldSwapchain and retired,
+    // frames already in flight keep presenting from it
+    vk->swapchainRecreations++;
     return VulkanCreateSwapchain(vk, preferredMode);
 }
 
+// Dirty flags from bursts of resize events collapse into one check per frame. A recreate is only
+// needed when the driver reported the swapchain as out of date / suboptimal or the extent changed.
+static bool SwapchainNeedsRecreate(Vulkan* vk)
+{
+    if (vk->swapchainSuboptimal || !vk->swapchain) {
+        return true;
+    }
+    
+    VkSurfaceCapabilitiesKHR surface_capabilities;
+    VKCALL(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vk->gpu, vk->surface, &surface_capabilities),
+           "vkGetPhysicalDeviceSurfaceCapabilitiesKHR");
+    VkExtent2D extent = ChooseSwapExtent(&surface_capabilities, vk->window);
+    return extent.width != vk->swapchainExtent.width || extent.height != vk->swapchainExtent.height;
+}
+
+// FRAMES /////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VulkanCreateFrames(Vulkan* vk, uint32_t frames_in_flight)
+{
+    if (frames_in_flight < 1) frames_in_flight = 1;
+    if (frames_in_flight > VULKAN_MAX_FRAMES_IN_FLIGHT) frames_in_flight = VULKAN_MAX_FRAMES_IN_FLIGHT;
+    vk->framesInFlight = frames_in_flight;
+    vk->frameNumber = 0;
+    
+    for (uint32_t i = 0; i < frames_in_flight; i++) {
+        VulkanFrame* frame = &vk->frames[i];
+        
+        // Reset wholesale at the start of the frame, so the buffers are transient
+        VkCommandPoolCreateInfo pool_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = vk->graphicsQueueFamily
+        };
+        VKCALL(vkCreateCommandPool(vk->device, &pool_info, NULL, &frame->commandPool), "vkCreateCommandPool(frame)");
+        
+        VkCommandBufferAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = frame->commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        VKCALL(vkAllocateCommandBuffers(vk->device, &alloc_info, &frame->commandBuffer), "vkAllocateCommandBuffers(frame)");
+        
+        // Created signalled so the first wait on each slot returns immediately
+        VkFenceCreateInfo fence_info = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .flags = VK_FENCE_CREATE_SIGNALED_BIT
+        };
+        VKCALL(vkCreateFence(vk->device, &fence_info, NULL, &frame->fence), "vkCreateFence(frame)");
+        
+        VkSemaphoreCreateInfo semaphore_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+        };
+        VKCALL(vkCreateSemaphore(vk->device, &semaphore_info, NULL, &frame->imageAvailable), "vkCreateSemaphore(image available)");
+    }
+    
+    // Counts finished frames for compute work that consumes rendered output
+    if (vk->features12.timelineSemaphore) {
+        VkSemaphoreTypeCreateInfo type_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0
+        };
+        VkSemaphoreCreateInfo semaphore_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &type_info
+        };
+        VKCALL(vkCreateSemaphore(vk->device, &semaphore_info, NULL, &vk->graphicsTimeline), "vkCreateSemaphore(graphics timeline)");
+    }
+    
+    // Timings are no reason to fail; a profiler without query pools records labels only
+    if (!VulkanProfilerInit(&vk->profiler, vk->device, vk->timestampPeriod, vk->timestampValidBits, frames_in_flight,
+                            vk->cmdBeginDebugUtilsLabel, vk->cmdEndDebugUtilsLabel)) {
+        PRINT_WARNING("Vulkan: GPU profiler unavailable\n");
+        VulkanProfilerDestroy(&vk->profiler);
+    }
+    
+    PRINT("Vulkan: %u frames in flight\n", frames_in_flight);
+    return true;
+}
+
+void VulkanDestroyFrames(Vulkan* vk)
+{
+    for (uint32_t i = 0; i < vk->framesInFlight; i++) {
+        VulkanFrame* frame = &vk->frames[i];
+        if (frame->fence) {
+            vkWaitForFences(vk->device, 1, &frame->fence, VK_TRUE, UINT64_MAX);
+            vkDestroyFence(vk->device, frame->fence, NULL);
+        }
+        if (frame->imageAvailable) {
+            vkDestroySemaphore(vk->device, frame->imageAvailable, NULL);
+        }
+        if (frame->commandPool) {
+            vkDestroyCommandPool(vk->device, frame->commandPool, NULL);
+        }
+        memset(frame, 0, sizeof(*frame));
+    }
+    VulkanProfilerPrintStats(&vk->profiler);
+    VulkanProfilerDestroy(&vk->profiler);
+    if (vk->graphicsTimeline) {
+        vkDestroySemaphore(vk->device, vk->graphicsTimeline, NULL);
+        vk->graphicsTimeline = VK_NULL_HANDLE;
+    }
+    
+    if (vk->frameNumber) {
+        PRINT_DEBUG("Vulkan: %llu frames, CPU waited on the GPU in %llu of them\n",
+                    (unsigned long long)vk->frameNumber, (unsigned long long)vk->frameStalls);
+    }
+    vk->framesInFlight = 0;
+}
+
+bool VulkanCreateOffscreenTargets(Vulkan* vk, uint32_t width, uint32_t height)
+{
+    vk->swapchainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    vk->swapchainExtent.width = width;
+    vk->swapchainExtent.height = height;
+    vk->swapchainImageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                              VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    vk->swapchainImageCount = vk->framesInFlight;
+    
+    vk->swapchainMarker = ArenaMark(&vk->arena);
+    vk->swapchainImages = ARENA_NEW(&vk->arena, VkImage, vk->swapchainImageCount);
+    vk->swapchainImageViews = ARENA_NEW(&vk->arena, VkImageView, vk->swapchainImageCount);
+    vk->offscreenAllocations = ARENA_NEW(&vk->arena, VulkanAllocation, vk->swapchainImageCount);
+    if (!vk->swapchainImages || !vk->swapchainImageViews || !vk->offscreenAllocations) {
+        PRINT_ERROR("Vulkan: Out of memory for %u offscreen targets\n", vk->swapchainImageCount);
+        return false;
+    }
+    
+    for (uint32_t i = 0; i < vk->swapchainImageCount; i++) {
+        VkImageCreateInfo image_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = vk->swapchainImageFormat,
+            .extent = { width, height, 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = vk->swapchainImageUsage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        if (!VulkanMemoryCreateImage(&vk->memory, &image_info, VULKAN_MEMORY_GPU_ONLY,
+                                     &vk->swapchainImages[i], &vk->offscreenAllocations[i])) {
+            return false;
+        }
+    }
+    
+    return CreateSwapchainImageViews(vk);
+}
+
+static void TransitionFrameImage(VkCommandBuffer cmd, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout,
+                                 VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+                                 VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+{
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = src_access,
+        .dstAccessMask = dst_access,
+        .oldLayout = old_layout,
+        .newLayout = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+VkCommandBuffer VulkanBeginFrame(Vulkan* vk)
+{
+    VulkanFrame* frame = &vk->frames[vk->frameNumber % vk->framesInFlight];
+    if (vk->frameSubmitFailed) {
+        return VK_NULL_HANDLE;
+    }
+    
+    // Only the frame that last used this slot has to be finished; the ones submitted after it keep
+    // the GPU busy while the CPU records
+    if (vkGetFenceStatus(vk->device, frame->fence) == VK_NOT_READY) {
+        vk->frameStalls++;
+        vkWaitForFences(vk->device, 1, &frame->fence, VK_TRUE, UINT64_MAX);
+    }
+    
+    // Swapchains retired a full round of frames ago are no longer referenced
+    if (vk->retiredSwapchainCount) {
+        ReleaseRetiredSwapchains(vk, false);
+    }
+    
+    // Same for bindless indices released since then
+    if (vk->bindless.device) {
+        VulkanBindlessBeginFrame(&vk->bindless, vk->frameNumber);
+    }
+    
+    if (vk->headless) {
+        vk->imageIndex = (uint32_t)(vk->frameNumber % vk->swapchainImageCount);
+    } else {
+        // A minimized window has no extent to render to
+        if (vk->window->width == 0 || vk->window->height == 0) {
+            return VK_NULL_HANDLE;
+        }
+        if (vk->swapchainDirty) {
+            if (SwapchainNeedsRecreate(vk)) {
+                if (!VulkanRecreateSwapchain(vk, vk->presentMode)) {
+                    return VK_NULL_HANDLE;
+                }
+            } else {
+                vk->swapchainDirty = false;
+                vk->swapchainResizesSkipped++;
+            }
+        }
+        
+        VkResult result = vkAcquireNextImageKHR(vk->device, vk->swapchain, UINT64_MAX, frame->imageAvailable,
+                                                VK_NULL_HANDLE, &vk->imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            // Nothing was signalled; skip the frame and rebuild the swapchain on the next one
+            vk->swapchainDirty = true;
+            vk->swapchainSuboptimal = true;
+            return VK_NULL_HANDLE;
+        }
+        if (result == VK_SUBOPTIMAL_KHR) {
+            // Still presentable, the semaphore is signalled: finish this frame and rebuild afterwards
+            vk->swapchainDirty = true;
+            vk->swapchainSuboptimal = true;
+        } else if (result != VK_SUCCESS) {
+            PRINT_ERROR("Vulkan: vkAcquireNextImageKHR failed (%d)\n", result);
+            return VK_NULL_HANDLE;
+        }
+    }
+    
+    // Reset only once a submission is certain, or a skipped frame would leave the fence unsignalled forever
+    vkResetFences(vk->device, 1, &frame->fence);
+    vkResetCommandPool(vk->device, frame->commandPool, 0);
+    
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    VKCALL(vkBeginCommandBuffer(frame->commandBuffer, &begin_info), "vkBeginCommandBuffer(frame)");
+    
+    // The slot's fence has signalled, so its timestamps from framesInFlight frames ago are ready
+    VulkanProfilerBeginFrame(&vk->profiler, frame->commandBuffer, vk->frameNumber);
+    
+    // Take ownership of anything uploaded on the transfer queue since the last frame
+    frame->uploadWait = VulkanUploadAcquire(&vk->uploader, frame->commandBuffer);
+    frame->computeWait = 0;
+    frame->computeWaitStages = 0;
+    
+    // Start from a cleared target in COLOR_ATTACHMENT_OPTIMAL
+    VkImage image = vk->swapchainImages[vk->imageIndex];
+    VulkanProfilerBeginScope(&vk->profiler, frame->commandBuffer, "Clear");
+    if (vk->swapchainImageUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) {
+        TransitionFrameImage(frame->commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        
+        VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        vkCmdClearColorImage(frame->commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &vk->clearColor, 1, &range);
+        
+        TransitionFrameImage(frame->commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    } else {
+        TransitionFrameImage(frame->commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    }
+    VulkanProfilerEndScope(&vk->profiler, frame->commandBuffer);
+    
+    return frame->commandBuffer;
+}
+
+bool VulkanEndFrame(Vulkan* vk)
+{
+    VulkanFrame* frame = &vk->frames[vk->frameNumber % vk->framesInFlight];
+    VkCommandBuffer cmd = frame->commandBuffer;
+    
+    // Presentation reads the image; headless targets are left ready to be copied out
+    TransitionFrameImage(cmd, vk->swapchainImages[vk->imageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                         vk->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+    VulkanProfilerEndFrame(&vk->profiler, cmd);
+    VKCALL(vkEndCommandBuffer(cmd), "vkEndCommandBuffer(frame)");
+    
+    // Binary acquire semaphore plus the upload and compute timelines; binary entries ignore their value
+    VkSemaphore wait_semaphores[3];
+    VkPipelineStageFlags wait_stages[3];
+    uint64_t wait_values[3];
+    uint32_t wait_count = 0;
+    if (!vk->headless) {
+        wait_semaphores[wait_count] = frame->imageAvailable;
+        wait_stages[wait_count] = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        wait_values[wait_count++] = 0;
+    }
+    if (frame->uploadWait) {
+        wait_semaphores[wait_count] = vk->uploader.timeline;
+        wait_stages[wait_count] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        wait_values[wait_count++] = frame->uploadWait;
+    }
+    if (frame->computeWait) {
+        wait_semaphores[wait_count] = vk->compute.timeline;
+        wait_stages[wait_count] = frame->computeWaitStages;
+        wait_values[wait_count++] = frame->computeWait;
+    }
+    
+    // Binary present semaphore plus the graphics timeline
+    VkSemaphore signal_semaphores[2];
+    uint64_t signal_values[2];
+    uint32_t signal_count = 0;
+    if (!vk->headless) {
+        signal_semaphores[signal_count] = vk->swapchainRenderFinished[vk->imageIndex];
+        signal_values[signal_count++] = 0;
+    }
+    if (vk->graphicsTimeline) {
+        signal_semaphores[signal_count] = vk->graphicsTimeline;
+        signal_values[signal_count++] = vk->frameNumber + 1;
+    }
+    
+    VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = wait_count,
+        .pWaitSemaphoreValues = wait_values,
+        .signalSemaphoreValueCount = signal_count,
+        .pSignalSemaphoreValues = signal_values
+    };
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = (frame->uploadWait || frame->computeWait || vk->graphicsTimeline) ? &timeline_info : NULL,
+        .waitSemaphoreCount = wait_count,
+        .pWaitSemaphores = wait_semaphores,
+        .pWaitDstStageMask = wait_stages,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd,
+        .signalSemaphoreCount = signal_count,
+        .pSignalSemaphores = signal_semaphores
+    };
+    
+    VkResult result = vkQueueSubmit(vk->graphicsQueue, 1, &submit_info, frame->fence);
+    if (result != VK_SUCCESS) {
+        // Only out of memory or device loss fail a submit, neither leaves a frame worth retrying, so rendering
+        // stops here. An empty batch consumes the acquire semaphore and signals what the lost frame would
+        // have: the fence reset in VulkanBeginFrame, which teardown waits on, and frameNumber + 1 on the
+        // graphics timeline, which compute work may wait on. frameNumber stays, its value was never reached.
+        PRINT_ERROR("Vulkan: Frame submission failed (%d), rendering stopped\n", result);
+        vk->frameSubmitFailed = true;
+        if (vk->profiler.frames) {
+            vk->profiler.frames[vk->frameNumber % vk->profiler.framesInFlight].pending = false;
+        }
+        uint64_t lost_value = vk->frameNumber + 1;
+        VkTimelineSemaphoreSubmitInfo lost_timeline_info = {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = vk->headless ? 0u : 1u,
+            .pWaitSemaphoreValues = wait_values,
+            .signalSemaphoreValueCount = vk->graphicsTimeline ? 1u : 0u,
+            .pSignalSemaphoreValues = &lost_value
+        };
+        VkSubmitInfo lost_info = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = vk->graphicsTimeline ? &lost_timeline_info : NULL,
+            .waitSemaphoreCount = vk->headless ? 0u : 1u,
+            .pWaitSemaphores = &frame->imageAvailable,
+            .pWaitDstStageMask = wait_stages,
+            .signalSemaphoreCount = vk->graphicsTimeline ? 1u : 0u,
+            .pSignalSemaphores = &vk->graphicsTimeline
+        };
+        vkQueueSubmit(vk->graphicsQueue, 1, &lost_info, frame->fence);
+        return false;
+    }
+    vk->frameNumber++;
+    
+    if (vk->headless) {
+        return true;
+    }
+    
+    VkPresentInfoKHR present_info = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &vk->swapchainRenderFinished[vk->imageIndex],
+        .swapchainCount = 1,
+        .pSwapchains = &vk->swapchain,
+        .pImageIndices = &vk->imageIndex
+    };
+    result = vkQueuePresentKHR(vk->presentQueue, &present_info);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        vk->swapchainDirty = true;
+        vk->swapchainSuboptimal = true;
+    } else if (result != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: vkQueuePresentKHR failed (%d)\n", result);
+        return false;
+    }
+    
+    return true;
+}
+
+void VulkanWaitCompute(Vulkan* vk, VkCommandBuffer cmd, uint64_t value, VkPipelineStageFlags stage)
+{
+    VulkanFrame* frame = &vk->frames[vk->frameNumber % vk->framesInFlight];
+    uint64_t acquire_value = VulkanComputeAcquire(&vk->compute, cmd, stage);
+    value = MAX(value, acquire_value);
+    if (value == 0) {
+        return;
+    }
+    frame->computeWait = MAX(frame->computeWait, value);
+    frame->computeWaitStages |= stage;
+}
+
+VkShaderModule VulkanLoadShader(Vulkan* vk, const char* path)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        PRINT_ERROR("Vulkan: Failed to open shader %s\n", path);
+        return VK_NULL_HANDLE;
+    }
+
+    LARGE_INTEGER size;
+    uint32_t* code = NULL;
+    DWORD read = 0;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart % 4 == 0 && size.QuadPart <= MAXDWORD) {
+        code = (uint32_t*)malloc((size_t)size.QuadPart);
+        if (code && !ReadFile(file, code, (DWORD)size.QuadPart, &read, NULL)) {
+            read = 0;
+        }
+    }
+    CloseHandle(file);
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (read != 0 && read == size.QuadPart) {
+        VkShaderModuleCreateInfo module_info = {
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .codeSize = read,
+            .pCode = code
+        };
+        if (vkCreateShaderModule(vk->device, &module_info, NULL, &module) != VK_SUCCESS) {
+            module = VK_NULL_HANDLE;
+        }
+    }
+    free(code);
+
+    if (!module) {
+        PRINT_ERROR("Vulkan: %s is not a valid SPIR-V module\n", path);
+    }
+    return module;
+}
+
 void VulkanDestroy(Vulkan* vk)
 {
+    // Let every frame in flight finish before anything it uses goes away
+    VulkanDestroyFrames(vk);
+
     // Clean up swapchain resources first
     VulkanDestroySwapchain(vk);
 
+    // Persist what was compiled this run
+    VulkanPipelineCacheDestroy(&vk->pipelineCache);
+    VulkanBindlessDestroy(&vk->bindless);
+    
+    // All device memory goes back before the device
+    VulkanComputeDestroy(&vk->compute);
+    VulkanUploaderDestroy(&vk->uploader);
+    VulkanMemoryPrintStats(&vk->memory);
+    VulkanMemoryDestroy(&vk->memory);
+
     // Device needs to be destroyed before the instance
     if (vk->device) {
         vkDestroyDevice(vk->device, NULL);
@@ -817,6 +1758,8 @@ void VulkanDestroy(Vulkan* vk)
         vk->instance = NULL;
     }
 
+    ArenaDestroy(&vk->arena);
+
     PRINT("Vulkan: Resources destroyed\n");
 }
 
@@ -2,12 +2,22 @@
 
 #include "common.h"
 #include "window.h"
+#include "arena.h"
+#include "vulkan_memory.h"
+#include "vulkan_upload.h"
+#include "vulkan_pipeline_cache.h"
+#include "vulkan_bindless.h"
+#include "vulkan_profiler.h"
+#include "vulkan_compute.h"
 
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_win32.h>
 
 #pragma comment(lib, "vulkan-1.lib")
 
+// Pipeline cache persisted next to the executable between runs
+#define VULKAN_PIPELINE_CACHE_FILE     "pipeline_cache.bin"
+
 // GPU selection score weights
 #define GPU_SCORE_DISCRETE             1000
 #define GPU_SCORE_INTEGRATED           500
@@ -76,6 +86,32 @@ typedef enum VulkanPresentMode {
     VULKAN_PRESENT_MODE_FIFO_RELAXED    // Relaxed V-Sync
 } VulkanPresentMode;
 
+// Frames the CPU may record ahead of the GPU
+#define VULKAN_MAX_FRAMES_IN_FLIGHT    3
+
+// Swapchains replaced through oldSwapchain wait here until the frames that used them have retired
+#define VULKAN_MAX_RETIRED_SWAPCHAINS  4
+#define VULKAN_MAX_SWAPCHAIN_IMAGES    8
+
+typedef struct VulkanRetiredSwapchain {
+    VkSwapchainKHR swapchain;
+    uint32_t imageCount;
+    VkImageView imageViews[VULKAN_MAX_SWAPCHAIN_IMAGES];
+    VkSemaphore renderFinished[VULKAN_MAX_SWAPCHAIN_IMAGES];
+    uint64_t retireFrame;           // Destroyed once frameNumber reaches this
+} VulkanRetiredSwapchain;
+
+// Per-frame submission state, reused every framesInFlight frames
+typedef struct VulkanFrame {
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;                  // Signalled when the frame's submission has executed
+    VkSemaphore imageAvailable;
+    uint64_t uploadWait;            // Upload timeline value the submission waits on, 0 for none
+    uint64_t computeWait;           // Compute timeline value the submission waits on, 0 for none
+    VkPipelineStageFlags computeWaitStages;
+} VulkanFrame;
+
 // Initializes VulkanGpuPreferences with default values
 void VulkanInitDefaultGpuPreferences(VulkanGpuPreferences* prefs);
 
@@ -90,10 +126,30 @@ typedef struct Vulkan {
     // Queue family indices
     uint graphicsQueueFamily;
     uint presentQueueFamily;
+    uint transferQueueFamily;       // Equals graphicsQueueFamily when there is no separate copy queue
+    uint computeQueueFamily;        // Equals graphicsQueueFamily when there is no async compute family
+    uint computeQueueIndex;         // 1 when sharing the transfer family, which had a second queue
     
     // Queue handles
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    VkQueue transferQueue;
+    VkQueue computeQueue;
+    
+    // Vulkan 1.2 features enabled on the device
+    VkPhysicalDeviceVulkan12Features features12;
+    bool pipelineCreationFeedback;  // VK_EXT_pipeline_creation_feedback enabled
+    float maxSamplerAnisotropy;     // 0 when anisotropic filtering is not enabled
+    bool bindlessRequested;         // Set before VulkanInit to enable descriptor indexing and create vk->bindless
+    bool synchronization2;          // VK_KHR_synchronization2 enabled, cmdPipelineBarrier2 loaded
+    bool multiDrawIndirect;         // multiDrawIndirect and drawIndirectFirstInstance enabled
+    uint32_t maxDrawIndirectCount;  // Draws one vkCmdDraw*Indirect call may issue
+    PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2;
+    bool debugUtils;                // VK_EXT_debug_utils enabled on the instance
+    PFN_vkCmdBeginDebugUtilsLabelEXT cmdBeginDebugUtilsLabel;
+    PFN_vkCmdEndDebugUtilsLabelEXT cmdEndDebugUtilsLabel;
+    float timestampPeriod;          // Nanoseconds per timestamp tick
+    uint32_t timestampValidBits;    // Of the graphics queue family, 0 when it has no timestamps
     
     // GPU selection preferences
     VulkanGpuPreferences gpuPreferences;
@@ -105,16 +161,77 @@ typedef struct Vulkan {
     uint32_t swapchainImageCount;
     VkImage* swapchainImages;
     VkImageView* swapchainImageViews;
+    VkSemaphore* swapchainRenderFinished;  // One per image, waited on by present
+    VkImageUsageFlags swapchainImageUsage;
+    VulkanPresentMode presentMode;
+    bool swapchainDirty;            // Resized, out of date or suboptimal; checked at the start of the next frame
+    bool swapchainSuboptimal;       // Reported by acquire/present, rebuilt even if the extent is unchanged
+    VulkanRetiredSwapchain retiredSwapchains[VULKAN_MAX_RETIRED_SWAPCHAINS];
+    uint32_t retiredSwapchainCount;
+    uint32_t swapchainRecreations;
+    uint32_t swapchainResizesSkipped;   // Dirty flags dropped because the surface extent had not changed
+
+    // Headless runs render into offscreen images standing in for the swapchain
+    bool headless;
+    VulkanAllocation* offscreenAllocations;
+
+    // Frames in flight
+    VulkanFrame frames[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    uint32_t framesInFlight;
+    uint64_t frameNumber;
+    uint32_t imageIndex;            // Image acquired by VulkanBeginFrame
+    VkClearColorValue clearColor;
+    uint64_t frameStalls;           // Frames whose fence was still pending in VulkanBeginFrame
+    bool frameSubmitFailed;         // Out of memory or device lost on submit; no frame is rendered after it
+    VkSemaphore graphicsTimeline;   // Reaches N + 1 once frame N has executed; compute waits on it for rendered inputs
+
+    // Device memory for buffers and images, sub-allocated from large blocks
+    VulkanMemory memory;
+
+    // Staging ring and batched copies on the transfer queue
+    VulkanUploader uploader;
+
+    // Dispatches on the compute queue, beside graphics when there is an async family
+    VulkanCompute compute;
+
+    // GPU timings of the frame and its scopes, read back framesInFlight frames later
+    VulkanProfiler profiler;
+
+    // Bindless descriptor set and pipeline layout, valid when bindless.device is set
+    VulkanBindless bindless;
+
+    // Compiled pipelines, loaded from and saved to VULKAN_PIPELINE_CACHE_FILE
+    VulkanPipelineCache pipelineCache;
+
+    // Long-lived CPU allocations (swapchain arrays etc.); swapchain data sits above swapchainMarker
+    Arena arena;
+    ArenaMarker swapchainMarker;
 
 } Vulkan;
 
-void VulkanInit(Vulkan* vk, Window* wnd);
+void VulkanInit(Vulkan* vk, Window* wnd, uint32_t framesInFlight);
+bool VulkanInitHeadless(Vulkan* vk, uint32_t width, uint32_t height, uint32_t framesInFlight);
 bool VulkanCreateInstance(Vulkan* vk, const char* appName, uint32_t appVersion);
 bool VulkanCreateSurface(Vulkan* vk, Window* wnd);
 bool VulkanSelectPhysicalDevice(Vulkan* vk);
 bool VulkanCreateLogicalDevice(Vulkan* vk, const VkPhysicalDeviceFeatures* enabledFeatures);
 bool VulkanCreateSwapchain(Vulkan* vk, VulkanPresentMode preferredPresentMode);
 bool VulkanRecreateSwapchain(Vulkan* vk, VulkanPresentMode preferredPresentMode);
+bool VulkanCreateOffscreenTargets(Vulkan* vk, uint32_t width, uint32_t height);
+bool VulkanCreateFrames(Vulkan* vk, uint32_t framesInFlight);
+
+// Waits for the frame slot, acquires an image and returns a command buffer with the image cleared and in
+// COLOR_ATTACHMENT_OPTIMAL. Returns VK_NULL_HANDLE when the frame has to be skipped (minimized, out of date).
+VkCommandBuffer VulkanBeginFrame(Vulkan* vk);
+// Submits the command buffer returned by VulkanBeginFrame and presents the image
+bool VulkanEndFrame(Vulkan* vk);
+// Makes the frame's submission wait at stage for compute work up to value (from VulkanComputeSubmit) and
+// records the ownership acquires of what that work released into cmd
+void VulkanWaitCompute(Vulkan* vk, VkCommandBuffer cmd, uint64_t value, VkPipelineStageFlags stage);
+
+// Reads a SPIR-V file and creates a shader module from it; VK_NULL_HANDLE on failure
+VkShaderModule VulkanLoadShader(Vulkan* vk, const char* path);
 
 void VulkanDestroy(Vulkan* vk);
 void VulkanDestroySwapchain(Vulkan* vk);
+void VulkanDestroyFrames(Vulkan* vk);
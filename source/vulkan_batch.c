@@ -0,0 +1,296 @@
+#include "vulkan_batch.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define VULKAN_BATCH_DEPTH_SHIFT    0
+#define VULKAN_BATCH_MESH_SHIFT     (VULKAN_BATCH_DEPTH_SHIFT + VULKAN_BATCH_DEPTH_BITS)
+#define VULKAN_BATCH_MATERIAL_SHIFT (VULKAN_BATCH_MESH_SHIFT + VULKAN_BATCH_MESH_BITS)
+#define VULKAN_BATCH_PIPELINE_SHIFT (VULKAN_BATCH_MATERIAL_SHIFT + VULKAN_BATCH_MATERIAL_BITS)
+#define VULKAN_BATCH_PASS_SHIFT     (VULKAN_BATCH_PIPELINE_SHIFT + VULKAN_BATCH_PIPELINE_BITS)
+
+// Radix sort digit
+#define VULKAN_BATCH_RADIX_BITS     8
+#define VULKAN_BATCH_RADIX          (1u << VULKAN_BATCH_RADIX_BITS)
+
+// SETUP ///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VulkanBatcherInit(VulkanBatcher* batcher, Vulkan* vk, uint32_t max_draws, uint32_t max_meshes)
+{
+    memset(batcher, 0, sizeof(*batcher));
+    if (!vk->device) {
+        return false;
+    }
+
+    batcher->vk = vk;
+    batcher->maxDraws = max_draws;
+    batcher->meshCount = MIN(max_meshes, VULKAN_BATCH_MAX_MESHES);
+    batcher->frameNumber = UINT64_MAX;
+
+    batcher->meshes = (VulkanBatchMesh*)calloc(batcher->meshCount, sizeof(VulkanBatchMesh));
+    batcher->keys = (uint64_t*)malloc(max_draws * sizeof(uint64_t));
+    batcher->instances = (VulkanBatchInstance*)malloc(max_draws * sizeof(VulkanBatchInstance));
+    batcher->sortKeys = (uint64_t*)malloc(max_draws * sizeof(uint64_t));
+    batcher->order = (uint32_t*)malloc(max_draws * sizeof(uint32_t));
+    batcher->sortOrder = (uint32_t*)malloc(max_draws * sizeof(uint32_t));
+    // Worst case every draw is its own batch
+    batcher->batches = (VulkanBatch*)malloc(max_draws * sizeof(VulkanBatch));
+    if (!batcher->meshes || !batcher->keys || !batcher->instances || !batcher->sortKeys || !batcher->order ||
+        !batcher->sortOrder || !batcher->batches) {
+        PRINT_ERROR("Batcher: Out of memory for %u draws\n", max_draws);
+        VulkanBatcherDestroy(batcher);
+        return false;
+    }
+
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = (VkDeviceSize)max_draws * sizeof(VulkanBatchInstance),
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+    for (uint32_t i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; i++) {
+        batcher->instanceBindless[i] = VULKAN_BINDLESS_INVALID;
+    }
+    for (uint32_t i = 0; i < vk->framesInFlight; i++) {
+        if (!VulkanMemoryCreateBuffer(&vk->memory, &buffer_info, VULKAN_MEMORY_CPU_TO_GPU,
+                                      &batcher->instanceBuffers[i], &batcher->instanceAllocations[i])) {
+            PRINT_ERROR("Batcher: Failed to create instance buffer\n");
+            VulkanBatcherDestroy(batcher);
+            return false;
+        }
+        if (vk->bindless.device) {
+            batcher->instanceBindless[i] = VulkanBindlessAddBuffer(&vk->bindless, batcher->instanceBuffers[i], 0,
+                                                                   VK_WHOLE_SIZE);
+        }
+    }
+
+    return true;
+}
+
+void VulkanBatcherDestroy(VulkanBatcher* batcher)
+{
+    if (!batcher->vk) {
+        return;
+    }
+
+    Vulkan* vk = batcher->vk;
+    for (uint32_t i = 0; i < vk->framesInFlight; i++) {
+        if (batcher->instanceBindless[i] != VULKAN_BINDLESS_INVALID) {
+            VulkanBindlessRemove(&vk->bindless, VULKAN_BINDLESS_BUFFER, batcher->instanceBindless[i]);
+        }
+        VulkanMemoryDestroyBuffer(&vk->memory, batcher->instanceBuffers[i], &batcher->instanceAllocations[i]);
+    }
+
+    free(batcher->meshes);
+    free(batcher->keys);
+    free(batcher->instances);
+    free(batcher->sortKeys);
+    free(batcher->order);
+    free(batcher->sortOrder);
+    free(batcher->batches);
+    memset(batcher, 0, sizeof(*batcher));
+}
+
+bool VulkanBatchSetMesh(VulkanBatcher* batcher, uint32_t mesh, uint32_t index_count, uint32_t first_index,
+                        int32_t vertex_offset)
+{
+    if (mesh >= batcher->meshCount) {
+        PRINT_ERROR("Batcher: Mesh %u out of range\n", mesh);
+        return false;
+    }
+    batcher->meshes[mesh].indexCount = index_count;
+    batcher->meshes[mesh].firstIndex = first_index;
+    batcher->meshes[mesh].vertexOffset = vertex_offset;
+    return true;
+}
+
+// SUBMISSION //////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VulkanBatchBegin(VulkanBatcher* batcher)
+{
+    batcher->frameNumber = batcher->vk->frameNumber;
+    batcher->built = false;
+    batcher->drawCount = 0;
+    batcher->dropped = 0;
+    batcher->batchCount = 0;
+    memset(batcher->passFirst, 0, sizeof(batcher->passFirst));
+}
+
+// Top bits of a non-negative float order the same as the float
+static uint64_t QuantizeDepth(float depth)
+{
+    uint32_t bits = 0;
+    if (depth > 0.0f) {
+        memcpy(&bits, &depth, sizeof(bits));
+    }
+    return bits >> (32 - VULKAN_BATCH_DEPTH_BITS);
+}
+
+bool VulkanBatchSubmit(VulkanBatcher* batcher, uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh,
+                       const float transform[3][4], float depth)
+{
+    if (batcher->drawCount == batcher->maxDraws) {
+        batcher->dropped++;
+        return false;
+    }
+    if (pass >= VULKAN_BATCH_MAX_PASSES || pipeline >= VULKAN_BATCH_MAX_PIPELINES ||
+        material >= VULKAN_BATCH_MAX_MATERIALS || mesh >= batcher->meshCount) {
+        PRINT_ERROR("Batcher: Draw (pass %u, pipeline %u, material %u, mesh %u) out of range\n",
+                    pass, pipeline, material, mesh);
+        return false;
+    }
+
+    uint32_t draw = batcher->drawCount++;
+    batcher->keys[draw] = ((uint64_t)pass << VULKAN_BATCH_PASS_SHIFT) |
+                          ((uint64_t)pipeline << VULKAN_BATCH_PIPELINE_SHIFT) |
+                          ((uint64_t)material << VULKAN_BATCH_MATERIAL_SHIFT) |
+                          ((uint64_t)mesh << VULKAN_BATCH_MESH_SHIFT) |
+                          (QuantizeDepth(depth) << VULKAN_BATCH_DEPTH_SHIFT);
+    memcpy(batcher->instances[draw].transform, transform, sizeof(batcher->instances[draw].transform));
+    return true;
+}
+
+// LSD radix sort of the keys, carrying the draw indices along; stable, so equal keys keep submission
+// order. Digits every key shares are skipped, which with few passes and pipelines is most of the top ones.
+static void RadixSortDraws(VulkanBatcher* batcher)
+{
+    uint32_t count = batcher->drawCount;
+    uint64_t* keys = batcher->keys;
+    uint64_t* keys_out = batcher->sortKeys;
+    uint32_t* order = batcher->order;
+    uint32_t* order_out = batcher->sortOrder;
+
+    for (uint32_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+
+    // Keys are sorted in place of the submitted ones; instances stay put and are gathered through order
+    for (uint32_t shift = 0; shift < 64; shift += VULKAN_BATCH_RADIX_BITS) {
+        uint32_t histogram[VULKAN_BATCH_RADIX] = {0};
+        for (uint32_t i = 0; i < count; i++) {
+            histogram[(keys[i] >> shift) & (VULKAN_BATCH_RADIX - 1)]++;
+        }
+        if (histogram[(keys[0] >> shift) & (VULKAN_BATCH_RADIX - 1)] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < VULKAN_BATCH_RADIX; digit++) {
+            uint32_t digit_count = histogram[digit];
+            histogram[digit] = offset;
+            offset += digit_count;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t slot = histogram[(keys[i] >> shift) & (VULKAN_BATCH_RADIX - 1)]++;
+            keys_out[slot] = keys[i];
+            order_out[slot] = order[i];
+        }
+
+        uint64_t* swap_keys = keys;
+        keys = keys_out;
+        keys_out = swap_keys;
+        uint32_t* swap_order = order;
+        order = order_out;
+        order_out = swap_order;
+    }
+
+    // An odd number of scatters leaves the result in the scratch arrays
+    batcher->keys = keys;
+    batcher->sortKeys = keys_out;
+    batcher->order = order;
+    batcher->sortOrder = order_out;
+}
+
+uint32_t VulkanBatchEnd(VulkanBatcher* batcher)
+{
+    Vulkan* vk = batcher->vk;
+    if (batcher->frameNumber != vk->frameNumber) {
+        PRINT_ERROR("Batcher: VulkanBatchEnd without VulkanBatchBegin this frame\n");
+        return 0;
+    }
+    if (batcher->dropped > 0) {
+        PRINT_WARNING("Batcher: %u draws over the limit of %u dropped\n", batcher->dropped, batcher->maxDraws);
+    }
+
+    uint32_t count = batcher->drawCount;
+    if (count > 0) {
+        RadixSortDraws(batcher);
+    }
+
+    // The slot's fence has been waited on, so its instance buffer is free to overwrite
+    uint32_t slot = (uint32_t)(vk->frameNumber % vk->framesInFlight);
+    VulkanBatchInstance* mapped = (VulkanBatchInstance*)batcher->instanceAllocations[slot].mapped;
+    const uint64_t group_mask = ~(uint64_t)0 << VULKAN_BATCH_MESH_SHIFT;
+
+    uint32_t batch_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t key = batcher->keys[i];
+        mapped[i] = batcher->instances[batcher->order[i]];
+
+        // Same pass, pipeline, material and mesh as the previous draw: one more instance of its batch
+        if (i > 0 && (key & group_mask) == (batcher->keys[i - 1] & group_mask)) {
+            batcher->batches[batch_count - 1].instanceCount++;
+            continue;
+        }
+
+        VulkanBatch* batch = &batcher->batches[batch_count++];
+        batch->pipeline = (uint16_t)((key >> VULKAN_BATCH_PIPELINE_SHIFT) & (VULKAN_BATCH_MAX_PIPELINES - 1));
+        batch->material = (uint16_t)((key >> VULKAN_BATCH_MATERIAL_SHIFT) & (VULKAN_BATCH_MAX_MATERIALS - 1));
+        batch->mesh = (uint16_t)((key >> VULKAN_BATCH_MESH_SHIFT) & (VULKAN_BATCH_MAX_MESHES - 1));
+        batch->firstInstance = i;
+        batch->instanceCount = 1;
+
+        // Passes after this one start no earlier than here
+        uint32_t pass = (uint32_t)(key >> VULKAN_BATCH_PASS_SHIFT);
+        for (uint32_t p = pass + 1; p <= VULKAN_BATCH_MAX_PASSES; p++) {
+            batcher->passFirst[p] = batch_count;
+        }
+    }
+    if (count > 0) {
+        VulkanMemoryFlush(&vk->memory, &batcher->instanceAllocations[slot]);
+    }
+
+    batcher->batchCount = batch_count;
+    batcher->built = true;
+    batcher->statDraws = count;
+    batcher->statBatches = batch_count;
+    return batch_count;
+}
+
+// RECORDING ///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VkBuffer VulkanBatchGetInstanceBuffer(const VulkanBatcher* batcher)
+{
+    return batcher->instanceBuffers[batcher->vk->frameNumber % batcher->vk->framesInFlight];
+}
+
+uint32_t VulkanBatchGetInstanceBindless(const VulkanBatcher* batcher)
+{
+    return batcher->instanceBindless[batcher->vk->frameNumber % batcher->vk->framesInFlight];
+}
+
+void VulkanBatchRecord(VulkanBatcher* batcher, VkCommandBuffer cmd, uint32_t pass, VulkanBatchBindFn bind,
+                       void* user_data)
+{
+    if (!batcher->built || batcher->frameNumber != batcher->vk->frameNumber || pass >= VULKAN_BATCH_MAX_PASSES) {
+        return;
+    }
+
+    uint32_t pipeline = UINT32_MAX;
+    uint32_t material = UINT32_MAX;
+    for (uint32_t i = batcher->passFirst[pass]; i < batcher->passFirst[pass + 1]; i++) {
+        const VulkanBatch* batch = &batcher->batches[i];
+        if (batch->pipeline != pipeline || batch->material != material) {
+            pipeline = batch->pipeline;
+            material = batch->material;
+            if (bind) {
+                bind(cmd, pipeline, material, user_data);
+            }
+        }
+
+        const VulkanBatchMesh* mesh = &batcher->meshes[batch->mesh];
+        vkCmdDrawIndexed(cmd, mesh->indexCount, batch->instanceCount, mesh->firstIndex, mesh->vertexOffset,
+                         batch->firstInstance);
+    }
+}
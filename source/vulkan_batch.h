@@ -0,0 +1,108 @@
+#pragma once
+
+#include "vulkan.h"
+
+// Sort key layout, most significant first. Passes draw in key order; within a pass draws are grouped by
+// pipeline, then material, then mesh, and ordered front to back inside each group.
+#define VULKAN_BATCH_PASS_BITS      4
+#define VULKAN_BATCH_PIPELINE_BITS  12
+#define VULKAN_BATCH_MATERIAL_BITS  16
+#define VULKAN_BATCH_MESH_BITS      16
+#define VULKAN_BATCH_DEPTH_BITS     16
+
+#define VULKAN_BATCH_MAX_PASSES     (1u << VULKAN_BATCH_PASS_BITS)
+#define VULKAN_BATCH_MAX_PIPELINES  (1u << VULKAN_BATCH_PIPELINE_BITS)
+#define VULKAN_BATCH_MAX_MATERIALS  (1u << VULKAN_BATCH_MATERIAL_BITS)
+#define VULKAN_BATCH_MAX_MESHES     (1u << VULKAN_BATCH_MESH_BITS)
+
+// Per-instance data in the frame's instance buffer, std430 layout
+typedef struct VulkanBatchInstance {
+    float transform[3][4];      // Rows of the object-to-world matrix, the last row is (0, 0, 0, 1)
+} VulkanBatchInstance;
+
+// Geometry of one mesh inside the vertex and index buffers the caller binds
+typedef struct VulkanBatchMesh {
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t  vertexOffset;
+} VulkanBatchMesh;
+
+// Draws that share pass, pipeline, material and mesh, issued as one instanced draw
+typedef struct VulkanBatch {
+    uint16_t pipeline;
+    uint16_t material;
+    uint16_t mesh;
+    uint32_t firstInstance;     // Into the frame's instance buffer
+    uint32_t instanceCount;
+} VulkanBatch;
+
+// Binds the state of a batch whose pipeline or material differs from the previous one in the pass
+typedef void (*VulkanBatchBindFn)(VkCommandBuffer cmd, uint32_t pipeline, uint32_t material, void* user_data);
+
+// Draw submission front-end. The game submits (mesh, material, transform) draws for a frame; at the end
+// of submission they are radix-sorted by a packed 64-bit key, runs with the same mesh and material are
+// merged into instanced draws, and the transforms are written in sorted order into the frame's instance
+// buffer. Vertex shaders read their transform from that buffer at gl_InstanceIndex.
+//
+// Each frame in flight has its own persistently mapped instance buffer, so writing one frame never
+// waits on the GPU reading another. Pipeline and material ids are the caller's; the batcher only
+// orders by them and hands them back through VulkanBatchBindFn.
+// Not thread-safe; owned by the thread that records and submits Vulkan work.
+typedef struct VulkanBatcher {
+    Vulkan*              vk;
+    uint32_t             maxDraws;
+
+    VulkanBatchMesh*     meshes;            // Indexed by mesh id
+    uint32_t             meshCount;
+
+    // Submitted draws of the current frame, in submission order
+    uint64_t*            keys;
+    VulkanBatchInstance* instances;
+    uint32_t             drawCount;
+    uint32_t             dropped;           // Submitted past maxDraws this frame
+
+    // Radix sort ping-pong; the sorted order ends up in order
+    uint64_t*            sortKeys;
+    uint32_t*            order;
+    uint32_t*            sortOrder;
+
+    VulkanBatch*         batches;           // Sorted, grouped by pass
+    uint32_t             batchCount;
+    // Batches of pass p are [passFirst[p], passFirst[p + 1])
+    uint32_t             passFirst[VULKAN_BATCH_MAX_PASSES + 1];
+
+    VkBuffer             instanceBuffers[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    VulkanAllocation     instanceAllocations[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    uint32_t             instanceBindless[VULKAN_MAX_FRAMES_IN_FLIGHT]; // Storage buffer indices with bindless
+    uint64_t             frameNumber;       // Frame of the submitted draws
+    bool                 built;             // VulkanBatchEnd ran for frameNumber
+
+    // Last built frame
+    uint32_t             statDraws;
+    uint32_t             statBatches;
+} VulkanBatcher;
+
+bool VulkanBatcherInit(VulkanBatcher* batcher, Vulkan* vk, uint32_t max_draws, uint32_t max_meshes);
+// The frames drawing batches must have completed
+void VulkanBatcherDestroy(VulkanBatcher* batcher);
+
+bool VulkanBatchSetMesh(VulkanBatcher* batcher, uint32_t mesh, uint32_t index_count, uint32_t first_index,
+                        int32_t vertex_offset);
+
+// Starts submission for the current frame, after VulkanBeginFrame. Discards what was submitted before.
+void VulkanBatchBegin(VulkanBatcher* batcher);
+// depth is the view distance, for front-to-back order within a mesh run. Returns false (and drops the
+// draw) when the frame already holds maxDraws or an id is out of range.
+bool VulkanBatchSubmit(VulkanBatcher* batcher, uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh,
+                       const float transform[3][4], float depth);
+// Sorts, merges and uploads the submitted draws; returns the number of batches
+uint32_t VulkanBatchEnd(VulkanBatcher* batcher);
+
+// Instance buffer of the current frame, valid after VulkanBatchEnd
+VkBuffer VulkanBatchGetInstanceBuffer(const VulkanBatcher* batcher);
+uint32_t VulkanBatchGetInstanceBindless(const VulkanBatcher* batcher);
+
+// Records the batches of one pass inside its render pass: bind is called when the pipeline or material
+// changes, then one vkCmdDrawIndexed per batch. The caller binds the vertex and index buffers.
+void VulkanBatchRecord(VulkanBatcher* batcher, VkCommandBuffer cmd, uint32_t pass, VulkanBatchBindFn bind,
+                       void* user_data);
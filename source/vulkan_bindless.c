@@ -0,0 +1,325 @@
+#include "vulkan_bindless.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// INDEX TABLES ///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool TableInit(VulkanBindlessTable* table, uint32_t capacity)
+{
+    memset(table, 0, sizeof(*table));
+    table->capacity = capacity;
+    table->freeList = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    table->pending = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    table->pendingFrame = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    table->live = (uint32_t*)calloc((capacity + 31) / 32, sizeof(uint32_t));
+    return table->freeList && table->pending && table->pendingFrame && table->live;
+}
+
+static void TableDestroy(VulkanBindlessTable* table)
+{
+    free(table->freeList);
+    free(table->pending);
+    free(table->pendingFrame);
+    free(table->live);
+    memset(table, 0, sizeof(*table));
+}
+
+static uint32_t TableAlloc(VulkanBindlessTable* table)
+{
+    uint32_t index;
+    if (table->freeCount) {
+        index = table->freeList[--table->freeCount];
+    } else if (table->next < table->capacity) {
+        index = table->next++;
+    } else {
+        return VULKAN_BINDLESS_INVALID;
+    }
+    table->live[index / 32] |= 1u << (index % 32);
+    table->used++;
+    return index;
+}
+
+// Pending entries are released in frame order, so the ready ones sit at the front
+static void TableRecycle(VulkanBindlessTable* table, uint64_t frame_number, uint32_t frames_in_flight)
+{
+    uint32_t ready = 0;
+    while (ready < table->pendingCount && table->pendingFrame[ready] + frames_in_flight <= frame_number) {
+        table->freeList[table->freeCount++] = table->pending[ready++];
+    }
+    if (ready) {
+        table->pendingCount -= ready;
+        memmove(table->pending, table->pending + ready, table->pendingCount * sizeof(uint32_t));
+        memmove(table->pendingFrame, table->pendingFrame + ready, table->pendingCount * sizeof(uint64_t));
+    }
+}
+
+// SETUP //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool CreateSamplers(VulkanBindless* bl, float max_anisotropy)
+{
+    for (uint32_t i = 0; i < VULKAN_BINDLESS_SAMPLER_COUNT; i++) {
+        bool linear = i == VULKAN_BINDLESS_SAMPLER_LINEAR_REPEAT || i == VULKAN_BINDLESS_SAMPLER_LINEAR_CLAMP;
+        bool repeat = i == VULKAN_BINDLESS_SAMPLER_LINEAR_REPEAT || i == VULKAN_BINDLESS_SAMPLER_NEAREST_REPEAT;
+        VkFilter filter = linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+        VkSamplerAddressMode address = repeat ? VK_SAMPLER_ADDRESS_MODE_REPEAT : VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+        VkSamplerCreateInfo sampler_info = {
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .magFilter = filter,
+            .minFilter = filter,
+            .mipmapMode = linear ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressModeU = address,
+            .addressModeV = address,
+            .addressModeW = address,
+            .anisotropyEnable = linear && max_anisotropy > 1.0f ? VK_TRUE : VK_FALSE,
+            .maxAnisotropy = max_anisotropy > 1.0f ? max_anisotropy : 1.0f,
+            .maxLod = VK_LOD_CLAMP_NONE
+        };
+        if (vkCreateSampler(bl->device, &sampler_info, NULL, &bl->samplers[i]) != VK_SUCCESS) {
+            PRINT_ERROR("Vulkan: Failed to create bindless sampler %u\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool VulkanBindlessInit(VulkanBindless* bl, VkPhysicalDevice gpu, VkDevice device, uint32_t frames_in_flight,
+                        float max_anisotropy)
+{
+    memset(bl, 0, sizeof(*bl));
+    bl->device = device;
+    bl->framesInFlight = frames_in_flight;
+
+    // Table sizes are bounded by the update-after-bind limits, per stage and per set
+    VkPhysicalDeviceVulkan12Properties properties12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &properties12
+    };
+    vkGetPhysicalDeviceProperties2(gpu, &properties);
+
+    uint32_t image_count = VULKAN_BINDLESS_MAX_IMAGES;
+    image_count = MIN(image_count, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    image_count = MIN(image_count, properties12.maxDescriptorSetUpdateAfterBindSampledImages);
+    uint32_t buffer_count = VULKAN_BINDLESS_MAX_BUFFERS;
+    buffer_count = MIN(buffer_count, properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+    buffer_count = MIN(buffer_count, properties12.maxDescriptorSetUpdateAfterBindStorageBuffers);
+
+    // Everything in the set counts against the per-stage resource limit
+    uint32_t resource_limit = properties12.maxPerStageUpdateAfterBindResources;
+    if (image_count + buffer_count > resource_limit) {
+        image_count = resource_limit / 2;
+        buffer_count = resource_limit - image_count;
+    }
+
+    if (!TableInit(&bl->tables[VULKAN_BINDLESS_IMAGE], image_count) ||
+        !TableInit(&bl->tables[VULKAN_BINDLESS_BUFFER], buffer_count)) {
+        PRINT_ERROR("Vulkan: Out of memory for bindless tables\n");
+        return false;
+    }
+
+    if (!CreateSamplers(bl, max_anisotropy)) {
+        return false;
+    }
+
+    // Tables are only partially filled and change while frames using them are in flight
+    VkDescriptorSetLayoutBinding bindings[3] = {
+        { 0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, image_count, VK_SHADER_STAGE_ALL, NULL },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer_count, VK_SHADER_STAGE_ALL, NULL },
+        { 2, VK_DESCRIPTOR_TYPE_SAMPLER, VULKAN_BINDLESS_SAMPLER_COUNT, VK_SHADER_STAGE_ALL, bl->samplers }
+    };
+    VkDescriptorBindingFlags binding_flags[3] = {
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+        0
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = 3,
+        .pBindingFlags = binding_flags
+    };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &binding_flags_info,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = 3,
+        .pBindings = bindings
+    };
+    if (vkCreateDescriptorSetLayout(device, &layout_info, NULL, &bl->setLayout) != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to create bindless descriptor set layout\n");
+        return false;
+    }
+
+    VkDescriptorPoolSize pool_sizes[3] = {
+        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, image_count },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer_count },
+        { VK_DESCRIPTOR_TYPE_SAMPLER, VULKAN_BINDLESS_SAMPLER_COUNT }
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = 3,
+        .pPoolSizes = pool_sizes
+    };
+    if (vkCreateDescriptorPool(device, &pool_info, NULL, &bl->pool) != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to create bindless descriptor pool\n");
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo set_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = bl->pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &bl->setLayout
+    };
+    if (vkAllocateDescriptorSets(device, &set_info, &bl->set) != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to allocate bindless descriptor set\n");
+        return false;
+    }
+
+    VkPushConstantRange push_constants = {
+        .stageFlags = VK_SHADER_STAGE_ALL,
+        .offset = 0,
+        .size = VULKAN_BINDLESS_PUSH_SIZE
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &bl->setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constants
+    };
+    if (vkCreatePipelineLayout(device, &pipeline_layout_info, NULL, &bl->pipelineLayout) != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to create bindless pipeline layout\n");
+        return false;
+    }
+
+    PRINT("Vulkan: Bindless tables: %u images, %u storage buffers\n", image_count, buffer_count);
+    return true;
+}
+
+void VulkanBindlessDestroy(VulkanBindless* bl)
+{
+    if (!bl->device) {
+        return;
+    }
+
+    if (bl->pipelineLayout) {
+        vkDestroyPipelineLayout(bl->device, bl->pipelineLayout, NULL);
+    }
+    if (bl->pool) {
+        vkDestroyDescriptorPool(bl->device, bl->pool, NULL);
+    }
+    if (bl->setLayout) {
+        vkDestroyDescriptorSetLayout(bl->device, bl->setLayout, NULL);
+    }
+    for (uint32_t i = 0; i < VULKAN_BINDLESS_SAMPLER_COUNT; i++) {
+        if (bl->samplers[i]) {
+            vkDestroySampler(bl->device, bl->samplers[i], NULL);
+        }
+    }
+    for (uint32_t i = 0; i < VULKAN_BINDLESS_TYPE_COUNT; i++) {
+        TableDestroy(&bl->tables[i]);
+    }
+    memset(bl, 0, sizeof(*bl));
+}
+
+// RESOURCES //////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t VulkanBindlessAddImage(VulkanBindless* bl, VkImageView view, VkImageLayout layout)
+{
+    uint32_t index = TableAlloc(&bl->tables[VULKAN_BINDLESS_IMAGE]);
+    if (index == VULKAN_BINDLESS_INVALID) {
+        PRINT_ERROR("Vulkan: Bindless image table full (%u)\n", bl->tables[VULKAN_BINDLESS_IMAGE].capacity);
+        return VULKAN_BINDLESS_INVALID;
+    }
+
+    VkDescriptorImageInfo image_info = {
+        .sampler = VK_NULL_HANDLE,
+        .imageView = view,
+        .imageLayout = layout
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = bl->set,
+        .dstBinding = 0,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        .pImageInfo = &image_info
+    };
+    vkUpdateDescriptorSets(bl->device, 1, &write, 0, NULL);
+    return index;
+}
+
+uint32_t VulkanBindlessAddBuffer(VulkanBindless* bl, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    uint32_t index = TableAlloc(&bl->tables[VULKAN_BINDLESS_BUFFER]);
+    if (index == VULKAN_BINDLESS_INVALID) {
+        PRINT_ERROR("Vulkan: Bindless buffer table full (%u)\n", bl->tables[VULKAN_BINDLESS_BUFFER].capacity);
+        return VULKAN_BINDLESS_INVALID;
+    }
+
+    VkDescriptorBufferInfo buffer_info = {
+        .buffer = buffer,
+        .offset = offset,
+        .range = range
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = bl->set,
+        .dstBinding = 1,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &buffer_info
+    };
+    vkUpdateDescriptorSets(bl->device, 1, &write, 0, NULL);
+    return index;
+}
+
+void VulkanBindlessRemove(VulkanBindless* bl, VulkanBindlessType type, uint32_t index)
+{
+    VulkanBindlessTable* table = &bl->tables[type];
+    uint32_t bit = 1u << (index % 32);
+    if (index >= table->next || !(table->live[index / 32] & bit)) {
+        PRINT_ERROR("Vulkan: Bindless index %u removed but not in use\n", index);
+        return;
+    }
+    table->live[index / 32] &= ~bit;
+
+    // The descriptor stays as is; with partially bound bindings nothing reads it once no draw uses the index
+    table->pending[table->pendingCount] = index;
+    table->pendingFrame[table->pendingCount] = bl->frameNumber;
+    table->pendingCount++;
+    table->used--;
+}
+
+void VulkanBindlessBeginFrame(VulkanBindless* bl, uint64_t frame_number)
+{
+    bl->frameNumber = frame_number;
+    for (uint32_t i = 0; i < VULKAN_BINDLESS_TYPE_COUNT; i++) {
+        if (bl->tables[i].pendingCount) {
+            TableRecycle(&bl->tables[i], frame_number, bl->framesInFlight);
+        }
+    }
+}
+
+// RECORDING //////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VulkanBindlessBind(VulkanBindless* bl, VkCommandBuffer cmd, VkPipelineBindPoint bind_point)
+{
+    vkCmdBindDescriptorSets(cmd, bind_point, bl->pipelineLayout, 0, 1, &bl->set, 0, NULL);
+}
+
+void VulkanBindlessPush(VulkanBindless* bl, VkCommandBuffer cmd, const void* data, uint32_t size)
+{
+    vkCmdPushConstants(cmd, bl->pipelineLayout, VK_SHADER_STAGE_ALL, 0, MIN(size, VULKAN_BINDLESS_PUSH_SIZE), data);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Requested table sizes, clamped to the device's update-after-bind limits
+#define VULKAN_BINDLESS_MAX_IMAGES      65536
+#define VULKAN_BINDLESS_MAX_BUFFERS     65536
+
+// Push constant block shared by every pipeline using the bindless layout
+#define VULKAN_BINDLESS_PUSH_SIZE       128
+
+#define VULKAN_BINDLESS_INVALID         0xFFFFFFFFu
+
+// Set 0 layout, mirrored in the shaders:
+//   binding 0: texture2D images[]       (sampled images, indexed with nonuniformEXT where divergent)
+//   binding 1: buffer { ... } buffers[] (storage buffers)
+//   binding 2: sampler samplers[VULKAN_BINDLESS_SAMPLER_COUNT] (immutable)
+typedef enum VulkanBindlessType {
+    VULKAN_BINDLESS_IMAGE,
+    VULKAN_BINDLESS_BUFFER,
+    VULKAN_BINDLESS_TYPE_COUNT
+} VulkanBindlessType;
+
+typedef enum VulkanBindlessSampler {
+    VULKAN_BINDLESS_SAMPLER_LINEAR_REPEAT,
+    VULKAN_BINDLESS_SAMPLER_LINEAR_CLAMP,
+    VULKAN_BINDLESS_SAMPLER_NEAREST_REPEAT,
+    VULKAN_BINDLESS_SAMPLER_NEAREST_CLAMP,
+    VULKAN_BINDLESS_SAMPLER_COUNT
+} VulkanBindlessSampler;
+
+// Index allocator for one binding. Indices never handed out yet are above next; released ones wait
+// in pending until the frames that may still read them have retired, then go on the free list.
+typedef struct VulkanBindlessTable {
+    uint32_t  capacity;
+    uint32_t  next;
+    uint32_t* freeList;
+    uint32_t  freeCount;
+    uint32_t* pending;
+    uint64_t* pendingFrame;         // Frame in which pending[i] was released
+    uint32_t  pendingCount;
+    uint32_t  used;
+    uint32_t* live;                 // Bit per index, set from TableAlloc until the index is removed
+} VulkanBindlessTable;
+
+// One update-after-bind descriptor set holding every texture and storage buffer. It is bound once
+// per command buffer; draws select resources through indices in their push constants.
+// Not thread-safe; owned by the thread that records and submits Vulkan work.
+typedef struct VulkanBindless {
+    VkDevice              device;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool      pool;
+    VkDescriptorSet       set;
+    VkPipelineLayout      pipelineLayout;     // Set 0 plus VULKAN_BINDLESS_PUSH_SIZE bytes of push constants
+    VkSampler             samplers[VULKAN_BINDLESS_SAMPLER_COUNT];
+    VulkanBindlessTable   tables[VULKAN_BINDLESS_TYPE_COUNT];
+    uint32_t              framesInFlight;
+    uint64_t              frameNumber;
+} VulkanBindless;
+
+// max_anisotropy 0 disables anisotropic filtering on the linear samplers
+bool VulkanBindlessInit(VulkanBindless* bl, VkPhysicalDevice gpu, VkDevice device, uint32_t frames_in_flight,
+                        float max_anisotropy);
+void VulkanBindlessDestroy(VulkanBindless* bl);
+
+// Write a resource into a free slot and return its index, VULKAN_BINDLESS_INVALID when the table is full.
+// The slot can be written while command buffers using the set are pending.
+uint32_t VulkanBindlessAddImage(VulkanBindless* bl, VkImageView view, VkImageLayout layout);
+uint32_t VulkanBindlessAddBuffer(VulkanBindless* bl, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+
+// Releases an index. It is reused only after the frames in flight that may reference it have completed.
+// Removing an index that is not handed out (twice, or never added) is reported and ignored.
+void VulkanBindlessRemove(VulkanBindless* bl, VulkanBindlessType type, uint32_t index);
+
+// Call once per frame after the frame's fence wait; recycles indices released framesInFlight frames ago
+void VulkanBindlessBeginFrame(VulkanBindless* bl, uint64_t frame_number);
+
+void VulkanBindlessBind(VulkanBindless* bl, VkCommandBuffer cmd, VkPipelineBindPoint bind_point);
+void VulkanBindlessPush(VulkanBindless* bl, VkCommandBuffer cmd, const void* data, uint32_t size);
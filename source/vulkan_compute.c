@@ -0,0 +1,298 @@
+#include "vulkan_compute.h"
+#include "vulkan_memory.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// SYNCHRONIZATION ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VulkanComputeIsComplete(VulkanCompute* cs, uint64_t value)
+{
+    if (value > cs->completed) {
+        vkGetSemaphoreCounterValue(cs->device, cs->timeline, &cs->completed);
+    }
+    return value <= cs->completed;
+}
+
+void VulkanComputeWait(VulkanCompute* cs, uint64_t value)
+{
+    if (VulkanComputeIsComplete(cs, value)) {
+        return;
+    }
+
+    VkSemaphoreWaitInfo wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &cs->timeline,
+        .pValues = &value
+    };
+    vkWaitSemaphores(cs->device, &wait_info, UINT64_MAX);
+    vkGetSemaphoreCounterValue(cs->device, cs->timeline, &cs->completed);
+}
+
+// SETUP //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VulkanComputeInit(VulkanCompute* cs, VkDevice device, VkQueue queue, uint32_t queue_family,
+                       uint32_t graphics_queue_family, uint32_t frames_in_flight)
+{
+    memset(cs, 0, sizeof(*cs));
+    cs->device = device;
+    cs->queue = queue;
+    cs->queueFamily = queue_family;
+    cs->graphicsQueueFamily = graphics_queue_family;
+    cs->async = queue_family != graphics_queue_family;
+
+    VkSemaphoreTypeCreateInfo type_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0
+    };
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_info
+    };
+    VKCALL(vkCreateSemaphore(device, &semaphore_info, NULL, &cs->timeline), "vkCreateSemaphore(compute timeline)");
+
+    cs->frames = (VulkanComputeFrame*)calloc(frames_in_flight, sizeof(VulkanComputeFrame));
+    if (!cs->frames) {
+        return false;
+    }
+    cs->framesInFlight = frames_in_flight;
+
+    for (uint32_t i = 0; i < frames_in_flight; i++) {
+        VulkanComputeFrame* frame = &cs->frames[i];
+        VkCommandPoolCreateInfo pool_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = queue_family
+        };
+        VKCALL(vkCreateCommandPool(device, &pool_info, NULL, &frame->pool), "vkCreateCommandPool(compute)");
+
+        VkCommandBufferAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = frame->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = VULKAN_COMPUTE_MAX_SUBMITS
+        };
+        VKCALL(vkAllocateCommandBuffers(device, &alloc_info, frame->cmds), "vkAllocateCommandBuffers(compute)");
+    }
+
+    PRINT("Vulkan: Compute on queue family %u%s\n", queue_family, cs->async ? " (async)" : " (graphics)");
+    return true;
+}
+
+void VulkanComputeDestroy(VulkanCompute* cs)
+{
+    if (!cs->device) {
+        return;
+    }
+
+    if (cs->recording) {
+        VulkanComputeSubmit(cs, VK_NULL_HANDLE, 0);
+    }
+    VulkanComputeWait(cs, cs->submitted);
+    PRINT_DEBUG("Vulkan: %llu compute submissions, %u stalls on frame slots\n",
+                (unsigned long long)cs->submitted, cs->stalls);
+
+    for (uint32_t i = 0; i < cs->framesInFlight; i++) {
+        if (cs->frames[i].pool) {
+            vkDestroyCommandPool(cs->device, cs->frames[i].pool, NULL);
+        }
+    }
+    free(cs->frames);
+    vkDestroySemaphore(cs->device, cs->timeline, NULL);
+    free(cs->bufferAcquires);
+    free(cs->imageAcquires);
+    memset(cs, 0, sizeof(*cs));
+}
+
+// SUBMISSION /////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VkCommandBuffer VulkanComputeBegin(VulkanCompute* cs, uint64_t frame_number)
+{
+    if (cs->recording) {
+        return cs->recording;
+    }
+
+    // First submission of a new frame: the slot was last used framesInFlight frames ago
+    if (!cs->current || cs->frameNumber != frame_number) {
+        VulkanComputeFrame* frame = &cs->frames[frame_number % cs->framesInFlight];
+        if (frame->value && !VulkanComputeIsComplete(cs, frame->value)) {
+            cs->stalls++;
+            VulkanComputeWait(cs, frame->value);
+        }
+        vkResetCommandPool(cs->device, frame->pool, 0);
+        frame->used = 0;
+        cs->current = frame;
+        cs->frameNumber = frame_number;
+    }
+
+    VulkanComputeFrame* frame = cs->current;
+    if (frame->used == VULKAN_COMPUTE_MAX_SUBMITS) {
+        PRINT_ERROR("Vulkan: More than %u compute submissions in frame %llu\n", VULKAN_COMPUTE_MAX_SUBMITS,
+                    (unsigned long long)frame_number);
+        return VK_NULL_HANDLE;
+    }
+
+    VkCommandBuffer cmd = frame->cmds[frame->used];
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    if (vkBeginCommandBuffer(cmd, &begin_info) != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to begin compute command buffer\n");
+        return VK_NULL_HANDLE;
+    }
+
+    frame->used++;
+    cs->recording = cmd;
+    return cmd;
+}
+
+uint64_t VulkanComputeSubmit(VulkanCompute* cs, VkSemaphore wait_semaphore, uint64_t wait_value)
+{
+    if (!cs->recording) {
+        return 0;
+    }
+
+    VkCommandBuffer cmd = cs->recording;
+    cs->recording = VK_NULL_HANDLE;
+    vkEndCommandBuffer(cmd);
+
+    uint64_t value = cs->submitted + 1;
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = wait_semaphore ? 1u : 0u,
+        .pWaitSemaphoreValues = &wait_value,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &value
+    };
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timeline_info,
+        .waitSemaphoreCount = wait_semaphore ? 1u : 0u,
+        .pWaitSemaphores = &wait_semaphore,
+        .pWaitDstStageMask = &wait_stage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &cs->timeline
+    };
+    VkResult result = vkQueueSubmit(cs->queue, 1, &submit_info, VK_NULL_HANDLE);
+    if (result != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Compute submission failed (%d)\n", result);
+        // The releases recorded into it never happen, so graphics must not acquire them
+        cs->bufferAcquireCount = cs->bufferAcquireReady;
+        cs->imageAcquireCount = cs->imageAcquireReady;
+        return 0;
+    }
+
+    cs->submitted = value;
+    cs->current->value = value;
+
+    // Releases recorded into this submission can now be acquired on graphics
+    if (cs->bufferAcquireReady != cs->bufferAcquireCount || cs->imageAcquireReady != cs->imageAcquireCount) {
+        cs->bufferAcquireReady = cs->bufferAcquireCount;
+        cs->imageAcquireReady = cs->imageAcquireCount;
+        cs->acquireValue = value;
+    }
+    return value;
+}
+
+// OWNERSHIP //////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VulkanComputeReleaseBuffer(VulkanCompute* cs, VkBuffer buffer, VkPipelineStageFlags src_stage,
+                                VkAccessFlags src_access, VkAccessFlags dst_access)
+{
+    // One queue family: the timeline semaphore alone makes the writes available to graphics
+    if (!cs->recording || !cs->async) {
+        return true;
+    }
+
+    // A release without its acquire would leave the buffer owned by neither queue
+    if (!VulkanMemoryReserveArray((void**)&cs->bufferAcquires, cs->bufferAcquireCount, &cs->bufferAcquireCapacity,
+                                  sizeof(VkBufferMemoryBarrier))) {
+        PRINT_ERROR("Vulkan: Failed to grow compute acquire list\n");
+        return false;
+    }
+
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = src_access,
+        .dstAccessMask = dst_access,
+        .srcQueueFamilyIndex = cs->queueFamily,
+        .dstQueueFamilyIndex = cs->graphicsQueueFamily,
+        .buffer = buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(cs->recording, src_stage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, NULL, 1, &barrier, 0, NULL);
+    cs->bufferAcquires[cs->bufferAcquireCount++] = barrier;
+    return true;
+}
+
+bool VulkanComputeReleaseImage(VulkanCompute* cs, VkImage image, VkImageSubresourceRange range,
+                               VkImageLayout old_layout, VkImageLayout new_layout,
+                               VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkAccessFlags dst_access)
+{
+    if (!cs->recording || (!cs->async && old_layout == new_layout)) {
+        return true;
+    }
+    if (cs->async && !VulkanMemoryReserveArray((void**)&cs->imageAcquires, cs->imageAcquireCount,
+                                               &cs->imageAcquireCapacity, sizeof(VkImageMemoryBarrier))) {
+        PRINT_ERROR("Vulkan: Failed to grow compute acquire list\n");
+        return false;
+    }
+
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = src_access,
+        .dstAccessMask = cs->async ? dst_access : 0,
+        .oldLayout = old_layout,
+        .newLayout = new_layout,
+        .srcQueueFamilyIndex = cs->async ? cs->queueFamily : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = cs->async ? cs->graphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = range
+    };
+    vkCmdPipelineBarrier(cs->recording, src_stage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, NULL, 0, NULL, 1, &barrier);
+    if (cs->async) {
+        cs->imageAcquires[cs->imageAcquireCount++] = barrier;
+    }
+    return true;
+}
+
+uint64_t VulkanComputeAcquire(VulkanCompute* cs, VkCommandBuffer cmd, VkPipelineStageFlags stage)
+{
+    uint32_t buffer_count = cs->bufferAcquireReady;
+    uint32_t image_count = cs->imageAcquireReady;
+    if (buffer_count == 0 && image_count == 0) {
+        return 0;
+    }
+
+    // The acquire half repeats the release with no source access; it chains to the semaphore wait at stage
+    for (uint32_t i = 0; i < buffer_count; i++) {
+        cs->bufferAcquires[i].srcAccessMask = 0;
+    }
+    for (uint32_t i = 0; i < image_count; i++) {
+        cs->imageAcquires[i].srcAccessMask = 0;
+    }
+    vkCmdPipelineBarrier(cmd, stage, stage, 0, 0, NULL, buffer_count, cs->bufferAcquires, image_count, cs->imageAcquires);
+
+    // Releases recorded into a command buffer that is still open wait for the next call
+    cs->bufferAcquireCount -= buffer_count;
+    cs->imageAcquireCount -= image_count;
+    if (cs->bufferAcquireCount) {
+        memmove(cs->bufferAcquires, cs->bufferAcquires + buffer_count, cs->bufferAcquireCount * sizeof(VkBufferMemoryBarrier));
+    }
+    if (cs->imageAcquireCount) {
+        memmove(cs->imageAcquires, cs->imageAcquires + image_count, cs->imageAcquireCount * sizeof(VkImageMemoryBarrier));
+    }
+    cs->bufferAcquireReady = 0;
+    cs->imageAcquireReady = 0;
+    return cs->acquireValue;
+}
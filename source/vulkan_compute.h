@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Submissions one frame may make on the compute queue (e.g. culling before rendering, post-processing
+// of the previous frame)
+#define VULKAN_COMPUTE_MAX_SUBMITS      4
+
+typedef struct VulkanComputeFrame {
+    VkCommandPool   pool;
+    VkCommandBuffer cmds[VULKAN_COMPUTE_MAX_SUBMITS];
+    uint32_t        used;           // Command buffers begun this frame
+    uint64_t        value;          // Timeline value of the frame's last submission; the pool is free once reached
+} VulkanComputeFrame;
+
+// Work on the compute queue, running beside the graphics queue when the GPU has an async compute
+// family. Every submission signals a timeline semaphore; graphics submissions wait on a value at the
+// stage that consumes the results, and compute waits on the graphics timeline for inputs rendered
+// earlier, so the two queues only meet where data actually flows.
+//
+// With separate families, exclusive resources handed to graphics are released with
+// VulkanComputeReleaseBuffer/Image on the compute side; the matching acquires are recorded into the
+// graphics command buffer by VulkanComputeAcquire.
+// Not thread-safe; owned by the thread that records and submits Vulkan work.
+typedef struct VulkanCompute {
+    VkDevice           device;
+    VkQueue            queue;
+    uint32_t           queueFamily;
+    uint32_t           graphicsQueueFamily;
+    bool               async;       // Own family, runs concurrently with graphics
+
+    VkSemaphore        timeline;
+    uint64_t           submitted;   // Value of the last submission
+    uint64_t           completed;   // Last value the GPU was seen to reach
+
+    VulkanComputeFrame* frames;
+    uint32_t           framesInFlight;
+    VulkanComputeFrame* current;    // Frame recording, set by the first VulkanComputeBegin of a frame
+    uint64_t           frameNumber;
+    VkCommandBuffer    recording;   // Begun and not submitted yet
+
+    // Ownership acquires graphics has to record for resources released by submitted compute work
+    VkBufferMemoryBarrier* bufferAcquires;
+    uint32_t           bufferAcquireCount;
+    uint32_t           bufferAcquireCapacity;
+    VkImageMemoryBarrier*  imageAcquires;
+    uint32_t           imageAcquireCount;
+    uint32_t           imageAcquireCapacity;
+    uint32_t           bufferAcquireReady;  // Acquires [0, ready) belong to submitted work
+    uint32_t           imageAcquireReady;
+    uint64_t           acquireValue;        // Submission that released the ready ones
+
+    uint32_t           stalls;      // Times a frame's pool was still in use on the GPU
+} VulkanCompute;
+
+bool VulkanComputeInit(VulkanCompute* cs, VkDevice device, VkQueue queue, uint32_t queue_family,
+                       uint32_t graphics_queue_family, uint32_t frames_in_flight);
+void VulkanComputeDestroy(VulkanCompute* cs);
+
+// Opens a command buffer for the next submission of frame frame_number. Recycles the frame slot's
+// command buffers first, waiting only if its submissions from framesInFlight frames ago are still running.
+VkCommandBuffer VulkanComputeBegin(VulkanCompute* cs, uint64_t frame_number);
+
+// Submits the open command buffer. It starts once wait_semaphore reaches wait_value (pass VK_NULL_HANDLE
+// for no wait), e.g. the graphics timeline value of the frame whose output it reads. Returns the value
+// signalled on cs->timeline when it has executed, 0 on failure.
+uint64_t VulkanComputeSubmit(VulkanCompute* cs, VkSemaphore wait_semaphore, uint64_t wait_value);
+
+// Hands a resource written by the open command buffer to the graphics queue; dst_access is how graphics
+// first uses it. Without an async family the semaphore covers buffers and only images get a barrier.
+// Returns false, recording nothing, when the matching acquire cannot be queued.
+bool VulkanComputeReleaseBuffer(VulkanCompute* cs, VkBuffer buffer, VkPipelineStageFlags src_stage,
+                                VkAccessFlags src_access, VkAccessFlags dst_access);
+bool VulkanComputeReleaseImage(VulkanCompute* cs, VkImage image, VkImageSubresourceRange range,
+                               VkImageLayout old_layout, VkImageLayout new_layout,
+                               VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkAccessFlags dst_access);
+
+// Records the acquires of submitted releases into a graphics command buffer, to complete before stage.
+// Its submission must wait on cs->timeline for the returned value at stage (0 when nothing was released).
+uint64_t VulkanComputeAcquire(VulkanCompute* cs, VkCommandBuffer cmd, VkPipelineStageFlags stage);
+
+bool VulkanComputeIsComplete(VulkanCompute* cs, uint64_t value);
+void VulkanComputeWait(VulkanCompute* cs, uint64_t value);
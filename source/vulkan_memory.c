@@ -0,0 +1,664 @@
+#include "vulkan_memory.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define VULKAN_MEMORY_NO_TYPE 0xFFFFFFFFu
+
+// MEMORY TYPES ///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void UsageFlags(VulkanMemoryUsage usage, VkMemoryPropertyFlags* required, VkMemoryPropertyFlags* preferred)
+{
+    switch (usage) {
+        case VULKAN_MEMORY_CPU_TO_GPU:
+            *required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            *preferred = 0;
+            break;
+        case VULKAN_MEMORY_GPU_TO_CPU:
+            *required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            *preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        case VULKAN_MEMORY_GPU_ONLY:
+        default:
+            *required = 0;
+            *preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+    }
+}
+
+// Allowed type with all required flags and the fewest missing preferred ones. Drivers list types
+// in order of preference, so ties go to the first.
+static uint32_t FindMemoryType(const VulkanMemory* mem, uint32_t type_bits, VulkanMemoryUsage usage)
+{
+    VkMemoryPropertyFlags required, preferred;
+    UsageFlags(usage, &required, &preferred);
+
+    uint32_t best = VULKAN_MEMORY_NO_TYPE;
+    uint32_t best_cost = UINT32_MAX;
+    for (uint32_t i = 0; i < mem->properties.memoryTypeCount; i++) {
+        VkMemoryPropertyFlags flags = mem->properties.memoryTypes[i].propertyFlags;
+        if (!(type_bits & (1u << i)) || (flags & required) != required) {
+            continue;
+        }
+
+        uint32_t cost = 0;
+        for (VkMemoryPropertyFlags missing = preferred & ~flags; missing; missing &= missing - 1) {
+            cost += 2;
+        }
+        // Keep host-visible memory (often the small BAR heap) for the resources that map it
+        if (usage == VULKAN_MEMORY_GPU_ONLY && (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+            cost += 1;
+        }
+
+        if (cost < best_cost) {
+            best = i;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+static bool IsHostVisible(const VulkanMemory* mem, uint32_t type)
+{
+    return (mem->properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+static bool IsHostCoherent(const VulkanMemory* mem, uint32_t type)
+{
+    return (mem->properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+// DEVICE MEMORY //////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool AllocateDeviceMemory(VulkanMemory* mem, uint32_t type, VkDeviceSize size,
+                                 const VkMemoryDedicatedAllocateInfo* dedicated_info,
+                                 VkDeviceMemory* memory, void** mapped)
+{
+    if (mem->deviceAllocationCount >= mem->maxAllocationCount) {
+        PRINT_WARNING("Vulkan: Device memory allocation limit (%u) reached\n", mem->maxAllocationCount);
+        return false;
+    }
+
+    VkMemoryAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = dedicated_info,
+        .allocationSize = size,
+        .memoryTypeIndex = type
+    };
+
+    if (vkAllocateMemory(mem->device, &allocate_info, NULL, memory) != VK_SUCCESS) {
+        return false;
+    }
+
+    // Host-visible memory stays mapped for its whole lifetime
+    *mapped = NULL;
+    if (IsHostVisible(mem, type)) {
+        if (vkMapMemory(mem->device, *memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+            PRINT_ERROR("Vulkan: Failed to map %llu bytes of memory type %u\n", (unsigned long long)size, type);
+            vkFreeMemory(mem->device, *memory, NULL);
+            *memory = VK_NULL_HANDLE;
+            return false;
+        }
+    }
+
+    mem->deviceAllocationCount++;
+    return true;
+}
+
+static void FreeDeviceMemory(VulkanMemory* mem, VkDeviceMemory memory)
+{
+    // Freeing implicitly unmaps
+    vkFreeMemory(mem->device, memory, NULL);
+    mem->deviceAllocationCount--;
+}
+
+// BLOCKS /////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t CreateBlock(VulkanMemory* mem, uint32_t type, uint32_t kind, VkDeviceSize min_size)
+{
+    VulkanMemoryPool* pool = &mem->pools[type][kind];
+
+    // Reuse the slot of a destroyed block so live allocations keep their indices
+    uint32_t index = 0;
+    while (index < pool->blockCount && pool->blocks[index].memory != VK_NULL_HANDLE) {
+        index++;
+    }
+    if (index == pool->blockCount) {
+        if (pool->blockCount == pool->blockCapacity) {
+            uint32_t capacity = pool->blockCapacity ? pool->blockCapacity * 2 : 4;
+            VulkanMemoryBlock* blocks = (VulkanMemoryBlock*)realloc(pool->blocks, capacity * sizeof(VulkanMemoryBlock));
+            if (!blocks) {
+                return VULKAN_MEMORY_NO_BLOCK;
+            }
+            pool->blocks = blocks;
+            pool->blockCapacity = capacity;
+        }
+        memset(&pool->blocks[index], 0, sizeof(VulkanMemoryBlock));
+        pool->blockCount++;
+    }
+
+    // Under memory pressure settle for smaller blocks, as long as the request still fits
+    VulkanMemoryBlock* block = &pool->blocks[index];
+    VkDeviceSize size = mem->blockSize[mem->properties.memoryTypes[type].heapIndex];
+    while (!AllocateDeviceMemory(mem, type, size, NULL, &block->memory, &block->mapped)) {
+        size /= 2;
+        if (size < min_size || mem->deviceAllocationCount >= mem->maxAllocationCount) {
+            return VULKAN_MEMORY_NO_BLOCK;
+        }
+    }
+
+    if (!TlsfInit(&block->tlsf, size)) {
+        FreeDeviceMemory(mem, block->memory);
+        block->memory = VK_NULL_HANDLE;
+        return VULKAN_MEMORY_NO_BLOCK;
+    }
+
+    block->size = size;
+    PRINT_DEBUG("Vulkan: New %llu KiB block for memory type %u (%s)\n", (unsigned long long)(size / 1024), type,
+                kind == VULKAN_MEMORY_KIND_OPTIMAL ? "images" : "buffers");
+    return index;
+}
+
+static void DestroyBlock(VulkanMemory* mem, VulkanMemoryBlock* block)
+{
+    TlsfDestroy(&block->tlsf);
+    FreeDeviceMemory(mem, block->memory);
+    block->memory = VK_NULL_HANDLE;
+    block->mapped = NULL;
+    block->size = 0;
+}
+
+// One empty block per pool is kept around so an alloc/free pattern at a block boundary does not
+// hit vkAllocateMemory every time
+static void ReleaseIfEmpty(VulkanMemory* mem, VulkanMemoryPool* pool, uint32_t index)
+{
+    VulkanMemoryBlock* block = &pool->blocks[index];
+    if (block->tlsf.allocationCount != 0) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < pool->blockCount; i++) {
+        if (i != index && pool->blocks[i].memory != VK_NULL_HANDLE && pool->blocks[i].tlsf.allocationCount == 0) {
+            DestroyBlock(mem, block);
+            return;
+        }
+    }
+}
+
+static bool AllocFromBlock(VulkanMemory* mem, uint32_t type, uint32_t kind, uint32_t index, VkDeviceSize size,
+                           VkDeviceSize alignment, void* user_data, VulkanAllocation* allocation)
+{
+    VulkanMemoryBlock* block = &mem->pools[type][kind].blocks[index];
+    uint32_t node = TlsfAlloc(&block->tlsf, size, alignment, user_data);
+    if (node == TLSF_NULL) {
+        return false;
+    }
+
+    allocation->memory = block->memory;
+    allocation->offset = TlsfOffset(&block->tlsf, node);
+    allocation->size = size;
+    allocation->mapped = block->mapped ? (uint8_t*)block->mapped + allocation->offset : NULL;
+    allocation->memoryType = type;
+    allocation->kind = kind;
+    allocation->block = index;
+    allocation->node = node;
+    return true;
+}
+
+// ALLOCATOR //////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VulkanMemoryInit(VulkanMemory* mem, VkPhysicalDevice gpu, VkDevice device)
+{
+    memset(mem, 0, sizeof(*mem));
+    mem->device = device;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+    vkGetPhysicalDeviceMemoryProperties(gpu, &mem->properties);
+
+    mem->maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+    mem->nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+
+    for (uint32_t i = 0; i < mem->properties.memoryHeapCount; i++) {
+        VkDeviceSize heap_size = mem->properties.memoryHeaps[i].size;
+        mem->blockSize[i] = heap_size <= VULKAN_MEMORY_SMALL_HEAP_SIZE ? heap_size / 8 : VULKAN_MEMORY_BLOCK_SIZE;
+    }
+
+    PRINT("Vulkan: Memory allocator ready, %u types in %u heaps, %u allocations max\n",
+          mem->properties.memoryTypeCount, mem->properties.memoryHeapCount, mem->maxAllocationCount);
+    return true;
+}
+
+void VulkanMemoryDestroy(VulkanMemory* mem)
+{
+    if (!mem->device) {
+        return;
+    }
+
+    for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; type++) {
+        for (uint32_t kind = 0; kind < VULKAN_MEMORY_KIND_COUNT; kind++) {
+            VulkanMemoryPool* pool = &mem->pools[type][kind];
+            for (uint32_t i = 0; i < pool->blockCount; i++) {
+                VulkanMemoryBlock* block = &pool->blocks[i];
+                if (block->memory == VK_NULL_HANDLE) {
+                    continue;
+                }
+                if (block->tlsf.allocationCount) {
+                    PRINT_WARNING("Vulkan: %u allocations leaked in memory type %u\n", block->tlsf.allocationCount, type);
+                }
+                DestroyBlock(mem, block);
+            }
+            free(pool->blocks);
+        }
+        if (mem->dedicated[type].allocationCount) {
+            PRINT_WARNING("Vulkan: %u dedicated allocations leaked in memory type %u\n",
+                          mem->dedicated[type].allocationCount, type);
+        }
+    }
+
+    memset(mem, 0, sizeof(*mem));
+}
+
+static bool AllocFromType(VulkanMemory* mem, uint32_t type, const VkMemoryRequirements* requirements,
+                          VulkanMemoryKind kind, bool dedicated, const VkMemoryDedicatedAllocateInfo* dedicated_info,
+                          void* user_data, VulkanAllocation* allocation)
+{
+    VkDeviceSize block_size = mem->blockSize[mem->properties.memoryTypes[type].heapIndex];
+    if (requirements->size >= block_size / VULKAN_MEMORY_DEDICATED_DIVISOR) {
+        dedicated = true;
+    }
+
+    // Non-coherent ranges are flushed in whole atoms, so keep neighbours out of each other's atoms
+    VkDeviceSize alignment = requirements->alignment ? requirements->alignment : 1;
+    if (IsHostVisible(mem, type) && !IsHostCoherent(mem, type) && alignment < mem->nonCoherentAtomSize) {
+        alignment = mem->nonCoherentAtomSize;
+    }
+
+    if (!dedicated) {
+        VulkanMemoryPool* pool = &mem->pools[type][kind];
+        for (uint32_t i = 0; i < pool->blockCount; i++) {
+            if (pool->blocks[i].memory != VK_NULL_HANDLE &&
+                AllocFromBlock(mem, type, kind, i, requirements->size, alignment, user_data, allocation)) {
+                return true;
+            }
+        }
+
+        uint32_t index = CreateBlock(mem, type, kind, requirements->size + alignment);
+        if (index != VULKAN_MEMORY_NO_BLOCK &&
+            AllocFromBlock(mem, type, kind, index, requirements->size, alignment, user_data, allocation)) {
+            return true;
+        }
+    }
+
+    // Dedicated, or the pool could not grow: give the resource its own memory object
+    VkDeviceMemory memory;
+    void* mapped;
+    if (!AllocateDeviceMemory(mem, type, requirements->size, dedicated_info, &memory, &mapped)) {
+        return false;
+    }
+
+    allocation->memory = memory;
+    allocation->offset = 0;
+    allocation->size = requirements->size;
+    allocation->mapped = mapped;
+    allocation->memoryType = type;
+    allocation->kind = kind;
+    allocation->block = VULKAN_MEMORY_NO_BLOCK;
+    allocation->node = TLSF_NULL;
+
+    mem->dedicated[type].reserved += requirements->size;
+    mem->dedicated[type].used += requirements->size;
+    mem->dedicated[type].allocationCount++;
+    mem->dedicated[type].dedicatedCount++;
+    return true;
+}
+
+static bool Alloc(VulkanMemory* mem, const VkMemoryRequirements* requirements, VulkanMemoryUsage usage,
+                  VulkanMemoryKind kind, bool dedicated, const VkMemoryDedicatedAllocateInfo* dedicated_info,
+                  void* user_data, VulkanAllocation* allocation)
+{
+    memset(allocation, 0, sizeof(*allocation));
+
+    // When a heap is exhausted move on to the next best type the resource accepts
+    uint32_t type_bits = requirements->memoryTypeBits;
+    for (;;) {
+        uint32_t type = FindMemoryType(mem, type_bits, usage);
+        if (type == VULKAN_MEMORY_NO_TYPE) {
+            PRINT_ERROR("Vulkan: Out of device memory allocating %llu bytes\n", (unsigned long long)requirements->size);
+            return false;
+        }
+        if (AllocFromType(mem, type, requirements, kind, dedicated, dedicated_info, user_data, allocation)) {
+            return true;
+        }
+        type_bits &= ~(1u << type);
+    }
+}
+
+bool VulkanMemoryAlloc(VulkanMemory* mem, const VkMemoryRequirements* requirements, VulkanMemoryUsage usage,
+                       VulkanMemoryKind kind, bool dedicated, void* user_data, VulkanAllocation* allocation)
+{
+    return Alloc(mem, requirements, usage, kind, dedicated, NULL, user_data, allocation);
+}
+
+void VulkanMemoryFree(VulkanMemory* mem, VulkanAllocation* allocation)
+{
+    if (allocation->memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    uint32_t type = allocation->memoryType;
+    if (allocation->block == VULKAN_MEMORY_NO_BLOCK) {
+        FreeDeviceMemory(mem, allocation->memory);
+        mem->dedicated[type].reserved -= allocation->size;
+        mem->dedicated[type].used -= allocation->size;
+        mem->dedicated[type].allocationCount--;
+        mem->dedicated[type].dedicatedCount--;
+    } else {
+        VulkanMemoryPool* pool = &mem->pools[type][allocation->kind];
+        TlsfFree(&pool->blocks[allocation->block].tlsf, allocation->node);
+        ReleaseIfEmpty(mem, pool, allocation->block);
+    }
+
+    memset(allocation, 0, sizeof(*allocation));
+}
+
+// Non-coherent ranges must cover whole atoms; sub-allocations start on an atom boundary
+static VkMappedMemoryRange MappedRange(const VulkanMemory* mem, const VulkanAllocation* allocation)
+{
+    VkMappedMemoryRange range = {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = allocation->memory,
+        .offset = allocation->offset,
+        .size = VK_WHOLE_SIZE
+    };
+
+    if (allocation->block != VULKAN_MEMORY_NO_BLOCK) {
+        VkDeviceSize atom = mem->nonCoherentAtomSize;
+        VkDeviceSize block_size = mem->pools[allocation->memoryType][allocation->kind].blocks[allocation->block].size;
+        range.size = (allocation->size + atom - 1) / atom * atom;
+        if (range.offset + range.size > block_size) {
+            range.size = VK_WHOLE_SIZE;
+        }
+    }
+    return range;
+}
+
+void VulkanMemoryFlush(VulkanMemory* mem, const VulkanAllocation* allocation)
+{
+    if (allocation->mapped && !IsHostCoherent(mem, allocation->memoryType)) {
+        VkMappedMemoryRange range = MappedRange(mem, allocation);
+        vkFlushMappedMemoryRanges(mem->device, 1, &range);
+    }
+}
+
+void VulkanMemoryInvalidate(VulkanMemory* mem, const VulkanAllocation* allocation)
+{
+    if (allocation->mapped && !IsHostCoherent(mem, allocation->memoryType)) {
+        VkMappedMemoryRange range = MappedRange(mem, allocation);
+        vkInvalidateMappedMemoryRanges(mem->device, 1, &range);
+    }
+}
+
+// RESOURCES //////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VulkanMemoryCreateBuffer(VulkanMemory* mem, const VkBufferCreateInfo* info, VulkanMemoryUsage usage,
+                              VkBuffer* buffer, VulkanAllocation* allocation)
+{
+    if (vkCreateBuffer(mem->device, info, NULL, buffer) != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to create buffer of %llu bytes\n", (unsigned long long)info->size);
+        return false;
+    }
+
+    VkMemoryDedicatedRequirements dedicated_requirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS
+    };
+    VkMemoryRequirements2 requirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        .pNext = &dedicated_requirements
+    };
+    VkBufferMemoryRequirementsInfo2 requirements_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2,
+        .buffer = *buffer
+    };
+    vkGetBufferMemoryRequirements2(mem->device, &requirements_info, &requirements);
+
+    VkMemoryDedicatedAllocateInfo dedicated_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .buffer = *buffer
+    };
+    bool dedicated = dedicated_requirements.requiresDedicatedAllocation || dedicated_requirements.prefersDedicatedAllocation;
+
+    if (!Alloc(mem, &requirements.memoryRequirements, usage, VULKAN_MEMORY_KIND_LINEAR, dedicated, &dedicated_info,
+               *buffer, allocation)) {
+        vkDestroyBuffer(mem->device, *buffer, NULL);
+        *buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (vkBindBufferMemory(mem->device, *buffer, allocation->memory, allocation->offset) != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to bind buffer memory\n");
+        VulkanMemoryDestroyBuffer(mem, *buffer, allocation);
+        *buffer = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+bool VulkanMemoryCreateImage(VulkanMemory* mem, const VkImageCreateInfo* info, VulkanMemoryUsage usage,
+                             VkImage* image, VulkanAllocation* allocation)
+{
+    if (vkCreateImage(mem->device, info, NULL, image) != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to create %ux%u image\n", info->extent.width, info->extent.height);
+        return false;
+    }
+
+    VkMemoryDedicatedRequirements dedicated_requirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS
+    };
+    VkMemoryRequirements2 requirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        .pNext = &dedicated_requirements
+    };
+    VkImageMemoryRequirementsInfo2 requirements_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+        .image = *image
+    };
+    vkGetImageMemoryRequirements2(mem->device, &requirements_info, &requirements);
+
+    VkMemoryDedicatedAllocateInfo dedicated_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .image = *image
+    };
+    bool dedicated = dedicated_requirements.requiresDedicatedAllocation || dedicated_requirements.prefersDedicatedAllocation;
+
+    // Render targets and storage images are big, long-lived and often resized: give them their own memory
+    if (info->usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                       VK_IMAGE_USAGE_STORAGE_BIT)) {
+        dedicated = true;
+    }
+
+    VulkanMemoryKind kind = info->tiling == VK_IMAGE_TILING_OPTIMAL ? VULKAN_MEMORY_KIND_OPTIMAL : VULKAN_MEMORY_KIND_LINEAR;
+    if (!Alloc(mem, &requirements.memoryRequirements, usage, kind, dedicated, &dedicated_info, *image, allocation)) {
+        vkDestroyImage(mem->device, *image, NULL);
+        *image = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (vkBindImageMemory(mem->device, *image, allocation->memory, allocation->offset) != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to bind image memory\n");
+        VulkanMemoryDestroyImage(mem, *image, allocation);
+        *image = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+void VulkanMemoryDestroyBuffer(VulkanMemory* mem, VkBuffer buffer, VulkanAllocation* allocation)
+{
+    if (buffer) {
+        vkDestroyBuffer(mem->device, buffer, NULL);
+    }
+    VulkanMemoryFree(mem, allocation);
+}
+
+void VulkanMemoryDestroyImage(VulkanMemory* mem, VkImage image, VulkanAllocation* allocation)
+{
+    if (image) {
+        vkDestroyImage(mem->device, image, NULL);
+    }
+    VulkanMemoryFree(mem, allocation);
+}
+
+// DEFRAGMENTATION ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t VulkanMemoryBeginDefragment(VulkanMemory* mem, VulkanDefragMove* moves, uint32_t max_moves)
+{
+    uint32_t move_count = 0;
+
+    for (uint32_t type = 0; type < mem->properties.memoryTypeCount && move_count < max_moves; type++) {
+        for (uint32_t kind = 0; kind < VULKAN_MEMORY_KIND_COUNT && move_count < max_moves; kind++) {
+            VulkanMemoryPool* pool = &mem->pools[type][kind];
+
+            // Emptying the least used block frees the most memory for the fewest copies
+            uint32_t source = VULKAN_MEMORY_NO_BLOCK;
+            uint32_t live_blocks = 0;
+            for (uint32_t i = 0; i < pool->blockCount; i++) {
+                const VulkanMemoryBlock* block = &pool->blocks[i];
+                if (block->memory == VK_NULL_HANDLE) {
+                    continue;
+                }
+                live_blocks++;
+                if (block->tlsf.allocationCount &&
+                    (source == VULKAN_MEMORY_NO_BLOCK || block->tlsf.used < pool->blocks[source].tlsf.used)) {
+                    source = i;
+                }
+            }
+            if (live_blocks < 2 || source == VULKAN_MEMORY_NO_BLOCK) {
+                continue;
+            }
+
+            uint32_t node = TLSF_NULL;
+            while (move_count < max_moves && (node = TlsfNextAllocation(&pool->blocks[source].tlsf, node)) != TLSF_NULL) {
+                const Tlsf* src_tlsf = &pool->blocks[source].tlsf;
+                VkDeviceSize size = TlsfSize(src_tlsf, node);
+                VkDeviceSize alignment = TlsfAlignment(src_tlsf, node);
+                void* user_data = TlsfUserData(src_tlsf, node);
+
+                // Never into an empty block: that would only swap one block for another
+                VulkanDefragMove* move = &moves[move_count];
+                bool placed = false;
+                for (uint32_t i = 0; i < pool->blockCount && !placed; i++) {
+                    const VulkanMemoryBlock* block = &pool->blocks[i];
+                    if (i == source || block->memory == VK_NULL_HANDLE || block->tlsf.allocationCount == 0) {
+                        continue;
+                    }
+                    placed = AllocFromBlock(mem, type, kind, i, size, alignment, user_data, &move->dst);
+                }
+                if (!placed) {
+                    break;
+                }
+
+                const VulkanMemoryBlock* src_block = &pool->blocks[source];
+                move->src.memory = src_block->memory;
+                move->src.offset = TlsfOffset(&src_block->tlsf, node);
+                move->src.size = size;
+                move->src.mapped = src_block->mapped ? (uint8_t*)src_block->mapped + move->src.offset : NULL;
+                move->src.memoryType = type;
+                move->src.kind = kind;
+                move->src.block = source;
+                move->src.node = node;
+                move->userData = user_data;
+                move_count++;
+            }
+        }
+    }
+
+    if (move_count) {
+        PRINT_DEBUG("Vulkan: Defragmentation proposes %u moves\n", move_count);
+    }
+    return move_count;
+}
+
+void VulkanMemoryEndDefragment(VulkanMemory* mem, VulkanDefragMove* moves, uint32_t move_count)
+{
+    for (uint32_t i = 0; i < move_count; i++) {
+        VulkanMemoryFree(mem, &moves[i].src);
+    }
+}
+
+// STATS //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VulkanMemoryGetStats(const VulkanMemory* mem, uint32_t memory_type, VulkanMemoryStats* stats)
+{
+    *stats = mem->dedicated[memory_type];
+
+    for (uint32_t kind = 0; kind < VULKAN_MEMORY_KIND_COUNT; kind++) {
+        const VulkanMemoryPool* pool = &mem->pools[memory_type][kind];
+        for (uint32_t i = 0; i < pool->blockCount; i++) {
+            const VulkanMemoryBlock* block = &pool->blocks[i];
+            if (block->memory == VK_NULL_HANDLE) {
+                continue;
+            }
+
+            stats->reserved += block->size;
+            stats->used += block->tlsf.used;
+            stats->blockCount++;
+            stats->allocationCount += block->tlsf.allocationCount;
+            stats->freeRangeCount += TlsfFreeRangeCount(&block->tlsf);
+
+            VkDeviceSize largest = TlsfLargestFree(&block->tlsf);
+            if (largest > stats->largestFreeRange) {
+                stats->largestFreeRange = largest;
+            }
+        }
+    }
+}
+
+void VulkanMemoryPrintStats(const VulkanMemory* mem)
+{
+    VkDeviceSize total_reserved = 0;
+    VkDeviceSize total_used = 0;
+
+    PRINT("Vulkan: Memory usage (%u of %u device allocations)\n", mem->deviceAllocationCount, mem->maxAllocationCount);
+    for (uint32_t type = 0; type < mem->properties.memoryTypeCount; type++) {
+        VulkanMemoryStats stats;
+        VulkanMemoryGetStats(mem, type, &stats);
+        if (stats.reserved == 0) {
+            continue;
+        }
+
+        VkMemoryPropertyFlags flags = mem->properties.memoryTypes[type].propertyFlags;
+        PRINT("  type %2u heap %u [%s%s%s%s]: %8.2f / %8.2f MiB, %u blocks, %u allocations (%u dedicated), "
+              "%u free ranges, largest %.2f MiB\n",
+              type, mem->properties.memoryTypes[type].heapIndex,
+              flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT ? "D" : "-",
+              flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ? "V" : "-",
+              flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ? "C" : "-",
+              flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT ? "H" : "-",
+              stats.used / (1024.0 * 1024.0), stats.reserved / (1024.0 * 1024.0),
+              stats.blockCount, stats.allocationCount, stats.dedicatedCount,
+              stats.freeRangeCount, stats.largestFreeRange / (1024.0 * 1024.0));
+
+        total_reserved += stats.reserved;
+        total_used += stats.used;
+    }
+    PRINT("  total: %.2f / %.2f MiB\n", total_used / (1024.0 * 1024.0), total_reserved / (1024.0 * 1024.0));
+}
+
+// HOST ARRAYS /////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VulkanMemoryReserveArray(void** items, uint32_t count, uint32_t* capacity, size_t item_size)
+{
+    if (count < *capacity) {
+        return true;
+    }
+    uint32_t new_capacity = *capacity ? *capacity * 2 : 64;
+    void* grown = realloc(*items, new_capacity * item_size);
+    if (!grown) {
+        return false;
+    }
+    *items = grown;
+    *capacity = new_capacity;
+    return true;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "tlsf.h"
+
+// Default size of the device memory blocks sub-allocated with TLSF. Heaps of 1 GiB or less use
+// an eighth of the heap instead so a small heap is not swallowed by a single block.
+#define VULKAN_MEMORY_BLOCK_SIZE        (64ull * 1024 * 1024)
+#define VULKAN_MEMORY_SMALL_HEAP_SIZE   (1024ull * 1024 * 1024)
+
+// Resources at least this fraction of the block size get their own VkDeviceMemory
+#define VULKAN_MEMORY_DEDICATED_DIVISOR 2
+
+#define VULKAN_MEMORY_NO_BLOCK          0xFFFFFFFFu
+
+typedef enum VulkanMemoryUsage {
+    VULKAN_MEMORY_GPU_ONLY,         // Device local, never mapped
+    VULKAN_MEMORY_CPU_TO_GPU,       // Host visible + coherent, persistently mapped
+    VULKAN_MEMORY_GPU_TO_CPU        // Host visible + cached, persistently mapped, for readback
+} VulkanMemoryUsage;
+
+// Resource kinds are kept in separate blocks so bufferImageGranularity never has to be honoured
+// between neighbours
+typedef enum VulkanMemoryKind {
+    VULKAN_MEMORY_KIND_LINEAR,      // Buffers and linear images
+    VULKAN_MEMORY_KIND_OPTIMAL,     // Optimally tiled images
+    VULKAN_MEMORY_KIND_COUNT
+} VulkanMemoryKind;
+
+typedef struct VulkanAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize   offset;
+    VkDeviceSize   size;
+    void*          mapped;          // Start of this allocation in host memory, NULL if not host visible
+    uint32_t       memoryType;
+    uint32_t       kind;
+    uint32_t       block;           // Index within the pool, VULKAN_MEMORY_NO_BLOCK for dedicated memory
+    uint32_t       node;            // TLSF node within the block
+} VulkanAllocation;
+
+typedef struct VulkanMemoryBlock {
+    VkDeviceMemory memory;
+    VkDeviceSize   size;
+    void*          mapped;
+    Tlsf           tlsf;
+} VulkanMemoryBlock;
+
+typedef struct VulkanMemoryPool {
+    VulkanMemoryBlock* blocks;      // Destroyed blocks keep their slot with memory == VK_NULL_HANDLE
+    uint32_t           blockCount;
+    uint32_t           blockCapacity;
+} VulkanMemoryPool;
+
+typedef struct VulkanMemoryStats {
+    VkDeviceSize reserved;          // Bytes held in VkDeviceMemory objects
+    VkDeviceSize used;              // Bytes handed out to allocations
+    uint32_t     blockCount;
+    uint32_t     allocationCount;
+    uint32_t     dedicatedCount;
+    uint32_t     freeRangeCount;    // Holes between allocations, a fragmentation measure
+    VkDeviceSize largestFreeRange;
+} VulkanMemoryStats;
+
+// A relocation proposed by the defragmenter: copy src into dst, rebind the resource to dst, then
+// pass the move back to VulkanMemoryEndDefragment
+typedef struct VulkanDefragMove {
+    VulkanAllocation src;
+    VulkanAllocation dst;
+    void*            userData;      // As given to VulkanMemoryAlloc
+} VulkanDefragMove;
+
+// Not thread-safe; owned by the thread that records and submits Vulkan work
+typedef struct VulkanMemory {
+    VkDevice                         device;
+    VkPhysicalDeviceMemoryProperties properties;
+    VkDeviceSize                     blockSize[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize                     nonCoherentAtomSize;
+    uint32_t                         maxAllocationCount;
+    uint32_t                         deviceAllocationCount;     // Live VkDeviceMemory objects
+    VulkanMemoryPool                 pools[VK_MAX_MEMORY_TYPES][VULKAN_MEMORY_KIND_COUNT];
+    VulkanMemoryStats                dedicated[VK_MAX_MEMORY_TYPES];
+} VulkanMemory;
+
+bool VulkanMemoryInit(VulkanMemory* mem, VkPhysicalDevice gpu, VkDevice device);
+void VulkanMemoryDestroy(VulkanMemory* mem);
+
+// Picks a memory type for the requirements and sub-allocates from it (or makes a dedicated
+// allocation). user_data is handed back by the defragmenter.
+bool VulkanMemoryAlloc(VulkanMemory* mem, const VkMemoryRequirements* requirements, VulkanMemoryUsage usage,
+                       VulkanMemoryKind kind, bool dedicated, void* user_data, VulkanAllocation* allocation);
+void VulkanMemoryFree(VulkanMemory* mem, VulkanAllocation* allocation);
+
+// Make host writes visible to the device / device writes visible to the host. No-ops on coherent memory.
+void VulkanMemoryFlush(VulkanMemory* mem, const VulkanAllocation* allocation);
+void VulkanMemoryInvalidate(VulkanMemory* mem, const VulkanAllocation* allocation);
+
+// Creates the resource, allocates memory for it (honouring VK_KHR_dedicated_allocation hints) and binds it
+bool VulkanMemoryCreateBuffer(VulkanMemory* mem, const VkBufferCreateInfo* info, VulkanMemoryUsage usage,
+                              VkBuffer* buffer, VulkanAllocation* allocation);
+bool VulkanMemoryCreateImage(VulkanMemory* mem, const VkImageCreateInfo* info, VulkanMemoryUsage usage,
+                             VkImage* image, VulkanAllocation* allocation);
+void VulkanMemoryDestroyBuffer(VulkanMemory* mem, VkBuffer buffer, VulkanAllocation* allocation);
+void VulkanMemoryDestroyImage(VulkanMemory* mem, VkImage image, VulkanAllocation* allocation);
+
+// Defragmentation hooks. Begin picks the least occupied block of each pool and reserves new places
+// for its allocations in the other blocks, writing at most max_moves moves. The caller records the
+// copies, waits for them, rebinds the resources, then calls End which releases the old ranges and
+// frees blocks that became empty.
+uint32_t VulkanMemoryBeginDefragment(VulkanMemory* mem, VulkanDefragMove* moves, uint32_t max_moves);
+void VulkanMemoryEndDefragment(VulkanMemory* mem, VulkanDefragMove* moves, uint32_t move_count);
+
+void VulkanMemoryGetStats(const VulkanMemory* mem, uint32_t memory_type, VulkanMemoryStats* stats);
+void VulkanMemoryPrintStats(const VulkanMemory* mem);
+
+// Makes room for one more item after the first count of a realloc'd array, doubling its capacity when
+// full. On failure the array is left as it was.
+bool VulkanMemoryReserveArray(void** items, uint32_t count, uint32_t* capacity, size_t item_size);
@@ -0,0 +1,306 @@
+#include "vulkan_pipeline_cache.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// FILES //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t Checksum(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Returns the blob from path when it was written for this GPU and driver, NULL otherwise. The caller frees it.
+static uint8_t* LoadBlob(const VulkanPipelineCache* pc, size_t* size)
+{
+    HANDLE file = CreateFileA(pc->path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        PRINT("Vulkan: No pipeline cache at %s, starting cold\n", pc->path);
+        return NULL;
+    }
+
+    VulkanPipelineCacheHeader header;
+    DWORD read = 0;
+    uint8_t* blob = NULL;
+    const char* reason = NULL;
+
+    if (!ReadFile(file, &header, sizeof(header), &read, NULL) || read != sizeof(header)) {
+        reason = "truncated header";
+    } else if (header.magic != pc->identity.magic || header.version != pc->identity.version ||
+               header.headerSize != pc->identity.headerSize) {
+        reason = "unknown format";
+    } else if (header.vendorID != pc->identity.vendorID || header.deviceID != pc->identity.deviceID) {
+        reason = "different GPU";
+    } else if (header.driverVersion != pc->identity.driverVersion ||
+               memcmp(header.pipelineCacheUUID, pc->identity.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        reason = "different driver";
+    } else if (header.dataSize == 0 || header.dataSize > 0x7FFFFFFF) {
+        reason = "bad size";
+    } else if (!(blob = (uint8_t*)malloc((size_t)header.dataSize))) {
+        reason = "out of memory";
+    } else if (!ReadFile(file, blob, (DWORD)header.dataSize, &read, NULL) || read != header.dataSize) {
+        reason = "truncated data";
+    } else if (Checksum(blob, (size_t)header.dataSize) != header.checksum) {
+        reason = "checksum mismatch";
+    }
+    CloseHandle(file);
+
+    if (reason) {
+        PRINT_WARNING("Vulkan: Ignoring pipeline cache %s (%s)\n", pc->path, reason);
+        free(blob);
+        return NULL;
+    }
+
+    *size = (size_t)header.dataSize;
+    return blob;
+}
+
+bool VulkanPipelineCacheSave(VulkanPipelineCache* pc)
+{
+    size_t size = 0;
+    if (vkGetPipelineCacheData(pc->device, pc->cache, &size, NULL) != VK_SUCCESS || size == 0) {
+        return false;
+    }
+
+    uint8_t* blob = (uint8_t*)malloc(size);
+    if (!blob) {
+        PRINT_ERROR("Vulkan: Out of memory for %zu bytes of pipeline cache\n", size);
+        return false;
+    }
+    if (vkGetPipelineCacheData(pc->device, pc->cache, &size, blob) != VK_SUCCESS) {
+        free(blob);
+        return false;
+    }
+
+    VulkanPipelineCacheHeader header = pc->identity;
+    header.dataSize = size;
+    header.checksum = Checksum(blob, size);
+
+    // Write next to the destination and rename over it; the rename is atomic on the same volume
+    char temp_path[VULKAN_PIPELINE_CACHE_PATH_SIZE + 4];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", pc->path);
+
+    HANDLE file = CreateFileA(temp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        PRINT_ERROR("Vulkan: Failed to create %s\n", temp_path);
+        free(blob);
+        return false;
+    }
+
+    DWORD written_header = 0, written_blob = 0;
+    bool ok = WriteFile(file, &header, sizeof(header), &written_header, NULL) && written_header == sizeof(header) &&
+              WriteFile(file, blob, (DWORD)size, &written_blob, NULL) && written_blob == size &&
+              FlushFileBuffers(file);
+    CloseHandle(file);
+    free(blob);
+
+    if (!ok || !MoveFileExA(temp_path, pc->path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        PRINT_ERROR("Vulkan: Failed to write pipeline cache %s\n", pc->path);
+        DeleteFileA(temp_path);
+        return false;
+    }
+
+    PRINT("Vulkan: Saved pipeline cache %s (%zu bytes)\n", pc->path, size);
+    return true;
+}
+
+// CACHE //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VulkanPipelineCacheInit(VulkanPipelineCache* pc, VkPhysicalDevice gpu, VkDevice device, const char* path,
+                             bool creation_feedback)
+{
+    memset(pc, 0, sizeof(*pc));
+    pc->device = device;
+    pc->feedback = creation_feedback;
+    strncpy(pc->path, path, sizeof(pc->path) - 1);
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    pc->frequency = frequency.QuadPart;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+    pc->identity.magic = VULKAN_PIPELINE_CACHE_MAGIC;
+    pc->identity.version = VULKAN_PIPELINE_CACHE_VERSION;
+    pc->identity.headerSize = sizeof(VulkanPipelineCacheHeader);
+    pc->identity.vendorID = properties.vendorID;
+    pc->identity.deviceID = properties.deviceID;
+    pc->identity.driverVersion = properties.driverVersion;
+    memcpy(pc->identity.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    size_t size = 0;
+    uint8_t* blob = LoadBlob(pc, &size);
+
+    VkPipelineCacheCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = size,
+        .pInitialData = blob
+    };
+    VkResult result = vkCreatePipelineCache(device, &info, NULL, &pc->cache);
+    if (result != VK_SUCCESS && blob) {
+        // The driver can still refuse data that passed our checks; start over without it
+        PRINT_WARNING("Vulkan: Driver rejected pipeline cache %s (%d)\n", pc->path, result);
+        info.initialDataSize = 0;
+        info.pInitialData = NULL;
+        size = 0;
+        result = vkCreatePipelineCache(device, &info, NULL, &pc->cache);
+    }
+    free(blob);
+
+    if (result != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to create pipeline cache (%d)\n", result);
+        return false;
+    }
+
+    pc->loadedSize = size;
+    if (size) {
+        PRINT("Vulkan: Loaded pipeline cache %s (%zu bytes)\n", pc->path, size);
+    }
+    return true;
+}
+
+void VulkanPipelineCacheDestroy(VulkanPipelineCache* pc)
+{
+    if (!pc->cache) {
+        return;
+    }
+
+    if (pc->created) {
+        VulkanPipelineCachePrintStats(pc);
+        VulkanPipelineCacheSave(pc);
+    }
+    vkDestroyPipelineCache(pc->device, pc->cache, NULL);
+    pc->cache = VK_NULL_HANDLE;
+}
+
+VkPipelineCache VulkanPipelineCacheCreateWorker(VulkanPipelineCache* pc)
+{
+    VkPipelineCacheCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO
+    };
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    if (vkCreatePipelineCache(pc->device, &info, NULL, &cache) != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to create worker pipeline cache\n");
+        return VK_NULL_HANDLE;
+    }
+    return cache;
+}
+
+bool VulkanPipelineCacheMerge(VulkanPipelineCache* pc, VkPipelineCache* caches, uint32_t count)
+{
+    uint32_t valid = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (caches[i]) {
+            caches[valid++] = caches[i];
+        }
+    }
+
+    VkResult result = valid ? vkMergePipelineCaches(pc->device, pc->cache, valid, caches) : VK_SUCCESS;
+    if (result != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to merge %u pipeline caches (%d)\n", valid, result);
+    }
+
+    for (uint32_t i = 0; i < valid; i++) {
+        vkDestroyPipelineCache(pc->device, caches[i], NULL);
+        caches[i] = VK_NULL_HANDLE;
+    }
+    return result == VK_SUCCESS;
+}
+
+// PIPELINES //////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void RecordCreation(VulkanPipelineCache* pc, const VkPipelineCreationFeedbackEXT* feedback, LONG64 ticks)
+{
+    InterlockedIncrement64(&pc->created);
+
+    if (!pc->feedback || !(feedback->flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)) {
+        InterlockedAdd64(&pc->unknownTicks, ticks);
+    } else if (feedback->flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) {
+        InterlockedIncrement64(&pc->hits);
+        InterlockedAdd64(&pc->hitTicks, ticks);
+    } else {
+        InterlockedIncrement64(&pc->misses);
+        InterlockedAdd64(&pc->missTicks, ticks);
+    }
+}
+
+bool VulkanPipelineCacheCreateGraphics(VulkanPipelineCache* pc, VkPipelineCache cache,
+                                       const VkGraphicsPipelineCreateInfo* info, VkPipeline* pipeline)
+{
+    // Chain the feedback request in front of whatever the caller already has in pNext
+    VkPipelineCreationFeedbackEXT feedback = {0};
+    VkPipelineCreationFeedbackCreateInfoEXT feedback_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT,
+        .pNext = info->pNext,
+        .pPipelineCreationFeedback = &feedback
+    };
+    VkGraphicsPipelineCreateInfo create_info = *info;
+    if (pc->feedback) {
+        create_info.pNext = &feedback_info;
+    }
+
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+    VkResult result = vkCreateGraphicsPipelines(pc->device, cache ? cache : pc->cache, 1, &create_info, NULL, pipeline);
+    QueryPerformanceCounter(&end);
+
+    if (result != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: vkCreateGraphicsPipelines failed (%d)\n", result);
+        return false;
+    }
+    RecordCreation(pc, &feedback, end.QuadPart - start.QuadPart);
+    return true;
+}
+
+bool VulkanPipelineCacheCreateCompute(VulkanPipelineCache* pc, VkPipelineCache cache,
+                                      const VkComputePipelineCreateInfo* info, VkPipeline* pipeline)
+{
+    VkPipelineCreationFeedbackEXT feedback = {0};
+    VkPipelineCreationFeedbackCreateInfoEXT feedback_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT,
+        .pNext = info->pNext,
+        .pPipelineCreationFeedback = &feedback
+    };
+    VkComputePipelineCreateInfo create_info = *info;
+    if (pc->feedback) {
+        create_info.pNext = &feedback_info;
+    }
+
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+    VkResult result = vkCreateComputePipelines(pc->device, cache ? cache : pc->cache, 1, &create_info, NULL, pipeline);
+    QueryPerformanceCounter(&end);
+
+    if (result != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: vkCreateComputePipelines failed (%d)\n", result);
+        return false;
+    }
+    RecordCreation(pc, &feedback, end.QuadPart - start.QuadPart);
+    return true;
+}
+
+// STATS //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VulkanPipelineCachePrintStats(const VulkanPipelineCache* pc)
+{
+    double ms_per_tick = 1000.0 / (double)pc->frequency;
+    LONG64 unknown = pc->created - pc->hits - pc->misses;
+
+    PRINT("Vulkan: Pipeline cache (%s start, %zu bytes loaded): %lld pipelines\n",
+          pc->loadedSize ? "warm" : "cold", pc->loadedSize, (long long)pc->created);
+    if (pc->hits) {
+        PRINT("  hits:    %lld, %.3f ms average\n", (long long)pc->hits, pc->hitTicks * ms_per_tick / (double)pc->hits);
+    }
+    if (pc->misses) {
+        PRINT("  misses:  %lld, %.3f ms average\n", (long long)pc->misses, pc->missTicks * ms_per_tick / (double)pc->misses);
+    }
+    if (unknown) {
+        PRINT("  no feedback: %lld, %.3f ms average\n", (long long)unknown, pc->unknownTicks * ms_per_tick / (double)unknown);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Windows.h>
+#include <vulkan/vulkan.h>
+
+// Identifies our cache files and the layout of the header in front of the driver blob
+#define VULKAN_PIPELINE_CACHE_MAGIC     0x43505A58u     // "XZPC"
+#define VULKAN_PIPELINE_CACHE_VERSION   1
+
+#define VULKAN_PIPELINE_CACHE_PATH_SIZE 260
+
+// Written in front of the vkGetPipelineCacheData blob. A file is only handed to the driver when every
+// field matches the running GPU and driver, and the blob is intact.
+typedef struct VulkanPipelineCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+    uint64_t checksum;              // FNV-1a of the blob
+} VulkanPipelineCacheHeader;
+
+// One VkPipelineCache persisted to disk between runs. Pipelines may be created from any thread
+// through VulkanPipelineCacheCreate*; worker threads that want to avoid contention on the driver's
+// cache lock use a cache of their own from VulkanPipelineCacheCreateWorker and merge it back.
+typedef struct VulkanPipelineCache {
+    VkDevice        device;
+    VkPipelineCache cache;
+    VulkanPipelineCacheHeader identity;     // Header expected for this GPU and driver
+    char            path[VULKAN_PIPELINE_CACHE_PATH_SIZE];
+    size_t          loadedSize;             // Blob size read from disk, 0 on a cold start
+    bool            feedback;               // VK_EXT_pipeline_creation_feedback is enabled
+
+    // Updated with interlocked operations, pipelines are created from several threads
+    volatile LONG64 created;                // Pipelines created since load; nothing to save when 0
+    volatile LONG64 hits;
+    volatile LONG64 misses;
+    volatile LONG64 hitTicks;
+    volatile LONG64 missTicks;
+    volatile LONG64 unknownTicks;           // Time of pipelines without creation feedback
+    LONG64          frequency;
+} VulkanPipelineCache;
+
+// Loads path if it holds a valid cache for this GPU and driver, otherwise starts empty
+bool VulkanPipelineCacheInit(VulkanPipelineCache* pc, VkPhysicalDevice gpu, VkDevice device, const char* path,
+                             bool creation_feedback);
+// Saves (if anything was compiled) and destroys the cache
+void VulkanPipelineCacheDestroy(VulkanPipelineCache* pc);
+
+// Writes the cache to a temporary file and renames it over path, so a crash never leaves a torn file
+bool VulkanPipelineCacheSave(VulkanPipelineCache* pc);
+
+// Empty caches for worker threads, merged into the main cache and destroyed by VulkanPipelineCacheMerge
+VkPipelineCache VulkanPipelineCacheCreateWorker(VulkanPipelineCache* pc);
+bool VulkanPipelineCacheMerge(VulkanPipelineCache* pc, VkPipelineCache* caches, uint32_t count);
+
+// Create a pipeline through cache (pc->cache when VK_NULL_HANDLE) and record whether it was a cache hit
+// and how long it took
+bool VulkanPipelineCacheCreateGraphics(VulkanPipelineCache* pc, VkPipelineCache cache,
+                                       const VkGraphicsPipelineCreateInfo* info, VkPipeline* pipeline);
+bool VulkanPipelineCacheCreateCompute(VulkanPipelineCache* pc, VkPipelineCache cache,
+                                      const VkComputePipelineCreateInfo* info, VkPipeline* pipeline);
+
+void VulkanPipelineCachePrintStats(const VulkanPipelineCache* pc);
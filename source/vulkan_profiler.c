@@ -0,0 +1,379 @@
+#include "vulkan_profiler.h"
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// STATISTICS /////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static VulkanProfilerStat* FindStat(VulkanProfiler* prof, const char* name)
+{
+    // Names are usually literals, so the pointer compare hits first
+    for (uint32_t i = 0; i < prof->statCount; i++) {
+        if (prof->stats[i].name == name || strcmp(prof->stats[i].name, name) == 0) {
+            return &prof->stats[i];
+        }
+    }
+    if (prof->statCount == VULKAN_PROFILER_MAX_STATS) {
+        return NULL;
+    }
+
+    VulkanProfilerStat* stat = &prof->stats[prof->statCount++];
+    memset(stat, 0, sizeof(*stat));
+    stat->name = name;
+    stat->frameNumber = UINT64_MAX;
+    return stat;
+}
+
+static void PushHistory(VulkanProfilerStat* stat, float ms)
+{
+    if (stat->historyCount == VULKAN_PROFILER_HISTORY) {
+        stat->historySum -= stat->history[stat->historyNext];
+    } else {
+        stat->historyCount++;
+    }
+    stat->history[stat->historyNext] = ms;
+    stat->historyNext = (stat->historyNext + 1) % VULKAN_PROFILER_HISTORY;
+    stat->historySum += ms;
+
+    stat->lastMs = ms;
+    stat->averageMs = (float)(stat->historySum / stat->historyCount);
+    stat->peakMs = MAX(stat->peakMs, ms);
+}
+
+// TRACE //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void FlushTrace(VulkanProfiler* prof)
+{
+    if (prof->traceUsed) {
+        DWORD written = 0;
+        WriteFile(prof->trace, prof->traceBuffer, prof->traceUsed, &written, NULL);
+        prof->traceUsed = 0;
+    }
+}
+
+// Copies name as the body of a JSON string: quotes, backslashes and control characters escaped, cut
+// short rather than split an escape when out is too small
+static void EscapeTraceName(const char* name, char* out, size_t out_size)
+{
+    size_t used = 0;
+    for (const unsigned char* c = (const unsigned char*)name; *c; c++) {
+        char escaped[8];
+        int length;
+        if (*c == '"' || *c == '\\') {
+            length = snprintf(escaped, sizeof(escaped), "\\%c", *c);
+        } else if (*c < 0x20) {
+            length = snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+        } else {
+            escaped[0] = (char)*c;
+            length = 1;
+        }
+        if (used + length >= out_size) {
+            break;
+        }
+        memcpy(out + used, escaped, length);
+        used += length;
+    }
+    out[used] = 0;
+}
+
+static void WriteTraceEvent(VulkanProfiler* prof, const char* name, uint32_t depth, uint64_t begin, uint64_t end)
+{
+    if (prof->traceEvents == 0) {
+        prof->traceOrigin = begin;
+    }
+
+    char escaped_name[128];
+    EscapeTraceName(name, escaped_name, sizeof(escaped_name));
+
+    // Complete events in microseconds; nesting comes from the time ranges, depth only orders equal starts
+    char event[256];
+    int length = snprintf(event, sizeof(event),
+                          "%s{\"name\":\"%s\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,"
+                          "\"args\":{\"depth\":%u}}",
+                          prof->traceEvents ? ",\n" : "", escaped_name,
+                          (double)((begin - prof->traceOrigin) & prof->timestampMask) * prof->nsPerTick / 1000.0,
+                          (double)((end - begin) & prof->timestampMask) * prof->nsPerTick / 1000.0, depth);
+    if (length <= 0 || length >= (int)sizeof(event)) {
+        return;
+    }
+    if (prof->traceUsed + (uint32_t)length > VULKAN_PROFILER_TRACE_BUFFER) {
+        FlushTrace(prof);
+    }
+    memcpy(prof->traceBuffer + prof->traceUsed, event, length);
+    prof->traceUsed += length;
+    prof->traceEvents++;
+}
+
+bool VulkanProfilerOpenTrace(VulkanProfiler* prof, const char* path)
+{
+    VulkanProfilerCloseTrace(prof);
+    if (!prof->timestamps) {
+        PRINT_WARNING("Vulkan: No GPU timestamps, trace %s not written\n", path);
+        return false;
+    }
+
+    prof->traceBuffer = (char*)malloc(VULKAN_PROFILER_TRACE_BUFFER);
+    HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE || !prof->traceBuffer) {
+        PRINT_ERROR("Vulkan: Failed to open GPU trace %s\n", path);
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+        free(prof->traceBuffer);
+        prof->traceBuffer = NULL;
+        return false;
+    }
+
+    prof->trace = file;
+    prof->traceEvents = 0;
+    memcpy(prof->traceBuffer, "[\n", 2);
+    prof->traceUsed = 2;
+    return true;
+}
+
+void VulkanProfilerCloseTrace(VulkanProfiler* prof)
+{
+    if (!prof->trace) {
+        return;
+    }
+    if (prof->traceUsed + 3 > VULKAN_PROFILER_TRACE_BUFFER) {
+        FlushTrace(prof);
+    }
+    memcpy(prof->traceBuffer + prof->traceUsed, "\n]\n", 3);
+    prof->traceUsed += 3;
+    FlushTrace(prof);
+
+    CloseHandle(prof->trace);
+    free(prof->traceBuffer);
+    PRINT("Vulkan: GPU trace written, %llu events\n", (unsigned long long)prof->traceEvents);
+    prof->trace = NULL;
+    prof->traceBuffer = NULL;
+}
+
+// FRAMES /////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VulkanProfilerInit(VulkanProfiler* prof, VkDevice device, float timestamp_period, uint32_t timestamp_valid_bits,
+                        uint32_t frames_in_flight, PFN_vkCmdBeginDebugUtilsLabelEXT begin_label,
+                        PFN_vkCmdEndDebugUtilsLabelEXT end_label)
+{
+    memset(prof, 0, sizeof(*prof));
+    prof->device = device;
+    prof->timestamps = timestamp_valid_bits != 0 && timestamp_period > 0.0f;
+    prof->nsPerTick = timestamp_period;
+    prof->timestampMask = timestamp_valid_bits >= 64 ? UINT64_MAX : ((1ull << timestamp_valid_bits) - 1);
+    prof->beginLabel = begin_label;
+    prof->endLabel = end_label;
+
+    prof->frames = (VulkanProfilerFrame*)calloc(frames_in_flight, sizeof(VulkanProfilerFrame));
+    if (!prof->frames) {
+        return false;
+    }
+    prof->framesInFlight = frames_in_flight;
+
+    if (!prof->timestamps) {
+        PRINT_WARNING("Vulkan: Graphics queue has no timestamps, GPU profiling disabled\n");
+        return true;
+    }
+
+    for (uint32_t i = 0; i < frames_in_flight; i++) {
+        VkQueryPoolCreateInfo pool_info = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = VULKAN_PROFILER_MAX_SCOPES * 2
+        };
+        if (vkCreateQueryPool(device, &pool_info, NULL, &prof->frames[i].pool) != VK_SUCCESS) {
+            PRINT_ERROR("Vulkan: Failed to create timestamp query pool\n");
+            return false;
+        }
+    }
+
+    PRINT("Vulkan: GPU profiler, %.3f ns per tick, %u valid bits\n", timestamp_period, timestamp_valid_bits);
+    return true;
+}
+
+void VulkanProfilerDestroy(VulkanProfiler* prof)
+{
+    if (!prof->frames) {
+        return;
+    }
+    VulkanProfilerCloseTrace(prof);
+    for (uint32_t i = 0; i < prof->framesInFlight; i++) {
+        if (prof->frames[i].pool) {
+            vkDestroyQueryPool(prof->device, prof->frames[i].pool, NULL);
+        }
+    }
+    free(prof->frames);
+    memset(prof, 0, sizeof(*prof));
+}
+
+// Reads back a frame whose fence has signalled. Scopes whose queries are somehow not available are
+// skipped rather than waited for.
+static void ResolveFrame(VulkanProfiler* prof, VulkanProfilerFrame* frame)
+{
+    frame->pending = false;
+    uint32_t query_count = frame->scopeCount * 2;
+    if (query_count == 0) {
+        return;
+    }
+
+    uint64_t results[VULKAN_PROFILER_MAX_SCOPES * 2][2];     // Value, availability
+    VkResult result = vkGetQueryPoolResults(prof->device, frame->pool, 0, query_count, sizeof(results), results,
+                                            sizeof(results[0]), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        return;
+    }
+
+    VulkanProfilerStat* seen[VULKAN_PROFILER_MAX_SCOPES];
+    uint32_t seen_count = 0;
+    for (uint32_t i = 0; i < frame->scopeCount; i++) {
+        const uint64_t* begin = results[i * 2];
+        const uint64_t* end = results[i * 2 + 1];
+        if (!begin[1] || !end[1]) {
+            continue;
+        }
+
+        uint64_t ticks = (end[0] - begin[0]) & prof->timestampMask;
+        double ms = (double)ticks * prof->nsPerTick / 1000000.0;
+
+        VulkanProfilerStat* stat = FindStat(prof, frame->scopes[i].name);
+        if (stat) {
+            if (stat->frameNumber != frame->frameNumber) {
+                stat->frameNumber = frame->frameNumber;
+                stat->frameMs = 0.0;
+                seen[seen_count++] = stat;
+            }
+            stat->frameMs += ms;
+        }
+
+        if (prof->trace) {
+            WriteTraceEvent(prof, frame->scopes[i].name, frame->scopes[i].depth, begin[0], end[0]);
+        }
+    }
+
+    for (uint32_t i = 0; i < seen_count; i++) {
+        PushHistory(seen[i], (float)seen[i]->frameMs);
+    }
+}
+
+void VulkanProfilerBeginFrame(VulkanProfiler* prof, VkCommandBuffer cmd, uint64_t frame_number)
+{
+    if (!prof->frames) {
+        return;
+    }
+
+    VulkanProfilerFrame* frame = &prof->frames[frame_number % prof->framesInFlight];
+    if (frame->pending) {
+        ResolveFrame(prof, frame);
+    }
+
+    frame->frameNumber = frame_number;
+    frame->scopeCount = 0;
+    prof->current = frame;
+    prof->depth = 0;
+    prof->overflowDepth = 0;
+    if (prof->timestamps) {
+        vkCmdResetQueryPool(cmd, frame->pool, 0, VULKAN_PROFILER_MAX_SCOPES * 2);
+    }
+
+    VulkanProfilerBeginScope(prof, cmd, VULKAN_PROFILER_FRAME_SCOPE);
+}
+
+void VulkanProfilerEndFrame(VulkanProfiler* prof, VkCommandBuffer cmd)
+{
+    if (!prof->current) {
+        return;
+    }
+    while (prof->depth) {
+        VulkanProfilerEndScope(prof, cmd);
+    }
+    prof->current->pending = prof->timestamps;
+    prof->current = NULL;
+}
+
+// SCOPES /////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VulkanProfilerBeginScope(VulkanProfiler* prof, VkCommandBuffer cmd, const char* name)
+{
+    VulkanProfilerFrame* frame = prof->current;
+    if (!frame) {
+        return;
+    }
+    if (prof->depth == VULKAN_PROFILER_MAX_DEPTH) {
+        prof->overflowDepth++;
+        prof->droppedScopes++;
+        return;
+    }
+
+    if (prof->beginLabel) {
+        VkDebugUtilsLabelEXT label = {
+            .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,
+            .pLabelName = name
+        };
+        prof->beginLabel(cmd, &label);
+    }
+
+    uint32_t scope = VULKAN_PROFILER_MAX_SCOPES;
+    if (prof->timestamps && frame->scopeCount < VULKAN_PROFILER_MAX_SCOPES) {
+        scope = frame->scopeCount++;
+        frame->scopes[scope].name = name;
+        frame->scopes[scope].depth = prof->depth;
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->pool, scope * 2);
+    } else if (prof->timestamps) {
+        prof->droppedScopes++;
+    }
+    prof->stack[prof->depth++] = scope;
+}
+
+void VulkanProfilerEndScope(VulkanProfiler* prof, VkCommandBuffer cmd)
+{
+    VulkanProfilerFrame* frame = prof->current;
+    if (!frame || prof->depth == 0) {
+        return;
+    }
+    if (prof->overflowDepth) {
+        prof->overflowDepth--;
+        return;
+    }
+
+    uint32_t scope = prof->stack[--prof->depth];
+    if (scope != VULKAN_PROFILER_MAX_SCOPES) {
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame->pool, scope * 2 + 1);
+    }
+    if (prof->endLabel) {
+        prof->endLabel(cmd);
+    }
+}
+
+float VulkanProfilerGetAverage(const VulkanProfiler* prof, const char* name)
+{
+    for (uint32_t i = 0; i < prof->statCount; i++) {
+        if (prof->stats[i].name == name || strcmp(prof->stats[i].name, name) == 0) {
+            return prof->stats[i].averageMs;
+        }
+    }
+    return 0.0f;
+}
+
+const VulkanProfilerStat* VulkanProfilerGetStats(const VulkanProfiler* prof, uint32_t* count)
+{
+    *count = prof->statCount;
+    return prof->stats;
+}
+
+void VulkanProfilerPrintStats(const VulkanProfiler* prof)
+{
+    if (prof->statCount == 0) {
+        return;
+    }
+    PRINT("Vulkan: GPU timings over the last %u frames (average / last / peak ms)\n", VULKAN_PROFILER_HISTORY);
+    for (uint32_t i = 0; i < prof->statCount; i++) {
+        const VulkanProfilerStat* stat = &prof->stats[i];
+        PRINT("  - %-24s %8.3f %8.3f %8.3f\n", stat->name, stat->averageMs, stat->lastMs, stat->peakMs);
+    }
+    if (prof->droppedScopes) {
+        PRINT_WARNING("Vulkan: %u GPU scopes dropped, over %u per frame or %u deep\n",
+                      prof->droppedScopes, VULKAN_PROFILER_MAX_SCOPES, VULKAN_PROFILER_MAX_DEPTH);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Windows.h>
+#include <vulkan/vulkan.h>
+
+#define VULKAN_PROFILER_MAX_SCOPES      64      // Timed scopes per frame, nested ones included
+#define VULKAN_PROFILER_MAX_DEPTH       16
+#define VULKAN_PROFILER_MAX_STATS       128     // Distinct scope names tracked
+#define VULKAN_PROFILER_HISTORY         64      // Frames in the rolling average
+#define VULKAN_PROFILER_TRACE_BUFFER    (64 * 1024)
+
+#define VULKAN_PROFILER_FRAME_SCOPE     "Frame"
+
+// Rolling timings of every scope with one name; scopes opened several times in a frame add up
+typedef struct VulkanProfilerStat {
+    const char* name;
+    float       history[VULKAN_PROFILER_HISTORY];   // Milliseconds, ring indexed by historyNext
+    uint32_t    historyCount;
+    uint32_t    historyNext;
+    double      historySum;
+    float       lastMs;
+    float       averageMs;
+    float       peakMs;                             // Over the whole run
+    uint64_t    frameNumber;                        // Last frame the stat was seen in
+    double      frameMs;                            // Sum over that frame while it is being resolved
+} VulkanProfilerStat;
+
+typedef struct VulkanProfilerScope {
+    const char* name;
+    uint32_t    depth;
+} VulkanProfilerScope;
+
+// Queries of one frame in flight: scope i writes timestamps 2i and 2i + 1
+typedef struct VulkanProfilerFrame {
+    VkQueryPool         pool;
+    VulkanProfilerScope scopes[VULKAN_PROFILER_MAX_SCOPES];
+    uint32_t            scopeCount;
+    uint64_t            frameNumber;
+    bool                pending;    // Recorded and not read back yet
+} VulkanProfilerFrame;
+
+// GPU timings of named scopes recorded into the frame command buffer. Each frame in flight writes its own
+// query pool; the results are read when the slot comes around again, after its fence has been waited on,
+// so reading never stalls and timings trail the CPU by framesInFlight frames. Scopes also become
+// VK_EXT_debug_utils labels when the extension is enabled, for captures in RenderDoc and the like.
+// Not thread-safe; owned by the thread that records and submits Vulkan work.
+typedef struct VulkanProfiler {
+    VkDevice             device;
+    bool                 timestamps;            // The graphics queue supports timestamps
+    double               nsPerTick;             // VkPhysicalDeviceLimits::timestampPeriod
+    uint64_t             timestampMask;         // Valid bits of a timestamp
+    PFN_vkCmdBeginDebugUtilsLabelEXT beginLabel;
+    PFN_vkCmdEndDebugUtilsLabelEXT   endLabel;
+
+    VulkanProfilerFrame* frames;
+    uint32_t             framesInFlight;
+    VulkanProfilerFrame* current;               // Frame being recorded, NULL outside BeginFrame/EndFrame
+    uint32_t             stack[VULKAN_PROFILER_MAX_DEPTH];  // Open scopes, VULKAN_PROFILER_MAX_SCOPES when untimed
+    uint32_t             depth;
+    uint32_t             overflowDepth;         // Scopes opened past VULKAN_PROFILER_MAX_DEPTH
+    uint32_t             droppedScopes;         // Over VULKAN_PROFILER_MAX_SCOPES in a frame
+
+    VulkanProfilerStat   stats[VULKAN_PROFILER_MAX_STATS];
+    uint32_t             statCount;
+
+    // Chrome trace event file (chrome://tracing, Perfetto), written as frames resolve
+    HANDLE               trace;
+    char*                traceBuffer;
+    uint32_t             traceUsed;
+    uint64_t             traceEvents;
+    uint64_t             traceOrigin;           // First timestamp written, the trace starts at 0
+} VulkanProfiler;
+
+// timestamp_valid_bits 0 (no timestamp support) keeps the labels only. The label functions may be NULL.
+bool VulkanProfilerInit(VulkanProfiler* prof, VkDevice device, float timestamp_period, uint32_t timestamp_valid_bits,
+                        uint32_t frames_in_flight, PFN_vkCmdBeginDebugUtilsLabelEXT begin_label,
+                        PFN_vkCmdEndDebugUtilsLabelEXT end_label);
+// The frames' submissions must have completed
+void VulkanProfilerDestroy(VulkanProfiler* prof);
+
+// Call right after beginning the frame's command buffer, once the slot's fence has been waited on. Reads
+// back the slot's previous frame, resets its queries and opens the VULKAN_PROFILER_FRAME_SCOPE scope.
+void VulkanProfilerBeginFrame(VulkanProfiler* prof, VkCommandBuffer cmd, uint64_t frame_number);
+// Closes scopes left open and the frame scope; call before ending the command buffer
+void VulkanProfilerEndFrame(VulkanProfiler* prof, VkCommandBuffer cmd);
+
+// name must outlive the profiler, its statistics keep the pointer (string literals, pass names)
+void VulkanProfilerBeginScope(VulkanProfiler* prof, VkCommandBuffer cmd, const char* name);
+void VulkanProfilerEndScope(VulkanProfiler* prof, VkCommandBuffer cmd);
+
+// Rolling average of a scope in milliseconds, 0 if it has not been seen
+float VulkanProfilerGetAverage(const VulkanProfiler* prof, const char* name);
+const VulkanProfilerStat* VulkanProfilerGetStats(const VulkanProfiler* prof, uint32_t* count);
+void VulkanProfilerPrintStats(const VulkanProfiler* prof);
+
+bool VulkanProfilerOpenTrace(VulkanProfiler* prof, const char* path);
+void VulkanProfilerCloseTrace(VulkanProfiler* prof);
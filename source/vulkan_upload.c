@@ -0,0 +1,401 @@
+#include "vulkan_upload.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Keeps staging offsets valid for buffer copies and for every texel block size
+#define VULKAN_UPLOAD_ALIGNMENT 16
+
+// SYNCHRONIZATION ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void Retire(VulkanUploader* up)
+{
+    vkGetSemaphoreCounterValue(up->device, up->timeline, &up->completed);
+
+    // Batches complete in submission order, so the newest finished one frees everything before it
+    for (uint32_t i = 0; i < VULKAN_UPLOAD_BATCH_COUNT; i++) {
+        const VulkanUploadBatch* batch = &up->batches[i];
+        if (batch->value && batch->value <= up->completed && batch->ringEnd > up->tail) {
+            up->tail = batch->ringEnd;
+        }
+    }
+}
+
+bool VulkanUploadIsComplete(VulkanUploader* up, uint64_t value)
+{
+    if (value > up->completed) {
+        Retire(up);
+    }
+    return value <= up->completed;
+}
+
+void VulkanUploadWait(VulkanUploader* up, uint64_t value)
+{
+    if (VulkanUploadIsComplete(up, value)) {
+        return;
+    }
+
+    VkSemaphoreWaitInfo wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &up->timeline,
+        .pValues = &value
+    };
+    vkWaitSemaphores(up->device, &wait_info, UINT64_MAX);
+    Retire(up);
+}
+
+// BATCHES ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static VulkanUploadBatch* CurrentBatch(VulkanUploader* up)
+{
+    return &up->batches[up->submitted % VULKAN_UPLOAD_BATCH_COUNT];
+}
+
+static bool BeginBatch(VulkanUploader* up)
+{
+    if (up->recording) {
+        return true;
+    }
+
+    // The slot is reused every VULKAN_UPLOAD_BATCH_COUNT submissions
+    VulkanUploadBatch* batch = CurrentBatch(up);
+    if (batch->value) {
+        VulkanUploadWait(up, batch->value);
+    }
+
+    vkResetCommandPool(up->device, batch->pool, 0);
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    if (vkBeginCommandBuffer(batch->cmd, &begin_info) != VK_SUCCESS) {
+        PRINT_ERROR("Vulkan: Failed to begin upload command buffer\n");
+        return false;
+    }
+
+    up->recording = true;
+    return true;
+}
+
+uint64_t VulkanUploadFlush(VulkanUploader* up)
+{
+    if (!up->recording) {
+        return up->submitted;
+    }
+
+    VulkanUploadBatch* batch = CurrentBatch(up);
+    vkEndCommandBuffer(batch->cmd);
+
+    uint64_t value = up->submitted + 1;
+    VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &value
+    };
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timeline_info,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch->cmd,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &up->timeline
+    };
+    VkResult result = vkQueueSubmit(up->queue, 1, &submit_info, VK_NULL_HANDLE);
+    up->recording = false;
+    if (result != VK_SUCCESS) {
+        // The batch is dropped: its value would never be signalled, so nothing may wait on it. Its ring
+        // space goes back and the acquires of the releases it held are forgotten.
+        VkDeviceSize batch_start = 0;
+        if (up->submitted) {
+            batch_start = up->batches[(up->submitted - 1) % VULKAN_UPLOAD_BATCH_COUNT].ringEnd;
+        }
+        batch_start = MAX(batch_start, up->tail);
+        PRINT_ERROR("Vulkan: Upload submission failed (%d), %llu staged bytes dropped\n", result,
+                    (unsigned long long)(up->head - batch_start));
+        up->head = batch_start;
+        up->bufferAcquireCount = up->bufferAcquireReady;
+        up->imageAcquireCount = up->imageAcquireReady;
+        return 0;
+    }
+
+    batch->value = value;
+    batch->ringEnd = up->head;
+    up->submitted = value;
+    up->bufferAcquireReady = up->bufferAcquireCount;
+    up->imageAcquireReady = up->imageAcquireCount;
+    return value;
+}
+
+// STAGING RING ///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Reserves size contiguous bytes of the ring, waiting for older batches when it is full. Never wraps
+// an allocation around the end of the ring.
+static bool Reserve(VulkanUploader* up, VkDeviceSize size, VkDeviceSize* offset)
+{
+    if (size > up->capacity) {
+        PRINT_ERROR("Vulkan: Upload of %llu bytes exceeds the %llu byte staging ring\n",
+                    (unsigned long long)size, (unsigned long long)up->capacity);
+        return false;
+    }
+
+    for (;;) {
+        VkDeviceSize start = (up->head + VULKAN_UPLOAD_ALIGNMENT - 1) & ~(VkDeviceSize)(VULKAN_UPLOAD_ALIGNMENT - 1);
+        if (start % up->capacity + size > up->capacity) {
+            start = (start / up->capacity + 1) * up->capacity;
+        }
+        if (start + size - up->tail <= up->capacity) {
+            up->head = start + size;
+            *offset = start % up->capacity;
+            return true;
+        }
+
+        // Full: free the oldest batch, submitting the open one first if it is what holds the space
+        Retire(up);
+        if (start + size - up->tail <= up->capacity) {
+            continue;
+        }
+        if (up->tail == up->head) {
+            // Empty but the request does not fit before the end: restart at the beginning
+            up->head = up->tail = (up->head / up->capacity + 1) * up->capacity;
+            continue;
+        }
+        if (up->completed == up->submitted && !VulkanUploadFlush(up)) {
+            return false;
+        }
+        up->stalls++;
+        VulkanUploadWait(up, up->completed + 1);
+    }
+}
+
+// UPLOADS ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VulkanUploaderInit(VulkanUploader* up, VulkanMemory* memory, VkDevice device, VkQueue queue,
+                        uint32_t queue_family, uint32_t graphics_queue_family, VkDeviceSize capacity)
+{
+    memset(up, 0, sizeof(*up));
+    up->device = device;
+    up->memory = memory;
+    up->queue = queue;
+    up->queueFamily = queue_family;
+    up->graphicsQueueFamily = graphics_queue_family;
+
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = capacity,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+    if (!VulkanMemoryCreateBuffer(memory, &buffer_info, VULKAN_MEMORY_CPU_TO_GPU, &up->staging, &up->stagingAllocation)) {
+        PRINT_ERROR("Vulkan: Failed to create staging ring\n");
+        return false;
+    }
+    up->ring = (uint8_t*)up->stagingAllocation.mapped;
+    up->capacity = capacity;
+
+    VkSemaphoreTypeCreateInfo type_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0
+    };
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_info
+    };
+    VKCALL(vkCreateSemaphore(device, &semaphore_info, NULL, &up->timeline), "vkCreateSemaphore(upload timeline)");
+
+    for (uint32_t i = 0; i < VULKAN_UPLOAD_BATCH_COUNT; i++) {
+        VkCommandPoolCreateInfo pool_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = queue_family
+        };
+        VKCALL(vkCreateCommandPool(device, &pool_info, NULL, &up->batches[i].pool), "vkCreateCommandPool(upload)");
+
+        VkCommandBufferAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = up->batches[i].pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        VKCALL(vkAllocateCommandBuffers(device, &alloc_info, &up->batches[i].cmd), "vkAllocateCommandBuffers(upload)");
+    }
+
+    PRINT("Vulkan: Upload ring of %llu MiB on queue family %u%s\n", (unsigned long long)(capacity >> 20), queue_family,
+          queue_family == graphics_queue_family ? " (graphics)" : " (transfer)");
+    return true;
+}
+
+void VulkanUploaderDestroy(VulkanUploader* up)
+{
+    if (!up->device) {
+        return;
+    }
+
+    VulkanUploadFlush(up);
+    VulkanUploadWait(up, up->submitted);
+    PRINT_DEBUG("Vulkan: Uploaded %llu KiB in %llu batches, %u stalls on the staging ring\n",
+                (unsigned long long)(up->bytesUploaded >> 10), (unsigned long long)up->submitted, up->stalls);
+
+    for (uint32_t i = 0; i < VULKAN_UPLOAD_BATCH_COUNT; i++) {
+        vkDestroyCommandPool(up->device, up->batches[i].pool, NULL);
+    }
+    vkDestroySemaphore(up->device, up->timeline, NULL);
+    VulkanMemoryDestroyBuffer(up->memory, up->staging, &up->stagingAllocation);
+    free(up->bufferAcquires);
+    free(up->imageAcquires);
+    memset(up, 0, sizeof(*up));
+}
+
+bool VulkanUploadBuffer(VulkanUploader* up, VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size)
+{
+    if (size == 0) {
+        return true;
+    }
+
+    // Chunks of half the ring keep one upload from draining it completely
+    VkDeviceSize chunk_size = up->capacity / 2;
+    for (VkDeviceSize done = 0; done < size; done += chunk_size) {
+        VkDeviceSize chunk = size - done < chunk_size ? size - done : chunk_size;
+
+        VkDeviceSize offset;
+        if (!Reserve(up, chunk, &offset) || !BeginBatch(up)) {
+            return false;
+        }
+        memcpy(up->ring + offset, (const uint8_t*)data + done, chunk);
+
+        VkBufferCopy region = {
+            .srcOffset = offset,
+            .dstOffset = dst_offset + done,
+            .size = chunk
+        };
+        vkCmdCopyBuffer(CurrentBatch(up)->cmd, up->staging, dst, 1, &region);
+    }
+    up->bytesUploaded += size;
+
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = dst,
+        .offset = dst_offset,
+        .size = size
+    };
+
+    // On a transfer queue, release ownership here and let the graphics queue acquire it later
+    if (up->queueFamily != up->graphicsQueueFamily) {
+        barrier.srcQueueFamilyIndex = up->queueFamily;
+        barrier.dstQueueFamilyIndex = up->graphicsQueueFamily;
+        if (!VulkanMemoryReserveArray((void**)&up->bufferAcquires, up->bufferAcquireCount, &up->bufferAcquireCapacity,
+                                      sizeof(VkBufferMemoryBarrier))) {
+            PRINT_ERROR("Vulkan: Failed to grow upload acquire list\n");
+            return false;
+        }
+        up->bufferAcquires[up->bufferAcquireCount++] = barrier;
+        barrier.dstAccessMask = 0;
+    }
+
+    vkCmdPipelineBarrier(CurrentBatch(up)->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         0, 0, NULL, 1, &barrier, 0, NULL);
+    return true;
+}
+
+bool VulkanUploadImage(VulkanUploader* up, VkImage image, VkImageAspectFlags aspect, uint32_t mip_level,
+                       uint32_t array_layer, VkExtent3D extent, const void* data, VkDeviceSize size,
+                       VkImageLayout final_layout)
+{
+    VkDeviceSize offset;
+    if (!Reserve(up, size, &offset) || !BeginBatch(up)) {
+        return false;
+    }
+    memcpy(up->ring + offset, data, size);
+    up->bytesUploaded += size;
+
+    VkCommandBuffer cmd = CurrentBatch(up)->cmd;
+    VkImageSubresourceRange range = {
+        .aspectMask = aspect,
+        .baseMipLevel = mip_level,
+        .levelCount = 1,
+        .baseArrayLayer = array_layer,
+        .layerCount = 1
+    };
+
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = range
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, NULL, 0, NULL, 1, &barrier);
+
+    VkBufferImageCopy region = {
+        .bufferOffset = offset,
+        .imageSubresource = {
+            .aspectMask = aspect,
+            .mipLevel = mip_level,
+            .baseArrayLayer = array_layer,
+            .layerCount = 1
+        },
+        .imageExtent = extent
+    };
+    vkCmdCopyBufferToImage(cmd, up->staging, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = final_layout;
+
+    // The layout change is part of the ownership transfer and must match on both queues
+    if (up->queueFamily != up->graphicsQueueFamily) {
+        barrier.srcQueueFamilyIndex = up->queueFamily;
+        barrier.dstQueueFamilyIndex = up->graphicsQueueFamily;
+        if (!VulkanMemoryReserveArray((void**)&up->imageAcquires, up->imageAcquireCount, &up->imageAcquireCapacity,
+                                      sizeof(VkImageMemoryBarrier))) {
+            PRINT_ERROR("Vulkan: Failed to grow upload acquire list\n");
+            return false;
+        }
+        up->imageAcquires[up->imageAcquireCount++] = barrier;
+        barrier.dstAccessMask = 0;
+    }
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         0, 0, NULL, 0, NULL, 1, &barrier);
+    return true;
+}
+
+uint64_t VulkanUploadAcquire(VulkanUploader* up, VkCommandBuffer cmd)
+{
+    // Releases have to be submitted before anything can wait on them; a failed flush drops its own
+    // acquires, the ones left belong to batches submitted before
+    VulkanUploadFlush(up);
+    uint64_t value = up->submitted;
+
+    if (up->bufferAcquireCount == 0 && up->imageAcquireCount == 0) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < up->bufferAcquireCount; i++) {
+        up->bufferAcquires[i].srcAccessMask = 0;
+    }
+    for (uint32_t i = 0; i < up->imageAcquireCount; i++) {
+        up->imageAcquires[i].srcAccessMask = 0;
+    }
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                         0, NULL, up->bufferAcquireCount, up->bufferAcquires, up->imageAcquireCount, up->imageAcquires);
+
+    up->bufferAcquireCount = 0;
+    up->imageAcquireCount = 0;
+    up->bufferAcquireReady = 0;
+    up->imageAcquireReady = 0;
+    return value;
+}
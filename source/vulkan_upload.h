@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "vulkan_memory.h"
+
+// Size of the persistently mapped staging ring all uploads go through
+#define VULKAN_UPLOAD_RING_SIZE     (32ull * 1024 * 1024)
+
+// Upload submissions that can be in flight at once
+#define VULKAN_UPLOAD_BATCH_COUNT   8
+
+typedef struct VulkanUploadBatch {
+    VkCommandPool   pool;
+    VkCommandBuffer cmd;
+    uint64_t        value;          // Timeline value signalled when the batch has executed
+    VkDeviceSize    ringEnd;        // Ring head at submission; everything before it is free once value is reached
+} VulkanUploadBatch;
+
+// Streams buffer and image data to the GPU. Copies are written into a staging ring and recorded into
+// a batch that goes out in one submission on VulkanUploadFlush (or when the ring or batch fills up).
+// Each batch signals a timeline semaphore, so space is recycled without fences and the renderer can
+// wait for exactly the uploads it needs. Runs on the transfer queue when the GPU has one, otherwise on
+// the graphics queue. Not thread-safe; owned by the thread that submits Vulkan work.
+typedef struct VulkanUploader {
+    VkDevice         device;
+    VulkanMemory*    memory;
+    VkQueue          queue;
+    uint32_t         queueFamily;
+    uint32_t         graphicsQueueFamily;
+
+    VkBuffer         staging;
+    VulkanAllocation stagingAllocation;
+    uint8_t*         ring;
+    VkDeviceSize     capacity;
+    VkDeviceSize     head;          // Monotonic write position; head - tail bytes are in flight
+    VkDeviceSize     tail;
+
+    VkSemaphore      timeline;
+    uint64_t         submitted;     // Value of the last submitted batch
+    uint64_t         completed;     // Last value the GPU was seen to reach
+
+    VulkanUploadBatch batches[VULKAN_UPLOAD_BATCH_COUNT];
+    bool             recording;     // batches[submitted % VULKAN_UPLOAD_BATCH_COUNT] is open
+
+    // Queue family ownership acquires the graphics queue has to record for resources that were
+    // uploaded on a separate transfer queue
+    VkBufferMemoryBarrier* bufferAcquires;
+    uint32_t         bufferAcquireCount;
+    uint32_t         bufferAcquireCapacity;
+    VkImageMemoryBarrier*  imageAcquires;
+    uint32_t         imageAcquireCount;
+    uint32_t         imageAcquireCapacity;
+    uint32_t         bufferAcquireReady;    // Acquires [0, ready) belong to submitted batches
+    uint32_t         imageAcquireReady;
+
+    uint64_t         bytesUploaded;
+    uint32_t         stalls;        // Times the CPU waited for ring space
+} VulkanUploader;
+
+bool VulkanUploaderInit(VulkanUploader* up, VulkanMemory* memory, VkDevice device, VkQueue queue,
+                        uint32_t queue_family, uint32_t graphics_queue_family, VkDeviceSize capacity);
+void VulkanUploaderDestroy(VulkanUploader* up);
+
+// Queue a copy into dst. data is consumed immediately; large uploads are split across batches.
+bool VulkanUploadBuffer(VulkanUploader* up, VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size);
+
+// Queue a copy of tightly packed texels into one mip level / layer of image, which ends up in final_layout.
+// The previous contents of that subresource are discarded.
+bool VulkanUploadImage(VulkanUploader* up, VkImage image, VkImageAspectFlags aspect, uint32_t mip_level,
+                       uint32_t array_layer, VkExtent3D extent, const void* data, VkDeviceSize size,
+                       VkImageLayout final_layout);
+
+// Submits the open batch, if any. Returns the timeline value that marks completion of everything queued so far,
+// 0 when the submission failed and the open batch was dropped.
+uint64_t VulkanUploadFlush(VulkanUploader* up);
+
+// Records the pending ownership acquires into a graphics command buffer. Its submission must wait on
+// up->timeline for the returned value (0 when there is nothing to wait for).
+uint64_t VulkanUploadAcquire(VulkanUploader* up, VkCommandBuffer cmd);
+
+bool VulkanUploadIsComplete(VulkanUploader* up, uint64_t value);
+void VulkanUploadWait(VulkanUploader* up, uint64_t value);
@@ -1,8 +1,26 @@
 #include "window.h"
 #include "debug.h"
+#include "pool.h"
 
 namespace ZX {
 
+// Legacy window structs handed to the C code live in a pool instead of individual heap blocks
+static Pool<::Window, 8>& LegacyWindowPool()
+{
+    static Pool<::Window, 8> pool;
+    return pool;
+}
+
+static ::Window* CreateLegacyWindow()
+{
+    return LegacyWindowPool().Get(LegacyWindowPool().Create());
+}
+
+static void DestroyLegacyWindow(::Window* window)
+{
+    LegacyWindowPool().Destroy(LegacyWindowPool().HandleOf(window));
+}
+
 // Static class name for Win32 window registration
 static constexpr const char* CLASS_NAME = "ENGINE_WindowClass";
 
@@ -39,7 +57,7 @@ Window::Window()
     , m_legacyWindow(nullptr)
 {
     // Create a legacy window struct for compatibility with old code
-    m_legacyWindow = new ::Window();
+    m_legacyWindow = CreateLegacyWindow();
 }
 
 // Window destructor - automatically destroy window if not already done
@@ -50,7 +68,7 @@ Window::~Window() {
     
     // Free the legacy window struct
     if (m_legacyWindow) {
-        delete m_legacyWindow;
+        DestroyLegacyWindow(m_legacyWindow);
         m_legacyWindow = nullptr;
     }
 }
@@ -110,7 +128,7 @@ Window& Window::operator=(Window&& other) noexcept {
     
     // Free the legacy window struct
     if (m_legacyWindow) {
-        delete m_legacyWindow;
+        DestroyLegacyWindow(m_legacyWindow);
     }
     
     // Copy all properties
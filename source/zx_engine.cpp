@@ -7,15 +7,43 @@
 #include "debug.h"
 #include "system.h"
 #include "vmath.h"
+#include "arena.h"
+#include "culling.h"
+#include "jobs.h"
+#include "frame.h"
 #include "vulkan.h"
+#include "pipelines.h"
+#include "recorder.h"
+#include "render_graph.h"
+#include "gpu_scene.h"
+#include "vulkan_batch.h"
+#include "bench.h"
 
 // Implementations for window system
 #define IMPLEMENTATION
 #include "window.cpp"
+#include "fiber.cpp"
+#include "jobs.cpp"
+#include "frame.cpp"
+#include "pipelines.cpp"
+#include "recorder.cpp"
+#include "bench.cpp"
 
 // C implementation code - include directly for STU compilation
 // but without extern "C" since vmath.h contains C++ classes
 #include "vmath.c"
+#include "arena.c"
+#include "culling.c"
+#include "tlsf.c"
+#include "vulkan_memory.c"
+#include "vulkan_upload.c"
+#include "vulkan_pipeline_cache.c"
+#include "vulkan_bindless.c"
+#include "vulkan_profiler.c"
+#include "vulkan_compute.c"
+#include "render_graph.c"
+#include "gpu_scene.c"
+#include "vulkan_batch.c"
 #include "vulkan.c"
 
 // Implementation of system utilities
@@ -150,11 +178,84 @@ namespace System {
     }
 } // namespace System
 
+// Renders frame_count frames offscreen with no window and reports the frame rate. Used to measure
+// frame pacing (e.g. on lavapipe) without a display.
+static int RunHeadless(const ZX::Config& cfg, uint32_t frame_count, const char* gpu_trace)
+{
+    Vulkan vk = {};
+    if (!VulkanInitHeadless(&vk, cfg.width, cfg.height, cfg.gpuFramesInFlight)) {
+        PRINT_ERROR("Failed to initialize headless Vulkan\n");
+        VulkanDestroy(&vk);
+        return -1;
+    }
+    if (gpu_trace) {
+        VulkanProfilerOpenTrace(&vk.profiler, gpu_trace);
+    }
+
+    // Counter ticks rather than GetTime(): a float of the uptime is too coarse for per-frame timings
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    for (uint32_t i = 0; i < frame_count; i++) {
+        vk.clearColor.float32[0] = (float)(i % 256) / 255.0f;
+        vk.clearColor.float32[3] = 1.0f;
+
+        VkCommandBuffer cmd = VulkanBeginFrame(&vk);
+        if (cmd) {
+            VulkanEndFrame(&vk);
+        }
+    }
+    vkDeviceWaitIdle(vk.device);
+    QueryPerformanceCounter(&end);
+    double elapsed = (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+
+    PRINT_INFO("Headless: %u frames, %u in flight, %.3f ms/frame (GPU %.3f ms), CPU waited on the GPU in %llu frames\n",
+               frame_count, vk.framesInFlight, elapsed * 1000.0 / (double)frame_count,
+               VulkanProfilerGetAverage(&vk.profiler, VULKAN_PROFILER_FRAME_SCOPE), (unsigned long long)vk.frameStalls);
+
+    VulkanDestroy(&vk);
+    return 0;
+}
+
 // Entry point
-int main()
+int main(int argc, char** argv)
 {
     // Create configuration with default values
     ZX::Config cfg;
+
+    // --gpu-trace <file> writes GPU scope timings as Chrome trace events
+    const char* gpuTrace = NULL;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--gpu-trace") == 0) {
+            gpuTrace = argv[i + 1];
+        }
+    }
+
+    // --headless [frames] renders offscreen without opening a window
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            uint32_t frames = (i + 1 < argc) ? (uint32_t)atoi(argv[i + 1]) : 0;
+            return RunHeadless(cfg, frames ? frames : 1000, gpuTrace);
+        }
+    }
+
+    // --bench [name] runs the CPU micro-benchmarks (all of them without a name) and exits; non-zero when a
+    // result disagrees with its reference
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            const char* name = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[i + 1] : NULL;
+            return ZX::RunBenchmarks(name) == 0 ? 0 : -1;
+        }
+    }
+
+    // --resize-storm [frames] resizes the window every frame and reports frame times, then exits
+    uint32_t resizeStorm = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--resize-storm") == 0) {
+            resizeStorm = (i + 1 < argc) ? (uint32_t)atoi(argv[i + 1]) : 0;
+            resizeStorm = resizeStorm ? resizeStorm : 600;
+        }
+    }
     
     // Create window using the modernized Window class
     auto window = ZX::Window::Create(cfg);
@@ -180,13 +281,106 @@ int main()
     // Initialize Vulkan - using the legacy window struct through our compatibility layer
     Vulkan vk = {};
     Window* compatWindow = *window;
-    VulkanInit(&vk, compatWindow);
+    vk.bindlessRequested = cfg.bindless;
+    VulkanInit(&vk, compatWindow, cfg.gpuFramesInFlight);
+    if (gpuTrace) {
+        VulkanProfilerOpenTrace(&vk.profiler, gpuTrace);
+    }
+
+    // Worker pool sized from the core count; the main thread joins in whenever it waits on jobs, and so
+    // does the render thread, which gets the one external slot
+    auto jobs = ZX::JobSystem::Create(0, 1);
+    // GetThreadCount counts every slot: the main thread, the workers and the render thread's external one
+    PRINT_INFO("Job system running %u workers + main thread + 1 external slot\n", jobs->GetThreadCount() - 2);
+
+    // Every pipeline permutation used last session compiles on the workers while we start up;
+    // the renderer only compiles the ones it asks for before their job got to them
+    // In bindless mode every pipeline shares the bindless layout
+    auto pipelines = ZX::PipelineManager::Create(&vk, jobs.get(), "pipelines.manifest", vk.bindless.pipelineLayout);
+    if (pipelines) {
+        pipelines->PrecompileAsync();
+    }
+
+    // Draw lists are recorded into secondary command buffers across the job threads
+    auto recorder = ZX::CommandRecorder::Create(&vk, jobs.get());
+    
+    // Render submission runs on its own thread, up to cfg.framesInFlight frames behind simulation.
+    // All Vulkan work, including swapchain recreation, happens on that side.
+    auto pipeline = ZX::FramePipeline::Create(cfg.framesInFlight, [&](const ZX::RenderState& state) {
+        if (pipelines) {
+            pipelines->Update();
+        }
+
+        if (state.resized) {
+            // Rebuilt at the start of the next frame, together with out-of-date reports from the driver
+            vk.swapchainDirty = true;
+        }
+
+        // Waits only when the GPU is a full gpuFramesInFlight behind. Also sends off the copies queued
+        // since the last frame; they run on the transfer queue meanwhile.
+        VkCommandBuffer cmd = VulkanBeginFrame(&vk);
+        if (!cmd) {
+            return;     // Minimized or out of date, nothing to draw into
+        }
+
+        // Render commands for state.frameIndex would go here, large draw lists through recorder->Record...
+
+        VulkanEndFrame(&vk);
+    });
+
+    // Transient per-frame memory, one arena per frame in flight per job thread, reset automatically
+    // when a frame slot comes around again. Both sides index it with RenderState::frameIndex.
+    FrameArena frameArena;
+    FrameArenaInit(&frameArena, pipeline->GetFramesInFlight(), jobs->GetThreadCount(), 1024 * 1024);
+
+    float lastTime = GetTime();
+
+    LARGE_INTEGER stormFrequency, stormLast;
+    QueryPerformanceFrequency(&stormFrequency);
+    QueryPerformanceCounter(&stormLast);
+    uint32_t stormFrame = 0;
+    double stormTotal = 0.0, stormWorst = 0.0;
     
     // Main game loop
     while (window->IsRunning())
     {
+        if (resizeStorm) {
+            if (stormFrame == resizeStorm) {
+                break;
+            }
+
+            // Several sizes per frame, as a drag delivers them; only the last one should cost a recreate
+            for (uint32_t j = 0; j < 4; j++) {
+                uint32_t step = stormFrame * 4 + j;
+                window->SetSize(cfg.width - (step * 7) % 400, cfg.height - (step * 5) % 300);
+            }
+
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            double ms = (double)(now.QuadPart - stormLast.QuadPart) * 1000.0 / (double)stormFrequency.QuadPart;
+            stormLast = now;
+            if (stormFrame > 0) {
+                stormTotal += ms;
+                stormWorst = ms > stormWorst ? ms : stormWorst;
+            }
+            stormFrame++;
+        }
+
         // Process window events
         window->Update();
+
+        // Blocks only when the renderer is a full framesInFlight behind
+        ZX::RenderState* state = pipeline->BeginSimulation();
+        FrameArenaBegin(&frameArena, state->frameIndex);
+
+        float time = GetTime();
+        state->time = time;
+        state->deltaTime = time - lastTime;
+        state->width = window->GetWidth();
+        state->height = window->GetHeight();
+        state->resized = false;
+        state->viewProj = identity();
+        lastTime = time;
         
         // Check if window was resized
         if (window->CheckResized())
@@ -195,17 +389,35 @@ int main()
             if (window->GetWidth() > 0 && window->GetHeight() > 0)
             {
                 PRINT("Window resized to %d x %d\n", window->GetWidth(), window->GetHeight());
-                
-                // Recreate swapchain with same presentation mode as before
-                VulkanRecreateSwapchain(&vk, cfg.vsync ? VULKAN_PRESENT_MODE_FIFO : VULKAN_PRESENT_MODE_MAILBOX);
+                state->resized = true;
             }
         }
         
-        // Main game update and render code would go here...
+        // Main game update code would go here, filling in the rest of the render state...
+
+        pipeline->EndSimulation();
     }
+
+    // Let the render thread finish its queued frames before tearing anything down
+    pipeline.reset();
+
+    if (resizeStorm && stormFrame > 1) {
+        PRINT_INFO("Resize storm: %u frames, %.3f ms/frame average, %.3f ms worst, %u swapchain recreations, "
+                   "%u resizes coalesced\n", stormFrame, stormTotal / (double)(stormFrame - 1), stormWorst,
+                   vk.swapchainRecreations, vk.swapchainResizesSkipped);
+    }
+    // Nothing in the loop allocates from it yet (--bench arena exercises it); stay quiet until something does
+    if (frameArena.peak > 0) {
+        PRINT_DEBUG("Frame arena peak: %zu bytes per frame\n", frameArena.peak);
+    }
+    FrameArenaDestroy(&frameArena);
+
+    // Records this session's permutations; its pipeline caches are merged before VulkanDestroy saves them
+    pipelines.reset();
     
     // Wait for the device to finish operations before cleanup
     vkDeviceWaitIdle(vk.device);
+    recorder.reset();
     
     // Clean up resources
     VulkanDestroy(&vk);